@@ -0,0 +1,83 @@
+// Copyright 2018 Google Inc. All Rights Reserved.
+//
+// This example compares the size and query performance of the different
+// point index representations: S2PointIndex (an in-memory btree), and
+// S2PointIndexStatic using either the Elias-Fano (ef_map) or the
+// block-structured (block_map) layout.
+
+#include <chrono>
+#include <cinttypes>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+#include "s2/base/commandlineflags.h"
+#include "s2/s2earth.h"
+#include "s2/s1chord_angle.h"
+#include "s2/s2closest_point_query.h"
+#include "s2/s2point_index.h"
+#include "s2/s2point_index_static.h"
+#include "s2/s2testing.h"
+#include "s2/util/compressed_maps/compressed_maps.h"
+
+DEFINE_int32(num_index_points, 1000000, "Number of points to index");
+DEFINE_int32(num_queries, 100000, "Number of queries");
+DEFINE_int32(max_results, 10, "Maximum number of results per query");
+DEFINE_double(query_radius_km, 10, "Query radius in kilometers");
+
+// Runs FLAGS_num_queries closest point queries against "index" and prints
+// the average time per query.
+template <class Index>
+void RunQueries(const char* name, const Index& index, size_t bytes_used,
+                const std::vector<S2Point>& targets) {
+  S2ClosestPointQuery<int, Index> query(&index);
+  query.mutable_options()->set_max_results(FLAGS_max_results);
+  query.mutable_options()->set_max_distance(
+      S1Angle::Radians(S2Earth::KmToRadians(FLAGS_query_radius_km)));
+
+  auto start = std::chrono::steady_clock::now();
+  int64_t num_found = 0;
+  for (const S2Point& target_point : targets) {
+    typename S2ClosestPointQuery<int, Index>::PointTarget target(target_point);
+    num_found += query.FindClosestPoints(&target).size();
+  }
+  std::chrono::duration<double, std::micro> elapsed =
+      std::chrono::steady_clock::now() - start;
+  std::printf("%-24s %12zu bytes %10.3f us/query  (found %" PRId64 ")\n",
+              name, bytes_used, elapsed.count() / targets.size(), num_found);
+}
+
+int main(int argc, char **argv) {
+  std::vector<S2Point> points;
+  for (int i = 0; i < FLAGS_num_index_points; ++i) {
+    points.push_back(S2Testing::RandomPoint());
+  }
+  std::vector<S2Point> targets;
+  for (int i = 0; i < FLAGS_num_queries; ++i) {
+    targets.push_back(S2Testing::RandomPoint());
+  }
+
+  S2PointIndex<int> index;
+  for (int i = 0; i < points.size(); ++i) {
+    index.Add(points[i], i);
+  }
+  RunQueries("S2PointIndex", index, index.bytes_used(), targets);
+
+  S2PointIndexStaticEF<int> ef_index;
+  {
+    S2PointIndexStaticEF<int>::builder builder;
+    for (int i = 0; i < points.size(); ++i) builder.Add(points[i], i);
+    builder.build(ef_index);
+  }
+  RunQueries("S2PointIndexStaticEF", ef_index, ef_index.bytes_used(),
+             targets);
+
+  S2PointIndexStaticBlock<int> block_index;
+  {
+    S2PointIndexStaticBlock<int>::builder builder;
+    for (int i = 0; i < points.size(); ++i) builder.Add(points[i], i);
+    builder.build(block_index);
+  }
+  RunQueries("S2PointIndexStaticBlock", block_index, block_index.bytes_used(),
+             targets);
+  return  0;
+}
@@ -0,0 +1,142 @@
+// Copyright 2018 Google Inc. All Rights Reserved.
+//
+// This example compares the running time of the pruned polyline distance
+// predicates with the corresponding brute-force computations, for pairs of
+// similar polylines of increasing size:
+//
+//  - IsDiscreteFrechetDistanceLess() and GetBandedDiscreteFrechetDistance()
+//    versus GetDiscreteFrechetDistance(), which fills in the full table.
+//
+//  - S2ShapeIndexDistanceQuery::IsHausdorffDistanceLess() versus
+//    GetHausdorffDistance() and a loop that runs an S2ClosestEdgeQuery for
+//    every vertex of each polyline.
+//
+// Each predicate is timed both with a limit just above the actual distance
+// (so that the answer is "true") and with a limit of half the distance.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <memory>
+#include <vector>
+#include "s2/base/commandlineflags.h"
+#include "s2/third_party/absl/memory/memory.h"
+#include "s2/mutable_s2shape_index.h"
+#include "s2/s1angle.h"
+#include "s2/s1chord_angle.h"
+#include "s2/s2cap.h"
+#include "s2/s2closest_edge_query.h"
+#include "s2/s2polyline.h"
+#include "s2/s2polyline_alignment.h"
+#include "s2/s2shape_index_distance_query.h"
+#include "s2/s2testing.h"
+
+DEFINE_int32(min_vertices, 256, "Number of vertices in the smallest input");
+DEFINE_int32(max_vertices, 16384, "Number of vertices in the largest input");
+DEFINE_int32(band_radius, 4, "Radius for GetBandedDiscreteFrechetDistance");
+DEFINE_double(perturbation, 0.5,
+              "Maximum vertex perturbation, as a fraction of the edge length");
+
+using s2polyline_alignment::GetBandedDiscreteFrechetDistance;
+using s2polyline_alignment::GetDiscreteFrechetDistance;
+using s2polyline_alignment::IsDiscreteFrechetDistanceLess;
+
+// Returns a polyline that approximates a circle of radius 0.01 radians
+// around "center" using "num_vertices" vertices, each perturbed randomly.
+std::unique_ptr<S2Polyline> MakeNoisyArc(const S2Point& center,
+                                         int num_vertices) {
+  static const double kRadius = 0.01;
+  S1Angle max_error = S1Angle::Radians(FLAGS_perturbation * 2 * M_PI *
+                                       kRadius / num_vertices);
+  std::vector<S2Point> vertices;
+  for (const S2Point& p : S2Testing::MakeRegularPoints(
+           center, S1Angle::Radians(kRadius), num_vertices)) {
+    vertices.push_back(S2Testing::SamplePoint(S2Cap(p, max_error)));
+  }
+  vertices.pop_back();  // Keep the polyline open.
+  return absl::make_unique<S2Polyline>(vertices);
+}
+
+// Calls "fn" once and returns the elapsed time in milliseconds.
+template <class Fn>
+double TimeMs(const Fn& fn) {
+  auto start = std::chrono::steady_clock::now();
+  fn();
+  std::chrono::duration<double, std::milli> elapsed =
+      std::chrono::steady_clock::now() - start;
+  return elapsed.count();
+}
+
+// Returns the maximum over the vertices of "a" of the distance to the
+// closest edge of "b_index".
+S1ChordAngle GetMaxVertexDistance(const S2Polyline& a,
+                                  const MutableS2ShapeIndex& b_index) {
+  S2ClosestEdgeQuery query(&b_index);
+  S1ChordAngle max_dist = S1ChordAngle::Zero();
+  for (int i = 0; i < a.num_vertices(); ++i) {
+    S2ClosestEdgeQuery::PointTarget target(a.vertex(i));
+    max_dist = std::max(max_dist, query.GetDistance(&target));
+  }
+  return max_dist;
+}
+
+void RunFrechet(const S2Polyline& a, const S2Polyline& b) {
+  S1ChordAngle dist, banded;
+  bool less_above = false, less_below = true;
+  double exact_ms = TimeMs([&]() {
+    dist = GetDiscreteFrechetDistance(a, b);
+  });
+  double banded_ms = TimeMs([&]() {
+    banded = GetBandedDiscreteFrechetDistance(a, b, FLAGS_band_radius);
+  });
+  double above_ms = TimeMs([&]() {
+    less_above = IsDiscreteFrechetDistanceLess(a, b, dist.Successor());
+  });
+  S1ChordAngle half = S1ChordAngle::FromLength2(dist.length2() / 4);
+  double below_ms = TimeMs([&]() {
+    less_below = IsDiscreteFrechetDistanceLess(a, b, half);
+  });
+  std::printf("  Frechet:   exact %9.2f ms  banded %7.2f ms (%s)  "
+              "less(above) %7.2f ms  less(below) %7.2f ms%s\n",
+              exact_ms, banded_ms, banded == dist ? "exact" : "upper bound",
+              above_ms, below_ms,
+              (less_above && !less_below) ? "" : "  MISMATCH");
+}
+
+void RunHausdorff(const S2Polyline& a, const S2Polyline& b) {
+  MutableS2ShapeIndex a_index, b_index;
+  a_index.Add(absl::make_unique<S2Polyline::Shape>(&a));
+  b_index.Add(absl::make_unique<S2Polyline::Shape>(&b));
+  S1ChordAngle vertex_dist, dist;
+  bool less_above = false, less_below = true;
+  double vertex_ms = TimeMs([&]() {
+    vertex_dist = std::max(GetMaxVertexDistance(a, b_index),
+                           GetMaxVertexDistance(b, a_index));
+  });
+  S2ShapeIndexDistanceQuery query(&a_index, &b_index);
+  double exact_ms = TimeMs([&]() { dist = query.GetHausdorffDistance(); });
+  double above_ms = TimeMs([&]() {
+    less_above = query.IsHausdorffDistanceLess(dist.Successor());
+  });
+  S1ChordAngle half = S1ChordAngle::FromLength2(dist.length2() / 4);
+  double below_ms = TimeMs([&]() {
+    less_below = query.IsHausdorffDistanceLess(half);
+  });
+  std::printf("  Hausdorff: per-vertex %7.2f ms  exact %7.2f ms  "
+              "less(above) %7.2f ms  less(below) %7.2f ms%s\n",
+              vertex_ms, exact_ms, above_ms, below_ms,
+              (less_above && !less_below) ? "" : "  MISMATCH");
+}
+
+int main(int argc, char **argv) {
+  S2Point center = S2Testing::RandomPoint();
+  for (int n = FLAGS_min_vertices; n <= FLAGS_max_vertices; n *= 2) {
+    auto a = MakeNoisyArc(center, n);
+    auto b = MakeNoisyArc(center, n);
+    std::printf("%d vertices:\n", a->num_vertices());
+    RunFrechet(*a, *b);
+    RunHausdorff(*a, *b);
+  }
+  return 0;
+}
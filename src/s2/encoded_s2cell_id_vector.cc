@@ -25,6 +25,13 @@ using std::vector;
 namespace s2coding {
 
 void EncodeS2CellIdVector(Span<const S2CellId> v, Encoder* encoder) {
+  EncodeS2CellIdVector(v, 0, encoder);
+}
+
+void EncodeS2CellIdVector(Span<const S2CellId> v, int directory_shift,
+                          Encoder* encoder) {
+  S2_DCHECK(directory_shift >= 0 && directory_shift <= 31);
+
   // v[i] is encoded as (base + (deltas[i] << shift)).
   //
   // "base" consists of 0-7 bytes, and is always shifted so that its bytes are
@@ -43,6 +50,18 @@ void EncodeS2CellIdVector(Span<const S2CellId> v, Encoder* encoder) {
   //   - otherwise 2 bytes
   // Note that (shift == 1) means that all S2CellIds are leaf cells, and
   // (shift == 2) means that all S2CellIds are at level 29.
+  //
+  // If a directory is present (see below) then the 2-byte form is always
+  // used, and the second byte is encoded as follows:
+  //   bits 0-4: shift >> 1
+  //   bit 5:    shift is even
+  //   bit 6:    a directory is present
+  // Encodings without a directory leave bits 5-7 zero, and are therefore
+  // decoded exactly as before.
+  //
+  // The optional directory follows "base" and consists of one byte
+  // containing "directory_shift" followed by an EncodedUintVector<uint64>
+  // containing every (1 << directory_shift)-th delta.
   uint64 v_or = 0, v_and = ~0ULL, v_min = ~0ULL, v_max = 0;
   for (auto cellid : v) {
     v_or |= cellid.id();
@@ -90,29 +109,41 @@ void EncodeS2CellIdVector(Span<const S2CellId> v, Encoder* encoder) {
   }
   S2_DCHECK_LE(e_base_len, 7);
   S2_DCHECK_LE(e_shift, 56);
-  encoder->Ensure(2 + e_base_len);
+  encoder->Ensure(3 + e_base_len);
 
   // As described above, "shift" and "base_len" are encoded in 1 or 2 bytes.
   // "shift_code" is 5 bits:
   //   values <= 28 represent even shifts in the range 0..56
   //   values 29, 30 represent odd shifts 1 and 3
-  //   value 31 indicates that the shift is odd and encoded in the next byte
+  //   value 31 indicates that the shift is encoded in the next byte
   int shift_code = e_shift >> 1;
   if (e_shift & 1) shift_code = min(31, shift_code + 29);
+  if (directory_shift > 0) shift_code = 31;
   encoder->put8((shift_code << 3) | e_base_len);
   if (shift_code == 31) {
-    encoder->put8(e_shift >> 1);  // Shift is always odd, so 3 bits unused.
+    int flags = 0;
+    if (!(e_shift & 1)) flags |= 0x20;
+    if (directory_shift > 0) flags |= 0x40;
+    encoder->put8(flags | (e_shift >> 1));
   }
   // Encode the "base_len" most-significant bytes of "base".
   uint64 base_bytes = e_base >> (64 - 8 * max(1, e_base_len));
   EncodeUintWithLength<uint64>(base_bytes, e_base_len, encoder);
 
-  // Finally, encode the vector of deltas.
   vector<uint64> deltas;
   deltas.reserve(v.size());
   for (auto cellid : v) {
     deltas.push_back((cellid.id() - e_base) >> e_shift);
   }
+  if (directory_shift > 0) {
+    vector<uint64> samples;
+    for (uint64 i = 0; i < deltas.size(); i += uint64{1} << directory_shift) {
+      samples.push_back(deltas[i]);
+    }
+    encoder->put8(directory_shift);
+    EncodeUintVector<uint64>(samples, encoder);
+  }
+  // Finally, encode the vector of deltas.
   EncodeUintVector<uint64>(deltas, encoder);
 }
 
@@ -124,8 +155,13 @@ bool EncodedS2CellIdVector::Init(Decoder* decoder) {
   // Invert the encoding of (shift_code, base_len) described above.
   int code_plus_len = decoder->get8();
   int shift_code = code_plus_len >> 3;
+  bool odd_shift = true, have_directory = false;
   if (shift_code == 31) {
-    shift_code = 29 + decoder->get8();
+    int shift_byte = decoder->get8();
+    if (shift_byte & 0x80) return false;
+    odd_shift = !(shift_byte & 0x20);
+    have_directory = (shift_byte & 0x40) != 0;
+    shift_code = (odd_shift ? 29 : 0) + (shift_byte & 0x1f);
   }
   // Decode the "base_len" most-significant bytes of "base".
   int base_len = code_plus_len & 7;
@@ -133,19 +169,37 @@ bool EncodedS2CellIdVector::Init(Decoder* decoder) {
   base_ <<= 64 - 8 * max(1, base_len);
 
   // Invert the encoding of "shift_code" described above.
-  if (shift_code >= 29) {
+  if (odd_shift && shift_code >= 29) {
     shift_ = 2 * (shift_code - 29) + 1;
     base_ |= 1ULL << (shift_ - 1);
   } else {
     shift_ = 2 * shift_code;
   }
-  return deltas_.Init(decoder);
+  if (shift_ > 56) return false;
+
+  directory_shift_ = 0;
+  directory_.Clear();
+  if (have_directory) {
+    if (decoder->avail() < 1) return false;
+    directory_shift_ = decoder->get8();
+    if (directory_shift_ == 0 || directory_shift_ > 31) return false;
+    if (!directory_.Init(decoder)) return false;
+  }
+  if (!deltas_.Init(decoder)) return false;
+  if (directory_shift_ != 0 &&
+      directory_.size() !=
+      ((deltas_.size() + (size_t{1} << directory_shift_) - 1) >>
+       directory_shift_)) {
+    return false;
+  }
+  return true;
 }
 
 vector<S2CellId> EncodedS2CellIdVector::Decode() const {
-  vector<S2CellId> result(size());
-  for (int i = 0; i < size(); ++i) {
-    result[i] = (*this)[i];
+  vector<uint64> deltas = deltas_.Decode();
+  vector<S2CellId> result(deltas.size());
+  for (int i = 0; i < deltas.size(); ++i) {
+    result[i] = S2CellId((deltas[i] << shift_) + base_);
   }
   return result;
 }
@@ -17,6 +17,7 @@
 
 #include "s2/encoded_s2cell_id_vector.h"
 
+#include <algorithm>
 #include <vector>
 #include <gtest/gtest.h>
 #include "s2/third_party/absl/memory/memory.h"
@@ -229,4 +230,55 @@ TEST(EncodedS2CellIdVector, LowerBoundLimits) {
   EXPECT_EQ(2, cell_ids.lower_bound(S2CellId::Sentinel()));
 }
 
+TEST(EncodedS2CellIdVector, DirectoryLowerBound) {
+  for (int n : {0, 1, 2, 3, 4, 5, 31, 32, 33, 1000}) {
+    for (int directory_shift : {1, 2, 5, 8}) {
+      for (int level : {10, 30, -1}) {
+        // Generate sorted ids with duplicates, either at a fixed level (which
+        // yields an odd or even shift) or at random levels.
+        vector<S2CellId> ids;
+        for (int i = 0; i < n; ++i) {
+          ids.push_back(level >= 0 ? S2Testing::GetRandomCellId(level)
+                                   : S2Testing::GetRandomCellId());
+          if (S2Testing::rnd.OneIn(5)) ids.push_back(ids.back());
+        }
+        std::sort(ids.begin(), ids.end());
+        Encoder encoder;
+        EncodeS2CellIdVector(ids, directory_shift, &encoder);
+        Decoder decoder(encoder.base(), encoder.length());
+        EncodedS2CellIdVector actual;
+        ASSERT_TRUE(actual.Init(&decoder));
+        EXPECT_EQ(0, decoder.avail());
+        EXPECT_EQ(ids, actual.Decode());
+
+        vector<S2CellId> targets = {S2CellId::None(), S2CellId::Sentinel()};
+        for (S2CellId id : ids) {
+          targets.push_back(id);
+          targets.push_back(id.next());
+          targets.push_back(id.prev());
+        }
+        for (S2CellId target : targets) {
+          EXPECT_EQ(std::lower_bound(ids.begin(), ids.end(), target) -
+                    ids.begin(), actual.lower_bound(target));
+        }
+      }
+    }
+  }
+}
+
+TEST(EncodedS2CellIdVector, DirectorySize) {
+  // The directory should add roughly 1 / (1 << directory_shift) of the space
+  // used by the deltas.
+  vector<S2CellId> ids;
+  for (int i = 0; i < 10000; ++i) {
+    ids.push_back(S2Testing::GetRandomCellId(20));
+  }
+  std::sort(ids.begin(), ids.end());
+  Encoder plain, sampled;
+  EncodeS2CellIdVector(ids, &plain);
+  EncodeS2CellIdVector(ids, 6, &sampled);
+  EXPECT_GT(sampled.length(), plain.length());
+  EXPECT_LT(sampled.length(), plain.length() + plain.length() / 50);
+}
+
 }  // namespace s2coding
@@ -17,7 +17,17 @@
 
 #include "s2/encoded_s2point_vector.h"
 
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+#include "s2/util/bits/bits.h"
+#include "s2/s2cell_id.h"
+#include "s2/s2coords.h"
+
 using absl::Span;
+using std::max;
+using std::min;
 using std::vector;
 
 namespace s2coding {
@@ -29,29 +39,83 @@ namespace s2coding {
 // encoding the actual format separately, but it seems unlikely we will ever
 // need to do that.
 static const int kEncodingFormatBits = 3;
+static const uint8 kEncodingFormatMask = (1 << kEncodingFormatBits) - 1;
+
+void EncodeS2PointVectorFast(Span<const S2Point> points, Encoder* encoder);
+void EncodeS2PointVectorCompact(Span<const S2Point> points, Encoder* encoder);
 
-void EncodeS2PointVector(Span<const S2Point> v, CodingHint hint,
+void EncodeS2PointVector(Span<const S2Point> points, CodingHint hint,
                          Encoder* encoder) {
-  // TODO(ericv): Implement CodingHint::COMPACT.
+  switch (hint) {
+    case CodingHint::FAST:
+      return EncodeS2PointVectorFast(points, encoder);
+
+    case CodingHint::COMPACT:
+      return EncodeS2PointVectorCompact(points, encoder);
+
+    default:
+      S2_LOG(DFATAL) << "Unknown CodingHint: " << static_cast<int>(hint);
+  }
+}
+
+bool EncodedS2PointVector::Init(Decoder* decoder) {
+  if (decoder->avail() < 1) return false;
+
+  // Peek at the format but don't advance the decoder; the format-specific
+  // Init functions will do that.
+  format_ = static_cast<Format>(*decoder->ptr() & kEncodingFormatMask);
+  switch (format_) {
+    case UNCOMPRESSED:
+      return InitUncompressedFormat(decoder);
 
-  encoder->Ensure(Varint::kMax64 + v.size() * sizeof(S2Point));
-  uint64 size_format = (v.size() << kEncodingFormatBits |
+    case CELL_ID:
+      return InitCellIdsFormat(decoder);
+
+    default:
+      return false;
+  }
+}
+
+vector<S2Point> EncodedS2PointVector::Decode() const {
+  if (format_ == UNCOMPRESSED) {
+    return vector<S2Point>(uncompressed_.points, uncompressed_.points + size_);
+  }
+  vector<S2Point> points;
+  points.reserve(size_);
+  for (int i = 0; i < size_; ++i) {
+    points.push_back((*this)[i]);
+  }
+  return points;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//                     UNCOMPRESSED Encoding Format
+//////////////////////////////////////////////////////////////////////////////
+
+// Encodes a vector of points, optimizing for (encoding and decoding) speed.
+void EncodeS2PointVectorFast(Span<const S2Point> points, Encoder* encoder) {
+  // The header consists of a varint64 in the following format:
+  //
+  //   bits 0-2:  encoding format (UNCOMPRESSED)
+  //   bits 3-63: vector size
+  //
+  // This is followed by an array of S2Points in little-endian order.
+  encoder->Ensure(Varint::kMax64 + points.size() * sizeof(S2Point));
+  uint64 size_format = (points.size() << kEncodingFormatBits |
                         EncodedS2PointVector::UNCOMPRESSED);
   encoder->put_varint64(size_format);
-  encoder->putn(v.data(), v.size() * sizeof(S2Point));
+  encoder->putn(points.data(), points.size() * sizeof(S2Point));
 }
 
-bool EncodedS2PointVector::Init(Decoder* decoder) {
-  uint64 size_format;
-  if (!decoder->get_varint64(&size_format)) return false;
-  format_ = static_cast<Format>(size_format & ((1 << kEncodingFormatBits) - 1));
-  if (format_ != UNCOMPRESSED) return false;
+bool EncodedS2PointVector::InitUncompressedFormat(Decoder* decoder) {
+  uint64 size;
+  if (!decoder->get_varint64(&size)) return false;
+  size >>= kEncodingFormatBits;
 
   // Note that the encoding format supports up to 2**59 vertices, but we
   // currently only support decoding up to 2**32 vertices.
-  size_format >>= kEncodingFormatBits;
-  if (size_format > std::numeric_limits<uint32>::max()) return false;
-  size_ = size_format;
+  if (size > std::numeric_limits<uint32>::max()) return false;
+  size_ = size;
 
   size_t bytes = size_t{size_} * sizeof(S2Point);
   if (decoder->avail() < bytes) return false;
@@ -61,8 +125,406 @@ bool EncodedS2PointVector::Init(Decoder* decoder) {
   return true;
 }
 
-vector<S2Point> EncodedS2PointVector::Decode() const {
-  return vector<S2Point>(uncompressed_.points, uncompressed_.points + size_);
+//////////////////////////////////////////////////////////////////////////////
+//                     CELL_ID Encoding Format
+//////////////////////////////////////////////////////////////////////////////
+
+// Points are encoded in fixed-size blocks of kBlockSize values, so that any
+// value can be located in constant time.
+static const int kBlockShift = 4;
+static const int kBlockSize = 1 << kBlockShift;
+
+// Marks a point that cannot be encoded as an S2CellId center.
+static const uint64 kException = ~uint64{0};
+
+// Represents a point as (face, si, ti) coordinates together with the level
+// of the S2CellId whose center it is, or level == -1 if it is not an
+// S2CellId center.
+struct CellPoint {
+  int level, face;
+  uint32 si, ti;
+};
+
+// Describes how the values of one block are encoded (see below).
+struct BlockCode {
+  int delta_nibbles;    // Bits per delta / 4 (1-16).
+  int overlap_nibbles;  // Overlap between the offset and deltas (0 or 1).
+  int offset_bytes;     // Bytes used to encode the offset (0-7).
+  uint64 offset;        // Added to all deltas after shifting.
+};
+
+// Returns a bit mask with "n" low-order 1 bits, for 0 <= n <= 64.
+static inline uint64 BitMask(int n) {
+  return (n == 0) ? 0 : (~uint64{0} >> (64 - n));
+}
+
+// Returns the maximum number of bits per value at the given S2CellId level.
+static inline int MaxBitsForLevel(int level) {
+  return 2 * level + 3;
+}
+
+// Returns the number of low-order bits of "base" that are not encoded when
+// "base" is encoded using "base_bytes" bytes at the given level.
+static inline int BaseShift(int level, int base_bytes) {
+  return max(0, MaxBitsForLevel(level) - 8 * base_bytes);
+}
+
+// Returns the number of bytes needed to encode "value".
+static inline int BytesForValue(uint64 value) {
+  return (value == 0) ? 0 : (Bits::Log2FloorNonZero64(value) >> 3) + 1;
+}
+
+// Returns "offset << shift", where "shift" may be 64.
+static inline uint64 ShiftOffset(uint64 offset, int shift) {
+  return (shift >= 64) ? 0 : (offset << shift);
+}
+
+// Spreads the bits of "v" so that each pair of bits is followed by two zero
+// bits, e.g. 0b1101 becomes 0b00110001.
+static inline uint64 SpreadBitPairs(uint32 v) {
+  uint64 x = v;
+  x = (x | (x << 16)) & 0x0000ffff0000ffffULL;
+  x = (x | (x << 8)) & 0x00ff00ff00ff00ffULL;
+  x = (x | (x << 4)) & 0x0f0f0f0f0f0f0f0fULL;
+  x = (x | (x << 2)) & 0x3333333333333333ULL;
+  return x;
+}
+
+// The inverse of SpreadBitPairs (ignoring the bits of "x" that
+// SpreadBitPairs always sets to zero).
+static inline uint32 CompactBitPairs(uint64 x) {
+  x &= 0x3333333333333333ULL;
+  x = (x | (x >> 2)) & 0x0f0f0f0f0f0f0f0fULL;
+  x = (x | (x >> 4)) & 0x00ff00ff00ff00ffULL;
+  x = (x | (x >> 8)) & 0x0000ffff0000ffffULL;
+  x = (x | (x >> 16)) & 0x00000000ffffffffULL;
+  return x;
+}
+
+// Like InterleaveUint32, but interleaves pairs of bits rather than
+// individual bits.  This is faster to decode and compresses almost as well.
+static inline uint64 InterleaveBitPairs(uint32 val0, uint32 val1) {
+  return SpreadBitPairs(val0) | (SpreadBitPairs(val1) << 2);
+}
+
+static inline void DeinterleaveBitPairs(uint64 code, uint32* val0,
+                                        uint32* val1) {
+  *val0 = CompactBitPairs(code);
+  *val1 = CompactBitPairs(code >> 2);
+}
+
+// Converts every point to (face, si, ti) coordinates and returns the
+// S2CellId level at which the largest number of points are cell centers, or
+// -1 if no point is a cell center.
+static int ChooseBestLevel(Span<const S2Point> points,
+                           vector<CellPoint>* cell_points) {
+  cell_points->clear();
+  cell_points->reserve(points.size());
+  int level_counts[S2CellId::kMaxLevel + 1] = {0};
+  for (const S2Point& point : points) {
+    CellPoint p;
+    p.level = S2::XYZtoFaceSiTi(point, &p.face, &p.si, &p.ti);
+    if (p.level >= 0) ++level_counts[p.level];
+    cell_points->push_back(p);
+  }
+  int best_level = -1;
+  for (int level = 0; level <= S2CellId::kMaxLevel; ++level) {
+    if (level_counts[level] > 0 &&
+        (best_level < 0 || level_counts[level] > level_counts[best_level])) {
+      best_level = level;
+    }
+  }
+  return best_level;
+}
+
+// Converts each point at the given level to a 64-bit value with at most
+// MaxBitsForLevel(level) bits, and the remaining points to kException.
+static vector<uint64> ConvertCellsToValues(const vector<CellPoint>& cell_points,
+                                           int level, int* num_exceptions) {
+  vector<uint64> values;
+  values.reserve(cell_points.size());
+  *num_exceptions = 0;
+  for (const CellPoint& p : cell_points) {
+    if (p.level != level) {
+      values.push_back(kException);
+      ++*num_exceptions;
+    } else {
+      // "si" and "ti" consist of an (level)-bit value followed by a 1 bit and
+      // (30 - level) 0 bits.  We remove these constant bits and prepend the
+      // face bits, yielding (level + 2) bits for "sj" and (level + 1) bits
+      // for "tj".
+      uint32 sj = (((p.face & 3) << 30) | (p.si >> 1)) >> (30 - level);
+      uint32 tj = (((p.face & 4) << 29) | p.ti) >> (31 - level);
+      values.push_back(InterleaveBitPairs(sj, tj));
+    }
+  }
+  return values;
+}
+
+// Returns the number of bytes needed to encode the deltas of a block.
+static inline int DeltaBytes(int num_values, int delta_nibbles) {
+  return (num_values * delta_nibbles + 1) >> 1;
+}
+
+// Chooses the encoding parameters for a block that minimize its size.
+// Values are encoded as (base + (offset << shift) + delta), where
+// shift = 4 * (delta_nibbles - overlap_nibbles).  Exceptions are encoded
+// using the largest deltas, i.e. the k-th exception of a block is encoded as
+// BitMask(4 * delta_nibbles) - k.
+static BlockCode GetBlockCode(Span<const uint64> values, uint64 base) {
+  uint64 min_delta = ~uint64{0}, max_delta = 0;
+  int num_exceptions = 0;
+  for (uint64 v : values) {
+    if (v == kException) {
+      ++num_exceptions;
+    } else {
+      S2_DCHECK_GE(v, base);
+      min_delta = min(min_delta, v - base);
+      max_delta = max(max_delta, v - base);
+    }
+  }
+  if (num_exceptions == static_cast<int>(values.size())) min_delta = max_delta = 0;
+
+  BlockCode best{16, 0, 0, 0};
+  int best_bytes = std::numeric_limits<int>::max();
+  for (int delta_nibbles = 1; delta_nibbles <= 16; ++delta_nibbles) {
+    for (int overlap_nibbles = 0; overlap_nibbles <= 1; ++overlap_nibbles) {
+      const int shift = 4 * (delta_nibbles - overlap_nibbles);
+      uint64 offset = (shift >= 64) ? 0 : (min_delta >> shift);
+      uint64 range = max_delta - ShiftOffset(offset, shift);
+      bool fits = (delta_nibbles == 16)
+          ? (range <= ~uint64{0} - num_exceptions)
+          : (range + num_exceptions < (uint64{1} << (4 * delta_nibbles)));
+      int offset_bytes = BytesForValue(offset);
+      if (!fits || offset_bytes > 7) continue;
+      int bytes = offset_bytes + DeltaBytes(values.size(), delta_nibbles);
+      if (bytes < best_bytes) {
+        best_bytes = bytes;
+        best = BlockCode{delta_nibbles, overlap_nibbles, offset_bytes, offset};
+      }
+    }
+  }
+  return best;
+}
+
+// Returns the total number of bytes used by the offsets and deltas of all
+// blocks when values are encoded relative to "base".
+static size_t GetBlocksBytes(const vector<uint64>& values, uint64 base) {
+  size_t bytes = 0;
+  for (size_t i = 0; i < values.size(); i += kBlockSize) {
+    size_t n = min<size_t>(kBlockSize, values.size() - i);
+    BlockCode code = GetBlockCode(Span<const uint64>(&values[i], n), base);
+    bytes += 1 + code.offset_bytes + DeltaBytes(n, code.delta_nibbles);
+  }
+  return bytes;
+}
+
+// Chooses "base" and the number of bytes used to encode it so that the
+// total encoded size is minimized.  Note that "base" cannot exceed the
+// minimum value.
+static uint64 ChooseBase(const vector<uint64>& values, int level,
+                         int* base_bytes) {
+  uint64 min_value = kException;
+  for (uint64 v : values) min_value = min(min_value, v);
+  if (min_value == kException) min_value = 0;
+  uint64 base = 0;
+  size_t best_bytes = std::numeric_limits<size_t>::max();
+  for (int bytes = 0; bytes <= 7; ++bytes) {
+    int shift = BaseShift(level, bytes);
+    uint64 candidate = (min_value >> shift) << shift;
+    size_t total = bytes + GetBlocksBytes(values, candidate);
+    if (total < best_bytes) {
+      best_bytes = total;
+      *base_bytes = bytes;
+      base = candidate;
+    }
+    if (shift == 0) break;  // Larger values of "bytes" can't help.
+  }
+  return base;
+}
+
+// Encodes the values relative to "base" as a sequence of blocks (see
+// EncodeS2PointVectorCompact).
+static void EncodeBlocks(Span<const S2Point> points,
+                         const vector<uint64>& values, uint64 base,
+                         Encoder* encoder) {
+  StringVectorEncoder blocks;
+  vector<uint8> deltas;
+  for (int i = 0; i < values.size(); i += kBlockSize) {
+    const int n = min<int>(kBlockSize, values.size() - i);
+    Span<const uint64> block_values(&values[i], n);
+    BlockCode code = GetBlockCode(block_values, base);
+    const int shift = 4 * (code.delta_nibbles - code.overlap_nibbles);
+    const uint64 delta_mask = BitMask(4 * code.delta_nibbles);
+
+    // Pack the deltas as a sequence of nibbles in little-endian order.
+    deltas.assign(DeltaBytes(n, code.delta_nibbles), 0);
+    int block_exceptions = 0;
+    for (int j = 0; j < n; ++j) {
+      uint64 delta = (block_values[j] == kException)
+          ? delta_mask - block_exceptions++
+          : block_values[j] - base - ShiftOffset(code.offset, shift);
+      S2_DCHECK_LE(delta, delta_mask);
+      for (int k = j * code.delta_nibbles; delta != 0; ++k, delta >>= 4) {
+        deltas[k >> 1] |= (delta & 15) << (4 * (k & 1));
+      }
+    }
+    Encoder* block = blocks.AddViaEncoder();
+    block->Ensure(1 + code.offset_bytes + deltas.size() +
+                  block_exceptions * sizeof(S2Point));
+    block->put8(code.offset_bytes | code.overlap_nibbles << 3 |
+                (code.delta_nibbles - 1) << 4);
+    EncodeUintWithLength<uint64>(code.offset, code.offset_bytes, block);
+    block->putn(deltas.data(), deltas.size());
+    for (int j = 0; j < n; ++j) {
+      if (block_values[j] == kException) {
+        block->putn(&points[i + j], sizeof(S2Point));
+      }
+    }
+  }
+  blocks.Encode(encoder);
+}
+
+// Encodes a vector of points, optimizing for space.
+void EncodeS2PointVectorCompact(Span<const S2Point> points, Encoder* encoder) {
+  // OVERVIEW
+  // --------
+  //
+  // We attempt to represent each S2Point as the center of an S2CellId.  All
+  // S2CellIds must be at the same level, which is chosen to maximize the
+  // number of points that can be encoded this way.  Any other points are
+  // stored as exceptions using 24 bytes each.  If the result is not smaller
+  // than the UNCOMPRESSED format then that format is used instead.
+  //
+  // Each encodable point is converted to a 64-bit value with at most
+  // (2 * level + 3) bits by removing the constant low-order bits of its
+  // (si, ti) coordinates, prepending the face bits, and interleaving the
+  // results in pairs of bits.  This is similar to right-shifting the
+  // S2CellId, and gives similar spatial locality, but is faster to decode.
+  //
+  // The values are divided into blocks of kBlockSize, and each value is
+  // encoded as
+  //
+  //   value = base + (offset << shift) + delta
+  //
+  // where "base" is shared by all blocks, "offset" is chosen per block, and
+  // "delta" is a fixed-width value of 1-16 nibbles per block (so that any
+  // value can be decoded in constant time).  The offset may overlap the
+  // deltas by one nibble, which allows narrower deltas when the values of a
+  // block straddle a nibble boundary.  The k-th exception within a block is
+  // encoded as the k-th largest delta, and its S2Point is stored after the
+  // deltas.
+  //
+  // ENCODING FORMAT
+  // ---------------
+  //
+  //   byte 0, bits 0-2: encoding format (CELL_ID)
+  //   byte 0, bit 3:    have_exceptions
+  //   byte 0, bits 4-7: (last_block_count - 1)
+  //   byte 1, bits 0-2: base_bytes
+  //   byte 1, bits 3-7: level (0-30)
+  //   bytes 2+:         base >> BaseShift(level, base_bytes) [base_bytes]
+  //   EncodedStringVector of blocks, each consisting of:
+  //     byte 0, bits 0-2: offset_bytes
+  //     byte 0, bit 3:    overlap_nibbles
+  //     byte 0, bits 4-7: (delta_nibbles - 1)
+  //     bytes 1+:         offset [offset_bytes]
+  //     deltas [ceil(block_count * delta_nibbles / 2)]
+  //     exceptions [num_exceptions * 24]
+  if (points.empty()) return EncodeS2PointVectorFast(points, encoder);
+  vector<CellPoint> cell_points;
+  int level = ChooseBestLevel(points, &cell_points);
+  if (level < 0) return EncodeS2PointVectorFast(points, encoder);
+
+  int num_exceptions;
+  vector<uint64> values = ConvertCellsToValues(cell_points, level,
+                                               &num_exceptions);
+  int base_bytes;
+  uint64 base = ChooseBase(values, level, &base_bytes);
+  const int num_blocks = (values.size() + kBlockSize - 1) >> kBlockShift;
+  const int last_block_count = values.size() - kBlockSize * (num_blocks - 1);
+  Encoder compact;
+  compact.Ensure(2 + base_bytes);
+  compact.put8(EncodedS2PointVector::CELL_ID |
+               (num_exceptions > 0) << 3 | (last_block_count - 1) << 4);
+  compact.put8(base_bytes | level << 3);
+  EncodeUintWithLength<uint64>(base >> BaseShift(level, base_bytes),
+                               base_bytes, &compact);
+  EncodeBlocks(points, values, base, &compact);
+  if (compact.length() >= points.size() * sizeof(S2Point)) {
+    return EncodeS2PointVectorFast(points, encoder);
+  }
+  encoder->Ensure(compact.length());
+  encoder->putn(compact.base(), compact.length());
+}
+
+bool EncodedS2PointVector::InitCellIdsFormat(Decoder* decoder) {
+  if (decoder->avail() < 2) return false;
+  uint8 header1 = decoder->get8();
+  uint8 header2 = decoder->get8();
+  S2_DCHECK_EQ(header1 & kEncodingFormatMask, CELL_ID);
+  cell_ids_.have_exceptions = (header1 & 8) != 0;
+  int last_block_count = (header1 >> 4) + 1;
+  int base_bytes = header2 & 7;
+  cell_ids_.level = header2 >> 3;
+  if (cell_ids_.level > S2CellId::kMaxLevel) return false;
+
+  uint64 base;
+  if (!DecodeUintWithLength(base_bytes, decoder, &base)) return false;
+  cell_ids_.base = base << BaseShift(cell_ids_.level, base_bytes);
+
+  if (!cell_ids_.blocks.Init(decoder)) return false;
+  if (cell_ids_.blocks.size() == 0) return false;
+  uint64 size = kBlockSize * (cell_ids_.blocks.size() - 1) + last_block_count;
+  if (size > std::numeric_limits<uint32>::max()) return false;
+  size_ = size;
+  return true;
+}
+
+S2Point EncodedS2PointVector::DecodeCellIdsFormat(int i) const {
+  // This function is time-critical since it is called on every point access.
+  absl::string_view block = cell_ids_.blocks[i >> kBlockShift];
+  const char* ptr = block.data();
+  const uint8 header = *ptr++;
+  const int offset_bytes = header & 7;
+  const int overlap_nibbles = (header >> 3) & 1;
+  const int delta_nibbles = (header >> 4) + 1;
+  const uint64 offset = GetUintWithLength<uint64>(ptr, offset_bytes);
+  ptr += offset_bytes;
+
+  // Decode the delta, which starts at nibble "j * delta_nibbles".
+  const int nibble = (i & (kBlockSize - 1)) * delta_nibbles;
+  const int delta_bytes = ((nibble & 1) + delta_nibbles + 1) >> 1;
+  const uint64 delta_mask = BitMask(4 * delta_nibbles);
+  uint64 delta = GetUintWithLength<uint64>(ptr + (nibble >> 1), delta_bytes);
+  delta = (delta >> (4 * (nibble & 1))) & delta_mask;
+
+  if (cell_ids_.have_exceptions) {
+    // The exceptions are stored after the deltas.
+    int block_count = kBlockSize;
+    if ((i >> kBlockShift) == cell_ids_.blocks.size() - 1) {
+      block_count = size_ - (i & ~(kBlockSize - 1));
+    }
+    const char* exceptions = ptr + DeltaBytes(block_count, delta_nibbles);
+    uint64 num_exceptions = (block.end() - exceptions) / sizeof(S2Point);
+    uint64 k = delta_mask - delta;
+    if (k < num_exceptions) {
+      S2Point p;
+      memcpy(&p, exceptions + k * sizeof(S2Point), sizeof(p));
+      return p;
+    }
+  }
+  const int shift = 4 * (delta_nibbles - overlap_nibbles);
+  uint64 value = cell_ids_.base + ShiftOffset(offset, shift) + delta;
+
+  // Invert the transformation performed by ConvertCellsToValues().
+  const int level = cell_ids_.level;
+  uint32 sj, tj;
+  DeinterleaveBitPairs(value, &sj, &tj);
+  int face = ((sj >> level) & 3) | (((tj >> level) & 1) << 2);
+  uint32 si = (((sj << 1) | 1) << (30 - level)) & 0x7fffffff;
+  uint32 ti = (((tj << 1) | 1) << (30 - level)) & 0x7fffffff;
+  return S2::FaceSiTitoXYZ(face, si, ti).Normalize();
 }
 
 }  // namespace s2coding
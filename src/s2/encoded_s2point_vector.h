@@ -19,6 +19,7 @@
 #define S2_ENCODED_S2POINT_VECTOR_H_
 
 #include "s2/third_party/absl/types/span.h"
+#include "s2/encoded_string_vector.h"
 #include "s2/encoded_uint_vector.h"
 #include "s2/s2point.h"
 
@@ -30,7 +31,9 @@ namespace s2coding {
 enum CodingHint { FAST, COMPACT };
 
 // Encodes a vector of S2Points in a format that can later be decoded as an
-// EncodedS2PointVector.
+// EncodedS2PointVector.  With CodingHint::COMPACT, points that are S2CellId
+// centers (e.g. points snapped using S2CellIdSnapFunction) are encoded in a
+// few bytes each; the remaining points are stored exactly as exceptions.
 //
 // REQUIRES: "encoder" uses the default constructor, so that its buffer
 //           can be enlarged as necessary by calling Ensure(int).
@@ -67,6 +70,15 @@ class EncodedS2PointVector {
   std::vector<S2Point> Decode() const;
 
  private:
+  friend void EncodeS2PointVector(absl::Span<const S2Point>, CodingHint,
+                                  Encoder*);
+  friend void EncodeS2PointVectorFast(absl::Span<const S2Point>, Encoder*);
+  friend void EncodeS2PointVectorCompact(absl::Span<const S2Point>, Encoder*);
+
+  bool InitUncompressedFormat(Decoder* decoder);
+  bool InitCellIdsFormat(Decoder* decoder);
+  S2Point DecodeCellIdsFormat(int i) const;
+
   // We use a tagged union to represent multiple formats, as opposed to an
   // abstract base class or templating.  This represents the best compromise
   // between performance, space, and convenience.  Note that the overhead of
@@ -87,11 +99,12 @@ class EncodedS2PointVector {
       const S2Point* points;
     } uncompressed_;
     struct {
-      // TODO(ericv): Implement.
-    } cell_id_;
+      EncodedStringVector blocks;
+      uint64 base;
+      uint8 level;
+      bool have_exceptions;
+    } cell_ids_;
   };
-  friend void EncodeS2PointVector(absl::Span<const S2Point>, CodingHint,
-                                  Encoder*);
 };
 
 
@@ -108,7 +121,10 @@ inline S2Point EncodedS2PointVector::operator[](int i) const {
       return uncompressed_.points[i];
 
     case CELL_ID:
-      S2_LOG(FATAL) << "Not implemented yet";
+      return DecodeCellIdsFormat(i);
+
+    default:
+      S2_LOG(DFATAL) << "Unrecognized format";
       return S2Point();
   }
 }
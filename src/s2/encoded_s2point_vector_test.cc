@@ -19,20 +19,45 @@
 
 #include <vector>
 #include <gtest/gtest.h>
+#include "s2/s2cell_id.h"
+#include "s2/s2testing.h"
 
 using std::vector;
 
 namespace s2coding {
 
-void TestEncodedS2PointVector(const vector<S2Point>& expected,
-                              size_t expected_bytes) {
+// Encodes "expected" using the given hint, checks that it decodes correctly
+// (both with Decode() and operator[]), and returns the encoded size.
+size_t TestEncodedS2PointVector(const vector<S2Point>& expected,
+                                CodingHint hint) {
   Encoder encoder;
-  EncodeS2PointVector(expected, CodingHint::FAST, &encoder);
-  EXPECT_EQ(expected_bytes, encoder.length());
+  EncodeS2PointVector(expected, hint, &encoder);
   Decoder decoder(encoder.base(), encoder.length());
   EncodedS2PointVector actual;
-  ASSERT_TRUE(actual.Init(&decoder));
+  EXPECT_TRUE(actual.Init(&decoder));
+  EXPECT_EQ(0, decoder.avail());
   EXPECT_EQ(actual.Decode(), expected);
+  EXPECT_EQ(expected.size(), actual.size());
+  for (int i = 0; i < actual.size(); ++i) {
+    EXPECT_EQ(expected[i], actual[i]) << "i = " << i;
+  }
+  return encoder.length();
+}
+
+void TestEncodedS2PointVector(const vector<S2Point>& expected,
+                              size_t expected_bytes) {
+  EXPECT_EQ(expected_bytes,
+            TestEncodedS2PointVector(expected, CodingHint::FAST));
+}
+
+// Returns "n" random points that are centers of S2CellIds at "level".
+vector<S2Point> RandomCellCenters(int n, int level) {
+  vector<S2Point> points;
+  for (int i = 0; i < n; ++i) {
+    points.push_back(
+        S2CellId(S2Testing::RandomPoint()).parent(level).ToPoint());
+  }
+  return points;
 }
 
 TEST(EncodedS2PointVectorTest, Empty) {
@@ -51,4 +76,61 @@ TEST(EncodedS2PointVectorTest, TenPoints) {
   TestEncodedS2PointVector(points, 241);
 }
 
+TEST(EncodedS2PointVectorTest, CompactEmpty) {
+  EXPECT_EQ(1, TestEncodedS2PointVector({}, CodingHint::COMPACT));
+}
+
+TEST(EncodedS2PointVectorTest, CompactOneCellCenter) {
+  EXPECT_LT(TestEncodedS2PointVector(
+                {S2CellId::FromFace(3).child_begin(10).ToPoint()},
+                CodingHint::COMPACT),
+            sizeof(S2Point));
+}
+
+TEST(EncodedS2PointVectorTest, CompactCellCentersAllLevels) {
+  for (int level = 0; level <= S2CellId::kMaxLevel; ++level) {
+    for (int n : {1, 2, 15, 16, 17, 100}) {
+      TestEncodedS2PointVector(RandomCellCenters(n, level),
+                               CodingHint::COMPACT);
+    }
+  }
+}
+
+TEST(EncodedS2PointVectorTest, CompactSnappedPolylineIsSmall) {
+  // Points along a path that are snapped to level 20 cells should take
+  // only a few bytes each, since nearby points share most of their bits.
+  vector<S2Point> points;
+  S2Point a = S2Testing::RandomPoint();
+  S2Point b = (a + S2Point(1e-3, 2e-3, -1e-3)).Normalize();
+  for (int i = 0; i < 1000; ++i) {
+    S2Point p = ((1000 - i) * a + i * b).Normalize();
+    points.push_back(S2CellId(p).parent(20).ToPoint());
+  }
+  size_t bytes = TestEncodedS2PointVector(points, CodingHint::COMPACT);
+  EXPECT_LT(bytes, 4 * points.size());
+}
+
+TEST(EncodedS2PointVectorTest, CompactWithExceptions) {
+  for (int iter = 0; iter < 20; ++iter) {
+    vector<S2Point> points = RandomCellCenters(200, 16);
+    for (S2Point& p : points) {
+      if (S2Testing::rnd.OneIn(10)) p = S2Testing::RandomPoint();
+    }
+    // A few points snapped at a different level are also exceptions.
+    points[S2Testing::rnd.Uniform(points.size())] =
+        S2CellId(S2Testing::RandomPoint()).parent(5).ToPoint();
+    size_t bytes = TestEncodedS2PointVector(points, CodingHint::COMPACT);
+    EXPECT_LT(bytes, points.size() * sizeof(S2Point));
+  }
+}
+
+TEST(EncodedS2PointVectorTest, CompactFallsBackToUncompressed) {
+  // When no points are cell centers the COMPACT and FAST encodings match.
+  vector<S2Point> points;
+  for (int i = 0; i < 10; ++i) {
+    points.push_back(S2Testing::RandomPoint());
+  }
+  EXPECT_EQ(241, TestEncodedS2PointVector(points, CodingHint::COMPACT));
+}
+
 }  // namespace s2coding
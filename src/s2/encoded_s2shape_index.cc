@@ -17,11 +17,21 @@
 
 #include "s2/encoded_s2shape_index.h"
 
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <functional>
 #include <memory>
 #include "s2/third_party/absl/memory/memory.h"
 #include "s2/mutable_s2shape_index.h"
+#include "s2/s2cell_union.h"
+#include "s2/util/thread/parallel_for.h"
 
 using absl::make_unique;
+using std::pair;
 using std::unique_ptr;
 using std::vector;
 
@@ -44,17 +54,32 @@ void EncodedS2ShapeIndex::Iterator::Copy(const IteratorBase& other)  {
 }
 
 
+// Returns the approximate number of bytes used by a decoded shape.  (S2Shape
+// does not have a SpaceUsed() method, so we assume that the shape stores its
+// vertices.)
+static size_t ShapeBytesUsed(const S2Shape& shape) {
+  return sizeof(S2Shape) + shape.num_edges() * sizeof(S2Point);
+}
+
 S2Shape* EncodedS2ShapeIndex::GetShape(int id) const {
   // This method is called when a shape has not been decoded yet.
   unique_ptr<S2Shape> shape = (*shape_factory_)[id];
   if (shape) shape->id_ = id;
   S2Shape* expected = kUndecodedShape();
   if (shapes_[id].compare_exchange_strong(expected, shape.get(),
-                                          std::memory_order_relaxed)) {
+                                          std::memory_order_acq_rel)) {
+    shape_misses_.fetch_add(1, std::memory_order_relaxed);
+    if (memory_budget_ != 0 && shape != nullptr) {
+      AddResident(id | kShapeBit, ShapeBytesUsed(*shape));
+    }
     return shape.release();  // Ownership has been transferred to shapes_.
   }
-  return shapes_[id].load(std::memory_order_relaxed);
+  // Another thread decoded the shape first.  Note that we return the value
+  // observed by compare_exchange_strong rather than loading it again, since
+  // the shape may have been evicted in the meantime.
+  return expected;
 }
+
 inline const S2ShapeIndexCell* EncodedS2ShapeIndex::GetCell(int i) const {
   // This method is called by Iterator::cell() when the cell has not been
   // decoded yet.  For thread safety, we first decode the cell and then assign
@@ -64,11 +89,14 @@ inline const S2ShapeIndexCell* EncodedS2ShapeIndex::GetCell(int i) const {
   if (cell->Decode(num_shape_ids(), &decoder)) {
     S2ShapeIndexCell* expected = nullptr;
     if (cells_[i].compare_exchange_strong(expected, cell.get(),
-                                          std::memory_order_relaxed)) {
+                                          std::memory_order_acq_rel)) {
+      cell_misses_.fetch_add(1, std::memory_order_relaxed);
+      if (memory_budget_ != 0) AddResident(i, cell->SpaceUsed());
       return cell.release();  // Ownership has been transferred to cells_.
     }
+    return expected;  // Decoded by another thread (see GetShape).
   }
-  return cells_[i].load(std::memory_order_relaxed);
+  return cells_[i].load(std::memory_order_acquire);
 }
 
 const S2ShapeIndexCell* EncodedS2ShapeIndex::Iterator::GetCell() const {
@@ -117,6 +145,7 @@ bool EncodedS2ShapeIndex::Init(Decoder* decoder,
 
   // The cells_ elements are default-initialized to nullptr.
   cells_ = std::vector<std::atomic<S2ShapeIndexCell*>>(cell_ids_.size());
+  if (memory_budget_ != 0) set_memory_budget(memory_budget_);
   return encoded_cells_.Init(decoder);
 }
 
@@ -135,6 +164,273 @@ void EncodedS2ShapeIndex::Minimize() {
       delete cell;
     }
   }
+  DeleteRetired();
+  resident_.clear();
+  clock_hand_ = 0;
+  decoded_bytes_ = 0;
+}
+
+void EncodedS2ShapeIndex::set_memory_budget(size_t bytes) {
+  memory_budget_ = bytes;
+  if (bytes == 0) {
+    DeleteRetired();
+    cell_refs_.clear();
+    shape_refs_.clear();
+    resident_.clear();
+    clock_hand_ = 0;
+    decoded_bytes_ = 0;
+    return;
+  }
+  // Cells and shapes decoded before the budget was set are not tracked, so
+  // we simply discard them.
+  Minimize();
+  cell_refs_ = vector<std::atomic<uint8>>(cells_.size());
+  shape_refs_ = vector<std::atomic<uint8>>(shapes_.size());
+}
+
+EncodedS2ShapeIndex::CacheStats EncodedS2ShapeIndex::cache_stats() const {
+  CacheStats stats;
+  for (const HitShard& shard : hit_shards_) {
+    stats.cell_hits += shard.cell_hits.load(std::memory_order_relaxed);
+    stats.shape_hits += shard.shape_hits.load(std::memory_order_relaxed);
+  }
+  stats.cell_misses = cell_misses_.load(std::memory_order_relaxed);
+  stats.cell_evictions = cell_evictions_.load(std::memory_order_relaxed);
+  stats.shape_misses = shape_misses_.load(std::memory_order_relaxed);
+  stats.shape_evictions = shape_evictions_.load(std::memory_order_relaxed);
+  if (memory_budget_ != 0) {
+    lock_.Lock();
+    stats.decoded_bytes = decoded_bytes_;
+    lock_.Unlock();
+  }
+  return stats;
+}
+
+void EncodedS2ShapeIndex::AddResident(uint32 resident, size_t bytes) const {
+  // New entries start with their reference bit set so that they are not
+  // evicted before they have been used.
+  (resident & kShapeBit ? shape_refs_ : cell_refs_)[resident & ~kShapeBit]
+      .store(1, std::memory_order_relaxed);
+  lock_.Lock();
+  resident_.push_back(resident);
+  decoded_bytes_ += bytes;
+  if (decoded_bytes_ > memory_budget_) {
+    EvictLocked();
+    ReclaimLocked();
+  }
+  lock_.Unlock();
+}
+
+void EncodedS2ShapeIndex::EvictLocked() const {
+  // Evict until we are comfortably below the budget, so that the cost of
+  // sweeping is amortized over many insertions.
+  const size_t target = memory_budget_ - memory_budget_ / 8;
+  const uint64 epoch = epoch_.load();
+  // Every entry is visited at most twice (once to clear its reference bit
+  // and once to evict it).
+  for (size_t steps = 2 * resident_.size();
+       decoded_bytes_ > target && steps > 0 && !resident_.empty(); --steps) {
+    if (clock_hand_ >= resident_.size()) clock_hand_ = 0;
+    uint32 resident = resident_[clock_hand_];
+    bool is_shape = resident & kShapeBit;
+    uint32 i = resident & ~kShapeBit;
+    auto& ref = (is_shape ? shape_refs_ : cell_refs_)[i];
+    if (ref.load(std::memory_order_relaxed)) {
+      ref.store(0, std::memory_order_relaxed);
+      ++clock_hand_;
+      continue;
+    }
+    // Unpublish the object so that subsequent lookups will decode it again.
+    void* ptr;
+    if (is_shape) {
+      S2Shape* shape = shapes_[i].exchange(kUndecodedShape());
+      decoded_bytes_ -= ShapeBytesUsed(*shape);
+      shape_evictions_.fetch_add(1, std::memory_order_relaxed);
+      ptr = shape;
+    } else {
+      S2ShapeIndexCell* cell = cells_[i].exchange(nullptr);
+      decoded_bytes_ -= cell->SpaceUsed();
+      cell_evictions_.fetch_add(1, std::memory_order_relaxed);
+      ptr = cell;
+    }
+    retired_[epoch % 3].push_back(std::make_pair(resident, ptr));
+    resident_[clock_hand_] = resident_.back();
+    resident_.pop_back();
+  }
+}
+
+void EncodedS2ShapeIndex::ReclaimLocked() const {
+  // Objects retired during epoch (e - 1) can be deleted once no readers
+  // remain in that epoch, since readers that started in epoch "e" or later
+  // cannot have seen them.  Note that (e + 2) % 3 == (e - 1) % 3.
+  uint64 epoch = epoch_.load();
+  int slot = (epoch + 2) % 3;
+  if (readers_[slot].load() != 0) return;
+  for (const auto& entry : retired_[slot]) {
+    DeleteResident(entry.first, entry.second);
+  }
+  retired_[slot].clear();
+  epoch_.store(epoch + 1);
+}
+
+void EncodedS2ShapeIndex::DeleteRetired() {
+  // Since there are no concurrent readers, retired objects can be deleted.
+  for (auto& retired : retired_) {
+    for (const auto& entry : retired) DeleteResident(entry.first, entry.second);
+    retired.clear();
+  }
+}
+
+void EncodedS2ShapeIndex::DeleteResident(uint32 resident, void* ptr) const {
+  if (resident & kShapeBit) {
+    delete static_cast<S2Shape*>(ptr);
+  } else {
+    delete static_cast<S2ShapeIndexCell*>(ptr);
+  }
+}
+
+EncodedS2ShapeIndex::WarmUpOptions::WarmUpOptions()
+    : num_threads_(1), decode_shapes_(false) {
+}
+
+void EncodedS2ShapeIndex::WarmUpOptions::set_num_threads(int num_threads) {
+  S2_DCHECK_GE(num_threads, 1);
+  num_threads_ = num_threads;
+}
+
+// The number of cells or shapes decoded by each WarmUp() work item.
+static const int kWarmUpChunkSize = 256;
+
+// Splits the given ranges into chunks of at most "chunk_size" elements and
+// calls "fn" on each chunk using up to "num_threads" threads (including the
+// calling thread).
+static void ParallelForEachChunk(const vector<pair<int, int>>& ranges,
+                                 int chunk_size, int num_threads,
+                                 const std::function<void(int, int)>& fn) {
+  vector<pair<int, int>> chunks;
+  for (const auto& range : ranges) {
+    for (int begin = range.first; begin < range.second; begin += chunk_size) {
+      chunks.emplace_back(begin, std::min(begin + chunk_size, range.second));
+    }
+  }
+  util_thread::ParallelFor(chunks.size(), num_threads,
+                           [&chunks, &fn](int thread, int i) {
+                             fn(chunks[i].first, chunks[i].second);
+                           });
+}
+
+vector<pair<int, int>> EncodedS2ShapeIndex::GetCellRanges(
+    const S2CellUnion& region) const {
+  vector<pair<int, int>> ranges;
+  for (S2CellId id : region) {
+    // An index cell intersects "id" if it is a descendant of "id" or if it
+    // contains "id", in which case it immediately precedes the descendants.
+    int begin = cell_ids_.lower_bound(id.range_min());
+    if (begin > 0 && cell_ids_[begin - 1].range_max() >= id.range_min()) {
+      --begin;
+    }
+    int end = cell_ids_.lower_bound(id.range_max().next());
+    // An index cell that contains "id" may start after id.range_min() (if
+    // "id" lies in its lower half), in which case it was not found above.
+    if (begin < cell_ids_.size() &&
+        cell_ids_[begin].range_min() <= id.range_max()) {
+      end = std::max(end, begin + 1);
+    }
+    if (begin == end) continue;
+    if (!ranges.empty() && begin <= ranges.back().second) {
+      ranges.back().second = std::max(ranges.back().second, end);
+    } else {
+      ranges.emplace_back(begin, end);
+    }
+  }
+  return ranges;
+}
+
+void EncodedS2ShapeIndex::WarmUp(const WarmUpOptions& options) const {
+  vector<pair<int, int>> ranges;
+  if (!cells_.empty()) ranges.emplace_back(0, cells_.size());
+  WarmUpRanges(ranges, options);
+}
+
+void EncodedS2ShapeIndex::WarmUp(const S2CellUnion& region,
+                                 const WarmUpOptions& options) const {
+  WarmUpRanges(GetCellRanges(region), options);
+}
+
+void EncodedS2ShapeIndex::WarmUpRanges(const vector<pair<int, int>>& ranges,
+                                       const WarmUpOptions& options) const {
+  ParallelForEachChunk(
+      ranges, kWarmUpChunkSize, options.num_threads(), [this](int b, int e) {
+        ReadGuard guard(this);
+        for (int i = b; i < e; ++i) {
+          if (cells_[i].load(std::memory_order_acquire) == nullptr) GetCell(i);
+        }
+      });
+  if (!options.decode_shapes()) return;
+
+  // Determine which shapes to decode.  When warming up the entire index we
+  // decode all shapes (including those that do not intersect any cell).
+  vector<pair<int, int>> shape_ranges;
+  if (ranges.size() == 1 && ranges[0].first == 0 &&
+      ranges[0].second == cells_.size()) {
+    shape_ranges.emplace_back(0, num_shape_ids());
+  } else {
+    vector<bool> used(num_shape_ids());
+    ReadGuard guard(this);
+    for (const auto& range : ranges) {
+      for (int i = range.first; i < range.second; ++i) {
+        const S2ShapeIndexCell* cell =
+            cells_[i].load(std::memory_order_acquire);
+        if (cell == nullptr && (cell = GetCell(i)) == nullptr) continue;
+        for (int j = 0; j < cell->num_clipped(); ++j) {
+          used[cell->clipped(j).shape_id()] = true;
+        }
+      }
+    }
+    for (int id = 0; id < used.size(); ++id) {
+      if (!used[id]) continue;
+      if (!shape_ranges.empty() && shape_ranges.back().second == id) {
+        ++shape_ranges.back().second;
+      } else {
+        shape_ranges.emplace_back(id, id + 1);
+      }
+    }
+  }
+  ParallelForEachChunk(
+      shape_ranges, kWarmUpChunkSize, options.num_threads(),
+      [this](int b, int e) {
+        ReadGuard guard(this);
+        for (int id = b; id < e; ++id) {
+          if (shapes_[id].load(std::memory_order_acquire) ==
+              kUndecodedShape()) {
+            GetShape(id);
+          }
+        }
+      });
+}
+
+// Advises the operating system that the pages containing "bytes" will be
+// accessed soon.  This is a no-op on platforms without madvise().
+static void PrefetchBytes(absl::string_view bytes) {
+#if defined(__unix__) || defined(__APPLE__)
+  if (bytes.empty()) return;
+  static const uintptr_t kPageSize = sysconf(_SC_PAGESIZE);
+  uintptr_t start = reinterpret_cast<uintptr_t>(bytes.data());
+  uintptr_t limit = start + bytes.size();
+  start &= ~(kPageSize - 1);
+  // The result is ignored since this is only a hint.
+  madvise(reinterpret_cast<void*>(start), limit - start, MADV_WILLNEED);
+#endif
+}
+
+void EncodedS2ShapeIndex::Prefetch(const S2CellUnion& region) const {
+  for (const auto& range : GetCellRanges(region)) {
+    PrefetchBytes(encoded_cells_.GetRange(range.first, range.second));
+  }
+}
+
+void EncodedS2ShapeIndex::Prefetch() const {
+  PrefetchBytes(encoded_cells_.GetRange(0, encoded_cells_.size()));
 }
 
 size_t EncodedS2ShapeIndex::SpaceUsed() const {
@@ -18,10 +18,18 @@
 #ifndef S2_ENCODED_S2SHAPE_INDEX_H_
 #define S2_ENCODED_S2SHAPE_INDEX_H_
 
+#include <array>
+#include <atomic>
+#include <vector>
+
+#include "s2/base/mutex.h"
+#include "s2/third_party/absl/base/optimization.h"
 #include "s2/encoded_s2cell_id_vector.h"
 #include "s2/encoded_string_vector.h"
 #include "s2/mutable_s2shape_index.h"
 
+class S2CellUnion;
+
 class EncodedS2ShapeIndex final : public S2ShapeIndex {
  public:
   using Options = MutableS2ShapeIndex::Options;
@@ -61,6 +69,120 @@ class EncodedS2ShapeIndex final : public S2ShapeIndex {
   // Like all non-const methods, this method is not thread-safe.
   void Minimize() override;
 
+  // Limits the approximate number of bytes used by decoded cells and shapes.
+  // Normally cells and shapes are decoded on demand and kept until
+  // Minimize() is called, so an index that is scanned over a long period of
+  // time eventually decodes everything.  When a budget is set, decoded cells
+  // and shapes are evicted using the CLOCK algorithm (an approximation of
+  // LRU) whenever the budget is exceeded, and are decoded again if they are
+  // accessed later.
+  //
+  // Memory used by S2ShapeIndexCells is computed exactly, while each decoded
+  // shape is assumed to use sizeof(S2Point) bytes per edge (this
+  // overestimates the memory used by lazily decoded shapes).
+  //
+  // IMPORTANT: When a budget is set, evicted cells and shapes may be deleted
+  // by other threads at any time, and therefore all methods that access
+  // cells or shapes (including all S2ShapeIndex queries) must be called
+  // while holding a ReadGuard (see below).  Pointers to cells and shapes
+  // (including those held by iterators) must not be used after the
+  // ReadGuard is destroyed; iterators must be repositioned (e.g. by calling
+  // Seek) before being used again.
+  //
+  // Setting the budget back to 0 deletes any evicted cells and shapes that
+  // are still awaiting reclamation and stops tracking memory usage; cells
+  // and shapes that are currently decoded are kept (see Minimize).
+  //
+  // This method may only be called when no other threads are accessing the
+  // index.
+  //
+  // DEFAULT: 0 (no limit)
+  void set_memory_budget(size_t bytes);
+  size_t memory_budget() const { return memory_budget_; }
+
+  // Cells and shapes accessed while a ReadGuard exists are guaranteed not to
+  // be deleted until the ReadGuard is destroyed.  ReadGuards are cheap (two
+  // atomic operations), may be nested, and may be used concurrently by any
+  // number of threads.  They have no effect when no memory budget is set.
+  //
+  //   {
+  //     EncodedS2ShapeIndex::ReadGuard guard(&index);
+  //     S2ClosestEdgeQuery query(&index);
+  //     ...
+  //   }
+  class ReadGuard {
+   public:
+    explicit ReadGuard(const EncodedS2ShapeIndex* index);
+    ~ReadGuard();
+
+    ReadGuard(const ReadGuard&) = delete;
+    void operator=(const ReadGuard&) = delete;
+
+   private:
+    const EncodedS2ShapeIndex* index_;
+    int slot_;
+  };
+
+  // Statistics about decoded cells and shapes.  Hits are only counted when a
+  // memory budget is set.
+  struct CacheStats {
+    int64 cell_hits = 0;
+    int64 cell_misses = 0;      // Number of cells decoded.
+    int64 cell_evictions = 0;
+    int64 shape_hits = 0;
+    int64 shape_misses = 0;     // Number of shapes decoded.
+    int64 shape_evictions = 0;
+    size_t decoded_bytes = 0;   // Approximate bytes used by decoded data.
+  };
+  CacheStats cache_stats() const;
+
+  // Options that control WarmUp().
+  class WarmUpOptions {
+   public:
+    WarmUpOptions();
+
+    // The number of threads used to decode cells and shapes (including the
+    // calling thread).
+    //
+    // DEFAULT: 1
+    int num_threads() const { return num_threads_; }
+    void set_num_threads(int num_threads);
+
+    // If true, the shapes referenced by the decoded cells are also decoded.
+    //
+    // DEFAULT: false
+    bool decode_shapes() const { return decode_shapes_; }
+    void set_decode_shapes(bool decode_shapes) {
+      decode_shapes_ = decode_shapes;
+    }
+
+   private:
+    int num_threads_;
+    bool decode_shapes_;
+  };
+
+  // Decodes all cells in the index (and optionally all shapes) ahead of
+  // time, so that subsequent queries do not pay for decoding.  This is
+  // useful for bringing a freshly loaded index up to full speed before it
+  // is used to serve requests.  If a memory budget is set (see above), cells
+  // and shapes are still evicted once the budget is exceeded.
+  //
+  // This method has the same thread safety as the other "const" methods.
+  void WarmUp(const WarmUpOptions& options = WarmUpOptions()) const;
+
+  // Like WarmUp(), but only decodes the cells that intersect "region" (and
+  // optionally the shapes that those cells refer to).
+  void WarmUp(const S2CellUnion& region,
+              const WarmUpOptions& options = WarmUpOptions()) const;
+
+  // Advises the operating system that the encoded cells intersecting
+  // "region" (or the entire index) will be needed soon, e.g. so that pages
+  // of a memory-mapped index are read ahead of time.  Nothing is decoded,
+  // and the method returns without waiting for the data to be read.  (The
+  // encoded shapes are owned by the ShapeFactory and are not prefetched.)
+  void Prefetch(const S2CellUnion& region) const;
+  void Prefetch() const;
+
   class Iterator final : public IteratorBase {
    public:
     // Default constructor; must be followed by a call to Init().
@@ -134,6 +256,27 @@ class EncodedS2ShapeIndex final : public S2ShapeIndex {
   S2Shape* GetShape(int id) const;
   const S2ShapeIndexCell* GetCell(int i) const;
 
+  // Returns the ranges [begin, end) of cell positions that intersect
+  // "region", in increasing order.
+  std::vector<std::pair<int, int>> GetCellRanges(
+      const S2CellUnion& region) const;
+
+  // Decodes the cells in the given ranges (see WarmUp).
+  void WarmUpRanges(const std::vector<std::pair<int, int>>& ranges,
+                    const WarmUpOptions& options) const;
+
+  // Methods used to implement the memory budget.  Resident cells and shapes
+  // are represented as indexes into cells_ and shapes_, where shapes are
+  // distinguished by having kShapeBit set.
+  static constexpr uint32 kShapeBit = 1u << 31;
+  void RecordHit(uint32 resident) const;
+  static int GetHitShard();
+  void AddResident(uint32 resident, size_t bytes) const;
+  void EvictLocked() const;
+  void ReclaimLocked() const;
+  void DeleteRetired();
+  void DeleteResident(uint32 resident, void* ptr) const;
+
   std::unique_ptr<ShapeFactory> shape_factory_;
 
   // The options specified for this index.
@@ -155,6 +298,45 @@ class EncodedS2ShapeIndex final : public S2ShapeIndex {
   // to the vector using std::atomic::compare_exchange_strong.
   mutable std::vector<std::atomic<S2ShapeIndexCell*>> cells_;
 
+  // The memory budget for decoded cells and shapes, or 0 if unlimited.
+  size_t memory_budget_ = 0;
+
+  // CLOCK reference bits for each element of cells_ and shapes_.  These
+  // vectors are only allocated when a memory budget is set.
+  mutable std::vector<std::atomic<uint8>> cell_refs_, shape_refs_;
+
+  // Protects the fields below.
+  mutable absl::Mutex lock_;
+
+  // The cells and shapes that have been decoded (see kShapeBit), and the
+  // current position of the CLOCK hand in this vector.
+  mutable std::vector<uint32> resident_;
+  mutable size_t clock_hand_ = 0;
+  mutable size_t decoded_bytes_ = 0;
+
+  // Evicted cells and shapes are deleted using epoch-based reclamation.  A
+  // ReadGuard registers itself in readers_[epoch_ % 3], and objects evicted
+  // during an epoch are added to retired_[epoch_ % 3].  The epoch can only
+  // advance from "e" to "e + 1" once there are no readers in epoch "e - 1",
+  // at which point objects retired during "e - 1" can be deleted since
+  // they were no longer reachable once epoch "e" began.
+  mutable std::atomic<uint64> epoch_{0};
+  mutable std::array<std::atomic<int32>, 3> readers_{};
+  mutable std::array<std::vector<std::pair<uint32, void*>>, 3> retired_;
+
+  // Statistics (see CacheStats).  Hits are recorded on every access to a
+  // decoded cell or shape, so they are counted in several shards (each
+  // aligned to its own cache line) to keep concurrent readers from
+  // contending for a single counter.  Each thread always uses the same
+  // shard (see GetHitShard), and cache_stats() sums the shards.
+  static constexpr int kNumHitShards = 16;
+  struct alignas(ABSL_CACHELINE_SIZE) HitShard {
+    std::atomic<int64> cell_hits{0}, shape_hits{0};
+  };
+  mutable std::array<HitShard, kNumHitShards> hit_shards_;
+  mutable std::atomic<int64> cell_misses_{0}, cell_evictions_{0};
+  mutable std::atomic<int64> shape_misses_{0}, shape_evictions_{0};
+
   EncodedS2ShapeIndex(const EncodedS2ShapeIndex&) = delete;
   void operator=(const EncodedS2ShapeIndex&) = delete;
 };
@@ -183,8 +365,12 @@ inline void EncodedS2ShapeIndex::Iterator::Refresh() {
   if (cell_pos_ == num_cells_) {
     set_finished();
   } else {
-    set_state(index_->cell_ids_[cell_pos_],
-              index_->cells_[cell_pos_].load(std::memory_order_relaxed));
+    const S2ShapeIndexCell* cell =
+        index_->cells_[cell_pos_].load(std::memory_order_acquire);
+    if (index_->memory_budget_ != 0 && cell != nullptr) {
+      index_->RecordHit(cell_pos_);
+    }
+    set_state(index_->cell_ids_[cell_pos_], cell);
   }
 }
 
@@ -222,9 +408,52 @@ EncodedS2ShapeIndex::NewIterator(InitialPosition pos) const {
 }
 
 inline S2Shape* EncodedS2ShapeIndex::shape(int id) const {
-  S2Shape* shape = shapes_[id].load(std::memory_order_relaxed);
-  if (shape != kUndecodedShape()) return shape;
+  S2Shape* shape = shapes_[id].load(std::memory_order_acquire);
+  if (shape != kUndecodedShape()) {
+    if (memory_budget_ != 0 && shape != nullptr) RecordHit(id | kShapeBit);
+    return shape;
+  }
   return GetShape(id);
 }
 
+inline void EncodedS2ShapeIndex::RecordHit(uint32 resident) const {
+  // Avoid writing to the reference bit when it is already set, since
+  // otherwise concurrent readers would contend for the cache line.
+  bool is_shape = resident & kShapeBit;
+  auto& ref = (is_shape ? shape_refs_ : cell_refs_)[resident & ~kShapeBit];
+  if (ref.load(std::memory_order_relaxed) == 0) {
+    ref.store(1, std::memory_order_relaxed);
+  }
+  HitShard& shard = hit_shards_[GetHitShard()];
+  (is_shape ? shard.shape_hits : shard.cell_hits).fetch_add(
+      1, std::memory_order_relaxed);
+}
+
+inline int EncodedS2ShapeIndex::GetHitShard() {
+  // Threads are assigned to shards in round-robin order on first use.
+  static std::atomic<int> next_shard{0};
+  static thread_local int shard =
+      next_shard.fetch_add(1, std::memory_order_relaxed) % kNumHitShards;
+  return shard;
+}
+
+inline EncodedS2ShapeIndex::ReadGuard::ReadGuard(
+    const EncodedS2ShapeIndex* index)
+    : index_(index), slot_(-1) {
+  if (index->memory_budget_ == 0) return;
+  // Register in the current epoch.  If the epoch changes before we are
+  // registered then the reclaimer may not have seen us, so we try again.
+  for (;;) {
+    uint64 epoch = index->epoch_.load();
+    slot_ = epoch % 3;
+    index->readers_[slot_].fetch_add(1);
+    if (index->epoch_.load() == epoch) break;
+    index->readers_[slot_].fetch_sub(1);
+  }
+}
+
+inline EncodedS2ShapeIndex::ReadGuard::~ReadGuard() {
+  if (slot_ >= 0) index_->readers_[slot_].fetch_sub(1);
+}
+
 #endif  // S2_ENCODED_S2SHAPE_INDEX_H_
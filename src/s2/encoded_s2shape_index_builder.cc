@@ -0,0 +1,706 @@
+// Copyright 2018 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "s2/encoded_s2shape_index_builder.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <functional>
+#include <queue>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "s2/base/commandlineflags.h"
+#include "s2/third_party/absl/memory/memory.h"
+#include "s2/encoded_s2cell_id_vector.h"
+#include "s2/encoded_string_vector.h"
+#include "s2/encoded_uint_vector.h"
+#include "s2/s2edge_clipping.h"
+#include "s2/s2edge_crosser.h"
+#include "s2/s2lax_polyline_shape.h"
+#include "s2/s2metrics.h"
+#include "s2/s2padded_cell.h"
+#include "s2/s2shapeutil_coding.h"
+#include "s2/util/thread/parallel_for.h"
+
+using absl::make_unique;
+using std::pair;
+using std::string;
+using std::unique_ptr;
+using std::vector;
+
+DECLARE_double(s2shape_index_cell_size_to_long_edge_ratio);
+
+EncodedS2ShapeIndexBuilder::Options::Options()
+    : max_edges_per_run_(1 << 22), num_threads_(1) {
+}
+
+void EncodedS2ShapeIndexBuilder::Options::set_max_edges_per_run(
+    int max_edges_per_run) {
+  S2_DCHECK_GE(max_edges_per_run, 1);
+  max_edges_per_run_ = max_edges_per_run;
+}
+
+void EncodedS2ShapeIndexBuilder::Options::set_num_threads(int num_threads) {
+  S2_DCHECK_GE(num_threads, 1);
+  num_threads_ = num_threads;
+}
+
+// A sequence of (S2CellId, encoded S2ShapeIndexCell) pairs in increasing
+// S2CellId order, where the cells are encoded using global shape ids.
+class EncodedS2ShapeIndexBuilder::CellSource {
+ public:
+  virtual ~CellSource() {}
+
+  // Reads the next cell.  Returns false when there are no more cells or if
+  // an error occurred (see error()).
+  virtual bool Read(S2CellId* id, string* cell) = 0;
+
+  virtual bool error() const = 0;
+};
+
+// A temporary file containing a sequence of (S2CellId, encoded
+// S2ShapeIndexCell) records in increasing S2CellId order.  Each record
+// consists of the cell id (8 bytes), the length of the encoded cell (4
+// bytes), and the encoded cell itself.  (RunFile is also used to hold the
+// encoded cells of the merged index when the output Encoder has a sink; in
+// that case only the raw cell data is written.)
+class EncodedS2ShapeIndexBuilder::RunFile final : public CellSource {
+ public:
+  // Returns nullptr if the file could not be created.
+  static unique_ptr<RunFile> Create(const string& temp_directory);
+
+  ~RunFile() override { std::fclose(file_); }
+
+  bool Write(S2CellId id, const Encoder& cell);
+
+  // Must be called after all records have been written.
+  bool StartReading();
+
+  bool Read(S2CellId* id, string* cell) override;
+
+  bool error() const override { return std::ferror(file_) != 0; }
+
+  // Methods for writing and reading raw bytes.
+  bool Append(const string& data) {
+    return data.empty() || std::fwrite(data.data(), data.size(), 1,
+                                       file_) == 1;
+  }
+  bool ReadBytes(char* data, size_t n) {
+    return n == 0 || std::fread(data, n, 1, file_) == 1;
+  }
+
+ private:
+  explicit RunFile(std::FILE* file) : file_(file) {}
+
+  static constexpr int kHeaderSize = 12;
+  std::FILE* file_;
+};
+
+unique_ptr<EncodedS2ShapeIndexBuilder::RunFile>
+EncodedS2ShapeIndexBuilder::RunFile::Create(const string& temp_directory) {
+  std::FILE* file = nullptr;
+#if defined(__unix__) || defined(__APPLE__)
+  if (!temp_directory.empty()) {
+    string path = temp_directory + "/s2index_run_XXXXXX";
+    int fd = mkstemp(&path[0]);
+    if (fd < 0) return nullptr;
+    unlink(path.c_str());  // The file is deleted once it is closed.
+    file = fdopen(fd, "w+b");
+    if (file == nullptr) close(fd);
+  } else {
+    file = std::tmpfile();
+  }
+#else
+  file = std::tmpfile();
+#endif
+  if (file == nullptr) return nullptr;
+  return unique_ptr<RunFile>(new RunFile(file));
+}
+
+bool EncodedS2ShapeIndexBuilder::RunFile::Write(S2CellId id,
+                                                const Encoder& cell) {
+  char header[kHeaderSize];
+  Encoder encoder(header, kHeaderSize);
+  encoder.put64(id.id());
+  encoder.put32(cell.length());
+  return (std::fwrite(header, kHeaderSize, 1, file_) == 1 &&
+          (cell.length() == 0 ||
+           std::fwrite(cell.base(), cell.length(), 1, file_) == 1));
+}
+
+bool EncodedS2ShapeIndexBuilder::RunFile::StartReading() {
+  return std::fflush(file_) == 0 && std::fseek(file_, 0, SEEK_SET) == 0;
+}
+
+bool EncodedS2ShapeIndexBuilder::RunFile::Read(S2CellId* id, string* cell) {
+  char header[kHeaderSize];
+  if (std::fread(header, kHeaderSize, 1, file_) != 1) return false;
+  Decoder decoder(header, kHeaderSize);
+  *id = S2CellId(decoder.get64());
+  cell->resize(decoder.get32());
+  return (cell->empty() ||
+          std::fread(&(*cell)[0], cell->size(), 1, file_) == 1);
+}
+
+// Returns the cells of an existing S2ShapeIndex, adding "shape_id_offset"
+// to all of its shape ids.
+class EncodedS2ShapeIndexBuilder::IndexCellSource final : public CellSource {
+ public:
+  IndexCellSource(const S2ShapeIndex& index, int shape_id_offset,
+                  int num_shape_ids)
+      : it_(&index, S2ShapeIndex::BEGIN), shape_id_offset_(shape_id_offset),
+        num_shape_ids_(num_shape_ids) {
+  }
+
+  bool Read(S2CellId* id, string* cell) override {
+    if (it_.done()) return false;
+    *id = it_.id();
+    encoder_.clear();
+    EncodeCell(it_.cell(), shape_id_offset_, num_shape_ids_, &encoder_);
+    cell->assign(encoder_.base(), encoder_.length());
+    it_.Next();
+    return true;
+  }
+
+  bool error() const override { return false; }
+
+ private:
+  S2ShapeIndex::Iterator it_;
+  const int shape_id_offset_;
+  const int num_shape_ids_;
+  Encoder encoder_;
+};
+
+// Merges a set of runs into a single index.  Cells that do not overlap any
+// cell from another run are copied unchanged.  Otherwise the overlapping
+// cells are recursively split until they are disjoint, and the contents of
+// each resulting cell are computed by clipping the edges of the larger
+// cells that contain it (see AddCell).
+class EncodedS2ShapeIndexBuilder::RunMerger {
+ public:
+  RunMerger(const Options& options,
+            const S2ShapeIndex::ShapeFactory& shape_factory,
+            vector<unique_ptr<CellSource>> runs);
+
+  bool Merge(Encoder* encoder, S2Error* error);
+
+ private:
+  // A cell read from one of the runs (or created while merging).  The cell
+  // contents are decoded on demand.
+  struct Entry {
+    S2CellId id;
+    string data;
+    unique_ptr<S2ShapeIndexCell> cell;
+  };
+
+  // The contents of an S2ClippedShape while a cell is being constructed.
+  struct ClippedShape {
+    int shape_id;
+    bool contains_center;
+    vector<int> edges;
+    bool operator<(const ClippedShape& other) const {
+      return shape_id < other.shape_id;
+    }
+  };
+
+  bool ReadNext(int run);
+  const S2ShapeIndexCell& GetCell(Entry* entry) const;
+  const S2Shape& GetShape(int shape_id);
+  void Refine(S2CellId id, const vector<Entry*>& covering,
+              const vector<Entry*>& descendants);
+  void AddCell(S2CellId id, const vector<Entry*>& covering);
+  void ClipShape(S2CellId id, S2CellId ancestor, const S2ClippedShape& clipped,
+                 vector<ClippedShape>* result);
+  bool EdgeIntersectsCell(const S2Shape::Edge& edge,
+                          const S2PaddedCell& pcell);
+  int CountShortEdges(int level, const vector<ClippedShape>& shapes);
+  void EmitCell(S2CellId id, const string& data);
+
+  const Options& options_;
+  const S2ShapeIndex::ShapeFactory& shape_factory_;
+  const int num_shape_ids_;
+  vector<unique_ptr<CellSource>> runs_;
+
+  // The first unprocessed cell of each run, or nullptr if the run is done.
+  vector<unique_ptr<Entry>> fronts_;
+
+  // A priority queue of the runs with unprocessed cells, ordered by the
+  // range_min() of their first cell.  When two cells have the same
+  // range_min(), the larger cell is returned first.
+  using QueueEntry = std::tuple<uint64, int, int>;  // range_min, level, run
+  std::priority_queue<QueueEntry, vector<QueueEntry>,
+                      std::greater<QueueEntry>> queue_;
+
+  // A cache of recently used shapes.  Since cells are processed in S2CellId
+  // order, the same shapes tend to be accessed repeatedly.
+  static constexpr int kMaxCachedShapes = 1000;
+  std::unordered_map<int, unique_ptr<S2Shape>> shapes_;
+
+  vector<S2CellId> cell_ids_;
+  s2coding::StringVectorEncoder encoded_cells_;
+  Encoder cell_encoder_;
+
+  // When the output Encoder has a sink, the encoded cells are written to a
+  // temporary file rather than to encoded_cells_, and cell_offsets_ holds
+  // the offset just past the end of each cell.
+  unique_ptr<RunFile> cells_file_;
+  vector<uint64> cell_offsets_;
+  bool cells_file_ok_ = true;
+};
+
+EncodedS2ShapeIndexBuilder::RunMerger::RunMerger(
+    const Options& options, const S2ShapeIndex::ShapeFactory& shape_factory,
+    vector<unique_ptr<CellSource>> runs)
+    : options_(options), shape_factory_(shape_factory),
+      num_shape_ids_(shape_factory.size()), runs_(std::move(runs)),
+      fronts_(runs_.size()) {
+}
+
+bool EncodedS2ShapeIndexBuilder::RunMerger::ReadNext(int run) {
+  auto entry = make_unique<Entry>();
+  if (!runs_[run]->Read(&entry->id, &entry->data)) {
+    fronts_[run] = nullptr;
+    return !runs_[run]->error();
+  }
+  queue_.emplace(entry->id.range_min().id(), entry->id.level(), run);
+  fronts_[run] = std::move(entry);
+  return true;
+}
+
+const S2ShapeIndexCell& EncodedS2ShapeIndexBuilder::RunMerger::GetCell(
+    Entry* entry) const {
+  if (entry->cell == nullptr) {
+    entry->cell = make_unique<S2ShapeIndexCell>();
+    Decoder decoder(entry->data.data(), entry->data.size());
+    bool ok = entry->cell->Decode(num_shape_ids_, &decoder);
+    S2_DCHECK(ok);  // We wrote the data ourselves.
+  }
+  return *entry->cell;
+}
+
+const S2Shape& EncodedS2ShapeIndexBuilder::RunMerger::GetShape(int shape_id) {
+  auto it = shapes_.find(shape_id);
+  if (it != shapes_.end()) return *it->second;
+  if (shapes_.size() >= kMaxCachedShapes) shapes_.clear();
+  auto shape = shape_factory_[shape_id];
+  // Removed shapes do not have any edges, and therefore are never referenced
+  // by any cell.
+  S2_DCHECK(shape != nullptr);
+  return *(shapes_[shape_id] = std::move(shape));
+}
+
+bool EncodedS2ShapeIndexBuilder::RunMerger::Merge(Encoder* encoder,
+                                                  S2Error* error) {
+  if (encoder->has_sink()) {
+    cells_file_ = RunFile::Create(options_.temp_directory());
+    if (cells_file_ == nullptr) {
+      error->Init(S2Error::RESOURCE_EXHAUSTED,
+                  "Could not create temporary file");
+      return false;
+    }
+  }
+  for (int run = 0; run < runs_.size(); ++run) {
+    if (!ReadNext(run)) {
+      error->Init(S2Error::DATA_LOSS, "Could not read cells");
+      return false;
+    }
+  }
+  while (!queue_.empty()) {
+    // Since "cell" has the smallest range_min() of any unprocessed cell (and
+    // is the largest such cell), every other cell that intersects it is a
+    // descendant of "cell" (or the same cell).
+    int run = std::get<2>(queue_.top());
+    queue_.pop();
+    unique_ptr<Entry> cell = std::move(fronts_[run]);
+    bool ok = ReadNext(run);
+    vector<unique_ptr<Entry>> overlapping;
+    while (ok && !queue_.empty() &&
+           std::get<0>(queue_.top()) <= cell->id.range_max().id()) {
+      int other = std::get<2>(queue_.top());
+      queue_.pop();
+      overlapping.push_back(std::move(fronts_[other]));
+      ok = ReadNext(other);
+    }
+    if (!ok) {
+      error->Init(S2Error::DATA_LOSS, "Could not read cells");
+      return false;
+    }
+    if (overlapping.empty()) {
+      EmitCell(cell->id, cell->data);
+    } else {
+      vector<Entry*> covering = {cell.get()}, descendants;
+      for (const auto& entry : overlapping) {
+        (entry->id == cell->id ? covering : descendants).push_back(
+            entry.get());
+      }
+      Refine(cell->id, covering, descendants);
+    }
+  }
+  encoder->Ensure(Varint::kMax64);
+  uint64 max_edges = options_.max_edges_per_cell();
+  encoder->put_varint64(max_edges << 2 |
+                        MutableS2ShapeIndex::kCurrentEncodingVersionNumber);
+  s2coding::EncodeS2CellIdVector(cell_ids_, options_.cell_id_directory_shift(),
+                                 encoder);
+  if (cells_file_ == nullptr) {
+    encoded_cells_.Encode(encoder);
+    return true;
+  }
+  // Copy the encoded cells from the temporary file in chunks.  This
+  // produces the same output as StringVectorEncoder.
+  s2coding::EncodeUintVector<uint64>(cell_offsets_, encoder);
+  if (!cells_file_ok_ || !cells_file_->StartReading()) {
+    error->Init(S2Error::RESOURCE_EXHAUSTED, "Could not write temporary file");
+    return false;
+  }
+  static const size_t kChunkSize = 1 << 20;
+  string chunk(kChunkSize, '\0');
+  uint64 remaining = cell_offsets_.empty() ? 0 : cell_offsets_.back();
+  while (remaining > 0) {
+    size_t n = std::min<uint64>(remaining, kChunkSize);
+    if (!cells_file_->ReadBytes(&chunk[0], n)) {
+      error->Init(S2Error::DATA_LOSS, "Could not read temporary file");
+      return false;
+    }
+    encoder->Ensure(n);
+    encoder->putn(chunk.data(), n);
+    remaining -= n;
+  }
+  return true;
+}
+
+// Adds the cells within "id" to the output, where "covering" is a list of
+// cells that contain "id" and "descendants" is a list of cells that are
+// properly contained by "id".
+void EncodedS2ShapeIndexBuilder::RunMerger::Refine(
+    S2CellId id, const vector<Entry*>& covering,
+    const vector<Entry*>& descendants) {
+  if (descendants.empty()) {
+    AddCell(id, covering);
+    return;
+  }
+  for (S2CellId child = id.child_begin(); child != id.child_end();
+       child = child.next()) {
+    vector<Entry*> child_covering = covering, child_descendants;
+    for (Entry* entry : descendants) {
+      if (!child.contains(entry->id)) continue;
+      (entry->id == child ? child_covering : child_descendants).push_back(
+          entry);
+    }
+    Refine(child, child_covering, child_descendants);
+  }
+}
+
+// Adds a cell to the output consisting of the edges from the "covering"
+// cells (each of which contains "id") that intersect "id".  The cell is
+// subdivided if it contains too many edges.
+void EncodedS2ShapeIndexBuilder::RunMerger::AddCell(
+    S2CellId id, const vector<Entry*>& covering) {
+  if (covering.size() == 1 && covering[0]->id == id) {
+    EmitCell(id, covering[0]->data);
+    return;
+  }
+  vector<ClippedShape> shapes;
+  for (Entry* entry : covering) {
+    const S2ShapeIndexCell& cell = GetCell(entry);
+    for (int j = 0; j < cell.num_clipped(); ++j) {
+      ClipShape(id, entry->id, cell.clipped(j), &shapes);
+    }
+  }
+  if (shapes.empty()) return;
+  std::sort(shapes.begin(), shapes.end());
+
+  Entry entry;
+  entry.id = id;
+  entry.cell = make_unique<S2ShapeIndexCell>();
+  S2ClippedShape* clipped = entry.cell->add_shapes(shapes.size());
+  for (const ClippedShape& shape : shapes) {
+    clipped->Init(shape.shape_id, shape.edges.size());
+    clipped->set_contains_center(shape.contains_center);
+    for (int i = 0; i < shape.edges.size(); ++i) {
+      clipped->set_edge(i, shape.edges[i]);
+    }
+    ++clipped;
+  }
+  if (id.level() < S2CellId::kMaxLevel &&
+      CountShortEdges(id.level(), shapes) > options_.max_edges_per_cell()) {
+    for (S2CellId child = id.child_begin(); child != id.child_end();
+         child = child.next()) {
+      AddCell(child, {&entry});
+    }
+    return;
+  }
+  cell_encoder_.clear();
+  entry.cell->Encode(num_shape_ids_, &cell_encoder_);
+  EmitCell(id, string(cell_encoder_.base(), cell_encoder_.length()));
+}
+
+// Clips "clipped" (a shape from the cell "ancestor") to the cell "id", and
+// appends the result to "result" unless it is empty.
+void EncodedS2ShapeIndexBuilder::RunMerger::ClipShape(
+    S2CellId id, S2CellId ancestor, const S2ClippedShape& clipped,
+    vector<ClippedShape>* result) {
+  ClippedShape shape;
+  shape.shape_id = clipped.shape_id();
+  shape.contains_center = clipped.contains_center();
+  if (id == ancestor) {
+    for (int i = 0; i < clipped.num_edges(); ++i) {
+      shape.edges.push_back(clipped.edge(i));
+    }
+  } else {
+    // The ancestor cell contains every edge that intersects it, so we can
+    // determine whether the center of "id" is contained by counting the edge
+    // crossings along the segment between the two cell centers (which is
+    // entirely contained by the ancestor cell).
+    const S2Shape& s2shape = GetShape(clipped.shape_id());
+    S2PaddedCell pcell(id, MutableS2ShapeIndex::kCellPadding);
+    S2CopyingEdgeCrosser crosser(ancestor.ToPoint(), id.ToPoint());
+    bool check_center = s2shape.dimension() == 2;
+    for (int i = 0; i < clipped.num_edges(); ++i) {
+      S2Shape::Edge edge = s2shape.edge(clipped.edge(i));
+      if (check_center && crosser.EdgeOrVertexCrossing(edge.v0, edge.v1)) {
+        shape.contains_center = !shape.contains_center;
+      }
+      if (EdgeIntersectsCell(edge, pcell)) {
+        shape.edges.push_back(clipped.edge(i));
+      }
+    }
+  }
+  if (shape.edges.empty() && !shape.contains_center) return;
+  result->push_back(std::move(shape));
+}
+
+// Returns true if "edge" may intersect the given padded cell.  This method
+// is conservative, i.e. it may return true for edges that are slightly
+// outside the cell.
+bool EncodedS2ShapeIndexBuilder::RunMerger::EdgeIntersectsCell(
+    const S2Shape::Edge& edge, const S2PaddedCell& pcell) {
+  R2Point a, b;
+  if (!S2::ClipToPaddedFace(edge.v0, edge.v1, pcell.id().face(),
+                            MutableS2ShapeIndex::kCellPadding, &a, &b)) {
+    return false;
+  }
+  return S2::IntersectsRect(
+      a, b, pcell.bound().Expanded(S2::kIntersectsRectErrorUVDist));
+}
+
+// Returns the number of edges in "shapes" that count towards the decision
+// to subdivide a cell at the given level (see
+// MutableS2ShapeIndex::GetEdgeMaxLevel).
+int EncodedS2ShapeIndexBuilder::RunMerger::CountShortEdges(
+    int level, const vector<ClippedShape>& shapes) {
+  int num_edges = 0;
+  for (const ClippedShape& shape : shapes) num_edges += shape.edges.size();
+  if (num_edges <= options_.max_edges_per_cell()) return num_edges;
+
+  int count = 0;
+  for (const ClippedShape& shape : shapes) {
+    const S2Shape& s2shape = GetShape(shape.shape_id);
+    for (int edge_id : shape.edges) {
+      S2Shape::Edge edge = s2shape.edge(edge_id);
+      double cell_size = ((edge.v0 - edge.v1).Norm() *
+                          FLAGS_s2shape_index_cell_size_to_long_edge_ratio);
+      if (S2::kAvgEdge.GetLevelForMaxValue(cell_size) > level) ++count;
+    }
+  }
+  return count;
+}
+
+void EncodedS2ShapeIndexBuilder::RunMerger::EmitCell(S2CellId id,
+                                                     const string& data) {
+  cell_ids_.push_back(id);
+  if (cells_file_ != nullptr) {
+    uint64 offset = cell_offsets_.empty() ? 0 : cell_offsets_.back();
+    cell_offsets_.push_back(offset + data.size());
+    if (!cells_file_->Append(data)) cells_file_ok_ = false;
+    return;
+  }
+  Encoder* encoder = encoded_cells_.AddViaEncoder();
+  encoder->Ensure(data.size());
+  encoder->putn(data.data(), data.size());
+}
+
+EncodedS2ShapeIndexBuilder::EncodedS2ShapeIndexBuilder() {
+}
+
+EncodedS2ShapeIndexBuilder::EncodedS2ShapeIndexBuilder(
+    const Options& options) : options_(options) {
+}
+
+bool EncodedS2ShapeIndexBuilder::Build(
+    const S2ShapeIndex::ShapeFactory& shape_factory, Encoder* encoder,
+    S2Error* error) {
+  error->Clear();
+  const int num_shape_ids = shape_factory.size();
+
+  // Divide the shapes into runs.
+  vector<pair<int, int>> runs;
+  int64 run_edges = 0;
+  for (int id = 0; id < num_shape_ids; ++id) {
+    auto shape = shape_factory[id];
+    int num_edges = shape ? shape->num_edges() : 0;
+    if (runs.empty() ||
+        (run_edges > 0 &&
+         run_edges + num_edges > options_.max_edges_per_run())) {
+      runs.emplace_back(id, id);
+      run_edges = 0;
+    }
+    ++runs.back().second;
+    run_edges += num_edges;
+  }
+  num_runs_ = runs.size();
+  vector<unique_ptr<RunFile>> files;
+  for (int i = 0; i < runs.size(); ++i) {
+    files.push_back(RunFile::Create(options_.temp_directory()));
+    if (files.back() == nullptr) {
+      error->Init(S2Error::RESOURCE_EXHAUSTED,
+                  "Could not create temporary file");
+      return false;
+    }
+  }
+
+  // Index each run and write its cells to the corresponding file.  Shape
+  // ids in the run files are global rather than relative to the run.
+  const int num_threads =
+      util_thread::NumParallelForThreads(runs.size(), options_.num_threads());
+  vector<Encoder> cell_encoders(num_threads);
+  std::atomic<bool> ok(true);
+  util_thread::ParallelFor(runs.size(), num_threads, [&](int thread, int i) {
+    if (!ok) return;
+    Encoder* cell_encoder = &cell_encoders[thread];
+    const int offset = runs[i].first;
+    MutableS2ShapeIndex index(options_);
+    for (int id = offset; id < runs[i].second; ++id) {
+      auto shape = shape_factory[id];
+      // Removed shapes are replaced by an empty shape so that shape ids
+      // remain contiguous.
+      if (shape == nullptr) shape = make_unique<S2LaxPolylineShape>();
+      index.Add(std::move(shape));
+    }
+    for (MutableS2ShapeIndex::Iterator it(&index, S2ShapeIndex::BEGIN);
+         !it.done(); it.Next()) {
+      cell_encoder->clear();
+      EncodeCell(it.cell(), offset, num_shape_ids, cell_encoder);
+      if (!files[i]->Write(it.id(), *cell_encoder)) {
+        ok = false;
+        return;
+      }
+    }
+  });
+  if (!ok) {
+    error->Init(S2Error::RESOURCE_EXHAUSTED,
+                "Could not write temporary file");
+    return false;
+  }
+
+  vector<unique_ptr<CellSource>> sources;
+  for (auto& file : files) {
+    if (!file->StartReading()) {
+      error->Init(S2Error::DATA_LOSS, "Could not read cells");
+      return false;
+    }
+    sources.push_back(std::move(file));
+  }
+  RunMerger merger(options_, shape_factory, std::move(sources));
+  return merger.Merge(encoder, error);
+}
+
+namespace {
+
+// A ShapeFactory that returns the shapes of several indexes, where the
+// shape ids of each index are offset by the total number of shape ids in
+// the preceding indexes.
+class ConcatenatedShapeFactory : public S2ShapeIndex::ShapeFactory {
+ public:
+  explicit ConcatenatedShapeFactory(
+      const vector<const S2ShapeIndex*>& indexes) {
+    int num_shape_ids = 0;
+    for (const S2ShapeIndex* index : indexes) {
+      factories_.emplace_back(num_shape_ids,
+                              s2shapeutil::WrappedShapeFactory(index));
+      num_shape_ids += index->num_shape_ids();
+    }
+    size_ = num_shape_ids;
+  }
+
+  int size() const override { return size_; }
+
+  unique_ptr<S2Shape> operator[](int shape_id) const override {
+    // Find the last factory whose offset is at most "shape_id".
+    auto it = std::upper_bound(
+        factories_.begin(), factories_.end(), shape_id,
+        [](int id, const pair<int, s2shapeutil::WrappedShapeFactory>& f) {
+          return id < f.first;
+        });
+    --it;
+    return it->second[shape_id - it->first];
+  }
+
+  unique_ptr<ShapeFactory> Clone() const override {
+    return make_unique<ConcatenatedShapeFactory>(*this);
+  }
+
+ private:
+  vector<pair<int, s2shapeutil::WrappedShapeFactory>> factories_;
+  int size_;
+};
+
+}  // namespace
+
+bool EncodedS2ShapeIndexBuilder::Merge(
+    const vector<const S2ShapeIndex*>& indexes, Encoder* encoder,
+    S2Error* error) {
+  error->Clear();
+  ConcatenatedShapeFactory shape_factory(indexes);
+  vector<unique_ptr<CellSource>> sources;
+  int offset = 0;
+  for (const S2ShapeIndex* index : indexes) {
+    sources.push_back(make_unique<IndexCellSource>(*index, offset,
+                                                   shape_factory.size()));
+    offset += index->num_shape_ids();
+  }
+  num_runs_ = indexes.size();
+  RunMerger merger(options_, shape_factory, std::move(sources));
+  return merger.Merge(encoder, error);
+}
+
+void EncodedS2ShapeIndexBuilder::EncodeCell(const S2ShapeIndexCell& cell,
+                                            int shape_id_offset,
+                                            int num_shape_ids,
+                                            Encoder* encoder) {
+  if (shape_id_offset == 0) {
+    cell.Encode(num_shape_ids, encoder);
+    return;
+  }
+  S2ShapeIndexCell global_cell;
+  S2ClippedShape* clipped = global_cell.add_shapes(cell.num_clipped());
+  for (int j = 0; j < cell.num_clipped(); ++j, ++clipped) {
+    const S2ClippedShape& local = cell.clipped(j);
+    clipped->Init(local.shape_id() + shape_id_offset, local.num_edges());
+    clipped->set_contains_center(local.contains_center());
+    for (int k = 0; k < local.num_edges(); ++k) {
+      clipped->set_edge(k, local.edge(k));
+    }
+  }
+  global_cell.Encode(num_shape_ids, encoder);
+}
@@ -0,0 +1,169 @@
+// Copyright 2018 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef S2_ENCODED_S2SHAPE_INDEX_BUILDER_H_
+#define S2_ENCODED_S2SHAPE_INDEX_BUILDER_H_
+
+#include <string>
+#include <vector>
+
+#include "s2/mutable_s2shape_index.h"
+#include "s2/s2error.h"
+#include "s2/util/coding/coder.h"
+
+// EncodedS2ShapeIndexBuilder produces the same encoding as
+// MutableS2ShapeIndex::Encode() (so that it can be loaded using
+// EncodedS2ShapeIndex or MutableS2ShapeIndex::Init), but without ever
+// building the entire index in memory.  This makes it possible to index
+// datasets whose MutableS2ShapeIndex would be much larger than the
+// available RAM.
+//
+// The shapes are read through an S2ShapeIndex::ShapeFactory, typically one
+// that decodes shapes lazily from a memory-mapped file (see
+// s2shapeutil_coding.h).  The index is built in two phases:
+//
+//  1. The shapes are divided into "runs" of consecutive shapes containing a
+//     bounded number of edges.  Each run is indexed using an ordinary
+//     MutableS2ShapeIndex (in parallel if requested), and its cells are
+//     written in S2CellId order to a temporary file.
+//
+//  2. The runs are merged into a single index.  Wherever cells from
+//     different runs overlap, the larger cells are split so that the
+//     resulting cells are disjoint; cells that contain too many edges after
+//     merging are subdivided further.
+//
+// Only the final encoded index (which is typically much smaller than the
+// equivalent MutableS2ShapeIndex) is held in memory.  The resulting cell
+// structure is not necessarily identical to the one produced by
+// MutableS2ShapeIndex, but it satisfies the same invariants.  (If all the
+// shapes fit in a single run, the output is identical.)
+//
+// Example usage:
+//
+//   Decoder shapes_decoder(shapes_data, shapes_size);
+//   auto shape_factory = s2shapeutil::LazyDecodeShapeFactory(&shapes_decoder);
+//   EncodedS2ShapeIndexBuilder::Options options;
+//   options.set_num_threads(8);
+//   EncodedS2ShapeIndexBuilder builder(options);
+//   Encoder encoder;
+//   S2Error error;
+//   if (!builder.Build(shape_factory, &encoder, &error)) { ... }
+class EncodedS2ShapeIndexBuilder {
+ public:
+  // See MutableS2ShapeIndex::Options for the options that control the
+  // structure of the index.
+  class Options : public MutableS2ShapeIndex::Options {
+   public:
+    Options();
+
+    // The maximum number of edges in each run (except that a run always
+    // contains at least one shape).  Memory usage is roughly proportional to
+    // num_threads() * max_edges_per_run().
+    //
+    // DEFAULT: 1 << 22
+    int max_edges_per_run() const { return max_edges_per_run_; }
+    void set_max_edges_per_run(int max_edges_per_run);
+
+    // The number of threads used to index runs.  If this is greater than one,
+    // the ShapeFactory must be safe to call from multiple threads (which is
+    // true of all the factories in s2shapeutil_coding.h).
+    //
+    // DEFAULT: 1
+    int num_threads() const { return num_threads_; }
+    void set_num_threads(int num_threads);
+
+    // The directory where temporary files are created.  The files are
+    // deleted automatically.  If empty, the system default is used.
+    //
+    // DEFAULT: ""
+    const std::string& temp_directory() const { return temp_directory_; }
+    void set_temp_directory(const std::string& temp_directory) {
+      temp_directory_ = temp_directory;
+    }
+
+   private:
+    int max_edges_per_run_;
+    int num_threads_;
+    std::string temp_directory_;
+  };
+
+  EncodedS2ShapeIndexBuilder();
+  explicit EncodedS2ShapeIndexBuilder(const Options& options);
+
+  const Options& options() const { return options_; }
+
+  // Indexes the shapes returned by "shape_factory" and appends the encoded
+  // index to "encoder".  Returns false and sets "error" if a temporary file
+  // could not be written or read.
+  //
+  // If "encoder" writes to an EncoderSink, the cells are spooled to a
+  // temporary file so that the encoded index is never held in memory.
+  //
+  // Every run has its own temporary file, and all of them are open at once
+  // while the runs are merged, so Build() needs one file descriptor per run
+  // (about the total number of edges divided by max_edges_per_run()).  Each
+  // shape is obtained from "shape_factory" twice (once to count its edges
+  // when dividing the shapes into runs, and once to index it), and again
+  // during the merge if it has edges in cells from different runs that
+  // overlap.
+  //
+  // REQUIRES: "encoder" uses the default constructor or an EncoderSink, so
+  //           that its buffer can be enlarged by calling Ensure(int).
+  bool Build(const S2ShapeIndex::ShapeFactory& shape_factory,
+             Encoder* encoder, S2Error* error);
+
+  // Merges several existing indexes (e.g., indexes built separately for
+  // different regions) into a single encoded index, and appends it to
+  // "encoder".  The shape ids of indexes[i] are offset by the total number
+  // of shape ids in indexes[0..i-1]; in other words the shapes of the
+  // merged index are the shapes of each input index in order.  (For
+  // example, an EncodedS2ShapeIndex can be built from the concatenation of
+  // the encoded shape vectors.)
+  //
+  // This is much faster than adding all the shapes to a new index, since
+  // the existing cells are reused.  Cells that do not overlap any cell from
+  // another index are copied unchanged, and edges are only clipped again
+  // where cells from different indexes overlap.  The options that control
+  // the index structure (e.g. max_edges_per_cell) are taken from this
+  // builder.  Returns false and sets "error" on failure.
+  //
+  // REQUIRES: "encoder" uses the default constructor or an EncoderSink, so
+  //           that its buffer can be enlarged by calling Ensure(int).
+  bool Merge(const std::vector<const S2ShapeIndex*>& indexes,
+             Encoder* encoder, S2Error* error);
+
+  // Returns the number of runs used by the last call to Build(), or the
+  // number of indexes passed to the last call to Merge().
+  int num_runs() const { return num_runs_; }
+
+ private:
+  class CellSource;
+  class IndexCellSource;
+  class RunFile;
+  class RunMerger;
+
+  // Appends "cell" to "encoder" after adding "shape_id_offset" to all of its
+  // shape ids.  "num_shape_ids" is the total number of shape ids.
+  static void EncodeCell(const S2ShapeIndexCell& cell, int shape_id_offset,
+                         int num_shape_ids, Encoder* encoder);
+
+  Options options_;
+  int num_runs_ = 0;
+
+  EncodedS2ShapeIndexBuilder(const EncodedS2ShapeIndexBuilder&) = delete;
+  void operator=(const EncodedS2ShapeIndexBuilder&) = delete;
+};
+
+#endif  // S2_ENCODED_S2SHAPE_INDEX_BUILDER_H_
@@ -0,0 +1,303 @@
+// Copyright 2018 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "s2/encoded_s2shape_index_builder.h"
+
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include "s2/third_party/absl/memory/memory.h"
+#include "s2/encoded_s2shape_index.h"
+#include "s2/mutable_s2shape_index.h"
+#include "s2/s1angle.h"
+#include "s2/s2cap.h"
+#include "s2/s2contains_point_query.h"
+#include "s2/s2edge_clipping.h"
+#include "s2/s2lax_polygon_shape.h"
+#include "s2/s2lax_polyline_shape.h"
+#include "s2/s2loop.h"
+#include "s2/s2padded_cell.h"
+#include "s2/s2point_vector_shape.h"
+#include "s2/s2shapeutil_coding.h"
+#include "s2/s2testing.h"
+
+using absl::make_unique;
+using std::string;
+using std::unique_ptr;
+using std::vector;
+
+namespace {
+
+// Adds a mixture of overlapping polygons, polylines, and points near "cap"
+// to "index".
+void AddRandomShapes(const S2Cap& cap, int num_shapes,
+                     MutableS2ShapeIndex* index) {
+  for (int i = 0; i < num_shapes; ++i) {
+    S2Point center = S2Testing::SamplePoint(cap);
+    S1Angle radius = S1Angle::Degrees(S2Testing::rnd.UniformDouble(0.1, 5));
+    vector<S2Point> vertices;
+    switch (i % 3) {
+      case 0: {
+        auto loop = S2Loop::MakeRegularLoop(center, radius,
+                                            4 + S2Testing::rnd.Uniform(50));
+        for (int j = 0; j < loop->num_vertices(); ++j) {
+          vertices.push_back(loop->vertex(j));
+        }
+        index->Add(make_unique<S2LaxPolygonShape>(
+            vector<vector<S2Point>>{vertices}));
+        break;
+      }
+      case 1:
+        for (int j = 0; j < 30; ++j) {
+          vertices.push_back(S2Testing::SamplePoint(S2Cap(center, radius)));
+        }
+        index->Add(make_unique<S2LaxPolylineShape>(vertices));
+        break;
+      default:
+        for (int j = 0; j < 10; ++j) {
+          vertices.push_back(S2Testing::SamplePoint(S2Cap(center, radius)));
+        }
+        index->Add(make_unique<S2PointVectorShape>(vertices));
+        break;
+    }
+  }
+}
+
+S2Cap RandomCap() {
+  return S2Cap(S2Testing::RandomPoint(), S1Angle::Degrees(20));
+}
+
+// Checks that "actual" is a valid index for the shapes in "expected".
+void CheckIndexIsValid(const MutableS2ShapeIndex& expected,
+                       const EncodedS2ShapeIndex& actual) {
+  auto query = MakeS2ContainsPointQuery(&expected);
+  S2CellId prev_id = S2CellId::None();
+  for (EncodedS2ShapeIndex::Iterator it(&actual, S2ShapeIndex::BEGIN);
+       !it.done(); it.Next()) {
+    // The cells must be disjoint and sorted.
+    S2CellId id = it.id();
+    if (prev_id != S2CellId::None()) {
+      ASSERT_GT(id.range_min(), prev_id.range_max());
+    }
+    prev_id = id;
+
+    // Every edge that intersects the cell must be present, and the
+    // contains_center() flag must be correct.
+    const S2ShapeIndexCell& cell = it.cell();
+    R2Rect bound = S2PaddedCell(id, 0).bound();
+    for (int shape_id = 0; shape_id < expected.num_shape_ids(); ++shape_id) {
+      const S2Shape& shape = *expected.shape(shape_id);
+      const S2ClippedShape* clipped = cell.find_clipped(shape_id);
+      for (int e = 0; e < shape.num_edges(); ++e) {
+        S2Shape::Edge edge = shape.edge(e);
+        R2Point a, b;
+        if (S2::ClipToFace(edge.v0, edge.v1, id.face(), &a, &b) &&
+            S2::IntersectsRect(a, b, bound)) {
+          ASSERT_TRUE(clipped != nullptr && clipped->ContainsEdge(e))
+              << "Missing edge " << e << " of shape " << shape_id << " in "
+              << id;
+        }
+      }
+      if (shape.dimension() == 2) {
+        bool contains_center = clipped && clipped->contains_center();
+        ASSERT_EQ(query.ShapeContains(shape, it.center()), contains_center)
+            << "Shape " << shape_id << " in " << id;
+      }
+    }
+  }
+}
+
+TEST(EncodedS2ShapeIndexBuilder, SingleRunMatchesEncode) {
+  MutableS2ShapeIndex index;
+  AddRandomShapes(RandomCap(), 30, &index);
+  Encoder expected;
+  index.Encode(&expected);
+
+  s2shapeutil::WrappedShapeFactory shape_factory(&index);
+  EncodedS2ShapeIndexBuilder builder;
+  Encoder actual;
+  S2Error error;
+  ASSERT_TRUE(builder.Build(shape_factory, &actual, &error)) << error;
+  EXPECT_EQ(1, builder.num_runs());
+  EXPECT_EQ(string(expected.base(), expected.length()),
+            string(actual.base(), actual.length()));
+}
+
+TEST(EncodedS2ShapeIndexBuilder, EncoderSink) {
+  // Building to an EncoderSink must produce the same bytes as building to a
+  // memory buffer.
+  MutableS2ShapeIndex index;
+  AddRandomShapes(RandomCap(), 40, &index);
+  s2shapeutil::WrappedShapeFactory shape_factory(&index);
+  EncodedS2ShapeIndexBuilder::Options options;
+  options.set_max_edges_per_run(300);
+  EncodedS2ShapeIndexBuilder builder(options);
+  Encoder expected;
+  S2Error error;
+  ASSERT_TRUE(builder.Build(shape_factory, &expected, &error)) << error;
+  EXPECT_GT(builder.num_runs(), 1);
+
+  string output;
+  StringEncoderSink sink(&output);
+  Encoder actual(&sink, 64);
+  ASSERT_TRUE(builder.Build(shape_factory, &actual, &error)) << error;
+  EXPECT_EQ(expected.length(), actual.length());
+  ASSERT_TRUE(actual.Flush());
+  EXPECT_EQ(string(expected.base(), expected.length()), output);
+}
+
+TEST(EncodedS2ShapeIndexBuilder, Empty) {
+  MutableS2ShapeIndex index;
+  Encoder expected;
+  index.Encode(&expected);
+
+  s2shapeutil::WrappedShapeFactory shape_factory(&index);
+  EncodedS2ShapeIndexBuilder builder;
+  Encoder actual;
+  S2Error error;
+  ASSERT_TRUE(builder.Build(shape_factory, &actual, &error)) << error;
+  EXPECT_EQ(0, builder.num_runs());
+  EXPECT_EQ(string(expected.base(), expected.length()),
+            string(actual.base(), actual.length()));
+}
+
+TEST(EncodedS2ShapeIndexBuilder, MultipleRuns) {
+  for (int num_threads : {1, 4}) {
+    MutableS2ShapeIndex expected;
+    AddRandomShapes(RandomCap(), 60, &expected);
+    s2shapeutil::WrappedShapeFactory shape_factory(&expected);
+    EncodedS2ShapeIndexBuilder::Options options;
+    options.set_max_edges_per_run(200);
+    options.set_max_edges_per_cell(5);
+    options.set_num_threads(num_threads);
+    EncodedS2ShapeIndexBuilder builder(options);
+    Encoder encoder;
+    S2Error error;
+    ASSERT_TRUE(builder.Build(shape_factory, &encoder, &error)) << error;
+    EXPECT_GT(builder.num_runs(), 5);
+
+    Decoder decoder(encoder.base(), encoder.length());
+    EncodedS2ShapeIndex actual;
+    ASSERT_TRUE(actual.Init(&decoder, shape_factory));
+    EXPECT_EQ(5, actual.options().max_edges_per_cell());
+    CheckIndexIsValid(expected, actual);
+  }
+}
+
+TEST(EncodedS2ShapeIndexBuilder, TempDirectory) {
+  MutableS2ShapeIndex expected;
+  AddRandomShapes(RandomCap(), 20, &expected);
+  s2shapeutil::WrappedShapeFactory shape_factory(&expected);
+  EncodedS2ShapeIndexBuilder::Options options;
+  options.set_max_edges_per_run(100);
+  options.set_temp_directory("/tmp");
+  EncodedS2ShapeIndexBuilder builder(options);
+  Encoder encoder;
+  S2Error error;
+  ASSERT_TRUE(builder.Build(shape_factory, &encoder, &error)) << error;
+  Decoder decoder(encoder.base(), encoder.length());
+  EncodedS2ShapeIndex actual;
+  ASSERT_TRUE(actual.Init(&decoder, shape_factory));
+  CheckIndexIsValid(expected, actual);
+
+  options.set_temp_directory("/nonexistent/directory");
+  EncodedS2ShapeIndexBuilder bad_builder(options);
+  Encoder bad_encoder;
+  EXPECT_FALSE(bad_builder.Build(shape_factory, &bad_encoder, &error));
+  EXPECT_EQ(S2Error::RESOURCE_EXHAUSTED, error.code());
+}
+
+// Returns a new index containing the shapes of "index" with the given ids.
+unique_ptr<MutableS2ShapeIndex> MakeShard(const MutableS2ShapeIndex& index,
+                                          int begin, int end) {
+  s2shapeutil::WrappedShapeFactory shape_factory(&index);
+  auto shard = make_unique<MutableS2ShapeIndex>();
+  for (int id = begin; id < end; ++id) shard->Add(shape_factory[id]);
+  return shard;
+}
+
+TEST(EncodedS2ShapeIndexBuilder, MergeOverlappingIndexes) {
+  MutableS2ShapeIndex expected;
+  AddRandomShapes(RandomCap(), 60, &expected);
+  auto shard0 = MakeShard(expected, 0, 20);
+  auto shard1 = MakeShard(expected, 20, 45);
+  auto shard2 = MakeShard(expected, 45, 60);
+
+  // Also test merging an EncodedS2ShapeIndex.
+  Encoder shard1_encoder;
+  shard1->Encode(&shard1_encoder);
+  Decoder shard1_decoder(shard1_encoder.base(), shard1_encoder.length());
+  EncodedS2ShapeIndex encoded_shard1;
+  ASSERT_TRUE(encoded_shard1.Init(
+      &shard1_decoder, s2shapeutil::WrappedShapeFactory(shard1.get())));
+
+  EncodedS2ShapeIndexBuilder::Options options;
+  options.set_max_edges_per_cell(4);
+  EncodedS2ShapeIndexBuilder builder(options);
+  Encoder encoder;
+  S2Error error;
+  ASSERT_TRUE(builder.Merge({shard0.get(), &encoded_shard1, shard2.get()},
+                            &encoder, &error)) << error;
+  EXPECT_EQ(3, builder.num_runs());
+
+  Decoder decoder(encoder.base(), encoder.length());
+  EncodedS2ShapeIndex actual;
+  ASSERT_TRUE(actual.Init(&decoder,
+                          s2shapeutil::WrappedShapeFactory(&expected)));
+  EXPECT_EQ(60, actual.num_shape_ids());
+  CheckIndexIsValid(expected, actual);
+}
+
+TEST(EncodedS2ShapeIndexBuilder, MergeDisjointIndexes) {
+  // When the inputs do not overlap, the merged index consists of exactly
+  // the cells of the inputs.
+  MutableS2ShapeIndex expected;
+  for (int face = 0; face < 6; face += 2) {
+    AddRandomShapes(S2Cap(S2CellId::FromFace(face).ToPoint(),
+                          S1Angle::Degrees(10)), 10, &expected);
+  }
+  vector<unique_ptr<MutableS2ShapeIndex>> shards;
+  vector<const S2ShapeIndex*> inputs;
+  std::set<S2CellId> expected_ids;
+  for (int i = 0; i < 3; ++i) {
+    shards.push_back(MakeShard(expected, 10 * i, 10 * i + 10));
+    inputs.push_back(shards.back().get());
+    for (MutableS2ShapeIndex::Iterator it(shards.back().get(),
+                                          S2ShapeIndex::BEGIN);
+         !it.done(); it.Next()) {
+      expected_ids.insert(it.id());
+    }
+  }
+  EncodedS2ShapeIndexBuilder builder;
+  Encoder encoder;
+  S2Error error;
+  ASSERT_TRUE(builder.Merge(inputs, &encoder, &error)) << error;
+  Decoder decoder(encoder.base(), encoder.length());
+  EncodedS2ShapeIndex actual;
+  ASSERT_TRUE(actual.Init(&decoder,
+                          s2shapeutil::WrappedShapeFactory(&expected)));
+  std::set<S2CellId> actual_ids;
+  for (EncodedS2ShapeIndex::Iterator it(&actual, S2ShapeIndex::BEGIN);
+       !it.done(); it.Next()) {
+    actual_ids.insert(it.id());
+  }
+  EXPECT_EQ(expected_ids, actual_ids);
+  CheckIndexIsValid(expected, actual);
+}
+
+}  // namespace
@@ -0,0 +1,275 @@
+// Copyright 2018 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "s2/encoded_s2shape_index_delta.h"
+
+#include <vector>
+
+#include "s2/third_party/absl/strings/string_view.h"
+#include "s2/encoded_s2cell_id_vector.h"
+#include "s2/encoded_string_vector.h"
+#include "s2/encoded_uint_vector.h"
+#include "s2/util/coding/transforms.h"
+
+using absl::string_view;
+using std::vector;
+
+namespace s2coding {
+
+namespace {
+
+// A delta represents the target vector as a sequence of runs, each of which
+// either copies consecutive strings from the base vector or inserts
+// consecutive strings that are stored in the delta itself.  The encoding is:
+//
+//   varint32: number of runs
+//   for each run:
+//     varint64: (count << 1) | is_copy
+//     if is_copy, varint64: ZigZag(first base string - current target size)
+//   EncodedStringVector: the inserted strings
+//
+// Since strings are usually copied from the same position in the base
+// vector (or from a nearby position), the base offsets are very small.
+struct Run {
+  bool copy;
+  uint32 count;
+  uint32 base_start;  // Only used if "copy" is true.
+};
+
+class DeltaBuilder {
+ public:
+  // Appends base string "base_index" to the target vector.
+  void Copy(uint32 base_index) {
+    if (!runs_.empty() && runs_.back().copy &&
+        runs_.back().base_start + runs_.back().count == base_index) {
+      ++runs_.back().count;
+    } else {
+      runs_.push_back(Run{true, 1, base_index});
+    }
+  }
+
+  // Appends "str" to the target vector.
+  void Insert(string_view str) {
+    if (!runs_.empty() && !runs_.back().copy) {
+      ++runs_.back().count;
+    } else {
+      runs_.push_back(Run{false, 1, 0});
+    }
+    Encoder* encoder = inserted_.AddViaEncoder();
+    encoder->Ensure(str.size());
+    encoder->putn(str.data(), str.size());
+  }
+
+  void Encode(Encoder* encoder) {
+    encoder->Ensure(Encoder::kVarintMax32 + runs_.size() * 2 * Varint::kMax64);
+    encoder->put_varint32(runs_.size());
+    int64 target_size = 0;
+    for (const Run& run : runs_) {
+      encoder->put_varint64(uint64{run.count} << 1 | run.copy);
+      if (run.copy) {
+        encoder->put_varint64(ZigZagEncode64(run.base_start - target_size));
+      }
+      target_size += run.count;
+    }
+    inserted_.Encode(encoder);
+  }
+
+ private:
+  vector<Run> runs_;
+  StringVectorEncoder inserted_;
+};
+
+// Decodes the output of DeltaBuilder::Encode and checks that it is valid for
+// a base vector with "base_size" elements.
+bool DecodeRuns(Decoder* decoder, size_t base_size, vector<Run>* runs,
+                EncodedStringVector* inserted) {
+  uint32 num_runs;
+  if (!decoder->get_varint32(&num_runs)) return false;
+  // Each run requires at least one byte.
+  if (num_runs > decoder->avail()) return false;
+  runs->clear();
+  runs->reserve(num_runs);
+  int64 target_size = 0;
+  uint64 num_inserted = 0;
+  for (uint32 i = 0; i < num_runs; ++i) {
+    uint64 code;
+    if (!decoder->get_varint64(&code)) return false;
+    if ((code >> 1) > kuint32max) return false;
+    Run run{(code & 1) != 0, static_cast<uint32>(code >> 1), 0};
+    if (run.copy) {
+      uint64 zigzag;
+      if (!decoder->get_varint64(&zigzag)) return false;
+      int64 base_start = target_size + ZigZagDecode64(zigzag);
+      if (base_start < 0 || base_start + run.count > base_size) return false;
+      run.base_start = base_start;
+    } else {
+      num_inserted += run.count;
+    }
+    target_size += run.count;
+    runs->push_back(run);
+  }
+  if (!inserted->Init(decoder)) return false;
+  return inserted->size() == num_inserted;
+}
+
+// Appends the EncodedStringVector described by "runs" to "output".
+void ApplyRuns(const EncodedStringVector& base, const vector<Run>& runs,
+               const EncodedStringVector& inserted, Encoder* output) {
+  vector<uint64> offsets;
+  uint64 offset = 0;
+  int next_inserted = 0;
+  for (const Run& run : runs) {
+    const EncodedStringVector& source = run.copy ? base : inserted;
+    int start = run.copy ? run.base_start : next_inserted;
+    int limit = start + run.count;
+    for (int i = start; i < limit; ++i) {
+      offset += source[i].size();
+      offsets.push_back(offset);
+    }
+    if (!run.copy) next_inserted += run.count;
+  }
+  EncodeUintVector<uint64>(offsets, output);
+
+  // Now copy each run of strings, which are stored contiguously.
+  next_inserted = 0;
+  for (const Run& run : runs) {
+    string_view data;
+    if (run.copy) {
+      data = base.GetRange(run.base_start, run.base_start + run.count);
+    } else {
+      data = inserted.GetRange(next_inserted, next_inserted + run.count);
+      next_inserted += run.count;
+    }
+    output->Ensure(data.size());
+    output->putn(data.data(), data.size());
+  }
+}
+
+// Decodes the output of MutableS2ShapeIndex::Encode().  "header" is set to
+// the initial varint, which contains the version number and options.  (It
+// is copied to the output without being interpreted.)
+bool DecodeIndex(Decoder* decoder, uint64* header,
+                 EncodedS2CellIdVector* cell_ids,
+                 EncodedStringVector* cells) {
+  if (!decoder->get_varint64(header)) return false;
+  return (cell_ids->Init(decoder) && cells->Init(decoder) &&
+          cell_ids->size() == cells->size());
+}
+
+}  // namespace
+
+bool EncodeStringVectorDelta(Decoder* base, Decoder* target, Encoder* delta) {
+  EncodedStringVector base_vector, target_vector;
+  if (!base_vector.Init(base) || !target_vector.Init(target)) return false;
+  vector<string_view> base_strings = base_vector.Decode();
+  vector<string_view> target_strings = target_vector.Decode();
+  DeltaBuilder builder;
+  for (int i = 0; i < target_strings.size(); ++i) {
+    if (i < base_strings.size() && base_strings[i] == target_strings[i]) {
+      builder.Copy(i);
+    } else {
+      builder.Insert(target_strings[i]);
+    }
+  }
+  builder.Encode(delta);
+  return true;
+}
+
+bool ApplyStringVectorDelta(Decoder* base, Decoder* delta, Encoder* output) {
+  EncodedStringVector base_vector, inserted;
+  vector<Run> runs;
+  if (!base_vector.Init(base) ||
+      !DecodeRuns(delta, base_vector.size(), &runs, &inserted)) {
+    return false;
+  }
+  ApplyRuns(base_vector, runs, inserted, output);
+  return true;
+}
+
+// The index delta is encoded as follows:
+//
+//   varint64: the target index header (see MutableS2ShapeIndex::Encode)
+//   byte: the directory shift of the target EncodedS2CellIdVector
+//   runs: the target cells (see DeltaBuilder)
+//   EncodedS2CellIdVector: the S2CellIds of the inserted cells
+//
+// The S2CellIds of the copied cells are taken from the base index.
+bool EncodeS2ShapeIndexDelta(Decoder* base, Decoder* target, Encoder* delta) {
+  uint64 base_header, target_header;
+  EncodedS2CellIdVector base_ids, target_ids;
+  EncodedStringVector base_cells, target_cells;
+  if (!DecodeIndex(base, &base_header, &base_ids, &base_cells) ||
+      !DecodeIndex(target, &target_header, &target_ids, &target_cells)) {
+    return false;
+  }
+  delta->Ensure(Varint::kMax64 + 1);
+  delta->put_varint64(target_header);
+  delta->put8(target_ids.directory_shift());
+
+  // Both cell vectors are sorted by S2CellId, so we can match them by
+  // iterating through them in parallel.
+  vector<S2CellId> base_id_vector = base_ids.Decode();
+  vector<S2CellId> target_id_vector = target_ids.Decode();
+  vector<string_view> base_cell_vector = base_cells.Decode();
+  vector<string_view> target_cell_vector = target_cells.Decode();
+  DeltaBuilder builder;
+  vector<S2CellId> inserted_ids;
+  int j = 0;
+  for (int i = 0; i < target_id_vector.size(); ++i) {
+    S2CellId id = target_id_vector[i];
+    while (j < base_id_vector.size() && base_id_vector[j] < id) ++j;
+    if (j < base_id_vector.size() && base_id_vector[j] == id &&
+        base_cell_vector[j] == target_cell_vector[i]) {
+      builder.Copy(j);
+    } else {
+      builder.Insert(target_cell_vector[i]);
+      inserted_ids.push_back(id);
+    }
+  }
+  builder.Encode(delta);
+  EncodeS2CellIdVector(inserted_ids, delta);
+  return true;
+}
+
+bool ApplyS2ShapeIndexDelta(Decoder* base, Decoder* delta, Encoder* output) {
+  uint64 base_header, target_header;
+  EncodedS2CellIdVector base_ids, inserted_ids;
+  EncodedStringVector base_cells, inserted;
+  if (!DecodeIndex(base, &base_header, &base_ids, &base_cells)) return false;
+  if (!delta->get_varint64(&target_header)) return false;
+  if (delta->avail() < 1) return false;
+  int directory_shift = delta->get8();
+  if (directory_shift > 31) return false;
+  vector<Run> runs;
+  if (!DecodeRuns(delta, base_cells.size(), &runs, &inserted) ||
+      !inserted_ids.Init(delta) || inserted_ids.size() != inserted.size()) {
+    return false;
+  }
+  vector<S2CellId> ids;
+  int next_inserted = 0;
+  for (const Run& run : runs) {
+    for (uint32 i = 0; i < run.count; ++i) {
+      ids.push_back(run.copy ? base_ids[run.base_start + i]
+                             : inserted_ids[next_inserted++]);
+    }
+  }
+  output->Ensure(Varint::kMax64);
+  output->put_varint64(target_header);
+  EncodeS2CellIdVector(ids, directory_shift, output);
+  ApplyRuns(base_cells, runs, inserted, output);
+  return true;
+}
+
+}  // namespace s2coding
@@ -0,0 +1,99 @@
+// Copyright 2018 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef S2_ENCODED_S2SHAPE_INDEX_DELTA_H_
+#define S2_ENCODED_S2SHAPE_INDEX_DELTA_H_
+
+#include "s2/util/coding/coder.h"
+
+// This file defines functions that compute a compact "delta" between two
+// versions of an encoded S2ShapeIndex, and that reconstruct the new version
+// from the old version and the delta.  This is useful when an index that
+// changes slowly is distributed to many machines: only the delta needs to be
+// transmitted, and its size is proportional to the size of the change.
+//
+// Deltas are computed separately for each component of the encoding.  The
+// usual layout (see s2shapeutil_coding.h) consists of a vector of tagged
+// shapes (an EncodedStringVector) followed by the output of
+// MutableS2ShapeIndex::Encode().  Since all the functions below advance
+// their Decoders past the component they process, such an encoding can be
+// handled like this:
+//
+//   // Compute the delta.
+//   Decoder base(base_data, base_size), target(target_data, target_size);
+//   Encoder delta;
+//   if (!s2coding::EncodeStringVectorDelta(&base, &target, &delta) ||
+//       !s2coding::EncodeS2ShapeIndexDelta(&base, &target, &delta)) { ... }
+//
+//   // Apply the delta.
+//   Decoder base(base_data, base_size), delta(delta_data, delta_size);
+//   Encoder target;
+//   if (!s2coding::ApplyStringVectorDelta(&base, &delta, &target) ||
+//       !s2coding::ApplyS2ShapeIndexDelta(&base, &delta, &target)) { ... }
+//
+// The reconstructed encoding is byte-for-byte identical to the original
+// target encoding.  Shapes are matched by shape id, and index cells are
+// matched by S2CellId; a shape or cell is included in the delta only if its
+// encoding has changed.  Applying a delta copies each run of unchanged
+// strings from the base version with a single memcpy.
+//
+// Only the size of the delta is proportional to the size of the change.
+// Computing or applying a delta takes time proportional to the size of the
+// whole index, since every cell id and cell offset of the target is
+// re-encoded.  Shapes are matched by position in the string vector, which
+// is their shape id, so a delta stays small only if shape ids are stable
+// (as they are in MutableS2ShapeIndex, where removed shapes leave a null
+// entry); renumbering the shapes makes every later shape part of the delta.
+
+namespace s2coding {
+
+// Appends a delta between two EncodedStringVectors (such as those produced
+// by s2shapeutil::EncodeTaggedShapes) to "delta".  String "i" of the target
+// is copied from string "i" of the base if they are equal.  Returns false if
+// either vector cannot be decoded.
+//
+// REQUIRES: "delta" uses the default constructor, so that its buffer
+//           can be enlarged as necessary by calling Ensure(int).
+bool EncodeStringVectorDelta(Decoder* base, Decoder* target, Encoder* delta);
+
+// Decodes a delta produced by EncodeStringVectorDelta and appends the target
+// EncodedStringVector to "output".  Returns false on decoding errors
+// (including a delta that does not match "base").
+//
+// REQUIRES: "output" uses the default constructor, so that its buffer
+//           can be enlarged as necessary by calling Ensure(int).
+bool ApplyStringVectorDelta(Decoder* base, Decoder* delta, Encoder* output);
+
+// Appends a delta between two encodings produced by
+// MutableS2ShapeIndex::Encode() to "delta".  A cell of the target index is
+// copied from the base index if a cell with the same S2CellId exists there
+// and has the same encoding.  Returns false if either index cannot be
+// decoded.
+//
+// REQUIRES: "delta" uses the default constructor, so that its buffer
+//           can be enlarged as necessary by calling Ensure(int).
+bool EncodeS2ShapeIndexDelta(Decoder* base, Decoder* target, Encoder* delta);
+
+// Decodes a delta produced by EncodeS2ShapeIndexDelta and appends the
+// target index encoding to "output".  Returns false on decoding errors
+// (including a delta that does not match "base").
+//
+// REQUIRES: "output" uses the default constructor, so that its buffer
+//           can be enlarged as necessary by calling Ensure(int).
+bool ApplyS2ShapeIndexDelta(Decoder* base, Decoder* delta, Encoder* output);
+
+}  // namespace s2coding
+
+#endif  // S2_ENCODED_S2SHAPE_INDEX_DELTA_H_
@@ -0,0 +1,212 @@
+// Copyright 2018 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "s2/encoded_s2shape_index_delta.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include "s2/third_party/absl/memory/memory.h"
+#include "s2/encoded_s2shape_index.h"
+#include "s2/encoded_string_vector.h"
+#include "s2/mutable_s2shape_index.h"
+#include "s2/s1angle.h"
+#include "s2/s2lax_polygon_shape.h"
+#include "s2/s2loop.h"
+#include "s2/s2shapeutil_coding.h"
+#include "s2/s2testing.h"
+
+using absl::make_unique;
+using std::string;
+using std::vector;
+
+namespace s2coding {
+namespace {
+
+string EncodeStrings(const vector<string>& strings) {
+  Encoder encoder;
+  StringVectorEncoder::Encode(strings, &encoder);
+  return string(encoder.base(), encoder.length());
+}
+
+// Checks that applying the delta from "base" to "target" yields "target",
+// and returns the size of the delta.
+size_t TestStringVectorDelta(const vector<string>& base,
+                             const vector<string>& target) {
+  string base_data = EncodeStrings(base);
+  string target_data = EncodeStrings(target);
+  Decoder base_decoder(base_data.data(), base_data.size());
+  Decoder target_decoder(target_data.data(), target_data.size());
+  Encoder delta;
+  EXPECT_TRUE(EncodeStringVectorDelta(&base_decoder, &target_decoder,
+                                      &delta));
+  EXPECT_EQ(0, target_decoder.avail());
+
+  base_decoder.reset(base_data.data(), base_data.size());
+  Decoder delta_decoder(delta.base(), delta.length());
+  Encoder output;
+  EXPECT_TRUE(ApplyStringVectorDelta(&base_decoder, &delta_decoder, &output));
+  EXPECT_EQ(0, base_decoder.avail());
+  EXPECT_EQ(0, delta_decoder.avail());
+  EXPECT_EQ(target_data, string(output.base(), output.length()));
+  return delta.length();
+}
+
+TEST(StringVectorDelta, Empty) {
+  TestStringVectorDelta({}, {});
+  TestStringVectorDelta({"a", "b"}, {});
+  TestStringVectorDelta({}, {"a", "b"});
+}
+
+TEST(StringVectorDelta, Changes) {
+  vector<string> base;
+  for (int i = 0; i < 1000; ++i) {
+    base.push_back(string(20 + i % 7, 'a' + i % 26));
+  }
+  EXPECT_LT(TestStringVectorDelta(base, base), 10);
+
+  vector<string> target = base;
+  target[17] = "changed";
+  target[500] = "";
+  target[501] = "also changed";
+  target.push_back("appended");
+  EXPECT_LT(TestStringVectorDelta(base, target), 60);
+
+  target.resize(900);
+  TestStringVectorDelta(base, target);
+}
+
+TEST(StringVectorDelta, InvalidDelta) {
+  string base_data = EncodeStrings({"a", "b"});
+  string target_data = EncodeStrings({"a", "c", "d"});
+  Decoder base_decoder(base_data.data(), base_data.size());
+  Decoder target_decoder(target_data.data(), target_data.size());
+  Encoder delta;
+  ASSERT_TRUE(EncodeStringVectorDelta(&base_decoder, &target_decoder, &delta));
+
+  // A truncated delta is detected.
+  for (int len = 0; len < delta.length(); ++len) {
+    base_decoder.reset(base_data.data(), base_data.size());
+    Decoder delta_decoder(delta.base(), len);
+    Encoder output;
+    EXPECT_FALSE(ApplyStringVectorDelta(&base_decoder, &delta_decoder,
+                                        &output));
+  }
+  // So is a delta that copies strings not present in the base vector.
+  string empty_data = EncodeStrings({});
+  Decoder empty_decoder(empty_data.data(), empty_data.size());
+  Decoder delta_decoder(delta.base(), delta.length());
+  Encoder output;
+  EXPECT_FALSE(ApplyStringVectorDelta(&empty_decoder, &delta_decoder,
+                                      &output));
+}
+
+void AddRandomPolygon(MutableS2ShapeIndex* index) {
+  auto loop = S2Loop::MakeRegularLoop(
+      S2Testing::RandomPoint(), S1Angle::Degrees(2), 10);
+  vector<S2Point> vertices;
+  for (int i = 0; i < loop->num_vertices(); ++i) {
+    vertices.push_back(loop->vertex(i));
+  }
+  index->Add(make_unique<S2LaxPolygonShape>(vector<vector<S2Point>>{
+      vertices}));
+}
+
+// Returns the usual encoding of "index": the tagged shapes followed by the
+// index itself.
+string EncodeIndex(const MutableS2ShapeIndex& index) {
+  Encoder encoder;
+  EXPECT_TRUE(s2shapeutil::CompactEncodeTaggedShapes(index, &encoder));
+  index.Encode(&encoder);
+  return string(encoder.base(), encoder.length());
+}
+
+// Checks that the delta between the encodings of "base" and "target"
+// reconstructs the target encoding, and returns the size of the delta.
+size_t TestIndexDelta(const MutableS2ShapeIndex& base,
+                      const MutableS2ShapeIndex& target) {
+  string base_data = EncodeIndex(base);
+  string target_data = EncodeIndex(target);
+  Decoder base_decoder(base_data.data(), base_data.size());
+  Decoder target_decoder(target_data.data(), target_data.size());
+  Encoder delta;
+  EXPECT_TRUE(EncodeStringVectorDelta(&base_decoder, &target_decoder,
+                                      &delta));
+  EXPECT_TRUE(EncodeS2ShapeIndexDelta(&base_decoder, &target_decoder,
+                                      &delta));
+  EXPECT_EQ(0, target_decoder.avail());
+
+  base_decoder.reset(base_data.data(), base_data.size());
+  Decoder delta_decoder(delta.base(), delta.length());
+  Encoder output;
+  EXPECT_TRUE(ApplyStringVectorDelta(&base_decoder, &delta_decoder, &output));
+  EXPECT_TRUE(ApplyS2ShapeIndexDelta(&base_decoder, &delta_decoder, &output));
+  EXPECT_EQ(0, delta_decoder.avail());
+  EXPECT_EQ(target_data, string(output.base(), output.length()));
+
+  // Check that the result can be decoded.
+  Decoder decoder(output.base(), output.length());
+  s2shapeutil::TaggedShapeFactory shape_factory =
+      s2shapeutil::LazyDecodeShapeFactory(&decoder);
+  EncodedS2ShapeIndex decoded;
+  EXPECT_TRUE(decoded.Init(&decoder, shape_factory));
+  EXPECT_EQ(target.num_shape_ids(), decoded.num_shape_ids());
+  return delta.length();
+}
+
+TEST(S2ShapeIndexDelta, EmptyIndexes) {
+  MutableS2ShapeIndex empty, index;
+  AddRandomPolygon(&index);
+  TestIndexDelta(empty, empty);
+  TestIndexDelta(empty, index);
+  TestIndexDelta(index, empty);
+}
+
+TEST(S2ShapeIndexDelta, SmallChangeHasSmallDelta) {
+  // Make "target" a copy of "base" with one shape removed and one added.
+  MutableS2ShapeIndex base, target;
+  S2Testing::rnd.Reset(1);
+  for (int i = 0; i < 1000; ++i) AddRandomPolygon(&base);
+  S2Testing::rnd.Reset(1);
+  for (int i = 0; i < 1000; ++i) AddRandomPolygon(&target);
+  target.Release(123);
+  AddRandomPolygon(&target);
+
+  size_t full_size = EncodeIndex(target).size();
+  size_t delta_size = TestIndexDelta(base, target);
+  EXPECT_LT(delta_size, full_size / 50);
+
+  // The delta from an index to itself is tiny.
+  EXPECT_LT(TestIndexDelta(target, target), 20);
+}
+
+TEST(S2ShapeIndexDelta, CellIdDirectory) {
+  // The target's cell id directory is reproduced.
+  MutableS2ShapeIndex::Options options;
+  options.set_cell_id_directory_shift(3);
+  MutableS2ShapeIndex base, target(options);
+  S2Testing::rnd.Reset(1);
+  for (int i = 0; i < 20; ++i) AddRandomPolygon(&base);
+  S2Testing::rnd.Reset(1);
+  for (int i = 0; i < 20; ++i) AddRandomPolygon(&target);
+  AddRandomPolygon(&target);
+  TestIndexDelta(base, target);
+  TestIndexDelta(target, base);
+}
+
+}  // namespace
+}  // namespace s2coding
@@ -18,6 +18,9 @@
 #include "s2/encoded_s2shape_index.h"
 
 #include <map>
+#include <random>
+#include <set>
+#include <thread>
 #include <vector>
 #include <gtest/gtest.h>
 #include "s2/third_party/absl/memory/memory.h"
@@ -27,6 +30,7 @@
 #include "s2/s2builderutil_s2polyline_layer.h"
 #include "s2/s2builderutil_snap_functions.h"
 #include "s2/s2cap.h"
+#include "s2/s2cell_union.h"
 #include "s2/s2closest_edge_query.h"
 #include "s2/s2contains_point_query.h"
 #include "s2/s2edge_distances.h"
@@ -242,3 +246,243 @@ TEST(EncodedS2ShapeIndex, SnappedFractalPolylines) {
   TestEncodedS2ShapeIndex<S2LaxPolylineShape, EncodedS2LaxPolylineShape>(
       index, 8698);
 }
+
+TEST(EncodedS2ShapeIndex, CellIdDirectory) {
+  // Check that an index encoded with a sampled cell id directory decodes to
+  // the same index and that seeking works correctly.
+  MutableS2ShapeIndex::Options options;
+  options.set_max_edges_per_cell(1);
+  options.set_cell_id_directory_shift(3);
+  MutableS2ShapeIndex expected(options);
+  S2Testing::Fractal fractal;
+  fractal.SetLevelForApproxMaxEdges(3 * 256);
+  auto loop = fractal.MakeLoop(S2::GetFrame(S2Testing::RandomPoint()),
+                               S1Angle::Degrees(5));
+  vector<vector<S2Point>> loops(1);
+  S2Testing::AppendLoopVertices(*loop, &loops[0]);
+  expected.Add(make_unique<S2LaxPolygonShape>(loops));
+  Encoder encoder;
+  s2shapeutil::EncodeHomogeneousShapes<S2LaxPolygonShape>(expected, &encoder);
+  expected.Encode(&encoder);
+  Decoder decoder(encoder.base(), encoder.length());
+  EncodedS2ShapeIndex actual;
+  ASSERT_TRUE(DecodeHomegeneousShapeIndex<EncodedS2LaxPolygonShape>(
+      &actual, &decoder));
+  s2testing::ExpectEqual(expected, actual);
+
+  MutableS2ShapeIndex::Iterator expected_it(&expected);
+  EncodedS2ShapeIndex::Iterator actual_it(&actual);
+  for (int i = 0; i < 1000; ++i) {
+    S2CellId target = S2Testing::GetRandomCellId();
+    expected_it.Seek(target);
+    actual_it.Seek(target);
+    ASSERT_EQ(expected_it.done(), actual_it.done());
+    if (!expected_it.done()) EXPECT_EQ(expected_it.id(), actual_it.id());
+  }
+}
+
+// Builds a MutableS2ShapeIndex containing "num_shapes" random polylines and
+// encodes it (together with its shapes) into "encoder".
+static void EncodeRandomPolylines(int num_shapes, MutableS2ShapeIndex* index,
+                                  Encoder* encoder) {
+  for (int i = 0; i < num_shapes; ++i) {
+    vector<S2Point> vertices;
+    S2Point center = S2Testing::RandomPoint();
+    for (int j = 0; j < 20; ++j) {
+      vertices.push_back(S2Testing::SamplePoint(
+          S2Cap(center, S1Angle::Degrees(1))));
+    }
+    index->Add(make_unique<S2LaxPolylineShape>(vertices));
+  }
+  s2shapeutil::EncodeHomogeneousShapes<S2LaxPolylineShape>(*index, encoder);
+  index->Encode(encoder);
+}
+
+TEST(EncodedS2ShapeIndex, MemoryBudget) {
+  MutableS2ShapeIndex expected;
+  Encoder encoder;
+  EncodeRandomPolylines(100, &expected, &encoder);
+  Decoder decoder(encoder.base(), encoder.length());
+  EncodedS2ShapeIndex actual;
+  actual.set_memory_budget(4096);
+  ASSERT_TRUE(DecodeHomegeneousShapeIndex<EncodedS2LaxPolylineShape>(
+      &actual, &decoder));
+  {
+    EncodedS2ShapeIndex::ReadGuard guard(&actual);
+    s2testing::ExpectEqual(expected, actual);
+  }
+  auto stats = actual.cache_stats();
+  EXPECT_GT(stats.cell_evictions, 0);
+  EXPECT_GT(stats.shape_evictions, 0);
+  EXPECT_LE(stats.decoded_bytes, 4096);
+  EXPECT_GE(stats.cell_misses, stats.cell_evictions);
+
+  // Visiting all the cells again should decode them again.
+  {
+    EncodedS2ShapeIndex::ReadGuard guard(&actual);
+    s2testing::ExpectEqual(expected, actual);
+  }
+  auto stats2 = actual.cache_stats();
+  EXPECT_GT(stats2.cell_misses, stats.cell_misses);
+  EXPECT_LE(stats2.decoded_bytes, 4096);
+
+  // Without a budget, cells are never evicted.
+  actual.set_memory_budget(0);
+  s2testing::ExpectEqual(expected, actual);
+  EXPECT_EQ(stats2.cell_evictions, actual.cache_stats().cell_evictions);
+}
+
+TEST(EncodedS2ShapeIndex, MemoryBudgetHits) {
+  // With a generous budget, revisiting the same cells should be all hits.
+  MutableS2ShapeIndex expected;
+  Encoder encoder;
+  EncodeRandomPolylines(10, &expected, &encoder);
+  Decoder decoder(encoder.base(), encoder.length());
+  EncodedS2ShapeIndex actual;
+  ASSERT_TRUE(DecodeHomegeneousShapeIndex<EncodedS2LaxPolylineShape>(
+      &actual, &decoder));
+  actual.set_memory_budget(1 << 30);
+  EncodedS2ShapeIndex::ReadGuard guard(&actual);
+  int num_cells = 0;
+  for (int iter = 0; iter < 2; ++iter) {
+    for (EncodedS2ShapeIndex::Iterator it(&actual, S2ShapeIndex::BEGIN);
+         !it.done(); it.Next()) {
+      EXPECT_GT(it.cell().num_clipped(), 0);
+      if (iter == 0) ++num_cells;
+    }
+  }
+  auto stats = actual.cache_stats();
+  EXPECT_EQ(num_cells, stats.cell_misses);
+  EXPECT_EQ(num_cells, stats.cell_hits);
+  EXPECT_EQ(0, stats.cell_evictions);
+  EXPECT_GT(stats.decoded_bytes, 0);
+}
+
+TEST(EncodedS2ShapeIndex, MemoryBudgetConcurrentReaders) {
+  MutableS2ShapeIndex expected;
+  Encoder encoder;
+  EncodeRandomPolylines(100, &expected, &encoder);
+  Decoder decoder(encoder.base(), encoder.length());
+  EncodedS2ShapeIndex actual;
+  actual.set_memory_budget(8192);
+  ASSERT_TRUE(DecodeHomegeneousShapeIndex<EncodedS2LaxPolylineShape>(
+      &actual, &decoder));
+
+  // Each thread repeatedly seeks to random cells and checks their contents
+  // while other threads are decoding and evicting cells and shapes.
+  vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t) {
+    threads.push_back(std::thread([&expected, &actual, t]() {
+      std::mt19937 rnd(t);
+      for (int i = 0; i < 2000; ++i) {
+        EncodedS2ShapeIndex::ReadGuard guard(&actual);
+        S2CellId target(rnd() * uint64{rnd()} | 1);
+        MutableS2ShapeIndex::Iterator expected_it(&expected);
+        EncodedS2ShapeIndex::Iterator actual_it(&actual);
+        expected_it.Seek(target);
+        actual_it.Seek(target);
+        ASSERT_EQ(expected_it.done(), actual_it.done());
+        if (expected_it.done()) continue;
+        const S2ShapeIndexCell& a = expected_it.cell();
+        const S2ShapeIndexCell& b = actual_it.cell();
+        ASSERT_EQ(a.num_clipped(), b.num_clipped());
+        for (int j = 0; j < a.num_clipped(); ++j) {
+          ASSERT_EQ(a.clipped(j).shape_id(), b.clipped(j).shape_id());
+          ASSERT_EQ(a.clipped(j).num_edges(), b.clipped(j).num_edges());
+          int shape_id = a.clipped(j).shape_id();
+          ASSERT_EQ(expected.shape(shape_id)->num_edges(),
+                    actual.shape(shape_id)->num_edges());
+        }
+      }
+    }));
+  }
+  for (auto& thread : threads) thread.join();
+  EXPECT_GT(actual.cache_stats().cell_evictions, 0);
+}
+
+TEST(EncodedS2ShapeIndex, WarmUp) {
+  MutableS2ShapeIndex expected;
+  Encoder encoder;
+  EncodeRandomPolylines(100, &expected, &encoder);
+  Decoder decoder(encoder.base(), encoder.length());
+  EncodedS2ShapeIndex actual;
+  ASSERT_TRUE(DecodeHomegeneousShapeIndex<EncodedS2LaxPolylineShape>(
+      &actual, &decoder));
+  actual.Prefetch();
+  EncodedS2ShapeIndex::WarmUpOptions options;
+  options.set_num_threads(4);
+  options.set_decode_shapes(true);
+  actual.WarmUp(options);
+  int num_cells = 0;
+  for (MutableS2ShapeIndex::Iterator it(&expected, S2ShapeIndex::BEGIN);
+       !it.done(); it.Next()) {
+    ++num_cells;
+  }
+  auto stats = actual.cache_stats();
+  EXPECT_EQ(num_cells, stats.cell_misses);
+  EXPECT_EQ(100, stats.shape_misses);
+
+  // Nothing else needs to be decoded.
+  s2testing::ExpectEqual(expected, actual);
+  EXPECT_EQ(num_cells, actual.cache_stats().cell_misses);
+  EXPECT_EQ(100, actual.cache_stats().shape_misses);
+}
+
+TEST(EncodedS2ShapeIndex, WarmUpRegion) {
+  MutableS2ShapeIndex expected;
+  Encoder encoder;
+  EncodeRandomPolylines(100, &expected, &encoder);
+  Decoder decoder(encoder.base(), encoder.length());
+  EncodedS2ShapeIndex actual;
+  ASSERT_TRUE(DecodeHomegeneousShapeIndex<EncodedS2LaxPolylineShape>(
+      &actual, &decoder));
+  S2CellUnion region({S2CellId::FromFace(0).child(1),
+                      S2CellId(S2Testing::RandomPoint()).parent(3),
+                      S2CellId(S2Testing::RandomPoint()).parent(9)});
+  actual.Prefetch(region);
+  EncodedS2ShapeIndex::WarmUpOptions options;
+  options.set_num_threads(3);
+  options.set_decode_shapes(true);
+  actual.WarmUp(region, options);
+
+  // Count the index cells and shapes that intersect the region.
+  int num_cells = 0;
+  std::set<int> shape_ids;
+  for (MutableS2ShapeIndex::Iterator it(&expected, S2ShapeIndex::BEGIN);
+       !it.done(); it.Next()) {
+    if (!region.Intersects(it.id())) continue;
+    ++num_cells;
+    for (int j = 0; j < it.cell().num_clipped(); ++j) {
+      shape_ids.insert(it.cell().clipped(j).shape_id());
+    }
+  }
+  auto stats = actual.cache_stats();
+  EXPECT_GT(num_cells, 0);
+  EXPECT_EQ(num_cells, stats.cell_misses);
+  EXPECT_EQ(shape_ids.size(), stats.shape_misses);
+  s2testing::ExpectEqual(expected, actual);
+}
+
+TEST(EncodedS2ShapeIndex, WarmUpRegionInsideIndexCell) {
+  // The index consists of a single cell.  Check that WarmUp() decodes it
+  // when the region is a small cell in the lower half of that index cell,
+  // i.e. one that precedes the index cell in S2CellId order.
+  MutableS2ShapeIndex expected;
+  expected.Add(make_unique<S2LaxPolylineShape>(
+      s2textformat::ParsePoints("10:10, 10:11")));
+  Encoder encoder;
+  s2shapeutil::EncodeHomogeneousShapes<S2LaxPolylineShape>(expected, &encoder);
+  expected.Encode(&encoder);
+  Decoder decoder(encoder.base(), encoder.length());
+  EncodedS2ShapeIndex actual;
+  ASSERT_TRUE(DecodeHomegeneousShapeIndex<EncodedS2LaxPolylineShape>(
+      &actual, &decoder));
+  MutableS2ShapeIndex::Iterator it(&expected, S2ShapeIndex::BEGIN);
+  S2CellId index_cell = it.id();
+  it.Next();
+  ASSERT_TRUE(it.done());
+  ASSERT_LT(index_cell.level(), 20);
+  S2CellUnion region({index_cell.child_begin(20)});
+  actual.WarmUp(region, EncodedS2ShapeIndex::WarmUpOptions());
+  EXPECT_EQ(1, actual.cache_stats().cell_misses);
+}
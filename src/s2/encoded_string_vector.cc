@@ -17,9 +17,18 @@
 
 #include "s2/encoded_string_vector.h"
 
+#include <algorithm>
+#include <memory>
+#include <numeric>
+
+#include "s2/third_party/absl/memory/memory.h"
+#include "s2/util/thread/parallel_for.h"
+
 using absl::MakeSpan;
 using absl::Span;
+using absl::make_unique;
 using absl::string_view;
+using std::unique_ptr;
 using std::vector;
 
 namespace s2coding {
@@ -42,6 +51,108 @@ void StringVectorEncoder::Encode(Span<const string> v, Encoder* encoder) {
   string_vector.Encode(encoder);
 }
 
+void StringVectorEncoder::EncodeTwoPass(
+    int n, const std::function<void(int, Encoder*)>& encode_string,
+    Encoder* encoder) {
+  vector<uint64> offsets(n);
+  Encoder string_encoder;
+  uint64 offset = 0;
+  for (int i = 0; i < n; ++i) {
+    string_encoder.clear();
+    encode_string(i, &string_encoder);
+    offset += string_encoder.length();
+    offsets[i] = offset;
+  }
+  EncodeUintVector<uint64>(offsets, encoder);
+  for (int i = 0; i < n; ++i) {
+    size_t start = encoder->length();
+    encode_string(i, encoder);
+    S2_DCHECK_EQ(encoder->length() - start,
+                 offsets[i] - (i == 0 ? 0 : offsets[i - 1]));
+  }
+}
+
+// The number of consecutive strings encoded by each task in EncodeParallel.
+static const int kParallelBlockSize = 256;
+
+// When EncodeParallel writes to an EncoderSink, the number of blocks per
+// thread that may be buffered in memory at once.
+static const int kParallelBlocksPerThread = 4;
+
+void StringVectorEncoder::EncodeParallel(
+    int n, const std::function<void(int, Encoder*)>& encode_string,
+    int num_threads, Encoder* encoder) {
+  int num_blocks = (n + kParallelBlockSize - 1) / kParallelBlockSize;
+  if (num_threads <= 1 || num_blocks <= 1) {
+    if (encoder->has_sink()) {
+      EncodeTwoPass(n, encode_string, encoder);
+    } else {
+      StringVectorEncoder strings;
+      for (int i = 0; i < n; ++i) encode_string(i, strings.AddViaEncoder());
+      strings.Encode(encoder);
+    }
+    return;
+  }
+  // Encodes block "b" into blocks[b] and stores the string lengths.
+  vector<uint64> lengths(n);
+  vector<unique_ptr<Encoder>> blocks(num_blocks);
+  auto encode_block = [n, &encode_string, &lengths, &blocks](int b) {
+    auto block = make_unique<Encoder>();
+    int limit = std::min(n, (b + 1) * kParallelBlockSize);
+    for (int i = b * kParallelBlockSize; i < limit; ++i) {
+      size_t start = block->length();
+      encode_string(i, block.get());
+      lengths[i] = block->length() - start;
+    }
+    blocks[b] = std::move(block);
+  };
+  auto append_block = [&blocks, encoder](int b) {
+    encoder->Ensure(blocks[b]->length());
+    encoder->putn(blocks[b]->base(), blocks[b]->length());
+    blocks[b].reset();
+  };
+  vector<uint64> offsets(n);
+  if (!encoder->has_sink()) {
+    util_thread::ParallelFor(num_blocks, num_threads,
+                             [&encode_block](int thread, int b) {
+                               encode_block(b);
+                             });
+    std::partial_sum(lengths.begin(), lengths.end(), offsets.begin());
+    EncodeUintVector<uint64>(offsets, encoder);
+    for (int b = 0; b < num_blocks; ++b) append_block(b);
+    return;
+  }
+  // Determine the string lengths without keeping the encoded strings, then
+  // encode a few blocks at a time.
+  vector<Encoder> string_encoders(
+      util_thread::NumParallelForThreads(num_blocks, num_threads));
+  util_thread::ParallelFor(num_blocks, num_threads, [&](int thread, int b) {
+    Encoder* string_encoder = &string_encoders[thread];
+    int limit = std::min(n, (b + 1) * kParallelBlockSize);
+    for (int i = b * kParallelBlockSize; i < limit; ++i) {
+      string_encoder->clear();
+      encode_string(i, string_encoder);
+      lengths[i] = string_encoder->length();
+    }
+  });
+  std::partial_sum(lengths.begin(), lengths.end(), offsets.begin());
+  EncodeUintVector<uint64>(offsets, encoder);
+  size_t data_start = encoder->length();
+  int window = kParallelBlocksPerThread * num_threads;
+  for (int begin = 0; begin < num_blocks; begin += window) {
+    int end = std::min(num_blocks, begin + window);
+    util_thread::ParallelFor(end - begin, num_threads,
+                             [begin, &encode_block](int thread, int i) {
+                               encode_block(begin + i);
+                             });
+    for (int b = begin; b < end; ++b) {
+      S2_DCHECK_EQ(encoder->length() - data_start + blocks[b]->length(),
+                   offsets[std::min(n, (b + 1) * kParallelBlockSize) - 1]);
+      append_block(b);
+    }
+  }
+}
+
 bool EncodedStringVector::Init(Decoder* decoder) {
   if (!offsets_.Init(decoder)) return false;
   data_ = reinterpret_cast<const char*>(decoder->ptr());
@@ -54,10 +165,14 @@ bool EncodedStringVector::Init(Decoder* decoder) {
 }
 
 vector<string_view> EncodedStringVector::Decode() const {
-  size_t n = size();
-  vector<string_view> result(n);
-  for (int i = 0; i < n; ++i) {
-    result[i] = (*this)[i];
+  // Decoding all the offsets at once is much faster than decoding them
+  // individually.
+  vector<uint64> offsets = offsets_.Decode();
+  vector<string_view> result(offsets.size());
+  uint64 start = 0;
+  for (int i = 0; i < offsets.size(); ++i) {
+    result[i] = string_view(data_ + start, offsets[i] - start);
+    start = offsets[i];
   }
   return result;
 }
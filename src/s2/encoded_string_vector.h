@@ -18,6 +18,7 @@
 #ifndef S2_ENCODED_STRING_VECTOR_H_
 #define S2_ENCODED_STRING_VECTOR_H_
 
+#include <functional>
 #include <memory>
 #include <string>
 #include "s2/third_party/absl/strings/string_view.h"
@@ -63,6 +64,35 @@ class StringVectorEncoder {
   //           can be enlarged as necessary by calling Ensure(int).
   static void Encode(absl::Span<const string> v, Encoder* encoder);
 
+  // Encodes a vector of "n" strings, where string "i" consists of the output
+  // of encode_string(i, encoder), without buffering the strings in memory.
+  // Instead "encode_string" is called twice for each string: once to
+  // determine its length, and once to append it to "encoder".  It must
+  // produce the same output both times.  This is useful when "encoder"
+  // writes to an EncoderSink, since then the memory used does not depend on
+  // the total size of the strings.
+  //
+  // REQUIRES: "encoder" uses the default constructor, so that its buffer
+  //           can be enlarged as necessary by calling Ensure(int).
+  static void EncodeTwoPass(
+      int n, const std::function<void(int, Encoder*)>& encode_string,
+      Encoder* encoder);
+
+  // Like the above, but encodes the strings concurrently using up to
+  // "num_threads" threads.  Consecutive blocks of strings are encoded into
+  // separate buffers that are then concatenated, so the output is identical
+  // to encoding the strings sequentially.  "encode_string" must be safe to
+  // call from multiple threads.  Each string is encoded once, unless
+  // "encoder" writes to an EncoderSink, in which case each string is encoded
+  // twice (as with EncodeTwoPass) so that only a few blocks are buffered in
+  // memory at any time.  If "num_threads" is 1, no threads are created.
+  //
+  // REQUIRES: "encoder" uses the default constructor, so that its buffer
+  //           can be enlarged as necessary by calling Ensure(int).
+  static void EncodeParallel(
+      int n, const std::function<void(int, Encoder*)>& encode_string,
+      int num_threads, Encoder* encoder);
+
  private:
   // A vector consisting of the starting offset of each string in the
   // encoder's data buffer, plus a final entry pointing just past the end of
@@ -84,7 +114,7 @@ class StringVectorEncoder {
 class EncodedStringVector {
  public:
   // Constructs an uninitialized object; requires Init() to be called.
-  EncodedStringVector() {}
+  EncodedStringVector() = default;
 
   // Initializes the EncodedStringVector.  Returns false on errors, leaving
   // the vector in an unspecified state.
@@ -104,6 +134,10 @@ class EncodedStringVector {
   // Returns a Decoder initialized with the string at the given index.
   Decoder GetDecoder(int i) const;
 
+  // Returns the encoded bytes of the strings in the range [begin, end).
+  // The strings are stored contiguously, so this is useful for prefetching.
+  absl::string_view GetRange(int begin, int end) const;
+
   // Returns the entire vector of original strings.  Requires that the
   // data buffer passed to the constructor persists until the result vector is
   // no longer needed.
@@ -150,6 +184,15 @@ inline Decoder EncodedStringVector::GetDecoder(int i) const {
   return Decoder(data_ + start, limit - start);
 }
 
+inline absl::string_view EncodedStringVector::GetRange(int begin,
+                                                      int end) const {
+  S2_DCHECK_LE(begin, end);
+  if (begin == end) return absl::string_view();
+  uint64 start = (begin == 0) ? 0 : offsets_[begin - 1];
+  uint64 limit = offsets_[end - 1];
+  return absl::string_view(data_ + start, limit - start);
+}
+
 }  // namespace s2coding
 
 #endif  // S2_ENCODED_STRING_VECTOR_H_
@@ -17,6 +17,7 @@
 
 #include "s2/encoded_string_vector.h"
 
+#include <string>
 #include <vector>
 #include <gtest/gtest.h>
 #include "s2/third_party/absl/strings/string_view.h"
@@ -66,4 +67,74 @@ TEST(EncodedStringVectorTest, TwoBigStrings) {
                           110007);
 }
 
+TEST(EncodedStringVectorTest, EncodeTwoPass) {
+  vector<string> input = {"", "apples", string(1000, 'x'), "fuji", ""};
+  Encoder expected;
+  StringVectorEncoder::Encode(input, &expected);
+
+  // Use a chunk size smaller than some of the strings.
+  string output;
+  StringEncoderSink sink(&output);
+  Encoder actual(&sink, 16);
+  StringVectorEncoder::EncodeTwoPass(
+      input.size(),
+      [&input](int i, Encoder* encoder) {
+        encoder->Ensure(input[i].size());
+        encoder->putn(input[i].data(), input[i].size());
+      },
+      &actual);
+  EXPECT_EQ(expected.length(), actual.length());
+  ASSERT_TRUE(actual.Flush());
+  EXPECT_EQ(string(expected.base(), expected.length()), output);
+}
+
+TEST(EncodedStringVectorTest, EncodeParallel) {
+  vector<string> input;
+  for (int i = 0; i < 5000; ++i) input.push_back(string(i % 37, 'a' + i % 26));
+  Encoder expected;
+  StringVectorEncoder::Encode(input, &expected);
+  auto encode_string = [&input](int i, Encoder* encoder) {
+    encoder->Ensure(input[i].size());
+    encoder->putn(input[i].data(), input[i].size());
+  };
+  for (int num_threads : {1, 3, 8}) {
+    Encoder actual;
+    StringVectorEncoder::EncodeParallel(input.size(), encode_string,
+                                        num_threads, &actual);
+    EXPECT_EQ(string(expected.base(), expected.length()),
+              string(actual.base(), actual.length()));
+
+    string output;
+    StringEncoderSink sink(&output);
+    Encoder sink_encoder(&sink, 100);
+    StringVectorEncoder::EncodeParallel(input.size(), encode_string,
+                                        num_threads, &sink_encoder);
+    ASSERT_TRUE(sink_encoder.Flush());
+    EXPECT_EQ(string(expected.base(), expected.length()), output);
+  }
+}
+
+TEST(EncoderSinkTest, MatchesInMemoryEncoder) {
+  Encoder expected;
+  string output;
+  StringEncoderSink sink(&output);
+  Encoder actual(&sink, 8);
+  EXPECT_TRUE(actual.has_sink());
+  EXPECT_FALSE(expected.has_sink());
+  for (Encoder* encoder : {&expected, &actual}) {
+    for (int i = 0; i < 100; ++i) {
+      encoder->Ensure(Varint::kMax64 + 2 * sizeof(uint32));
+      encoder->put_varint64(uint64{1} << (i % 64));
+      encoder->put32(i);
+      encoder->put8(i);
+    }
+    string big(100, 'z');
+    encoder->Ensure(big.size());
+    encoder->putn(big.data(), big.size());
+  }
+  EXPECT_EQ(expected.length(), actual.length());
+  ASSERT_TRUE(actual.Flush());
+  EXPECT_EQ(string(expected.base(), expected.length()), output);
+}
+
 }  // namespace s2coding
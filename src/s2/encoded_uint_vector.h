@@ -18,6 +18,7 @@
 #ifndef S2_ENCODED_UINT_VECTOR_H_
 #define S2_ENCODED_UINT_VECTOR_H_
 
+#include <cstring>
 #include <type_traits>
 #include <vector>
 #include "s2/third_party/absl/base/internal/unaligned_access.h"
@@ -59,7 +60,7 @@ class EncodedUintVector {
   static_assert(sizeof(T) & 0xe, "Unsupported integer length");
 
   // Constructs an uninitialized object; requires Init() to be called.
-  EncodedUintVector() {}
+  EncodedUintVector() = default;
 
   // Initializes the EncodedUintVector.  Returns false on errors, leaving the
   // vector in an unspecified state.
@@ -82,6 +83,14 @@ class EncodedUintVector {
   // REQUIRES: The vector elements are sorted in non-decreasing order.
   size_t lower_bound(T target) const;
 
+  // As above, but only considers elements in the range [begin, end).  Returns
+  // "end" if no such element exists.  This is useful when the position of
+  // "target" is already known to be within a small range, since only the
+  // corresponding part of the encoded data is accessed.
+  //
+  // REQUIRES: begin <= end <= size()
+  size_t lower_bound(T target, size_t begin, size_t end) const;
+
   // Decodes and returns the entire original vector.
   std::vector<T> Decode() const;
 
@@ -120,6 +129,16 @@ T GetUintWithLength(const void* ptr, int length);
 template <class T>
 bool DecodeUintWithLength(int length, Decoder* decoder, T* result);
 
+// Decodes "n" consecutive integers of "length" bytes each starting at "ptr"
+// (in the format used by EncodeUintWithLength) and stores them in "out".
+// This is substantially faster than calling GetUintWithLength() in a loop.
+//
+// REQUIRES: T is an unsigned integer type.
+// REQUIRES: 2 <= sizeof(T) <= 8
+// REQUIRES: 0 <= length <= sizeof(T)
+template <class T>
+void GetUintsWithLength(const char* ptr, int length, size_t n, T* out);
+
 
 //////////////////   Implementation details follow   ////////////////////
 
@@ -190,6 +209,66 @@ bool DecodeUintWithLength(int length, Decoder* decoder, T* result) {
   return true;
 }
 
+namespace internal {
+
+// Like GetUintsWithLength, but with the length as a template argument.
+// Since the extent of the encoded data is known, all values except the last
+// few can be decoded with a single full-width (unaligned) load followed by a
+// mask, without any risk of accessing memory beyond the end of the data
+// (see GetUintWithLength).
+template <class T, int kLength>
+inline void GetUintsWithFixedLength(const char* ptr, size_t n, T* out) {
+  static_assert(kLength >= 0 && kLength <= sizeof(T), "Invalid length");
+  size_t i = 0;
+  if (kLength == sizeof(T)) {
+    std::memcpy(out, ptr, n * sizeof(T));
+    return;
+  }
+  if (kLength > 0 && n * kLength >= sizeof(T)) {
+    const T mask = static_cast<T>(~T{0}) >> 8 * (sizeof(T) - kLength);
+    // The number of values that can be loaded using a full-width load.
+    size_t n_fast = (n * kLength - sizeof(T)) / kLength + 1;
+    for (; i < n_fast; ++i, ptr += kLength) {
+      T x;
+      std::memcpy(&x, ptr, sizeof(T));
+      out[i] = x & mask;
+    }
+  }
+  for (; i < n; ++i, ptr += kLength) {
+    out[i] = GetUintWithLength<T>(ptr, kLength);
+  }
+}
+
+}  // namespace internal
+
+template <class T>
+void GetUintsWithLength(const char* ptr, int length, size_t n, T* out) {
+  static_assert(std::is_unsigned<T>::value, "Unsupported signed integer");
+  static_assert(sizeof(T) & 0xe, "Unsupported integer length");
+  S2_DCHECK(length >= 0 && length <= sizeof(T));
+
+  // Dispatch to a loop specialized for each length.  (Note that the compiler
+  // discards the cases where length > sizeof(T) since they are unreachable.)
+  switch (length) {
+#define S2_GET_UINTS_CASE(kLength)                                      \
+    case kLength:                                                       \
+      return internal::GetUintsWithFixedLength<                         \
+          T, (kLength <= sizeof(T) ? kLength : 0)>(ptr, n, out);
+    S2_GET_UINTS_CASE(0)
+    S2_GET_UINTS_CASE(1)
+    S2_GET_UINTS_CASE(2)
+    S2_GET_UINTS_CASE(3)
+    S2_GET_UINTS_CASE(4)
+    S2_GET_UINTS_CASE(5)
+    S2_GET_UINTS_CASE(6)
+    S2_GET_UINTS_CASE(7)
+    S2_GET_UINTS_CASE(8)
+#undef S2_GET_UINTS_CASE
+    default:
+      S2_LOG(DFATAL) << "Invalid length: " << length;
+  }
+}
+
 template <class T>
 void EncodeUintVector(absl::Span<const T> v, Encoder* encoder) {
   // The encoding is as follows:
@@ -253,7 +332,14 @@ inline size_t EncodedUintVector<T>::lower_bound(T target) const {
   // would require declaring the new field (length_lower_bound_hint_) as
   // mutable std::atomic<uint32> (accessed using std::memory_order_relaxed)
   // with a custom copy constructor that resets the hint component to zero.
-  size_t lo = 0, hi = size_;
+  return lower_bound(target, 0, size_);
+}
+
+template <class T>
+inline size_t EncodedUintVector<T>::lower_bound(T target, size_t begin,
+                                                size_t end) const {
+  S2_DCHECK(begin <= end && end <= size_);
+  size_t lo = begin, hi = end;
   while (lo < hi) {
     size_t mid = (lo + hi) >> 1;
     if ((*this)[mid] < target) {
@@ -268,9 +354,7 @@ inline size_t EncodedUintVector<T>::lower_bound(T target) const {
 template <class T>
 std::vector<T> EncodedUintVector<T>::Decode() const {
   std::vector<T> result(size_);
-  for (int i = 0; i < size_; ++i) {
-    result[i] = (*this)[i];
-  }
+  if (size_ > 0) GetUintsWithLength<T>(data_, len_, size_, result.data());
   return result;
 }
 
@@ -35,6 +35,44 @@ void TestEncodedUintVector(const vector<T>& expected, size_t expected_bytes) {
   EncodedUintVector<T> actual;
   ASSERT_TRUE(actual.Init(&decoder));
   EXPECT_EQ(actual.Decode(), expected);
+  for (int i = 0; i < expected.size(); ++i) {
+    EXPECT_EQ(expected[i], actual[i]);
+  }
+}
+
+// Checks that GetUintsWithLength() agrees with GetUintWithLength() for all
+// lengths and vector sizes up to "max_size".
+template <class T>
+void TestGetUintsWithLength(int max_size) {
+  for (int length = 0; length <= sizeof(T); ++length) {
+    for (int n = 0; n <= max_size; ++n) {
+      Encoder encoder;
+      encoder.Ensure(n * length);
+      vector<T> expected;
+      for (int i = 0; i < n; ++i) {
+        // Vary the bytes so that every byte position is exercised.
+        T value = 0;
+        for (int j = 0; j < length; ++j) {
+          value |= static_cast<T>(static_cast<uint8>(37 * i + 11 * j + 1))
+                   << (8 * j);
+        }
+        EncodeUintWithLength(value, length, &encoder);
+        expected.push_back(value);
+      }
+      // Copy the data into a buffer of exactly the right size so that any
+      // out-of-bounds reads are detected by memory checkers.
+      vector<char> data(encoder.base(), encoder.base() + encoder.length());
+      vector<T> actual(n);
+      GetUintsWithLength<T>(data.data(), length, n, actual.data());
+      EXPECT_EQ(expected, actual) << "length " << length << ", n " << n;
+    }
+  }
+}
+
+TEST(EncodedUintVectorTest, GetUintsWithLength) {
+  TestGetUintsWithLength<uint16>(20);
+  TestGetUintsWithLength<uint32>(20);
+  TestGetUintsWithLength<uint64>(20);
 }
 
 TEST(EncodedUintVectorTest, Empty) {
@@ -117,6 +117,12 @@ void MutableS2ShapeIndex::Options::set_max_edges_per_cell(
   max_edges_per_cell_ = max_edges_per_cell;
 }
 
+void MutableS2ShapeIndex::Options::set_cell_id_directory_shift(
+    int cell_id_directory_shift) {
+  S2_DCHECK(cell_id_directory_shift >= 0 && cell_id_directory_shift <= 31);
+  cell_id_directory_shift_ = cell_id_directory_shift;
+}
+
 bool MutableS2ShapeIndex::Iterator::Locate(const S2Point& target) {
   return LocateImpl(target, this);
 }
@@ -203,11 +209,8 @@ unique_ptr<S2Shape> MutableS2ShapeIndex::Release(int shape_id) {
     removed->has_interior = (shape->dimension() == 2);
     removed->contains_tracker_origin =
         s2shapeutil::ContainsBruteForce(*shape, kInteriorTrackerOrigin());
-    int num_edges = shape->num_edges();
-    removed->edges.reserve(num_edges);
-    for (int e = 0; e < num_edges; ++e) {
-      removed->edges.push_back(shape->edge(e));
-    }
+    removed->edges.resize(shape->num_edges());
+    shape->GetEdges(0, removed->edges.size(), removed->edges.data());
   }
   index_status_.store(STALE, std::memory_order_relaxed);
   return shape;
@@ -812,12 +815,19 @@ void MutableS2ShapeIndex::AddShape(int id, vector<FaceEdge> all_edges[6],
     tracker->AddShape(id, s2shapeutil::ContainsBruteForce(*shape,
                                                           tracker->focus()));
   }
+  // Edges are retrieved in small batches to avoid a virtual call per edge.
+  static const int kEdgeBatchSize = 64;
+  S2Shape::Edge edges[kEdgeBatchSize];
   int num_edges = shape->num_edges();
-  for (int e = 0; e < num_edges; ++e) {
-    edge.edge_id = e;
-    edge.edge = shape->edge(e);
-    edge.max_level = GetEdgeMaxLevel(edge.edge);
-    AddFaceEdge(&edge, all_edges);
+  for (int start = 0; start < num_edges; start += kEdgeBatchSize) {
+    int n = std::min(kEdgeBatchSize, num_edges - start);
+    shape->GetEdges(start, n, edges);
+    for (int i = 0; i < n; ++i) {
+      edge.edge_id = start + i;
+      edge.edge = edges[i];
+      edge.max_level = GetEdgeMaxLevel(edge.edge);
+      AddFaceEdge(&edge, all_edges);
+    }
   }
 }
 
@@ -1516,17 +1526,9 @@ size_t MutableS2ShapeIndex::SpaceUsed() const {
   size += shapes_.capacity() * sizeof(std::unique_ptr<S2Shape>);
   // cell_map_ itself is already included in sizeof(*this).
   size += cell_map_.bytes_used() - sizeof(cell_map_);
-  size += cell_map_.size() * sizeof(S2ShapeIndexCell);
   Iterator it;
   for (it.InitStale(this, S2ShapeIndex::BEGIN); !it.done(); it.Next()) {
-    const S2ShapeIndexCell& cell = it.cell();
-    size += cell.shapes_.capacity() * sizeof(S2ClippedShape);
-    for (int s = 0; s < cell.num_clipped(); ++s) {
-      const S2ClippedShape& clipped = cell.clipped(s);
-      if (!clipped.is_inline()) {
-        size += clipped.num_edges() * sizeof(int32);
-      }
-    }
+    size += it.cell().SpaceUsed();
   }
   if (pending_removals_ != nullptr) {
     size += pending_removals_->capacity() * sizeof(RemovedShape);
@@ -1535,7 +1537,7 @@ size_t MutableS2ShapeIndex::SpaceUsed() const {
   return size;
 }
 
-void MutableS2ShapeIndex::Encode(Encoder* encoder) const {
+void MutableS2ShapeIndex::Encode(Encoder* encoder, int num_threads) const {
   // The version number is encoded in 2 bits, under the assumption that by the
   // time we need 5 versions the first version can be permanently retired.
   // This only saves 1 byte, but that's significant for very small indexes.
@@ -1544,14 +1546,19 @@ void MutableS2ShapeIndex::Encode(Encoder* encoder) const {
   encoder->put_varint64(max_edges << 2 | kCurrentEncodingVersionNumber);
 
   vector<S2CellId> cell_ids;
+  vector<const S2ShapeIndexCell*> cells;
   cell_ids.reserve(cell_map_.size());
-  s2coding::StringVectorEncoder encoded_cells;
+  cells.reserve(cell_map_.size());
   for (Iterator it(this, S2ShapeIndex::BEGIN); !it.done(); it.Next()) {
     cell_ids.push_back(it.id());
-    it.cell().Encode(num_shape_ids(), encoded_cells.AddViaEncoder());
+    cells.push_back(&it.cell());
   }
-  s2coding::EncodeS2CellIdVector(cell_ids, encoder);
-  encoded_cells.Encode(encoder);
+  s2coding::EncodeS2CellIdVector(cell_ids, options_.cell_id_directory_shift(),
+                                 encoder);
+  s2coding::StringVectorEncoder::EncodeParallel(
+      cells.size(), [this, &cells](int i, Encoder* cell_encoder) {
+        cells[i]->Encode(num_shape_ids(), cell_encoder);
+      }, num_threads, encoder);
 }
 
 bool MutableS2ShapeIndex::Init(Decoder* decoder,
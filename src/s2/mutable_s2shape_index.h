@@ -144,8 +144,24 @@ class MutableS2ShapeIndex final : public S2ShapeIndex {
     int max_edges_per_cell() const { return max_edges_per_cell_; }
     void set_max_edges_per_cell(int max_edges_per_cell);
 
+    // If non-zero, Encode() also writes a sampled directory containing every
+    // (1 << cell_id_directory_shift)-th S2CellId of the index.  This makes
+    // seeking in the resulting EncodedS2ShapeIndex faster for large indexes
+    // (especially when the encoded data is memory-mapped), at the cost of
+    // about 1 / (1 << cell_id_directory_shift) of the space used by the
+    // encoded cell ids.  Values of 6 to 8 are reasonable.  Note that indexes
+    // encoded with a directory cannot be decoded by older versions of this
+    // library.  (See EncodeS2CellIdVector for details.)
+    //
+    // REQUIRES: 0 <= cell_id_directory_shift <= 31
+    //
+    // DEFAULT: 0 (no directory)
+    int cell_id_directory_shift() const { return cell_id_directory_shift_; }
+    void set_cell_id_directory_shift(int cell_id_directory_shift);
+
    private:
     int max_edges_per_cell_;
+    int cell_id_directory_shift_ = 0;
   };
 
   // Creates a MutableS2ShapeIndex that uses the default option settings.
@@ -189,9 +205,12 @@ class MutableS2ShapeIndex final : public S2ShapeIndex {
   //   s2shapeutil::CompactEncodeTaggedShapes(index, encoder);
   //   index.Encode(encoder);
   //
+  // If "num_threads" is greater than one, the cells are encoded concurrently
+  // using that many threads.  The output does not depend on "num_threads".
+  //
   // REQUIRES: "encoder" uses the default constructor, so that its buffer
   //           can be enlarged as necessary by calling Ensure(int).
-  void Encode(Encoder* encoder) const;
+  void Encode(Encoder* encoder, int num_threads = 1) const;
 
   // Decodes an S2ShapeIndex, returning true on success.
   //
@@ -312,6 +331,7 @@ class MutableS2ShapeIndex final : public S2ShapeIndex {
 
  private:
   friend class EncodedS2ShapeIndex;
+  friend class EncodedS2ShapeIndexBuilder;
   friend class Iterator;
   friend class MutableS2ShapeIndexTest;
   friend class S2Stats;
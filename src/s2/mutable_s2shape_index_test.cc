@@ -178,6 +178,17 @@ void MutableS2ShapeIndexTest::TestEncodeDecode() {
   MutableS2ShapeIndex index2;
   ASSERT_TRUE(index2.Init(&decoder, s2shapeutil::WrappedShapeFactory(&index_)));
   s2testing::ExpectEqual(index_, index2);
+
+  // Encoding through an EncoderSink must produce the same bytes.
+  string sink_output;
+  {
+    StringEncoderSink sink(&sink_output);
+    Encoder sink_encoder(&sink, 64);
+    index_.Encode(&sink_encoder);
+    EXPECT_EQ(encoder.length(), sink_encoder.length());
+    ASSERT_TRUE(sink_encoder.Flush());
+  }
+  EXPECT_EQ(string(encoder.base(), encoder.length()), sink_output);
 }
 
 namespace {
@@ -354,6 +365,35 @@ TEST_F(MutableS2ShapeIndexTest, ManyTinyEdges) {
   EXPECT_TRUE(it.done());
 }
 
+TEST_F(MutableS2ShapeIndexTest, ParallelEncode) {
+  // Encoding with multiple threads must produce the same bytes as encoding
+  // with a single thread, with and without an EncoderSink.
+  unique_ptr<S2Loop> loop(S2Loop::MakeRegularLoop(
+      S2Point(1, 0.5, 0.5).Normalize(), S1Angle::Degrees(10), 20000));
+  index_.Add(make_unique<S2Loop::Shape>(loop.get()));
+  int num_cells = 0;
+  for (MutableS2ShapeIndex::Iterator it(&index_, S2ShapeIndex::BEGIN);
+       !it.done(); it.Next()) {
+    ++num_cells;
+  }
+  ASSERT_GT(num_cells, 2000);  // Enough to be split among threads.
+  Encoder expected;
+  index_.Encode(&expected);
+  for (int num_threads : {2, 4}) {
+    Encoder actual;
+    index_.Encode(&actual, num_threads);
+    EXPECT_EQ(string(expected.base(), expected.length()),
+              string(actual.base(), actual.length()));
+
+    string sink_output;
+    StringEncoderSink sink(&sink_output);
+    Encoder sink_encoder(&sink, 4096);
+    index_.Encode(&sink_encoder, num_threads);
+    ASSERT_TRUE(sink_encoder.Flush());
+    EXPECT_EQ(string(expected.base(), expected.length()), sink_output);
+  }
+}
+
 TEST_F(MutableS2ShapeIndexTest, SimpleUpdates) {
   // Add 5 loops one at a time, then release them one at a time,
   // validating the index at each step.
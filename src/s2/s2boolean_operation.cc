@@ -782,10 +782,20 @@ void EdgeClippingLayer::Build(const Graph& g, S2Error* error) {
 class S2BooleanOperation::Impl {
  public:
   explicit Impl(S2BooleanOperation* op)
-      : op_(op), index_crossings_first_region_id_(-1) {
+      : op_(op), index_crossings_first_region_id_(-1),
+        has_interior_crossing_(false) {
   }
   bool Build(S2Error* error);
 
+  // Returns true if the given entry of the intersection matrix is empty.
+  // Requires boolean output.  The edge crossings between the two regions
+  // are computed only once, no matter how many entries are requested.
+  bool IsRelationEntryEmpty(Relation::Entry entry);
+
+  // Returns true if an edge of one region was found to cross an edge of the
+  // other region at a point interior to both edges.
+  bool has_interior_crossing() const { return has_interior_crossing_; }
+
  private:
   class CrossingIterator;
   class CrossingProcessor;
@@ -852,10 +862,10 @@ class S2BooleanOperation::Impl {
   static bool AddIndexCrossing(const ShapeEdge& a, const ShapeEdge& b,
                                bool is_interior, IndexCrossings* crossings);
   bool GetIndexCrossings(int region_id);
-  bool AddBoundaryPair(bool invert_a, bool invert_b, bool invert_result,
-                       CrossingProcessor* cp);
+  bool AddBoundaryPair(OpType op_type, bool invert_a, bool invert_b,
+                       bool invert_result, CrossingProcessor* cp);
   bool AreRegionsIdentical() const;
-  bool BuildOpType(OpType op_type);
+  bool BuildOpType(OpType op_type, InputEdgeCrossings* input_crossings);
 
   S2BooleanOperation* op_;
 
@@ -865,9 +875,11 @@ class S2BooleanOperation::Impl {
   // A vector specifying the dimension of each edge added to S2Builder.
   vector<int8> input_dimensions_;
 
-  // The set of all input edge crossings, which is used by EdgeClippingLayer
-  // to construct the clipped output polygon.
-  InputEdgeCrossings input_crossings_;
+  // For each operation, the set of all input edge crossings, which is used
+  // by EdgeClippingLayer to construct the clipped output polygon.  (Each
+  // operation is built as a separate S2Builder layer, and GraphEdgeClipper
+  // expects only the crossings between edges of its own layer.)
+  vector<InputEdgeCrossings> input_crossings_;
 
   // kSentinel is a sentinel value used to mark the end of vectors.
   static const ShapeEdgeId kSentinel;
@@ -883,6 +895,11 @@ class S2BooleanOperation::Impl {
   // This field is negative if index_crossings_ has not been computed yet.
   int index_crossings_first_region_id_;
 
+  // True if an interior crossing was found by GetIndexCrossings().  (This
+  // causes the computation of "index_crossings_" to stop early when boolean
+  // output is requested, since the result is then known to be non-empty.)
+  bool has_interior_crossing_;
+
   // Temporary storage used in GetChainStarts(), declared here to avoid
   // repeatedly allocating memory.
   IndexCrossings tmp_crossings_;
@@ -1871,6 +1888,7 @@ inline bool S2BooleanOperation::Impl::AddIndexCrossing(
 // as soon as the result is known to be non-empty.
 bool S2BooleanOperation::Impl::GetIndexCrossings(int region_id) {
   if (region_id == index_crossings_first_region_id_) return true;
+  if (has_interior_crossing_) return false;
   if (index_crossings_first_region_id_ < 0) {
     S2_DCHECK_EQ(region_id, 0);  // For efficiency, not correctness.
     if (!s2shapeutil::VisitCrossingEdgePairs(
@@ -1880,7 +1898,10 @@ bool S2BooleanOperation::Impl::GetIndexCrossings(int region_id) {
               // For all supported operations (union, intersection, and
               // difference), if the input edges have an interior crossing
               // then the output is guaranteed to have at least one edge.
-              if (is_interior && is_boolean_output()) return false;
+              if (is_interior && is_boolean_output()) {
+                has_interior_crossing_ = true;
+                return false;
+              }
               return AddIndexCrossing(a, b, is_interior, &index_crossings_);
             })) {
       return false;
@@ -1911,7 +1932,8 @@ bool S2BooleanOperation::Impl::GetIndexCrossings(int region_id) {
 // Supports "early exit" in the case of boolean results by returning false
 // as soon as the result is known to be non-empty.
 bool S2BooleanOperation::Impl::AddBoundaryPair(
-    bool invert_a, bool invert_b, bool invert_result, CrossingProcessor* cp) {
+    OpType op_type, bool invert_a, bool invert_b, bool invert_result,
+    CrossingProcessor* cp) {
   // Optimization: if the operation is DIFFERENCE or SYMMETRIC_DIFFERENCE,
   // it is worthwhile checking whether the two regions are identical (in which
   // case the output is empty).
@@ -1919,8 +1941,8 @@ bool S2BooleanOperation::Impl::AddBoundaryPair(
   // TODO(ericv): When boolean output is requested there are other quick
   // checks that could be done here, such as checking whether a full cell from
   // one S2ShapeIndex intersects a non-empty cell of the other S2ShapeIndex.
-  auto type = op_->op_type();
-  if (type == OpType::DIFFERENCE || type == OpType::SYMMETRIC_DIFFERENCE) {
+  if (op_type == OpType::DIFFERENCE ||
+      op_type == OpType::SYMMETRIC_DIFFERENCE) {
     if (AreRegionsIdentical()) return true;
   } else if (!is_boolean_output()) {
   }
@@ -1937,34 +1959,70 @@ bool S2BooleanOperation::Impl::AddBoundaryPair(
 
 // Supports "early exit" in the case of boolean results by returning false
 // as soon as the result is known to be non-empty.
-bool S2BooleanOperation::Impl::BuildOpType(OpType op_type) {
+bool S2BooleanOperation::Impl::BuildOpType(
+    OpType op_type, InputEdgeCrossings* input_crossings) {
   // CrossingProcessor does the real work of emitting the output edges.
   CrossingProcessor cp(op_->options_.polygon_model(),
                        op_->options_.polyline_model(),
                        op_->options_.polyline_loops_have_boundaries(),
-                       builder_.get(), &input_dimensions_, &input_crossings_);
+                       builder_.get(), &input_dimensions_, input_crossings);
   switch (op_type) {
     case OpType::UNION:
       // A | B == ~(~A & ~B)
-      return AddBoundaryPair(true, true, true, &cp);
+      return AddBoundaryPair(op_type, true, true, true, &cp);
 
     case OpType::INTERSECTION:
       // A & B
-      return AddBoundaryPair(false, false, false, &cp);
+      return AddBoundaryPair(op_type, false, false, false, &cp);
 
     case OpType::DIFFERENCE:
       // A - B = A & ~B
-      return AddBoundaryPair(false, true, false, &cp);
+      return AddBoundaryPair(op_type, false, true, false, &cp);
 
     case OpType::SYMMETRIC_DIFFERENCE:
       // Compute the union of (A - B) and (B - A).
-      return (AddBoundaryPair(false, true, false, &cp) &&
-              AddBoundaryPair(true, false, false, &cp));
+      return (AddBoundaryPair(op_type, false, true, false, &cp) &&
+              AddBoundaryPair(op_type, true, false, false, &cp));
   }
   S2_LOG(FATAL) << "Invalid S2BooleanOperation::OpType";
   return false;
 }
 
+bool S2BooleanOperation::Impl::IsRelationEntryEmpty(Relation::Entry entry) {
+  S2_DCHECK(is_boolean_output());
+  input_crossings_.resize(1);  // Not used, since there is no output.
+
+  // The interior of each region is given by the OPEN models, and its closure
+  // by the CLOSED models.  The intersection of Interior(A) with Exterior(B)
+  // is non-empty if and only if Closure(A) - Closure(B) is non-empty, since
+  // every point of Closure(A) is a limit of points in Interior(A) and
+  // Exterior(B) is open.
+  bool open = (entry == Relation::INTERIOR_INTERIOR);
+  CrossingProcessor cp(open ? PolygonModel::OPEN : PolygonModel::CLOSED,
+                       open ? PolylineModel::OPEN : PolylineModel::CLOSED,
+                       op_->options_.polyline_loops_have_boundaries(),
+                       nullptr, &input_dimensions_, &input_crossings_[0]);
+  switch (entry) {
+    case Relation::INTERIOR_INTERIOR:
+    case Relation::CLOSURE_CLOSURE:
+      // A & B
+      return AddBoundaryPair(OpType::INTERSECTION, false, false, false, &cp);
+
+    case Relation::INTERIOR_EXTERIOR:
+      // A - B = A & ~B
+      return AddBoundaryPair(OpType::DIFFERENCE, false, true, false, &cp);
+
+    case Relation::EXTERIOR_INTERIOR:
+      // B - A = ~A & B
+      return AddBoundaryPair(OpType::DIFFERENCE, true, false, false, &cp);
+
+    default:
+      break;
+  }
+  S2_LOG(DFATAL) << "Invalid S2BooleanOperation::Relation::Entry";
+  return true;
+}
+
 // Given a polygon edge graph containing only degenerate edges and sibling
 // edge pairs, the purpose of this function is to decide whether the polygon
 // is empty or full except for the degeneracies, i.e. whether the degeneracies
@@ -2018,7 +2076,8 @@ bool S2BooleanOperation::Impl::Build(S2Error* error) {
   error->Clear();
   if (is_boolean_output()) {
     // BuildOpType() returns true if and only if the result is empty.
-    *op_->result_empty_ = BuildOpType(op_->op_type());
+    input_crossings_.resize(1);
+    *op_->result_empty_ = BuildOpType(op_->op_type(), &input_crossings_[0]);
     return true;
   }
   // TODO(ericv): Rather than having S2Builder split the edges, it would be
@@ -2031,18 +2090,31 @@ bool S2BooleanOperation::Impl::Build(S2Error* error) {
   // TODO(ericv): Ideally idempotent() should be true, but existing clients
   // expect vertices closer than the full "snap_radius" to be snapped.
   options.set_idempotent(false);
+
+  // When several operations are computed, each one emits mostly the same
+  // input edges, so S2Builder should process each distinct edge only once.
+  options.set_merge_duplicate_edge_work(op_->op_types_.size() > 1);
   builder_ = make_unique<S2Builder>(options);
-  builder_->StartLayer(make_unique<EdgeClippingLayer>(
-      &op_->layers_, &input_dimensions_, &input_crossings_));
 
-  // Polygons with no edges are assumed to be empty.  It is the responsibility
-  // of clients to fix this if desired (e.g. S2Polygon has code for this).
-  //
-  // TODO(ericv): Implement a predicate that can determine whether a
-  // degenerate polygon is empty or full based on the input S2ShapeIndexes.
-  // (It is possible to do this 100% robustly, but tricky.)
-  builder_->AddIsFullPolygonPredicate(IsFullPolygonNever);
-  (void) BuildOpType(op_->op_type());
+  // Each operation is emitted into its own S2Builder layer.  The crossings
+  // between the two regions are computed only once (see GetIndexCrossings),
+  // and S2Builder snaps the edges of all the layers together.
+  const vector<OpType>& op_types = op_->op_types_;
+  input_crossings_.resize(op_types.size());
+  for (int i = 0; i < op_types.size(); ++i) {
+    builder_->StartLayer(make_unique<EdgeClippingLayer>(
+        &op_->layers_[i], &input_dimensions_, &input_crossings_[i]));
+
+    // Polygons with no edges are assumed to be empty.  It is the
+    // responsibility of clients to fix this if desired (e.g. S2Polygon has
+    // code for this).
+    //
+    // TODO(ericv): Implement a predicate that can determine whether a
+    // degenerate polygon is empty or full based on the input S2ShapeIndexes.
+    // (It is possible to do this 100% robustly, but tricky.)
+    builder_->AddIsFullPolygonPredicate(IsFullPolygonNever);
+    (void) BuildOpType(op_types[i], &input_crossings_[i]);
+  }
   return builder_->Build(error);
 }
 
@@ -2136,26 +2208,41 @@ const char* S2BooleanOperation::OpTypeToString(OpType op_type) {
 
 S2BooleanOperation::S2BooleanOperation(OpType op_type,
                                        const Options& options)
-    : op_type_(op_type), options_(options), result_empty_(nullptr) {
+    : op_types_(1, op_type), options_(options), result_empty_(nullptr) {
 }
 
 S2BooleanOperation::S2BooleanOperation(OpType op_type, bool* result_empty,
                                        const Options& options)
-    : op_type_(op_type), options_(options),
+    : op_types_(1, op_type), options_(options),
       result_empty_(result_empty) {
 }
 
 S2BooleanOperation::S2BooleanOperation(
     OpType op_type, unique_ptr<S2Builder::Layer> layer, const Options& options)
-    : op_type_(op_type), options_(options), result_empty_(nullptr) {
-  layers_.push_back(std::move(layer));
+    : op_types_(1, op_type), options_(options), layers_(1),
+      result_empty_(nullptr) {
+  layers_[0].push_back(std::move(layer));
 }
 
 S2BooleanOperation::S2BooleanOperation(
     OpType op_type, vector<unique_ptr<S2Builder::Layer>> layers,
     const Options& options)
-    : op_type_(op_type), options_(options), layers_(std::move(layers)),
+    : op_types_(1, op_type), options_(options), layers_(1),
+      result_empty_(nullptr) {
+  layers_[0] = std::move(layers);
+}
+
+S2BooleanOperation::S2BooleanOperation(
+    const vector<OpType>& op_types,
+    vector<vector<unique_ptr<S2Builder::Layer>>> layers,
+    const Options& options)
+    : op_types_(op_types), options_(options), layers_(std::move(layers)),
       result_empty_(nullptr) {
+  S2_DCHECK(!op_types_.empty());
+  S2_DCHECK_EQ(op_types_.size(), layers_.size());
+  for (const auto& op_layers : layers_) {
+    S2_DCHECK(op_layers.size() == 1 || op_layers.size() == 3);
+  }
 }
 
 bool S2BooleanOperation::Build(const S2ShapeIndex& a,
@@ -2176,3 +2263,96 @@ bool S2BooleanOperation::IsEmpty(
   S2_DCHECK(error.ok());
   return result_empty;
 }
+
+namespace {
+// The entries that must be empty and the entries that must be non-empty in
+// order for a given Relation::Predicate to be satisfied.
+struct PredicateEntries {
+  uint8 empty, nonempty;
+};
+}  // namespace
+
+// Every predicate is a conjunction of conditions on individual entries, so
+// evaluation can stop as soon as one condition fails.
+static PredicateEntries GetPredicateEntries(
+    S2BooleanOperation::Relation::Predicate predicate) {
+  using Relation = S2BooleanOperation::Relation;
+  using Predicate = Relation::Predicate;
+  switch (predicate) {
+    case Predicate::DISJOINT:
+      return {Relation::CLOSURE_CLOSURE, 0};
+    case Predicate::INTERSECTS:
+      return {0, Relation::CLOSURE_CLOSURE};
+    case Predicate::TOUCHES:
+      return {Relation::INTERIOR_INTERIOR, Relation::CLOSURE_CLOSURE};
+    case Predicate::CONTAINS:
+      return {Relation::EXTERIOR_INTERIOR, Relation::INTERIOR_INTERIOR};
+    case Predicate::WITHIN:
+      return {Relation::INTERIOR_EXTERIOR, Relation::INTERIOR_INTERIOR};
+    case Predicate::COVERS:
+      return {Relation::EXTERIOR_INTERIOR, Relation::CLOSURE_CLOSURE};
+    case Predicate::COVERED_BY:
+      return {Relation::INTERIOR_EXTERIOR, Relation::CLOSURE_CLOSURE};
+    case Predicate::EQUALS:
+      return {Relation::INTERIOR_EXTERIOR | Relation::EXTERIOR_INTERIOR, 0};
+  }
+  S2_LOG(DFATAL) << "Invalid S2BooleanOperation::Relation::Predicate";
+  return {0, 0};
+}
+
+uint8 S2BooleanOperation::Relation::GetEntries(Predicate predicate) {
+  PredicateEntries entries = GetPredicateEntries(predicate);
+  return entries.empty | entries.nonempty;
+}
+
+bool S2BooleanOperation::Relation::Matches(Predicate predicate) const {
+  PredicateEntries entries = GetPredicateEntries(predicate);
+  S2_DCHECK_EQ(entries.empty | entries.nonempty,
+               (entries.empty | entries.nonempty) & known_);
+  return (nonempty_ & entries.empty) == 0 &&
+         (nonempty_ & entries.nonempty) == entries.nonempty;
+}
+
+S2BooleanOperation::Relation S2BooleanOperation::ComputeRelation(
+    const S2ShapeIndex& a, const S2ShapeIndex& b, uint8 entries,
+    uint8 stop_if_empty, uint8 stop_if_nonempty, const Options& options) {
+  bool result_empty;  // Selects boolean output; not otherwise used.
+  S2BooleanOperation op(OpType::INTERSECTION, &result_empty, options);
+  op.regions_[0] = &a;
+  op.regions_[1] = &b;
+  Impl impl(&op);
+  Relation relation;
+  for (uint8 bit = 1; bit & Relation::ALL_ENTRIES; bit <<= 1) {
+    if ((entries & bit) == 0) continue;
+    auto entry = static_cast<Relation::Entry>(bit);
+    // If an interior crossing has been found, every entry is non-empty.
+    bool nonempty = (impl.has_interior_crossing() ||
+                     !impl.IsRelationEntryEmpty(entry));
+    relation.Set(entry, nonempty);
+    if ((nonempty ? stop_if_nonempty : stop_if_empty) & bit) break;
+  }
+  return relation;
+}
+
+S2BooleanOperation::Relation S2BooleanOperation::Relate(
+    const S2ShapeIndex& a, const S2ShapeIndex& b, uint8 entries,
+    const Options& options) {
+  return ComputeRelation(a, b, entries, 0, 0, options);
+}
+
+bool S2BooleanOperation::Relates(
+    Relation::Predicate predicate, const S2ShapeIndex& a,
+    const S2ShapeIndex& b, const Options& options) {
+  PredicateEntries entries = GetPredicateEntries(predicate);
+  Relation relation = ComputeRelation(
+      a, b, entries.empty | entries.nonempty,
+      entries.nonempty, entries.empty, options);
+  // ComputeRelation() only stops early if the predicate is not satisfied.
+  for (uint8 bit = 1; bit & Relation::ALL_ENTRIES; bit <<= 1) {
+    auto entry = static_cast<Relation::Entry>(bit);
+    if ((Relation::GetEntries(predicate) & bit) && !relation.is_known(entry)) {
+      return false;
+    }
+  }
+  return relation.Matches(predicate);
+}
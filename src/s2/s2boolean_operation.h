@@ -21,6 +21,8 @@
 #include <memory>
 #include <utility>
 #include <vector>
+#include "s2/base/logging.h"
+#include "s2/third_party/absl/base/integral_types.h"
 #include "s2/s2builder.h"
 #include "s2/s2builder_graph.h"
 #include "s2/s2builder_layer.h"
@@ -407,7 +409,43 @@ class S2BooleanOperation {
                      std::vector<std::unique_ptr<S2Builder::Layer>> layers,
                      const Options& options = Options());
 
-  OpType op_type() const { return op_type_; }
+  // Specifies that several operations on the same pair of regions should be
+  // computed together, sending the output of "op_types[i]" to "layers[i]".
+  // Each element of "layers" consists of either one layer or three layers
+  // (one per dimension, as described above).  For example:
+  //
+  //   vector<vector<unique_ptr<S2Builder::Layer>>> layers(4);
+  //   layers[0].push_back(make_unique<S2PolygonLayer>(&union_polygon));
+  //   ...
+  //   S2BooleanOperation op({OpType::UNION, OpType::INTERSECTION,
+  //                          OpType::DIFFERENCE, OpType::SYMMETRIC_DIFFERENCE},
+  //                         std::move(layers), options);
+  //
+  // This is faster than executing each operation separately, because the
+  // edge crossings between the two regions are computed only once and all
+  // the results are snapped together by a single S2Builder (which processes
+  // edges that belong to several results only once).
+  //
+  // Because the results are snapped together, they share a single set of
+  // output vertices.  This means that a result may differ slightly from
+  // that of the corresponding separate operation.  For example, an output
+  // edge may contain an extra vertex where it crosses an edge that only
+  // belongs to some other result, or (with a non-zero snap radius) it may be
+  // snapped to a vertex that only occurs in some other result.
+  //
+  // The output layers are built in the order given, i.e. all the layers of
+  // op_types[0] are built before any layers of op_types[1].
+  S2BooleanOperation(
+      const std::vector<OpType>& op_types,
+      std::vector<std::vector<std::unique_ptr<S2Builder::Layer>>> layers,
+      const Options& options = Options());
+
+  // Returns the operation type (or the first operation type, if several
+  // operations were specified).
+  OpType op_type() const { return op_types_[0]; }
+
+  // Returns the types of all the operations to be computed.
+  const std::vector<OpType>& op_types() const { return op_types_; }
 
   // Executes the given operation.  Returns true on success, and otherwise
   // sets "error" appropriately.  (This class does not generate any errors
@@ -442,26 +480,119 @@ class S2BooleanOperation {
     return IsEmpty(OpType::SYMMETRIC_DIFFERENCE, b, a, options);
   }
 
+  // Relation is a reduced form of the DE-9IM intersection matrix that
+  // describes how two regions A and B are related.  Each entry records
+  // whether a certain intersection of (parts of) A and B is non-empty, where
+  // the interior of each region is defined by the OPEN polygon and polyline
+  // models, and its closure by the CLOSED models.  (Points are always
+  // closed.  A polyline loop has a boundary unless
+  // Options::polyline_loops_have_boundaries() is false; the latter matches
+  // the OGC definition.)
+  //
+  // The entries that involve the boundaries of A and B individually are not
+  // computed, but the most commonly used predicates (see Predicate below)
+  // can be determined from the entries that are.
+  class Relation {
+   public:
+    // The entries of the matrix.  These are bit values so that callers can
+    // specify a set of entries to be computed.
+    enum Entry : uint8 {
+      INTERIOR_INTERIOR = 1 << 0,  // Interior(A) intersects Interior(B).
+      INTERIOR_EXTERIOR = 1 << 1,  // Interior(A) intersects Exterior(B).
+      EXTERIOR_INTERIOR = 1 << 2,  // Exterior(A) intersects Interior(B).
+      CLOSURE_CLOSURE = 1 << 3,    // Closure(A) intersects Closure(B).
+      ALL_ENTRIES = (1 << 4) - 1,
+    };
+
+    // Predicates that can be evaluated using the entries above.  These
+    // follow the OGC definitions (e.g. "A contains B" requires that the
+    // interiors of A and B intersect, and "A covers B" does not).
+    enum class Predicate {
+      DISJOINT,    // Closure(A) and Closure(B) do not intersect.
+      INTERSECTS,  // Closure(A) and Closure(B) intersect.
+      TOUCHES,     // A and B intersect, but their interiors do not.
+      CONTAINS,    // No point of B is exterior to A, and the interiors
+                   // intersect.
+      WITHIN,      // B contains A.
+      COVERS,      // No point of B is exterior to A, and A and B intersect.
+      COVERED_BY,  // B covers A.
+      EQUALS,      // Closure(A) and Closure(B) are the same point set.
+    };
+
+    // Returns the entries that are needed to evaluate the given predicate.
+    static uint8 GetEntries(Predicate predicate);
+
+    // Returns true if the given entry has been computed.
+    bool is_known(Entry entry) const { return (known_ & entry) != 0; }
+
+    // Returns true if the given entry is non-empty.  REQUIRES: is_known(entry)
+    bool is_nonempty(Entry entry) const;
+
+    // Returns true if the given predicate is satisfied.
+    // REQUIRES: All the entries in GetEntries(predicate) are known.
+    bool Matches(Predicate predicate) const;
+
+    // Records the value of the given entry.
+    void Set(Entry entry, bool nonempty);
+
+   private:
+    uint8 known_ = 0;
+    uint8 nonempty_ = 0;
+  };
+
+  // Computes the given set of entries (a combination of Relation::Entry
+  // values) of the intersection matrix for the regions A and B.  The edge
+  // crossings between A and B are found only once, but each entry is then
+  // computed by a separate pass over the boundaries of A and B, so asking
+  // for all four entries costs about as much as four IsEmpty() calls.
+  // Request only the entries you need (or use Relates() below).  If any
+  // edges of A and B cross at a point interior to both edges, then all the
+  // entries are known to be non-empty and the computation stops immediately.
+  //
+  // Only polyline_loops_have_boundaries() is used from "options"; the
+  // polygon and polyline models are determined by the entry being computed.
+  static Relation Relate(const S2ShapeIndex& a, const S2ShapeIndex& b,
+                         uint8 entries = Relation::ALL_ENTRIES,
+                         const Options& options = Options());
+
+  // Returns true if A and B satisfy the given predicate.  This computes only
+  // the entries required by the predicate and stops as soon as the result
+  // is known, e.g. TOUCHES returns false without computing
+  // CLOSURE_CLOSURE if the interiors of A and B intersect.
+  static bool Relates(Relation::Predicate predicate,
+                      const S2ShapeIndex& a, const S2ShapeIndex& b,
+                      const Options& options = Options());
+
  private:
   class Impl;  // The actual implementation.
 
   // Internal constructor to reduce code duplication.
   S2BooleanOperation(OpType op_type, const Options& options);
 
+  // Computes the given entries of the intersection matrix in increasing bit
+  // order, stopping early if an entry in "stop_if_empty" is empty or an
+  // entry in "stop_if_nonempty" is non-empty.
+  static Relation ComputeRelation(const S2ShapeIndex& a,
+                                  const S2ShapeIndex& b, uint8 entries,
+                                  uint8 stop_if_empty, uint8 stop_if_nonempty,
+                                  const Options& options);
+
   // Specifies that "result_empty" should be set to indicate whether the exact
   // result of the operation is empty (contains no edges).  This constructor
   // is used to efficiently test boolean relationships (see IsEmpty above).
   S2BooleanOperation(OpType op_type, bool* result_empty,
                      const Options& options = Options());
 
-  OpType op_type_;
+  std::vector<OpType> op_types_;
   Options options_;
 
   // The input regions.
   const S2ShapeIndex* regions_[2];
 
-  // The output consists either of zero layers, one layer, or three layers.
-  std::vector<std::unique_ptr<S2Builder::Layer>> layers_;
+  // The output layers for each operation in "op_types_".  The output of each
+  // operation consists either of one layer or three layers.  (If the
+  // operation has boolean output then this vector is empty.)
+  std::vector<std::vector<std::unique_ptr<S2Builder::Layer>>> layers_;
 
   // The following field is set if and only if there are no output layers.
   bool* result_empty_;
@@ -471,6 +602,20 @@ class S2BooleanOperation {
 //////////////////   Implementation details follow   ////////////////////
 
 
+inline bool S2BooleanOperation::Relation::is_nonempty(Entry entry) const {
+  S2_DCHECK(is_known(entry));
+  return (nonempty_ & entry) != 0;
+}
+
+inline void S2BooleanOperation::Relation::Set(Entry entry, bool nonempty) {
+  known_ |= entry;
+  if (nonempty) {
+    nonempty_ |= entry;
+  } else {
+    nonempty_ &= ~entry;
+  }
+}
+
 inline S2BooleanOperation::SourceId::SourceId()
     : region_id_(0), shape_id_(0), edge_id_(-1) {
 }
@@ -18,10 +18,12 @@
 #include "s2/s2boolean_operation.h"
 
 #include <memory>
+#include <vector>
 #include <gtest/gtest.h>
 #include "s2/third_party/absl/memory/memory.h"
 #include "s2/third_party/absl/strings/str_split.h"
 #include "s2/third_party/absl/strings/strip.h"
+#include "s2/mutable_s2shape_index.h"
 #include "s2/s2builder.h"
 #include "s2/s2builder_graph.h"
 #include "s2/s2builder_layer.h"
@@ -142,6 +144,30 @@ void ExpectResult(S2BooleanOperation::OpType op_type,
             S2BooleanOperation::IsEmpty(op_type, *a, *b, options));
 }
 
+// Like ExpectResult, but computes all the given operations at once.
+void ExpectResults(const S2BooleanOperation::Options& options,
+                   const string& a_str, const string& b_str,
+                   const vector<pair<OpType, string>>& expected_strs) {
+  auto a = s2textformat::MakeIndex(a_str);
+  auto b = s2textformat::MakeIndex(b_str);
+  vector<OpType> op_types;
+  vector<unique_ptr<MutableS2ShapeIndex>> expected;
+  vector<vector<unique_ptr<S2Builder::Layer>>> layers;
+  for (const auto& expected_str : expected_strs) {
+    op_types.push_back(expected_str.first);
+    expected.push_back(s2textformat::MakeIndex(expected_str.second));
+    layers.emplace_back();
+    for (int dim = 0; dim < 3; ++dim) {
+      layers.back().push_back(
+          make_unique<IndexMatchingLayer>(expected.back().get(), dim));
+    }
+  }
+  S2BooleanOperation op(op_types, std::move(layers), options);
+  EXPECT_EQ(op_types, op.op_types());
+  S2Error error;
+  EXPECT_TRUE(op.Build(*a, *b, &error)) << error;
+}
+
 }  // namespace
 
 // The intersections in the "expected" data below were computed in lat-lng
@@ -1011,6 +1037,34 @@ TEST(S2BooleanOperation, OverlappingDoughnuts) {
       "1:-91, 0:-91, 0:-90, 1:-90");
 }
 
+TEST(S2BooleanOperation, MultipleOperations) {
+  // Computes the overlay of the bars in ThreeOverlappingBars in one pass.
+  S2BooleanOperation::Options options = RoundToE(2);
+  auto a = "# # 0:0, 0:2, 3:2, 3:0; 0:3, 0:5, 3:5, 3:3";
+  auto b = "# # 1:1, 1:4, 2:4, 2:1";
+  ExpectResults(options, a, b, {
+      {OpType::UNION,
+       "# # 0:0, 0:2, 1:2, 1:3, 0:3, 0:5, 3:5, 3:3, 2:3, 2:2, 3:2, 3:0"},
+      {OpType::INTERSECTION,
+       "# # 1:1, 1:2, 2:2, 2:1; 1:3, 1:4, 2:4, 2:3"},
+      {OpType::DIFFERENCE,
+       "# # 0:0, 0:2, 1:2, 1:1, 2:1, 2:2, 3:2, 3:0; "
+       "0:3, 0:5, 3:5, 3:3, 2:3, 2:4, 1:4, 1:3"},
+      {OpType::SYMMETRIC_DIFFERENCE,
+       "# # 0:0, 0:2, 1:2, 1:1, 2:1, 2:2, 3:2, 3:0; "
+       "0:3, 0:5, 3:5, 3:3, 2:3, 2:4, 1:4, 1:3; "
+       "1:2, 1:3, 2:3, 2:2"}});
+
+  // The same operation may be requested more than once, and polylines are
+  // supported.
+  ExpectResults(options, "# 0:-5, 0:5, 5:0, -5:0 #",
+                "# # 1:1, 1:-1, -1:-1, -1:1", {
+      {OpType::INTERSECTION, "# 0:-1, 0:0, 0:1 | 1:0, 0:0, -1:0 #"},
+      {OpType::DIFFERENCE,
+       "# 0:-5, 0:-1 | 0:1, 0:5, 5:0, 1:0 | -1:0, -5:0 #"},
+      {OpType::INTERSECTION, "# 0:-1, 0:0, 0:1 | 1:0, 0:0, -1:0 #"}});
+}
+
 TEST(S2BooleanOperation, PolylineEnteringRectangle) {
   // A polyline that enters a rectangle very close to one of its vertices.
   S2BooleanOperation::Options options = RoundToE(1);
@@ -1044,3 +1098,89 @@ TEST(S2BooleanOperation, PolylineCrossingRectangleTwice) {
       "# 0:-5, 0:-1 | 0:1, 0:5, 5:0, 1:0 | -1:0, -5:0 "
       "# 1:1, 1:0, 1:-1, 0:-1, -1:-1, -1:0, -1:1, 0:1");
 }
+
+using Relation = S2BooleanOperation::Relation;
+using Predicate = Relation::Predicate;
+
+// Checks that Relate() computes the given entries for A and B, and that
+// Relates() agrees with Relation::Matches() for every predicate.
+static void ExpectRelation(const string& a_str, const string& b_str,
+                           bool interior_interior, bool interior_exterior,
+                           bool exterior_interior, bool closure_closure) {
+  auto a = s2textformat::MakeIndex(a_str);
+  auto b = s2textformat::MakeIndex(b_str);
+  SCOPED_TRACE("A = " + a_str + ", B = " + b_str);
+  Relation relation = S2BooleanOperation::Relate(*a, *b);
+  EXPECT_EQ(interior_interior,
+            relation.is_nonempty(Relation::INTERIOR_INTERIOR));
+  EXPECT_EQ(interior_exterior,
+            relation.is_nonempty(Relation::INTERIOR_EXTERIOR));
+  EXPECT_EQ(exterior_interior,
+            relation.is_nonempty(Relation::EXTERIOR_INTERIOR));
+  EXPECT_EQ(closure_closure, relation.is_nonempty(Relation::CLOSURE_CLOSURE));
+  for (Predicate predicate :
+           {Predicate::DISJOINT, Predicate::INTERSECTS, Predicate::TOUCHES,
+            Predicate::CONTAINS, Predicate::WITHIN, Predicate::COVERS,
+            Predicate::COVERED_BY, Predicate::EQUALS}) {
+    EXPECT_EQ(relation.Matches(predicate),
+              S2BooleanOperation::Relates(predicate, *a, *b))
+        << static_cast<int>(predicate);
+  }
+}
+
+TEST(S2BooleanOperation, RelateCrossingPolygons) {
+  // The boundaries cross, so every entry is non-empty.
+  ExpectRelation("# # 0:0, 0:2, 2:2, 2:0", "# # 1:1, 1:3, 3:3, 3:1",
+                 true, true, true, true);
+}
+
+TEST(S2BooleanOperation, RelateDisjointPolygons) {
+  ExpectRelation("# # 0:0, 0:1, 1:1, 1:0", "# # 5:5, 5:6, 6:6, 6:5",
+                 false, true, true, false);
+  auto a = s2textformat::MakeIndex("# # 0:0, 0:1, 1:1, 1:0");
+  auto b = s2textformat::MakeIndex("# # 5:5, 5:6, 6:6, 6:5");
+  EXPECT_TRUE(S2BooleanOperation::Relates(Predicate::DISJOINT, *a, *b));
+  EXPECT_FALSE(S2BooleanOperation::Relates(Predicate::INTERSECTS, *a, *b));
+}
+
+TEST(S2BooleanOperation, RelateNestedPolygons) {
+  auto outer = "# # 0:0, 0:10, 10:10, 10:0";
+  auto inner = "# # 2:2, 2:4, 4:4, 4:2";
+  ExpectRelation(outer, inner, true, true, false, true);
+  ExpectRelation(inner, outer, true, false, true, true);
+  auto a = s2textformat::MakeIndex(outer);
+  auto b = s2textformat::MakeIndex(inner);
+  EXPECT_TRUE(S2BooleanOperation::Relates(Predicate::CONTAINS, *a, *b));
+  EXPECT_TRUE(S2BooleanOperation::Relates(Predicate::COVERS, *a, *b));
+  EXPECT_FALSE(S2BooleanOperation::Relates(Predicate::WITHIN, *a, *b));
+  EXPECT_TRUE(S2BooleanOperation::Relates(Predicate::WITHIN, *b, *a));
+}
+
+TEST(S2BooleanOperation, RelateTouchingPolygons) {
+  // The closed polygons share a vertex, but their interiors are disjoint.
+  ExpectRelation("# # 0:0, 0:1, 1:1, 1:0", "# # 1:1, 1:2, 2:2, 2:1",
+                 false, true, true, true);
+}
+
+TEST(S2BooleanOperation, RelateEqualPolygons) {
+  auto a = "# # 0:0, 0:1, 1:1, 1:0";
+  ExpectRelation(a, a, true, false, false, true);
+}
+
+TEST(S2BooleanOperation, RelatePolylineInsidePolygon) {
+  ExpectRelation("# 1:1, 2:2 #", "# # 0:0, 0:3, 3:3, 3:0",
+                 true, false, true, true);
+}
+
+TEST(S2BooleanOperation, RelateSelectedEntries) {
+  // Only the requested entries are computed.
+  auto a = s2textformat::MakeIndex("# # 0:0, 0:10, 10:10, 10:0");
+  auto b = s2textformat::MakeIndex("# # 2:2, 2:4, 4:4, 4:2");
+  Relation relation = S2BooleanOperation::Relate(
+      *a, *b, Relation::GetEntries(Predicate::CONTAINS));
+  EXPECT_TRUE(relation.is_known(Relation::INTERIOR_INTERIOR));
+  EXPECT_TRUE(relation.is_known(Relation::EXTERIOR_INTERIOR));
+  EXPECT_FALSE(relation.is_known(Relation::INTERIOR_EXTERIOR));
+  EXPECT_FALSE(relation.is_known(Relation::CLOSURE_CLOSURE));
+  EXPECT_TRUE(relation.Matches(Predicate::CONTAINS));
+}
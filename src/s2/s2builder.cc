@@ -75,12 +75,15 @@
 #include <memory>
 #include <numeric>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include "s2/base/casts.h"
 #include "s2/base/logging.h"
 #include "s2/third_party/absl/memory/memory.h"
 #include "s2/util/bits/bits.h"
+#include "s2/util/hash/mix.h"
+#include "s2/util/thread/parallel_for.h"
 #include "s2/id_set_lexicon.h"
 #include "s2/mutable_s2shape_index.h"
 #include "s2/s1angle.h"
@@ -148,7 +151,9 @@ S2Builder::Options::Options(const Options& options)
     :  snap_function_(options.snap_function_->Clone()),
        split_crossing_edges_(options.split_crossing_edges_),
        simplify_edge_chains_(options.simplify_edge_chains_),
-       idempotent_(options.idempotent_) {
+       idempotent_(options.idempotent_),
+       merge_duplicate_edge_work_(options.merge_duplicate_edge_work_),
+       num_threads_(options.num_threads_) {
 }
 
 S2Builder::Options& S2Builder::Options::operator=(const Options& options) {
@@ -156,9 +161,16 @@ S2Builder::Options& S2Builder::Options::operator=(const Options& options) {
   split_crossing_edges_ = options.split_crossing_edges_;
   simplify_edge_chains_ = options.simplify_edge_chains_;
   idempotent_ = options.idempotent_;
+  merge_duplicate_edge_work_ = options.merge_duplicate_edge_work_;
+  num_threads_ = options.num_threads_;
   return *this;
 }
 
+void S2Builder::Options::set_num_threads(int num_threads) {
+  S2_DCHECK_GE(num_threads, 1);
+  num_threads_ = num_threads;
+}
+
 bool operator==(const S2Builder::GraphOptions& x,
                 const S2Builder::GraphOptions& y) {
   return (x.edge_type() == y.edge_type() &&
@@ -416,9 +428,18 @@ void S2Builder::ForceVertex(const S2Point& vertex) {
   sites_.push_back(vertex);
 }
 
+namespace {
+// Hash function for edges represented as a pair of vertices.
+struct S2PointPairHash {
+  size_t operator()(const pair<S2Point, S2Point>& edge) const {
+    HashMix mix(S2PointHash()(edge.first));
+    mix.Mix(S2PointHash()(edge.second));
+    return mix.get();
+  }
+};
+
 // An S2Shape used to represent the entire collection of S2Builder input edges.
 // Vertices are specified as indices into a vertex vector to save space.
-namespace {
 class VertexIdEdgeVectorShape final : public S2Shape {
  public:
   // Requires that "edges" is constant for the lifetime of this object.
@@ -495,17 +516,33 @@ void S2Builder::Reset() {
 void S2Builder::ChooseSites() {
   if (input_vertices_.empty()) return;
 
+  // When several layers contain the same geometry (e.g. S2BooleanOperation
+  // with multiple output operations), most input edges occur once per layer.
+  // If requested, such duplicate edges are only checked for crossings and
+  // nearby sites once.
+  vector<InputEdgeId> first_edge_ids = GetFirstEdgeIds();
   MutableS2ShapeIndex input_edge_index;
   input_edge_index.Add(make_unique<VertexIdEdgeVectorShape>(
       input_edges_, input_vertices_));
   if (options_.split_crossing_edges()) {
-    AddEdgeCrossings(input_edge_index);
+    if (first_edge_ids.empty()) {
+      AddEdgeCrossings(input_edge_index);
+    } else {
+      vector<InputEdge> distinct_edges;
+      for (InputEdgeId e = 0; e < input_edges_.size(); ++e) {
+        if (first_edge_ids[e] == e) distinct_edges.push_back(input_edges_[e]);
+      }
+      MutableS2ShapeIndex distinct_edge_index;
+      distinct_edge_index.Add(make_unique<VertexIdEdgeVectorShape>(
+          distinct_edges, input_vertices_));
+      AddEdgeCrossings(distinct_edge_index);
+    }
   }
   if (snapping_requested_) {
     S2PointIndex<SiteId> site_index;
     AddForcedSites(&site_index);
     ChooseInitialSites(&site_index);
-    CollectSiteEdges(site_index);
+    CollectSiteEdges(site_index, first_edge_ids);
   }
   if (snapping_needed_) {
     AddExtraSites(input_edge_index);
@@ -604,6 +641,26 @@ vector<S2Builder::InputVertexKey> S2Builder::SortInputVertices() {
   return keys;
 }
 
+// Returns a vector that maps each input edge to the first input edge with the
+// same endpoints.  Returns an empty vector unless merge_duplicate_edge_work()
+// is true, since otherwise duplicate edges are too rare to be worth looking
+// for.
+vector<S2Builder::InputEdgeId> S2Builder::GetFirstEdgeIds() const {
+  vector<InputEdgeId> first_edge_ids;
+  if (!options_.merge_duplicate_edge_work()) return first_edge_ids;
+  std::unordered_map<pair<S2Point, S2Point>, InputEdgeId, S2PointPairHash>
+      edge_map;
+  edge_map.reserve(input_edges_.size());
+  first_edge_ids.reserve(input_edges_.size());
+  for (InputEdgeId e = 0; e < input_edges_.size(); ++e) {
+    const InputEdge& edge = input_edges_[e];
+    auto key = std::make_pair(input_vertices_[edge.first],
+                              input_vertices_[edge.second]);
+    first_edge_ids.push_back(edge_map.emplace(key, e).first->second);
+  }
+  return first_edge_ids;
+}
+
 // Check all edge pairs for crossings, and add the corresponding intersection
 // points to input_vertices_.  (The intersection points will be snapped and
 // merged with the other vertices during site selection.)
@@ -657,11 +714,22 @@ void S2Builder::ChooseInitialSites(S2PointIndex<SiteId>* site_index) {
   // "0:0, 0:0" rather than the expected "0:0, 0:1", because the snap radius
   // is approximately sqrt(2) degrees and therefore it is legal to snap both
   // input points to "0:0".  "Snap first" produces "0:0, 0:1" as expected.
+  //
+  // Duplicate input vertices are adjacent in the sorted order (they are
+  // common when several layers share geometry, e.g. S2BooleanOperation with
+  // multiple output operations).  A vertex that snaps to the same site as
+  // the previous vertex would yield exactly the same outcome, so we skip it.
+  // This avoids a query whose distance test is an exact tie.
+  S2Point last_site;
+  bool have_last_site = false;
   for (const InputVertexKey& key : SortInputVertices()) {
     const S2Point& vertex = input_vertices_[key.second];
     S2Point site = SnapSite(vertex);
     // If any vertex moves when snapped, the output cannot be idempotent.
     snapping_needed_ = snapping_needed_ || site != vertex;
+    if (have_last_site && site == last_site) continue;
+    last_site = site;
+    have_last_site = true;
 
     // FindClosestPoints() measures distances conservatively, so we need to
     // recheck the distances using exact predicates.
@@ -708,7 +776,8 @@ S1ChordAngle dist_moved(site, point);
 // store them in edge_sites_.  Also, to implement idempotency this method also
 // checks whether the input vertices and edges may already satisfy the output
 // criteria.  If any problems are found then snapping_needed_ is set to true.
-void S2Builder::CollectSiteEdges(const S2PointIndex<SiteId>& site_index) {
+void S2Builder::CollectSiteEdges(const S2PointIndex<SiteId>& site_index,
+                                 const vector<InputEdgeId>& first_edge_ids) {
   // Find all points whose distance is <= edge_site_query_radius_ca_.
   S2ClosestPointQueryOptions options;
   options.set_conservative_max_distance(edge_site_query_radius_ca_);
@@ -719,6 +788,11 @@ void S2Builder::CollectSiteEdges(const S2PointIndex<SiteId>& site_index) {
     const InputEdge& edge = input_edges_[e];
     const S2Point& v0 = input_vertices_[edge.first];
     const S2Point& v1 = input_vertices_[edge.second];
+    if (!first_edge_ids.empty() && first_edge_ids[e] != e) {
+      // The nearby sites depend only on the edge endpoints.
+      edge_sites_[e] = edge_sites_[first_edge_ids[e]];
+      continue;
+    }
     if (s2builder_verbose) {
       std::cout << "S2Polyline: " << s2textformat::ToString(v0)
                 << ", " << s2textformat::ToString(v1) << "\n";
@@ -1086,16 +1160,39 @@ void S2Builder::BuildLayers() {
       vector<S2Point>().swap(sites_);  // Release memory
     }
   }
-  for (int i = 0; i < layers_.size(); ++i) {
+  int num_threads = std::min<size_t>(options_.num_threads(), layers_.size());
+  if (num_threads <= 1) {
+    for (int i = 0; i < layers_.size(); ++i) {
+      const vector<S2Point>& vertices = (layer_vertices.empty() ?
+                                         sites_ : layer_vertices[i]);
+      Graph graph(layer_options_[i], &vertices, &layer_edges[i],
+                  &layer_input_edge_ids[i], &input_edge_id_set_lexicon,
+                  &label_set_ids_, &label_set_lexicon_,
+                  layer_is_full_polygon_predicates_[i]);
+      layers_[i]->Build(graph, error_);
+      // Don't free the layer data until all layers have been built, in order
+      // to support building multiple layers at once (e.g. ClosedSetNormalizer).
+    }
+    return;
+  }
+  // Otherwise the layers are claimed one at a time by a set of worker
+  // threads.  Each layer reports errors into its own S2Error, and these are
+  // then merged in layer order so that the result does not depend on the
+  // order in which the layers were built.  The layer data is kept until all
+  // threads have finished (see above).
+  vector<S2Error> layer_errors(layers_.size());
+  util_thread::ParallelFor(layers_.size(), num_threads, [&](int thread,
+                                                            int i) {
     const vector<S2Point>& vertices = (layer_vertices.empty() ?
                                        sites_ : layer_vertices[i]);
     Graph graph(layer_options_[i], &vertices, &layer_edges[i],
                 &layer_input_edge_ids[i], &input_edge_id_set_lexicon,
                 &label_set_ids_, &label_set_lexicon_,
                 layer_is_full_polygon_predicates_[i]);
-    layers_[i]->Build(graph, error_);
-    // Don't free the layer data until all layers have been built, in order to
-    // support building multiple layers at once (e.g. ClosedSetNormalizer).
+    layers_[i]->Build(graph, &layer_errors[i]);
+  });
+  for (const S2Error& layer_error : layer_errors) {
+    if (!layer_error.ok()) *error_ = layer_error;
   }
 }
 
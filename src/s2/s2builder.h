@@ -369,6 +369,39 @@ class S2Builder {
     bool idempotent() const;
     void set_idempotent(bool idempotent);
 
+    // If true, then input edges with identical endpoints are detected before
+    // snapping, and only one copy of each such edge is checked for crossings
+    // (see split_crossing_edges) and for nearby sites.  This does not change
+    // the output.  It saves time when the same geometry is added to several
+    // layers (e.g., S2BooleanOperation with several operations), but
+    // otherwise it just adds the cost of hashing every input edge.
+    //
+    // DEFAULT: false
+    bool merge_duplicate_edge_work() const;
+    void set_merge_duplicate_edge_work(bool merge_duplicate_edge_work);
+
+    // The number of threads used to build the output layers (including the
+    // calling thread).  If this is greater than one, then the Graph for each
+    // layer is constructed and Layer::Build() is called concurrently, so
+    // layers must not share mutable state except through thread-safe
+    // mechanisms.  (For example, several Indexed* layers that add to the
+    // same MutableS2ShapeIndex may only be built concurrently if they are
+    // wrapped by s2builderutil::NormalizeClosedSet, which builds its output
+    // layers sequentially.)  Snapping and edge processing are always done
+    // by the calling thread.
+    //
+    // When layers are built concurrently, each layer starts with its own
+    // empty S2Error.  This means that a layer is not affected by errors
+    // reported by earlier layers (when layers are built sequentially, some
+    // layer types skip part of their work once an error has been reported),
+    // and all layers are built even if an earlier layer fails.  If several
+    // layers report errors, the error from the layer that was added last is
+    // returned.  The reported error does not depend on thread scheduling.
+    //
+    // DEFAULT: 1
+    int num_threads() const;
+    void set_num_threads(int num_threads);
+
     // Options may be assigned and copied.
     Options(const Options& options);
     Options& operator=(const Options& options);
@@ -378,6 +411,8 @@ class S2Builder {
     bool split_crossing_edges_ = false;
     bool simplify_edge_chains_ = false;
     bool idempotent_ = true;
+    bool merge_duplicate_edge_work_ = false;
+    int num_threads_ = 1;
   };
 
   // The following classes are only needed by Layer implementations.
@@ -612,12 +647,14 @@ class S2Builder {
   void ChooseSites();
   void CopyInputEdges();
   std::vector<InputVertexKey> SortInputVertices();
+  std::vector<InputEdgeId> GetFirstEdgeIds() const;
   void AddEdgeCrossings(const MutableS2ShapeIndex& input_edge_index);
   void AddForcedSites(S2PointIndex<SiteId>* site_index);
   bool is_forced(SiteId v) const;
   void ChooseInitialSites(S2PointIndex<SiteId>* site_index);
   S2Point SnapSite(const S2Point& point) const;
-  void CollectSiteEdges(const S2PointIndex<SiteId>& site_index);
+  void CollectSiteEdges(const S2PointIndex<SiteId>& site_index,
+                        const std::vector<InputEdgeId>& first_edge_ids);
   void SortSitesByDistance(const S2Point& x,
                            gtl::compact_array<SiteId>* sites) const;
   void AddExtraSites(const MutableS2ShapeIndex& input_edge_index);
@@ -998,6 +1035,19 @@ inline void S2Builder::Options::set_idempotent(bool idempotent) {
   idempotent_ = idempotent;
 }
 
+inline bool S2Builder::Options::merge_duplicate_edge_work() const {
+  return merge_duplicate_edge_work_;
+}
+
+inline void S2Builder::Options::set_merge_duplicate_edge_work(
+    bool merge_duplicate_edge_work) {
+  merge_duplicate_edge_work_ = merge_duplicate_edge_work;
+}
+
+inline int S2Builder::Options::num_threads() const {
+  return num_threads_;
+}
+
 inline S2Builder::GraphOptions::EdgeType
 S2Builder::GraphOptions::edge_type() const {
   return edge_type_;
@@ -1027,6 +1027,112 @@ TEST(S2Builder, SimplifyDegenerateEdgeMergingMultipleLayers) {
   ASSERT_TRUE(builder.Build(&error)) << error;
 }
 
+TEST(S2Builder, ParallelLayers) {
+  // Check that building the layers concurrently yields the same output as
+  // building them sequentially.  There are enough layers to enable vertex
+  // filtering.
+  S2Testing::rnd.Reset(1);
+  vector<unique_ptr<S2Polyline>> input;
+  S2Cap cap(S2Testing::RandomPoint(), S1Angle::Degrees(1));
+  for (int i = 0; i < 20; ++i) {
+    vector<S2Point> vertices(50);
+    for (S2Point& vertex : vertices) vertex = S2Testing::SamplePoint(cap);
+    input.push_back(make_unique<S2Polyline>(vertices));
+  }
+  vector<vector<unique_ptr<S2Polyline>>> output(2);
+  for (int num_threads : {1, 4}) {
+    S2Builder::Options options(S2CellIdSnapFunction(16));
+    options.set_num_threads(num_threads);
+    S2Builder builder(options);
+    auto& polylines = output[num_threads > 1];
+    polylines.resize(input.size());
+    for (int i = 0; i < input.size(); ++i) {
+      polylines[i] = make_unique<S2Polyline>();
+      builder.StartLayer(make_unique<S2PolylineLayer>(polylines[i].get()));
+      builder.AddPolyline(*input[i]);
+    }
+    S2Error error;
+    ASSERT_TRUE(builder.Build(&error)) << error;
+  }
+  for (int i = 0; i < input.size(); ++i) {
+    ExpectPolylinesEqual(*output[0][i], *output[1][i]);
+  }
+}
+
+// A layer that checks the number of edges in its graph and optionally
+// reports an error.
+class ErrorLayer : public S2Builder::Layer {
+ public:
+  ErrorLayer(int expected_num_edges, S2Error::Code code)
+      : expected_num_edges_(expected_num_edges), code_(code) {}
+
+  GraphOptions graph_options() const override { return GraphOptions(); }
+
+  void Build(const Graph& g, S2Error* error) override {
+    EXPECT_EQ(expected_num_edges_, g.num_edges());
+    if (code_ != S2Error::OK) error->Init(code_, "Layer error %d", code_);
+  }
+
+ private:
+  int expected_num_edges_;
+  S2Error::Code code_;
+};
+
+TEST(S2Builder, ParallelLayerErrors) {
+  // If several layers report errors, the error from the last layer is
+  // returned regardless of the order in which the layers are built.
+  for (int num_threads : {1, 3, 8}) {
+    S2Builder::Options options;
+    options.set_num_threads(num_threads);
+    S2Builder builder(options);
+    for (int i = 0; i < 6; ++i) {
+      S2Error::Code code = (i % 2 == 0) ? S2Error::OK : static_cast<
+          S2Error::Code>(S2Error::USER_DEFINED_START + i);
+      builder.StartLayer(make_unique<ErrorLayer>(i + 1, code));
+      vector<S2Point> vertices;
+      for (int j = 0; j <= i + 1; ++j) {
+        vertices.push_back(S2LatLng::FromDegrees(i, j).ToPoint());
+      }
+      builder.AddPolyline(S2Polyline(vertices));
+    }
+    S2Error error;
+    EXPECT_FALSE(builder.Build(&error));
+    EXPECT_EQ(S2Error::USER_DEFINED_START + 5, error.code());
+  }
+}
+
+TEST(S2Builder, MergeDuplicateEdgeWork) {
+  // Check that merge_duplicate_edge_work() does not change the output when
+  // every input polyline is added to several layers.
+  S2Testing::rnd.Reset(2);
+  vector<unique_ptr<S2Polyline>> input;
+  S2Cap cap(S2Testing::RandomPoint(), S1Angle::Degrees(1));
+  for (int i = 0; i < 5; ++i) {
+    vector<S2Point> vertices(20);
+    for (S2Point& vertex : vertices) vertex = S2Testing::SamplePoint(cap);
+    input.push_back(make_unique<S2Polyline>(vertices));
+  }
+  const int kCopies = 3;
+  vector<vector<unique_ptr<S2Polyline>>> output(2);
+  for (bool merge : {false, true}) {
+    S2Builder::Options options(S2CellIdSnapFunction(16));
+    options.set_split_crossing_edges(true);
+    options.set_merge_duplicate_edge_work(merge);
+    S2Builder builder(options);
+    auto& polylines = output[merge];
+    for (int i = 0; i < kCopies * input.size(); ++i) {
+      polylines.push_back(make_unique<S2Polyline>());
+      builder.StartLayer(make_unique<S2PolylineLayer>(polylines[i].get()));
+      builder.AddPolyline(*input[i % input.size()]);
+    }
+    S2Error error;
+    ASSERT_TRUE(builder.Build(&error)) << error;
+  }
+  for (int i = 0; i < output[0].size(); ++i) {
+    ExpectPolylinesEqual(*output[0][i], *output[1][i]);
+  }
+}
+
 TEST(S2Builder, HighPrecisionPredicates) {
   // To produce correct output in this example, the algorithm needs fall back
   // to high precision predicates when the output of the normal predicates is
@@ -18,6 +18,7 @@
 #include "s2/s2builderutil_closed_set_normalizer.h"
 
 #include <memory>
+#include <mutex>
 
 #include "s2/third_party/absl/memory/memory.h"
 #include "s2/s2builder_layer.h"
@@ -288,9 +289,15 @@ class NormalizeClosedSetImpl {
   };
 
   void Build(int dimension, const Graph& g, S2Error* error) {
-    // Errors are reported only on the last layer built.
-    graphs_[dimension] = g;
-    if (--graphs_left_ > 0) return;
+    // Errors are reported only on the last layer built.  The input layers
+    // may be built concurrently (see S2Builder::Options::num_threads), in
+    // which case the last thread to arrive does the work below.  The other
+    // Graphs remain valid until all layers have been built.
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      graphs_[dimension] = g;
+      if (--graphs_left_ > 0) return;
+    }
 
     vector<Graph> output = normalizer_.Run(graphs_, error);
     for (int dim = 0; dim < 3; ++dim) {
@@ -301,6 +308,7 @@ class NormalizeClosedSetImpl {
  private:
   vector<unique_ptr<S2Builder::Layer>> output_layers_;
   ClosedSetNormalizer normalizer_;
+  std::mutex mutex_;  // Protects graphs_ and graphs_left_.
   vector<Graph> graphs_;
   int graphs_left_;
 };
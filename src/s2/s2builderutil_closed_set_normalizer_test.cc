@@ -258,4 +258,35 @@ TEST(ComputeUnion, MixedGeometry) {
             s2textformat::ToString(result));
 }
 
+TEST(NormalizeClosedSet, ConcurrentInputLayers) {
+  // The input layers may be built concurrently, in which case the output
+  // layers are built by whichever thread builds the last input layer.
+  auto input = s2textformat::MakeIndex(
+      "0:0 | 10:10 | 20:20 # 0:0, 0:10 | 15:15, 16:16 # "
+      "0:0, 0:10, 10:10, 10:0");
+  vector<string> results;
+  for (int num_threads : {1, 3}) {
+    MutableS2ShapeIndex index;
+    LayerVector layers(3);
+    layers[0] = make_unique<IndexedS2PointVectorLayer>(&index);
+    layers[1] = make_unique<IndexedS2PolylineVectorLayer>(&index);
+    layers[2] = make_unique<IndexedS2PolygonLayer>(&index);
+    LayerVector normalized = NormalizeClosedSet(std::move(layers));
+    S2Builder::Options options;
+    options.set_num_threads(num_threads);
+    S2Builder builder(options);
+    for (int dim = 0; dim < 3; ++dim) {
+      builder.StartLayer(std::move(normalized[dim]));
+      for (S2Shape* shape : *input) {
+        if (shape->dimension() == dim) builder.AddShape(*shape);
+      }
+    }
+    S2Error error;
+    ASSERT_TRUE(builder.Build(&error)) << error;
+    results.push_back(s2textformat::ToString(index));
+  }
+  EXPECT_EQ("20:20 # 15:15, 16:16 # 0:0, 0:10, 10:10, 10:0", results[0]);
+  EXPECT_EQ(results[0], results[1]);
+}
+
 }  // namespace s2builderutil
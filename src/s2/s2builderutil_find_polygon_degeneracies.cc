@@ -341,7 +341,7 @@ void DegeneracyFinder::ComputeUnknownSignsIndexed(
     vector<Component>* components) const {
   MutableS2ShapeIndex index;
   index.Add(make_unique<GraphShape>(&g_));
-  S2CrossingEdgeQuery query(&index);
+  S2CrossingEdgeQueryBase<MutableS2ShapeIndex> query(&index);
   vector<ShapeEdgeId> crossing_edges;
   S2EdgeCrosser crosser;
   for (Component& component : *components) {
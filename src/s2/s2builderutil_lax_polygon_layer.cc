@@ -0,0 +1,213 @@
+// Copyright 2018 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "s2/s2builderutil_lax_polygon_layer.h"
+
+#include <algorithm>
+#include <vector>
+#include "s2/third_party/absl/types/span.h"
+#include "s2/s2builderutil_find_polygon_degeneracies.h"
+
+using absl::Span;
+using std::vector;
+
+using EdgeType = S2Builder::EdgeType;
+using Graph = S2Builder::Graph;
+using GraphOptions = S2Builder::GraphOptions;
+using Label = S2Builder::Label;
+
+using DegenerateEdges = GraphOptions::DegenerateEdges;
+using DuplicateEdges = GraphOptions::DuplicateEdges;
+using SiblingPairs = GraphOptions::SiblingPairs;
+
+using EdgeId = Graph::EdgeId;
+using InputEdgeIdSetId = Graph::InputEdgeIdSetId;
+using LoopType = Graph::LoopType;
+
+namespace s2builderutil {
+
+using DegenerateBoundaries = LaxPolygonLayer::Options::DegenerateBoundaries;
+
+LaxPolygonLayer::LaxPolygonLayer(S2LaxPolygonShape* polygon,
+                                 const Options& options) {
+  Init(polygon, nullptr, nullptr, options);
+}
+
+LaxPolygonLayer::LaxPolygonLayer(
+    S2LaxPolygonShape* polygon, LabelSetIds* label_set_ids,
+    IdSetLexicon* label_set_lexicon, const Options& options) {
+  Init(polygon, label_set_ids, label_set_lexicon, options);
+}
+
+void LaxPolygonLayer::Init(
+    S2LaxPolygonShape* polygon, LabelSetIds* label_set_ids,
+    IdSetLexicon* label_set_lexicon, const Options& options) {
+  S2_DCHECK_EQ(label_set_ids == nullptr, label_set_lexicon == nullptr);
+  polygon_ = polygon;
+  label_set_ids_ = label_set_ids;
+  label_set_lexicon_ = label_set_lexicon;
+  options_ = options;
+}
+
+GraphOptions LaxPolygonLayer::graph_options() const {
+  if (options_.degenerate_boundaries() == DegenerateBoundaries::DISCARD) {
+    // There should not be any duplicate edges, but if there are then we keep
+    // them since this yields more comprehensible error messages.
+    return GraphOptions(options_.edge_type(), DegenerateEdges::DISCARD,
+                        DuplicateEdges::KEEP, SiblingPairs::DISCARD);
+  } else {
+    // Keep at most one copy of each degeneracy.  (Degeneracies that coincide
+    // with other edges are removed, since they are not distinguishable from
+    // the edges that they coincide with.)
+    return GraphOptions(options_.edge_type(), DegenerateEdges::DISCARD_EXCESS,
+                        DuplicateEdges::KEEP, SiblingPairs::DISCARD_EXCESS);
+  }
+}
+
+// Appends the vertices of each loop in "edge_loops" to "vertices", and the
+// number of vertices in each loop to "loop_sizes".
+void LaxPolygonLayer::AppendPolygonLoops(
+    const Graph& g, const vector<Graph::EdgeLoop>& edge_loops,
+    vector<S2Point>* vertices, vector<int>* loop_sizes) const {
+  for (const auto& edge_loop : edge_loops) {
+    for (EdgeId edge_id : edge_loop) {
+      vertices->push_back(g.vertex(g.edge(edge_id).first));
+    }
+    loop_sizes->push_back(edge_loop.size());
+  }
+}
+
+void LaxPolygonLayer::AppendEdgeLabels(
+    const Graph& g, const vector<Graph::EdgeLoop>& edge_loops) {
+  if (!label_set_ids_) return;
+
+  vector<Label> labels;  // Temporary storage for labels.
+  Graph::LabelFetcher fetcher(g, options_.edge_type());
+  for (const auto& edge_loop : edge_loops) {
+    vector<LabelSetId> loop_label_set_ids;
+    loop_label_set_ids.reserve(edge_loop.size());
+    for (EdgeId edge_id : edge_loop) {
+      fetcher.Fetch(edge_id, &labels);
+      loop_label_set_ids.push_back(label_set_lexicon_->Add(labels));
+    }
+    label_set_ids_->push_back(std::move(loop_label_set_ids));
+  }
+}
+
+// Returns true if every edge of "g" is either a degenerate edge or one half
+// of a sibling pair.
+static bool IsFullyDegenerate(const Graph& g) {
+  const vector<Graph::Edge>& edges = g.edges();
+  for (const Graph::Edge& edge : edges) {
+    if (edge.first == edge.second) continue;
+    if (!std::binary_search(edges.begin(), edges.end(), Graph::reverse(edge))) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void LaxPolygonLayer::BuildDirected(Graph g, S2Error* error) {
+  // Some cases are handled by constructing a new graph with certain
+  // degenerate edges removed (overwriting "g").  These vectors store the
+  // edges of the new graph.
+  vector<Graph::Edge> new_edges;
+  vector<InputEdgeIdSetId> new_input_edge_id_set_ids;
+
+  // A full loop is represented as a loop with no vertices.
+  bool add_full_loop = false;
+  DegenerateBoundaries degenerate_boundaries = options_.degenerate_boundaries();
+  if (degenerate_boundaries == DegenerateBoundaries::DISCARD) {
+    // This is the easiest case, since there are no degeneracies.
+    if (g.num_edges() == 0) add_full_loop = g.IsFullPolygon(error);
+  } else if (degenerate_boundaries == DegenerateBoundaries::KEEP) {
+    // S2LaxPolygonShape does not need to distinguish degenerate shells from
+    // holes, except when the entire graph is degenerate.  In that case we
+    // need to decide whether it represents an empty polygon (possibly with
+    // degenerate shells) or a full polygon (possibly with degenerate holes).
+    if (IsFullyDegenerate(g)) add_full_loop = g.IsFullPolygon(error);
+  } else {
+    // For DISCARD_SHELLS and DISCARD_HOLES we first classify the
+    // degeneracies, and then (if necessary) construct a new graph with the
+    // unwanted degeneracies removed.
+    bool discard_holes =
+        (degenerate_boundaries == DegenerateBoundaries::DISCARD_HOLES);
+    vector<PolygonDegeneracy> degeneracies =
+        FindPolygonDegeneracies(g, error);
+    if (!error->ok()) return;
+    if (degeneracies.size() == g.num_edges()) {
+      if (degeneracies.empty()) {
+        add_full_loop = g.IsFullPolygon(error);
+      } else {
+        // All degeneracies are classified consistently in this case.
+        add_full_loop = degeneracies[0].is_hole;
+      }
+    }
+    if (!degeneracies.empty()) {
+      // "degeneracies" is sorted by edge id.
+      auto next = degeneracies.begin();
+      for (EdgeId e = 0; e < g.num_edges(); ++e) {
+        if (next != degeneracies.end() && next->edge_id == e) {
+          if ((next++)->is_hole == discard_holes) continue;
+        }
+        new_edges.push_back(g.edge(e));
+        new_input_edge_id_set_ids.push_back(g.input_edge_id_set_id(e));
+      }
+      if (new_edges.size() < g.num_edges()) {
+        g = Graph(g.options(), &g.vertices(), &new_edges,
+                  &new_input_edge_id_set_ids, &g.input_edge_id_set_lexicon(),
+                  &g.label_set_ids(), &g.label_set_lexicon(),
+                  g.is_full_polygon_predicate());
+      }
+    }
+  }
+  if (!error->ok()) return;
+
+  vector<Graph::EdgeLoop> edge_loops;
+  if (!g.GetDirectedLoops(LoopType::SIMPLE, &edge_loops, error)) return;
+
+  // The vertices of all loops are gathered into a single vector, which is
+  // then copied into the S2LaxPolygonShape in one pass.
+  vector<S2Point> vertices;
+  vector<int> loop_sizes;
+  vertices.reserve(g.num_edges());
+  loop_sizes.reserve(edge_loops.size() + 1);
+  if (add_full_loop) {
+    loop_sizes.push_back(0);
+    if (label_set_ids_) label_set_ids_->emplace_back();
+  }
+  AppendPolygonLoops(g, edge_loops, &vertices, &loop_sizes);
+  AppendEdgeLabels(g, edge_loops);
+
+  vector<Span<const S2Point>> loops;
+  loops.reserve(loop_sizes.size());
+  const S2Point* loop_start = vertices.data();
+  for (int loop_size : loop_sizes) {
+    loops.emplace_back(loop_start, loop_size);
+    loop_start += loop_size;
+  }
+  polygon_->Init(loops);
+}
+
+void LaxPolygonLayer::Build(const Graph& g, S2Error* error) {
+  if (label_set_ids_) label_set_ids_->clear();
+  if (g.options().edge_type() == EdgeType::DIRECTED) {
+    BuildDirected(g, error);
+  } else {
+    error->Init(S2Error::UNIMPLEMENTED, "Undirected edges not supported yet");
+  }
+}
+
+}  // namespace s2builderutil
@@ -0,0 +1,200 @@
+// Copyright 2018 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef S2_S2BUILDERUTIL_LAX_POLYGON_LAYER_H_
+#define S2_S2BUILDERUTIL_LAX_POLYGON_LAYER_H_
+
+#include <memory>
+#include <utility>
+#include <vector>
+#include "s2/third_party/absl/base/integral_types.h"
+#include "s2/id_set_lexicon.h"
+#include "s2/mutable_s2shape_index.h"
+#include "s2/s2builder.h"
+#include "s2/s2builder_graph.h"
+#include "s2/s2builder_layer.h"
+#include "s2/s2error.h"
+#include "s2/s2lax_polygon_shape.h"
+
+namespace s2builderutil {
+
+// A layer type that assembles directed edges into an S2LaxPolygonShape.
+// Returns an error if the edges cannot be assembled into loops.
+//
+// Unlike S2PolygonLayer, the loops are copied directly from the S2Builder
+// output graph into the S2LaxPolygonShape.  No S2Loop objects are
+// constructed and no loop nesting is computed, which makes this layer much
+// faster when the output is going to be indexed or encoded anyway.
+//
+// The input edges must be directed and oriented such that the polygon
+// interior is to the left of all edges.  (Since S2LaxPolygonShape does not
+// record which loops are shells and which are holes, undirected edges would
+// require the same nesting computation that this class is designed to
+// avoid; use S2PolygonLayer for undirected input.)
+//
+// Degenerate edges and sibling pairs can optionally be kept (see
+// DegenerateBoundaries below), since unlike S2Polygon, S2LaxPolygonShape
+// can represent zero-area degenerate regions.
+//
+// If the polygon has no edges, then the graph's IsFullPolygonPredicate is
+// called to determine whether the output polygon should be empty (containing
+// no points) or full (containing all points).  This predicate can be
+// specified as part of the S2Builder input geometry.
+class LaxPolygonLayer : public S2Builder::Layer {
+ public:
+  class Options {
+   public:
+    // Constructor that uses the default options (listed below).
+    Options();
+
+    // Constructor that specifies the edge type.
+    explicit Options(S2Builder::EdgeType edge_type);
+
+    // Indicates whether the input edges provided to S2Builder are directed or
+    // undirected.  Only directed edges are currently supported; undirected
+    // edges cause Build() to return S2Error::UNIMPLEMENTED.
+    //
+    // The input edges should be oriented so that the polygon interior is to
+    // the left of all edges.  Note that S2Builder::AddPolygon() and
+    // S2Builder::AddShape() do this automatically.
+    //
+    // DEFAULT: S2Builder::EdgeType::DIRECTED
+    S2Builder::EdgeType edge_type() const;
+    void set_edge_type(S2Builder::EdgeType edge_type);
+
+    // Specifies whether degenerate boundaries should be discarded or kept.
+    // (A degenerate boundary is either a degenerate edge, i.e. an edge from a
+    // vertex to itself, or a sibling edge pair consisting of an edge and its
+    // corresponding reverse edge.)  A polygon may contain degenerate
+    // boundaries of two types: degenerate shells (which enclose a zero-area
+    // region inside the polygon exterior) and degenerate holes (which
+    // exclude a zero-area region from the polygon interior).
+    enum class DegenerateBoundaries : uint8 {
+      DISCARD,         // Discard all degenerate boundaries.
+      DISCARD_HOLES,   // Keep degenerate shells but discard degenerate holes.
+      DISCARD_SHELLS,  // Keep degenerate holes but discard degenerate shells.
+      KEEP,            // Keep all degenerate boundaries.
+    };
+    //
+    // DEFAULT: DegenerateBoundaries::DISCARD
+    DegenerateBoundaries degenerate_boundaries() const;
+    void set_degenerate_boundaries(DegenerateBoundaries degenerate_boundaries);
+
+   private:
+    S2Builder::EdgeType edge_type_;
+    DegenerateBoundaries degenerate_boundaries_;
+  };
+
+  // Specifies that a polygon should be constructed using the given options.
+  explicit LaxPolygonLayer(S2LaxPolygonShape* polygon,
+                           const Options& options = Options());
+
+  // Specifies that a polygon should be constructed using the given options,
+  // and that any labels attached to the input edges should be returned in
+  // "label_set_ids" and "label_set_lexicion".
+  //
+  // The labels associated with the edge "polygon.chain_edge(i, j)"
+  // can be retrieved as follows:
+  //
+  //   for (int32 label : label_set_lexicon.id_set(label_set_ids[i][j])) {...}
+  using LabelSetIds = std::vector<std::vector<LabelSetId>>;
+  LaxPolygonLayer(S2LaxPolygonShape* polygon, LabelSetIds* label_set_ids,
+                  IdSetLexicon* label_set_lexicon,
+                  const Options& options = Options());
+
+  // Layer interface:
+  GraphOptions graph_options() const override;
+  void Build(const Graph& g, S2Error* error) override;
+
+ private:
+  void Init(S2LaxPolygonShape* polygon, LabelSetIds* label_set_ids,
+            IdSetLexicon* label_set_lexicon, const Options& options);
+  void AppendPolygonLoops(const Graph& g,
+                          const std::vector<Graph::EdgeLoop>& edge_loops,
+                          std::vector<S2Point>* vertices,
+                          std::vector<int>* loop_sizes) const;
+  void AppendEdgeLabels(const Graph& g,
+                        const std::vector<Graph::EdgeLoop>& edge_loops);
+  void BuildDirected(Graph g, S2Error* error);
+
+  S2LaxPolygonShape* polygon_;
+  LabelSetIds* label_set_ids_;
+  IdSetLexicon* label_set_lexicon_;
+  Options options_;
+};
+
+// Like LaxPolygonLayer, but adds the polygon to a MutableS2ShapeIndex (if
+// the polygon is non-empty).
+class IndexedLaxPolygonLayer : public S2Builder::Layer {
+ public:
+  using Options = LaxPolygonLayer::Options;
+  explicit IndexedLaxPolygonLayer(MutableS2ShapeIndex* index,
+                                  const Options& options = Options())
+      : index_(index), polygon_(new S2LaxPolygonShape),
+        layer_(polygon_.get(), options) {}
+
+  GraphOptions graph_options() const override {
+    return layer_.graph_options();
+  }
+
+  void Build(const Graph& g, S2Error* error) override {
+    layer_.Build(g, error);
+    if (error->ok() && polygon_->num_loops() > 0) {
+      index_->Add(std::move(polygon_));
+    }
+  }
+
+ private:
+  MutableS2ShapeIndex* index_;
+  std::unique_ptr<S2LaxPolygonShape> polygon_;
+  LaxPolygonLayer layer_;
+};
+
+
+//////////////////   Implementation details follow   ////////////////////
+
+
+inline LaxPolygonLayer::Options::Options()
+    : edge_type_(S2Builder::EdgeType::DIRECTED),
+      degenerate_boundaries_(DegenerateBoundaries::DISCARD) {
+}
+
+inline LaxPolygonLayer::Options::Options(S2Builder::EdgeType edge_type)
+    : edge_type_(edge_type),
+      degenerate_boundaries_(DegenerateBoundaries::DISCARD) {
+}
+
+inline S2Builder::EdgeType LaxPolygonLayer::Options::edge_type() const {
+  return edge_type_;
+}
+
+inline void LaxPolygonLayer::Options::set_edge_type(
+    S2Builder::EdgeType edge_type) {
+  edge_type_ = edge_type;
+}
+
+inline LaxPolygonLayer::Options::DegenerateBoundaries
+LaxPolygonLayer::Options::degenerate_boundaries() const {
+  return degenerate_boundaries_;
+}
+
+inline void LaxPolygonLayer::Options::set_degenerate_boundaries(
+    DegenerateBoundaries degenerate_boundaries) {
+  degenerate_boundaries_ = degenerate_boundaries;
+}
+
+}  // namespace s2builderutil
+
+#endif  // S2_S2BUILDERUTIL_LAX_POLYGON_LAYER_H_
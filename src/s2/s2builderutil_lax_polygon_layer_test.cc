@@ -0,0 +1,199 @@
+// Copyright 2018 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "s2/s2builderutil_lax_polygon_layer.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include "s2/third_party/absl/memory/memory.h"
+#include "s2/mutable_s2shape_index.h"
+#include "s2/s2builderutil_s2polygon_layer.h"
+#include "s2/s2polygon.h"
+#include "s2/s2text_format.h"
+
+using absl::make_unique;
+using s2builderutil::IndexedLaxPolygonLayer;
+using s2builderutil::LaxPolygonLayer;
+using s2builderutil::S2PolygonLayer;
+using std::string;
+using std::vector;
+
+using DegenerateBoundaries = LaxPolygonLayer::Options::DegenerateBoundaries;
+using EdgeType = S2Builder::EdgeType;
+
+namespace {
+
+string BuildLaxPolygon(const string& input_str,
+                       DegenerateBoundaries degenerate_boundaries) {
+  S2Builder builder{S2Builder::Options()};
+  S2LaxPolygonShape output;
+  LaxPolygonLayer::Options options;
+  options.set_degenerate_boundaries(degenerate_boundaries);
+  builder.StartLayer(make_unique<LaxPolygonLayer>(&output, options));
+  auto polygon = s2textformat::MakeLaxPolygonOrDie(input_str);
+  builder.AddShape(*polygon);
+
+  // In order to construct polygons that are full except possibly for a
+  // collection of degenerate holes, we must supply S2Builder with a
+  // predicate that distinguishes empty polygons from full ones.
+  bool is_full = (polygon->num_loops() > 0 &&
+                  polygon->num_loop_vertices(0) == 0);
+  builder.AddIsFullPolygonPredicate(S2Builder::IsFullPolygon(is_full));
+  S2Error error;
+  EXPECT_TRUE(builder.Build(&error)) << error;
+  return s2textformat::ToString(output, "; ");
+}
+
+void TestLaxPolygon(const string& input_str, const string& expected_str,
+                    DegenerateBoundaries degenerate_boundaries) {
+  EXPECT_EQ(expected_str, BuildLaxPolygon(input_str, degenerate_boundaries));
+}
+
+void TestLaxPolygonUnchanged(const string& input_str) {
+  for (auto degenerate_boundaries : {
+           DegenerateBoundaries::DISCARD, DegenerateBoundaries::DISCARD_HOLES,
+           DegenerateBoundaries::DISCARD_SHELLS, DegenerateBoundaries::KEEP}) {
+    TestLaxPolygon(input_str, input_str, degenerate_boundaries);
+  }
+}
+
+TEST(LaxPolygonLayer, Empty) {
+  TestLaxPolygonUnchanged("");
+}
+
+TEST(LaxPolygonLayer, Full) {
+  TestLaxPolygonUnchanged("full");
+}
+
+TEST(LaxPolygonLayer, OneLoop) {
+  TestLaxPolygonUnchanged("0:0, 0:10, 10:0");
+}
+
+TEST(LaxPolygonLayer, TwoLoops) {
+  TestLaxPolygonUnchanged("0:0, 0:10, 10:0; 20:20, 20:30, 30:20");
+}
+
+TEST(LaxPolygonLayer, ShellWithHole) {
+  // Loops are not nested or normalized, so holes need not follow their
+  // shells and the vertex order of each loop is preserved.
+  TestLaxPolygonUnchanged("1:1, 2:1, 1:2; 0:0, 0:10, 10:0");
+}
+
+TEST(LaxPolygonLayer, DegenerateBoundaries) {
+  // A shell containing a degenerate hole (a sibling pair), together with a
+  // degenerate shell (a single point) outside it.
+  const string input = "0:0, 0:10, 10:0; 1:1, 2:2; 20:20";
+  TestLaxPolygon(input, "0:0, 0:10, 10:0", DegenerateBoundaries::DISCARD);
+  TestLaxPolygon(input, "0:0, 0:10, 10:0; 20:20",
+                 DegenerateBoundaries::DISCARD_HOLES);
+  TestLaxPolygon(input, "0:0, 0:10, 10:0; 1:1, 2:2",
+                 DegenerateBoundaries::DISCARD_SHELLS);
+  TestLaxPolygon(input, input, DegenerateBoundaries::KEEP);
+}
+
+TEST(LaxPolygonLayer, FullWithDegenerateHoles) {
+  // A polygon consisting only of degenerate holes is full.
+  const string input = "full; 1:1, 2:2; 5:5";
+  TestLaxPolygon(input, "full", DegenerateBoundaries::DISCARD);
+  TestLaxPolygon(input, "full", DegenerateBoundaries::DISCARD_HOLES);
+  TestLaxPolygon(input, input, DegenerateBoundaries::DISCARD_SHELLS);
+  TestLaxPolygon(input, input, DegenerateBoundaries::KEEP);
+}
+
+TEST(LaxPolygonLayer, SameLoopsAsS2PolygonLayer) {
+  // For valid polygons, the output has the same loops as S2PolygonLayer
+  // (except that S2Polygon holes are oriented oppositely).
+  auto input = s2textformat::MakePolygonOrDie(
+      "0:0, 0:10, 10:10, 10:0; 2:2, 2:8, 8:8, 8:2; 20:20, 20:21, 21:21");
+  S2Builder builder{S2Builder::Options()};
+  S2Polygon polygon;
+  S2LaxPolygonShape lax_polygon;
+  builder.StartLayer(make_unique<S2PolygonLayer>(&polygon));
+  builder.AddPolygon(*input);
+  builder.StartLayer(make_unique<LaxPolygonLayer>(&lax_polygon));
+  builder.AddPolygon(*input);
+  S2Error error;
+  ASSERT_TRUE(builder.Build(&error)) << error;
+  S2LaxPolygonShape expected(polygon);
+  ASSERT_EQ(expected.num_loops(), lax_polygon.num_loops());
+  ASSERT_EQ(expected.num_edges(), lax_polygon.num_edges());
+  for (int i = 0; i < expected.num_loops(); ++i) {
+    // Both loops start at the vertex corresponding to the minimum input edge.
+    ASSERT_EQ(expected.num_loop_vertices(i), lax_polygon.num_loop_vertices(i));
+    for (int j = 0; j < expected.num_loop_vertices(i); ++j) {
+      EXPECT_EQ(expected.loop_vertex(i, j), lax_polygon.loop_vertex(i, j));
+    }
+  }
+}
+
+TEST(LaxPolygonLayer, EdgeLabels) {
+  S2Builder builder{S2Builder::Options()};
+  S2LaxPolygonShape output;
+  LaxPolygonLayer::LabelSetIds label_set_ids;
+  IdSetLexicon label_set_lexicon;
+  builder.StartLayer(make_unique<LaxPolygonLayer>(
+      &output, &label_set_ids, &label_set_lexicon));
+  auto input = s2textformat::MakeLaxPolygonOrDie(
+      "0:0, 0:10, 10:0; 20:20, 20:30, 30:20");
+  for (int e = 0; e < input->num_edges(); ++e) {
+    builder.set_label(e);
+    S2Shape::Edge edge = input->edge(e);
+    builder.AddEdge(edge.v0, edge.v1);
+  }
+  S2Error error;
+  ASSERT_TRUE(builder.Build(&error)) << error;
+  ASSERT_EQ(output.num_loops(), label_set_ids.size());
+  for (int i = 0; i < output.num_chains(); ++i) {
+    ASSERT_EQ(output.chain(i).length, label_set_ids[i].size());
+    for (int j = 0; j < output.chain(i).length; ++j) {
+      // Each output edge corresponds to the input edge with the same id.
+      int e = output.chain(i).start + j;
+      EXPECT_EQ(input->edge(e).v0, output.edge(e).v0);
+      vector<int32> labels;
+      for (int32 label : label_set_lexicon.id_set(label_set_ids[i][j])) {
+        labels.push_back(label);
+      }
+      EXPECT_EQ(vector<int32>{e}, labels);
+    }
+  }
+}
+
+TEST(LaxPolygonLayer, UndirectedEdgesNotSupported) {
+  S2Builder builder{S2Builder::Options()};
+  S2LaxPolygonShape output;
+  builder.StartLayer(make_unique<LaxPolygonLayer>(
+      &output, LaxPolygonLayer::Options(EdgeType::UNDIRECTED)));
+  builder.AddShape(*s2textformat::MakeLaxPolygonOrDie("0:0, 0:10, 10:0"));
+  S2Error error;
+  EXPECT_FALSE(builder.Build(&error));
+  EXPECT_EQ(S2Error::UNIMPLEMENTED, error.code());
+}
+
+TEST(IndexedLaxPolygonLayer, AddsToIndex) {
+  MutableS2ShapeIndex index;
+  S2Builder builder{S2Builder::Options()};
+  builder.StartLayer(make_unique<IndexedLaxPolygonLayer>(&index));
+  builder.AddShape(*s2textformat::MakeLaxPolygonOrDie("0:0, 0:10, 10:0"));
+  // Empty polygons are not added.
+  builder.StartLayer(make_unique<IndexedLaxPolygonLayer>(&index));
+  S2Error error;
+  ASSERT_TRUE(builder.Build(&error)) << error;
+  EXPECT_EQ("# # 0:0, 0:10, 10:0", s2textformat::ToString(index));
+}
+
+}  // namespace
@@ -0,0 +1,279 @@
+// Copyright 2018 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef S2_S2CACHED_CONTAINS_POINT_QUERY_H_
+#define S2_S2CACHED_CONTAINS_POINT_QUERY_H_
+
+#include <algorithm>
+#include <vector>
+
+#include "s2/base/logging.h"
+#include "s2/s2cell_id.h"
+#include "s2/s2cell_union.h"
+#include "s2/s2contains_point_query.h"
+#include "s2/s2region_coverer.h"
+#include "s2/s2shape_index.h"
+#include "s2/s2shape_index_region.h"
+
+// This class defines the options supported by S2CachedContainsPointQuery.
+class S2CachedContainsPointQueryOptions : public S2ContainsPointQueryOptions {
+ public:
+  S2CachedContainsPointQueryOptions() {}
+
+  // The maximum number of cells in the interior covering, i.e. the set of
+  // cells that are known to be contained by some polygon.  Points in these
+  // cells are reported as contained without examining the index.  Setting
+  // this option to zero disables the interior covering.
+  //
+  // DEFAULT: 256
+  int max_interior_cells() const { return max_interior_cells_; }
+  void set_max_interior_cells(int max_interior_cells);
+
+  // The maximum number of cells in the exterior covering, i.e. the set of
+  // cells that may intersect some shape.  Points outside these cells are
+  // reported as not contained without examining the index.  Setting this
+  // option to zero disables the exterior covering.
+  //
+  // Note that each cached cell requires slightly more than 8 bytes, so the
+  // memory used by the cache is bounded by approximately
+  // 8 * (max_interior_cells() + 2 * max_exterior_cells()) bytes (since
+  // removing the interior cells from the exterior covering can split some
+  // exterior cells).  In practice it is usually much less.
+  //
+  // DEFAULT: 256
+  int max_exterior_cells() const { return max_exterior_cells_; }
+  void set_max_exterior_cells(int max_exterior_cells);
+
+  // The maximum level of the cells used in both coverings.  Smaller cells
+  // approximate the shapes more closely but are more expensive to compute.
+  //
+  // DEFAULT: S2CellId::kMaxLevel
+  int max_level() const { return max_level_; }
+  void set_max_level(int max_level);
+
+ private:
+  int max_interior_cells_ = 256;
+  int max_exterior_cells_ = 256;
+  int max_level_ = S2CellId::kMaxLevel;
+};
+
+// S2CachedContainsPointQuery is a drop-in replacement for S2ContainsPointQuery
+// that is designed for testing large numbers of points against a small
+// number of large, complex polygons (e.g. geofencing).  It precomputes an
+// interior and an exterior covering of the index (see S2RegionCoverer) and
+// stores them as a single sorted array of disjoint cells, each labeled as
+// either "interior" or "boundary".  Containment of a point can then be
+// decided with a single binary search unless the point is close to the
+// boundary of some shape, in which case the query falls back to the exact
+// test performed by S2ContainsPointQuery.  The results are always identical
+// to those of S2ContainsPointQuery.
+//
+// Example usage:
+//   S2CachedContainsPointQuery<MutableS2ShapeIndex> query(&index);
+//   for (const S2Point& p : points) {
+//     if (query.Contains(p)) ...
+//   }
+//
+// The cache is computed by the constructor (or Init) and is not updated if
+// the index is subsequently modified; in that case Init() must be called
+// again.  The cost of building the cache is roughly proportional to
+// max_interior_cells() + max_exterior_cells() times the cost of locating a
+// cell in the index, so this class is only worthwhile when many points are
+// tested against the same index.
+//
+// This class is not thread-safe.  To use it in parallel, each thread should
+// construct its own instance.
+template <class IndexType>
+class S2CachedContainsPointQuery {
+ public:
+  using Options = S2CachedContainsPointQueryOptions;
+
+  // The result of looking up a point in the cached coverings.
+  enum class CacheResult {
+    OUTSIDE,   // The point is not contained by any shape.
+    INSIDE,    // The point is contained by some polygon.
+    BOUNDARY,  // The point is near an edge; the exact test is required.
+  };
+
+  // Default constructor; requires Init() to be called.
+  S2CachedContainsPointQuery();
+
+  // Rather than calling this constructor, which requires specifying the
+  // IndexType template argument explicitly, the preferred idiom is to call
+  // MakeS2CachedContainsPointQuery() instead.
+  explicit S2CachedContainsPointQuery(const IndexType* index,
+                                      const Options& options = Options());
+
+  // Equivalent to the two-argument constructor above.
+  void Init(const IndexType* index, const Options& options = Options());
+
+  const IndexType& index() const { return query_.index(); }
+  const Options& options() const { return options_; }
+
+  // Returns true if any shape in the given index contains the point "p"
+  // under the vertex model specified (OPEN, SEMI_OPEN, or CLOSED).  This
+  // method returns exactly the same result as S2ContainsPointQuery.
+  bool Contains(const S2Point& p);
+
+  // Looks up "p" in the cached coverings only, without examining the index.
+  CacheResult LookupCache(const S2Point& p) const;
+
+  // Returns the number of cells in the cache.
+  int num_cached_cells() const { return cell_ids_.size(); }
+
+  // Returns the memory used by the cache (not including the index).
+  size_t SpaceUsed() const;
+
+ private:
+  Options options_;
+
+  // A sorted vector of disjoint cells.  Points that are not contained by any
+  // cell are outside all shapes.
+  std::vector<S2CellId> cell_ids_;
+
+  // interior_[i] is true if cell_ids_[i] is contained by some polygon.
+  std::vector<bool> interior_;
+
+  S2ContainsPointQuery<IndexType> query_;
+};
+
+// Returns an S2CachedContainsPointQuery for the given S2ShapeIndex.
+template <class IndexType>
+inline S2CachedContainsPointQuery<IndexType> MakeS2CachedContainsPointQuery(
+    const IndexType* index,
+    const S2CachedContainsPointQueryOptions& options =
+    S2CachedContainsPointQueryOptions()) {
+  return S2CachedContainsPointQuery<IndexType>(index, options);
+}
+
+
+//////////////////   Implementation details follow   ////////////////////
+
+
+inline void S2CachedContainsPointQueryOptions::set_max_interior_cells(
+    int max_interior_cells) {
+  S2_DCHECK_GE(max_interior_cells, 0);
+  max_interior_cells_ = max_interior_cells;
+}
+
+inline void S2CachedContainsPointQueryOptions::set_max_exterior_cells(
+    int max_exterior_cells) {
+  S2_DCHECK_GE(max_exterior_cells, 0);
+  max_exterior_cells_ = max_exterior_cells;
+}
+
+inline void S2CachedContainsPointQueryOptions::set_max_level(int max_level) {
+  S2_DCHECK_GE(max_level, 0);
+  S2_DCHECK_LE(max_level, S2CellId::kMaxLevel);
+  max_level_ = max_level;
+}
+
+template <class IndexType>
+inline S2CachedContainsPointQuery<IndexType>::S2CachedContainsPointQuery() {
+}
+
+template <class IndexType>
+inline S2CachedContainsPointQuery<IndexType>::S2CachedContainsPointQuery(
+    const IndexType* index, const Options& options) {
+  Init(index, options);
+}
+
+template <class IndexType>
+void S2CachedContainsPointQuery<IndexType>::Init(const IndexType* index,
+                                                 const Options& options) {
+  options_ = options;
+  query_.Init(index, options);
+  cell_ids_.clear();
+  interior_.clear();
+
+  S2RegionCoverer coverer;
+  coverer.mutable_options()->set_max_level(options.max_level());
+  auto region = MakeS2ShapeIndexRegion(index);
+  S2CellUnion exterior;
+  if (options.max_exterior_cells() > 0) {
+    coverer.mutable_options()->set_max_cells(options.max_exterior_cells());
+    exterior = coverer.GetCovering(region);
+  } else {
+    std::vector<S2CellId> faces;
+    for (int face = 0; face < 6; ++face) {
+      faces.push_back(S2CellId::FromFace(face));
+    }
+    exterior = S2CellUnion::FromNormalized(std::move(faces));
+  }
+  S2CellUnion interior;
+  if (options.max_interior_cells() > 0) {
+    coverer.mutable_options()->set_max_cells(options.max_interior_cells());
+    interior = coverer.GetInteriorCovering(region);
+  }
+  // Every point in the interior covering is contained by the exterior
+  // covering, so the cache consists of the interior cells together with the
+  // exterior cells minus the interior.
+  S2CellUnion boundary = exterior.Difference(interior);
+
+  cell_ids_.reserve(interior.size() + boundary.size());
+  interior_.reserve(interior.size() + boundary.size());
+  auto i = interior.begin(), b = boundary.begin();
+  while (i != interior.end() || b != boundary.end()) {
+    if (b == boundary.end() || (i != interior.end() && *i < *b)) {
+      cell_ids_.push_back(*i++);
+      interior_.push_back(true);
+    } else {
+      cell_ids_.push_back(*b++);
+      interior_.push_back(false);
+    }
+  }
+}
+
+template <class IndexType>
+typename S2CachedContainsPointQuery<IndexType>::CacheResult
+S2CachedContainsPointQuery<IndexType>::LookupCache(const S2Point& p) const {
+  // Since the cells are disjoint, they are sorted by range_max() as well.
+  // We find the first cell whose range_max() is at least "id" (which is the
+  // only cell that can contain it) using a branch-free binary search, which
+  // is significantly faster than std::lower_bound for random queries.
+  const S2CellId id(p);
+  if (cell_ids_.empty()) return CacheResult::OUTSIDE;
+  const S2CellId* base = cell_ids_.data();
+  for (size_t n = cell_ids_.size(); n > 1; ) {
+    size_t half = n >> 1;
+    base = (base[half].range_max() < id) ? base + half : base;
+    n -= half;
+  }
+  // Now "base" is either the cell we are looking for or its predecessor.
+  if (base->range_max() < id) ++base;
+  if (base == cell_ids_.data() + cell_ids_.size() || base->range_min() > id) {
+    return CacheResult::OUTSIDE;
+  }
+  return interior_[base - cell_ids_.data()] ? CacheResult::INSIDE
+                                           : CacheResult::BOUNDARY;
+}
+
+template <class IndexType>
+bool S2CachedContainsPointQuery<IndexType>::Contains(const S2Point& p) {
+  switch (LookupCache(p)) {
+    case CacheResult::OUTSIDE: return false;
+    case CacheResult::INSIDE: return true;
+    case CacheResult::BOUNDARY: break;
+  }
+  return query_.Contains(p);
+}
+
+template <class IndexType>
+size_t S2CachedContainsPointQuery<IndexType>::SpaceUsed() const {
+  return sizeof(*this) + cell_ids_.capacity() * sizeof(S2CellId) +
+         interior_.capacity() / 8;
+}
+
+#endif  // S2_S2CACHED_CONTAINS_POINT_QUERY_H_
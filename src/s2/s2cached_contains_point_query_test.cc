@@ -0,0 +1,154 @@
+// Copyright 2018 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "s2/s2cached_contains_point_query.h"
+
+#include <memory>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include "s2/third_party/absl/memory/memory.h"
+#include "s2/mutable_s2shape_index.h"
+#include "s2/s1angle.h"
+#include "s2/s2cap.h"
+#include "s2/s2loop.h"
+#include "s2/s2testing.h"
+#include "s2/s2text_format.h"
+
+using absl::make_unique;
+using s2textformat::MakeIndexOrDie;
+using s2textformat::MakePointOrDie;
+using std::vector;
+
+namespace {
+
+using Query = S2CachedContainsPointQuery<MutableS2ShapeIndex>;
+
+// Checks that S2CachedContainsPointQuery returns the same results as
+// S2ContainsPointQuery for all the given points, and that the cache alone
+// never gives a wrong answer.
+void CheckMatchesContainsPointQuery(const MutableS2ShapeIndex& index,
+                                    const Query::Options& options,
+                                    const vector<S2Point>& points) {
+  auto expected_query = MakeS2ContainsPointQuery(&index, options);
+  auto query = MakeS2CachedContainsPointQuery(&index, options);
+  for (const S2Point& p : points) {
+    bool expected = expected_query.Contains(p);
+    EXPECT_EQ(expected, query.Contains(p)) << p;
+    switch (query.LookupCache(p)) {
+      case Query::CacheResult::OUTSIDE: EXPECT_FALSE(expected) << p; break;
+      case Query::CacheResult::INSIDE: EXPECT_TRUE(expected) << p; break;
+      case Query::CacheResult::BOUNDARY: break;
+    }
+  }
+}
+
+// Returns the vertices of all shapes in the index together with some random
+// points near them and some random points near the index.
+vector<S2Point> GetTestPoints(const MutableS2ShapeIndex& index,
+                              const S2Cap& cap, int num_random) {
+  vector<S2Point> points;
+  for (int id = 0; id < index.num_shape_ids(); ++id) {
+    const S2Shape* shape = index.shape(id);
+    for (int e = 0; e < shape->num_edges(); ++e) {
+      S2Point v = shape->edge(e).v0;
+      points.push_back(v);
+      points.push_back(S2Testing::SamplePoint(S2Cap(v, S1Angle::Radians(1e-9))));
+    }
+  }
+  S2Cap expanded = cap.Expanded(S1Angle::Radians(cap.GetRadius().radians()));
+  for (int i = 0; i < num_random; ++i) {
+    points.push_back(S2Testing::SamplePoint(expanded));
+  }
+  return points;
+}
+
+TEST(S2CachedContainsPointQuery, EmptyIndex) {
+  MutableS2ShapeIndex index;
+  auto query = MakeS2CachedContainsPointQuery(&index);
+  EXPECT_EQ(0, query.num_cached_cells());
+  EXPECT_FALSE(query.Contains(MakePointOrDie("0:0")));
+}
+
+TEST(S2CachedContainsPointQuery, FullPolygon) {
+  auto index = MakeIndexOrDie("# # full");
+  auto query = MakeS2CachedContainsPointQuery(index.get());
+  EXPECT_EQ(Query::CacheResult::INSIDE,
+            query.LookupCache(MakePointOrDie("10:20")));
+  EXPECT_TRUE(query.Contains(MakePointOrDie("10:20")));
+}
+
+TEST(S2CachedContainsPointQuery, VertexModels) {
+  auto index = MakeIndexOrDie("0:0 # -1:1, 1:1 # 0:5, 0:7, 2:6");
+  vector<S2Point> points;
+  for (const char* str : {"0:0", "-1:1", "1:1", "0:2", "0:3", "0:5", "0:7",
+                          "2:6", "1:6", "10:10"}) {
+    points.push_back(MakePointOrDie(str));
+  }
+  for (auto model : {S2VertexModel::OPEN, S2VertexModel::SEMI_OPEN,
+                     S2VertexModel::CLOSED}) {
+    Query::Options options;
+    options.set_vertex_model(model);
+    CheckMatchesContainsPointQuery(*index, options, points);
+  }
+}
+
+TEST(S2CachedContainsPointQuery, FractalPolygons) {
+  S2Testing::Fractal fractal;
+  fractal.SetLevelForApproxMaxEdges(3 * 256);
+  for (int iter = 0; iter < 10; ++iter) {
+    S2Testing::rnd.Reset(iter + 1);
+    S2Cap cap(S2Testing::RandomPoint(),
+              S1Angle::Degrees(0.1 + 10 * S2Testing::rnd.RandDouble()));
+    MutableS2ShapeIndex index;
+    index.Add(make_unique<S2Loop::OwningShape>(
+        fractal.MakeLoop(S2Testing::GetRandomFrameAt(cap.center()),
+                         cap.GetRadius())));
+    vector<S2Point> points = GetTestPoints(index, cap, 1000);
+    for (int max_cells : {0, 1, 16, 256}) {
+      Query::Options options;
+      options.set_max_interior_cells(max_cells);
+      options.set_max_exterior_cells(max_cells);
+      CheckMatchesContainsPointQuery(index, options, points);
+    }
+  }
+}
+
+TEST(S2CachedContainsPointQuery, MostPointsAnsweredByCache) {
+  S2Testing::Fractal fractal;
+  fractal.SetLevelForApproxMaxEdges(3 * 64);
+  S2Cap cap(MakePointOrDie("10:10"), S1Angle::Degrees(5));
+  MutableS2ShapeIndex index;
+  index.Add(make_unique<S2Loop::OwningShape>(
+      fractal.MakeLoop(S2Testing::GetRandomFrameAt(cap.center()),
+                       cap.GetRadius())));
+  Query::Options options;
+  options.set_max_interior_cells(1000);
+  options.set_max_exterior_cells(1000);
+  auto query = MakeS2CachedContainsPointQuery(&index, options);
+  EXPECT_LE(query.num_cached_cells(), 3000);
+  EXPECT_GE(query.SpaceUsed(), query.num_cached_cells() * sizeof(S2CellId));
+
+  S2Cap expanded = cap.Expanded(cap.GetRadius());
+  int num_boundary = 0;
+  const int kNumPoints = 1000;
+  for (int i = 0; i < kNumPoints; ++i) {
+    S2Point p = S2Testing::SamplePoint(expanded);
+    if (query.LookupCache(p) == Query::CacheResult::BOUNDARY) ++num_boundary;
+  }
+  EXPECT_LT(num_boundary, kNumPoints / 10);
+}
+
+}  // namespace
@@ -211,6 +211,10 @@ class S2Cap final : public S2Region {
                     S1Angle max_error = S1Angle::Radians(1e-14)) const;
 
  private:
+  // S2RegionCoverer computes the cell vertices once and uses them for both
+  // the MayIntersect() and Contains() tests.
+  friend class S2RegionCoverer;
+
   // Here are some useful relationships between the cap height (h), the cap
   // radius (r), the maximum chord length from the cap's center (d), and the
   // radius of cap's base (a).
@@ -18,6 +18,7 @@
 #ifndef S2_S2CLOSEST_EDGE_QUERY_BASE_H_
 #define S2_S2CLOSEST_EDGE_QUERY_BASE_H_
 
+#include <algorithm>
 #include <memory>
 #include <vector>
 
@@ -65,7 +66,14 @@
 // used as long as it implements the Distance concept described in
 // s2distance_targets.h.  For example this can be used to measure maximum
 // distances, to get more accuracy, or to measure non-spheroidal distances.
-template <class Distance>
+//
+// The IndexType template argument is the type of S2ShapeIndex being queried.
+// The default (S2ShapeIndex) accepts any index type, while specifying a
+// concrete type such as MutableS2ShapeIndex or EncodedS2ShapeIndex allows
+// the index iterator methods (Seek, Locate, etc) to be called without
+// virtual dispatch.  Note that the Options and Result types of different
+// instantiations are distinct.
+template <class Distance, class IndexType = S2ShapeIndex>
 class S2ClosestEdgeQueryBase {
  public:
   using Delta = typename Distance::Delta;
@@ -230,7 +238,7 @@ class S2ClosestEdgeQueryBase {
   ~S2ClosestEdgeQueryBase();
 
   // Convenience constructor that calls Init().
-  explicit S2ClosestEdgeQueryBase(const S2ShapeIndex* index);
+  explicit S2ClosestEdgeQueryBase(const IndexType* index);
 
   // S2ClosestEdgeQueryBase is not copyable.
   S2ClosestEdgeQueryBase(const S2ClosestEdgeQueryBase&) = delete;
@@ -238,14 +246,14 @@ class S2ClosestEdgeQueryBase {
 
   // Initializes the query.
   // REQUIRES: ReInit() must be called if "index" is modified.
-  void Init(const S2ShapeIndex* index);
+  void Init(const IndexType* index);
 
   // Reinitializes the query.  This method must be called whenever the
   // underlying index is modified.
   void ReInit();
 
   // Returns a reference to the underlying S2ShapeIndex.
-  const S2ShapeIndex& index() const;
+  const IndexType& index() const;
 
   // Returns the closest edges to the given target that satisfy the given
   // options.  This method may be called multiple times.
@@ -272,6 +280,7 @@ class S2ClosestEdgeQueryBase {
   Result FindClosestEdge(Target* target, const Options& options);
 
  private:
+  using Iterator = typename IndexType::Iterator;
   class QueueEntry;
 
   const Options& options() const { return *options_; }
@@ -280,15 +289,14 @@ class S2ClosestEdgeQueryBase {
   void FindClosestEdgesOptimized();
   void InitQueue();
   void InitCovering();
-  void AddInitialRange(const S2ShapeIndex::Iterator& first,
-                       const S2ShapeIndex::Iterator& last);
+  void AddInitialRange(const Iterator& first, const Iterator& last);
   void MaybeAddResult(const S2Shape& shape, int edge_id);
   void AddResult(const Result& result);
   void ProcessEdges(const QueueEntry& entry);
   void ProcessOrEnqueue(S2CellId id);
   void ProcessOrEnqueue(S2CellId id, const S2ShapeIndexCell* index_cell);
 
-  const S2ShapeIndex* index_;
+  const IndexType* index_;
   const Options* options_;
   Target* target_;
 
@@ -397,7 +405,7 @@ class S2ClosestEdgeQueryBase {
 
   // Temporaries, defined here to avoid multiple allocations / initializations.
 
-  S2ShapeIndex::Iterator iter_;
+  Iterator iter_;
   std::vector<S2CellId> max_distance_covering_;
   std::vector<S2CellId> initial_cells_;
 };
@@ -406,94 +414,102 @@ class S2ClosestEdgeQueryBase {
 //////////////////   Implementation details follow   ////////////////////
 
 
-template <class Distance>
-inline S2ClosestEdgeQueryBase<Distance>::Options::Options() {
+template <class Distance, class IndexType>
+inline S2ClosestEdgeQueryBase<Distance, IndexType>::Options::Options() {
 }
 
-template <class Distance>
-inline int S2ClosestEdgeQueryBase<Distance>::Options::max_results() const {
+template <class Distance, class IndexType>
+inline int
+S2ClosestEdgeQueryBase<Distance, IndexType>::Options::max_results() const {
   return max_results_;
 }
 
-template <class Distance>
-inline void S2ClosestEdgeQueryBase<Distance>::Options::set_max_results(
+template <class Distance, class IndexType>
+inline void
+S2ClosestEdgeQueryBase<Distance, IndexType>::Options::set_max_results(
     int max_results) {
   S2_DCHECK_GE(max_results, 1);
   max_results_ = max_results;
 }
 
-template <class Distance>
-inline Distance S2ClosestEdgeQueryBase<Distance>::Options::max_distance()
-    const {
+template <class Distance, class IndexType>
+inline Distance
+S2ClosestEdgeQueryBase<Distance, IndexType>::Options::max_distance() const {
   return max_distance_;
 }
 
-template <class Distance>
-inline void S2ClosestEdgeQueryBase<Distance>::Options::set_max_distance(
+template <class Distance, class IndexType>
+inline void
+S2ClosestEdgeQueryBase<Distance, IndexType>::Options::set_max_distance(
     Distance max_distance) {
   max_distance_ = max_distance;
 }
 
-template <class Distance>
+template <class Distance, class IndexType>
 inline typename Distance::Delta
-S2ClosestEdgeQueryBase<Distance>::Options::max_error() const {
+S2ClosestEdgeQueryBase<Distance, IndexType>::Options::max_error() const {
   return max_error_;
 }
 
-template <class Distance>
-inline void S2ClosestEdgeQueryBase<Distance>::Options::set_max_error(
+template <class Distance, class IndexType>
+inline void S2ClosestEdgeQueryBase<Distance, IndexType>::Options::set_max_error(
     Delta max_error) {
   max_error_ = max_error;
 }
 
-template <class Distance>
-inline bool S2ClosestEdgeQueryBase<Distance>::Options::include_interiors()
+template <class Distance, class IndexType>
+inline bool
+S2ClosestEdgeQueryBase<Distance, IndexType>::Options::include_interiors()
     const {
   return include_interiors_;
 }
 
-template <class Distance>
-inline void S2ClosestEdgeQueryBase<Distance>::Options::set_include_interiors(
+template <class Distance, class IndexType>
+inline void
+S2ClosestEdgeQueryBase<Distance, IndexType>::Options::set_include_interiors(
     bool include_interiors) {
   include_interiors_ = include_interiors;
 }
 
-template <class Distance>
-inline bool S2ClosestEdgeQueryBase<Distance>::Options::use_brute_force() const {
+template <class Distance, class IndexType>
+inline bool
+S2ClosestEdgeQueryBase<Distance, IndexType>::Options::use_brute_force() const {
   return use_brute_force_;
 }
 
-template <class Distance>
-inline void S2ClosestEdgeQueryBase<Distance>::Options::set_use_brute_force(
+template <class Distance, class IndexType>
+inline void
+S2ClosestEdgeQueryBase<Distance, IndexType>::Options::set_use_brute_force(
     bool use_brute_force) {
   use_brute_force_ = use_brute_force;
 }
 
-template <class Distance>
-S2ClosestEdgeQueryBase<Distance>::S2ClosestEdgeQueryBase()
+template <class Distance, class IndexType>
+S2ClosestEdgeQueryBase<Distance, IndexType>::S2ClosestEdgeQueryBase()
     : tested_edges_(1) /* expected_max_elements*/ {
   tested_edges_.set_empty_key(ShapeEdgeId(-1, -1));
 }
 
-template <class Distance>
-S2ClosestEdgeQueryBase<Distance>::~S2ClosestEdgeQueryBase() {
+template <class Distance, class IndexType>
+S2ClosestEdgeQueryBase<Distance, IndexType>::~S2ClosestEdgeQueryBase() {
   // Prevent inline destructor bloat by providing a definition.
 }
 
-template <class Distance>
-inline S2ClosestEdgeQueryBase<Distance>::S2ClosestEdgeQueryBase(
-    const S2ShapeIndex* index) : S2ClosestEdgeQueryBase() {
+template <class Distance, class IndexType>
+inline S2ClosestEdgeQueryBase<Distance, IndexType>::S2ClosestEdgeQueryBase(
+    const IndexType* index) : S2ClosestEdgeQueryBase() {
   Init(index);
 }
 
-template <class Distance>
-void S2ClosestEdgeQueryBase<Distance>::Init(const S2ShapeIndex* index) {
+template <class Distance, class IndexType>
+void S2ClosestEdgeQueryBase<Distance, IndexType>::Init(
+    const IndexType* index) {
   index_ = index;
   ReInit();
 }
 
-template <class Distance>
-void S2ClosestEdgeQueryBase<Distance>::ReInit() {
+template <class Distance, class IndexType>
+void S2ClosestEdgeQueryBase<Distance, IndexType>::ReInit() {
   index_num_edges_ = 0;
   index_num_edges_limit_ = 0;
   index_covering_.clear();
@@ -502,31 +518,32 @@ void S2ClosestEdgeQueryBase<Distance>::ReInit() {
   // faster (i.e., where brute force is used).
 }
 
-template <class Distance>
-inline const S2ShapeIndex& S2ClosestEdgeQueryBase<Distance>::index() const {
+template <class Distance, class IndexType>
+inline const IndexType& S2ClosestEdgeQueryBase<Distance, IndexType>::index()
+    const {
   return *index_;
 }
 
-template <class Distance>
-inline std::vector<typename S2ClosestEdgeQueryBase<Distance>::Result>
-S2ClosestEdgeQueryBase<Distance>::FindClosestEdges(Target* target,
+template <class Distance, class IndexType>
+inline std::vector<typename S2ClosestEdgeQueryBase<Distance, IndexType>::Result>
+S2ClosestEdgeQueryBase<Distance, IndexType>::FindClosestEdges(Target* target,
                                                    const Options& options) {
   std::vector<Result> results;
   FindClosestEdges(target, options, &results);
   return results;
 }
 
-template <class Distance>
-typename S2ClosestEdgeQueryBase<Distance>::Result
-S2ClosestEdgeQueryBase<Distance>::FindClosestEdge(Target* target,
+template <class Distance, class IndexType>
+typename S2ClosestEdgeQueryBase<Distance, IndexType>::Result
+S2ClosestEdgeQueryBase<Distance, IndexType>::FindClosestEdge(Target* target,
                                                   const Options& options) {
   S2_DCHECK_EQ(options.max_results(), 1);
   FindClosestEdgesInternal(target, options);
   return result_singleton_;
 }
 
-template <class Distance>
-void S2ClosestEdgeQueryBase<Distance>::FindClosestEdges(
+template <class Distance, class IndexType>
+void S2ClosestEdgeQueryBase<Distance, IndexType>::FindClosestEdges(
     Target* target, const Options& options,
     std::vector<Result>* results) {
   FindClosestEdgesInternal(target, options);
@@ -546,8 +563,8 @@ void S2ClosestEdgeQueryBase<Distance>::FindClosestEdges(
   }
 }
 
-template <class Distance>
-void S2ClosestEdgeQueryBase<Distance>::FindClosestEdgesInternal(
+template <class Distance, class IndexType>
+void S2ClosestEdgeQueryBase<Distance, IndexType>::FindClosestEdgesInternal(
     Target* target, const Options& options) {
   target_ = target;
   options_ = &options;
@@ -633,19 +650,33 @@ void S2ClosestEdgeQueryBase<Distance>::FindClosestEdgesInternal(
   }
 }
 
-template <class Distance>
-void S2ClosestEdgeQueryBase<Distance>::FindClosestEdgesBruteForce() {
-  for (S2Shape* shape : *index_) {
+template <class Distance, class IndexType>
+void S2ClosestEdgeQueryBase<Distance, IndexType>::FindClosestEdgesBruteForce() {
+  // Since each edge is considered exactly once, there is no need to check
+  // for duplicates (see MaybeAddResult).  Edges are retrieved in small
+  // batches to avoid a virtual call per edge.
+  static const int kEdgeBatchSize = 64;
+  S2Shape::Edge edges[kEdgeBatchSize];
+  int num_shape_ids = index_->num_shape_ids();
+  for (int id = 0; id < num_shape_ids; ++id) {
+    const S2Shape* shape = index_->shape(id);
     if (shape == nullptr) continue;
     int num_edges = shape->num_edges();
-    for (int e = 0; e < num_edges; ++e) {
-      MaybeAddResult(*shape, e);
+    for (int start = 0; start < num_edges; start += kEdgeBatchSize) {
+      int n = std::min(kEdgeBatchSize, num_edges - start);
+      shape->GetEdges(start, n, edges);
+      for (int i = 0; i < n; ++i) {
+        Distance distance = distance_limit_;
+        if (target_->UpdateMinDistance(edges[i].v0, edges[i].v1, &distance)) {
+          AddResult(Result(distance, shape->id(), start + i));
+        }
+      }
     }
   }
 }
 
-template <class Distance>
-void S2ClosestEdgeQueryBase<Distance>::FindClosestEdgesOptimized() {
+template <class Distance, class IndexType>
+void S2ClosestEdgeQueryBase<Distance, IndexType>::FindClosestEdgesOptimized() {
   InitQueue();
   // Repeatedly find the closest S2Cell to "target" and either split it into
   // its four children or process all of its edges.
@@ -688,8 +719,8 @@ void S2ClosestEdgeQueryBase<Distance>::FindClosestEdgesOptimized() {
   }
 }
 
-template <class Distance>
-void S2ClosestEdgeQueryBase<Distance>::InitQueue() {
+template <class Distance, class IndexType>
+void S2ClosestEdgeQueryBase<Distance, IndexType>::InitQueue() {
   S2_DCHECK(queue_.empty());
   if (index_covering_.empty()) {
     // We delay iterator initialization until now to make queries on very
@@ -765,8 +796,8 @@ void S2ClosestEdgeQueryBase<Distance>::InitQueue() {
   }
 }
 
-template <class Distance>
-void S2ClosestEdgeQueryBase<Distance>::InitCovering() {
+template <class Distance, class IndexType>
+void S2ClosestEdgeQueryBase<Distance, IndexType>::InitCovering() {
   // Find the range of S2Cells spanned by the index and choose a level such
   // that the entire index can be covered with just a few cells.  These are
   // the "top-level" cells.  There are two cases:
@@ -789,8 +820,8 @@ void S2ClosestEdgeQueryBase<Distance>::InitCovering() {
 
   // TODO(ericv): Use a single iterator (iter_) below and save position
   // information using pair<S2CellId, const S2ShapeIndexCell*> type.
-  S2ShapeIndex::Iterator next(index_, S2ShapeIndex::BEGIN);
-  S2ShapeIndex::Iterator last(index_, S2ShapeIndex::END);
+  Iterator next(index_, S2ShapeIndex::BEGIN);
+  Iterator last(index_, S2ShapeIndex::END);
   last.Prev();
   if (next.id() != last.id()) {
     // The index has at least two cells.  Choose a level such that the entire
@@ -806,9 +837,9 @@ void S2ClosestEdgeQueryBase<Distance>::InitCovering() {
 
       // Find the range of index cells contained by this top-level cell and
       // then shrink the cell if necessary so that it just covers them.
-      S2ShapeIndex::Iterator cell_first = next;
+      Iterator cell_first = next;
       next.Seek(id.range_max().next());
-      S2ShapeIndex::Iterator cell_last = next;
+      Iterator cell_last = next;
       cell_last.Prev();
       AddInitialRange(cell_first, cell_last);
     }
@@ -820,10 +851,9 @@ void S2ClosestEdgeQueryBase<Distance>::InitCovering() {
 // inclusive range of cells.
 //
 // REQUIRES: "first" and "last" have a common ancestor.
-template <class Distance>
-void S2ClosestEdgeQueryBase<Distance>::AddInitialRange(
-    const S2ShapeIndex::Iterator& first,
-    const S2ShapeIndex::Iterator& last) {
+template <class Distance, class IndexType>
+void S2ClosestEdgeQueryBase<Distance, IndexType>::AddInitialRange(
+    const Iterator& first, const Iterator& last) {
   if (first.id() == last.id()) {
     // The range consists of a single index cell.
     index_covering_.push_back(first.id());
@@ -837,8 +867,8 @@ void S2ClosestEdgeQueryBase<Distance>::AddInitialRange(
   }
 }
 
-template <class Distance>
-void S2ClosestEdgeQueryBase<Distance>::MaybeAddResult(
+template <class Distance, class IndexType>
+void S2ClosestEdgeQueryBase<Distance, IndexType>::MaybeAddResult(
     const S2Shape& shape, int edge_id) {
   if (avoid_duplicates_ &&
       !tested_edges_.insert(ShapeEdgeId(shape.id(), edge_id)).second) {
@@ -851,8 +881,9 @@ void S2ClosestEdgeQueryBase<Distance>::MaybeAddResult(
   }
 }
 
-template <class Distance>
-void S2ClosestEdgeQueryBase<Distance>::AddResult(const Result& result) {
+template <class Distance, class IndexType>
+void S2ClosestEdgeQueryBase<Distance, IndexType>::AddResult(
+    const Result& result) {
   if (options().max_results() == 1) {
     // Optimization for the common case where only the closest edge is wanted.
     result_singleton_ = result;
@@ -885,8 +916,9 @@ inline static int CountEdges(const S2ShapeIndexCell* cell) {
 }
 
 // Process all the edges of the given index cell.
-template <class Distance>
-void S2ClosestEdgeQueryBase<Distance>::ProcessEdges(const QueueEntry& entry) {
+template <class Distance, class IndexType>
+void S2ClosestEdgeQueryBase<Distance, IndexType>::ProcessEdges(
+    const QueueEntry& entry) {
   const S2ShapeIndexCell* index_cell = entry.index_cell;
   for (int s = 0; s < index_cell->num_clipped(); ++s) {
     const S2ClippedShape& clipped = index_cell->clipped(s);
@@ -899,8 +931,8 @@ void S2ClosestEdgeQueryBase<Distance>::ProcessEdges(const QueueEntry& entry) {
 
 // Enqueue the given cell id.
 // REQUIRES: iter_ is positioned at a cell contained by "id".
-template <class Distance>
-inline void S2ClosestEdgeQueryBase<Distance>::ProcessOrEnqueue(
+template <class Distance, class IndexType>
+inline void S2ClosestEdgeQueryBase<Distance, IndexType>::ProcessOrEnqueue(
     S2CellId id) {
   S2_DCHECK(id.contains(iter_.id()));
   if (iter_.id() == id) {
@@ -914,8 +946,8 @@ inline void S2ClosestEdgeQueryBase<Distance>::ProcessOrEnqueue(
 // S2ShapeIndexCell, or nullptr if "id" is not an index cell.
 //
 // This version is called directly only by InitQueue().
-template <class Distance>
-void S2ClosestEdgeQueryBase<Distance>::ProcessOrEnqueue(
+template <class Distance, class IndexType>
+void S2ClosestEdgeQueryBase<Distance, IndexType>::ProcessOrEnqueue(
     S2CellId id, const S2ShapeIndexCell* index_cell) {
   if (index_cell) {
     // If this index cell has only a few edges, then it is faster to check
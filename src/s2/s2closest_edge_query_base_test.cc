@@ -20,11 +20,26 @@
 
 #include "s2/s2closest_edge_query_base.h"
 
+#include <utility>
+#include <vector>
+
 #include <gtest/gtest.h>
+#include "s2/third_party/absl/memory/memory.h"
+#include "s2/encoded_s2shape_index.h"
 #include "s2/mutable_s2shape_index.h"
+#include "s2/s1angle.h"
+#include "s2/s2lax_polygon_shape.h"
+#include "s2/s2loop.h"
 #include "s2/s2max_distance_targets.h"
+#include "s2/s2min_distance_targets.h"
+#include "s2/s2polygon.h"
+#include "s2/s2shapeutil_coding.h"
+#include "s2/s2testing.h"
 #include "s2/s2text_format.h"
 
+using absl::make_unique;
+using std::vector;
+
 namespace {
 
 // This is a proof-of-concept prototype of a possible S2FurthestEdgeQuery
@@ -56,4 +71,47 @@ TEST(S2ClosestEdgeQueryBase, MaxDistance) {
               1e-13);
 }
 
+// Returns the results of querying "index" for the edges closest to "target",
+// using an S2ClosestEdgeQueryBase instantiated with the given index type.
+template <class IndexType>
+vector<std::pair<int, int>> GetClosestEdges(const IndexType& index,
+                                            const S2Point& target_point) {
+  using Query = S2ClosestEdgeQueryBase<S2MinDistance, IndexType>;
+  Query query(&index);
+  typename Query::Options options;
+  options.set_max_results(5);
+  S2MinDistancePointTarget target(target_point);
+  vector<std::pair<int, int>> results;
+  for (const auto& result : query.FindClosestEdges(&target, options)) {
+    results.emplace_back(result.shape_id(), result.edge_id());
+  }
+  return results;
+}
+
+TEST(S2ClosestEdgeQueryBase, ConcreteIndexTypes) {
+  // Check that queries templated on MutableS2ShapeIndex and
+  // EncodedS2ShapeIndex give the same results as the generic version.
+  MutableS2ShapeIndex index;
+  for (int i = 0; i < 5; ++i) {
+    auto loop = S2Loop::MakeRegularLoop(
+        S2Testing::RandomPoint(), S1Angle::Degrees(10), 200);
+    index.Add(make_unique<S2LaxPolygonShape>(S2Polygon(std::move(loop))));
+  }
+  Encoder encoder;
+  ASSERT_TRUE(s2shapeutil::CompactEncodeTaggedShapes(index, &encoder));
+  index.Encode(&encoder);
+  Decoder decoder(encoder.base(), encoder.length());
+  EncodedS2ShapeIndex encoded_index;
+  ASSERT_TRUE(encoded_index.Init(
+      &decoder, s2shapeutil::LazyDecodeShapeFactory(&decoder)));
+
+  for (int iter = 0; iter < 20; ++iter) {
+    S2Point target = S2Testing::RandomPoint();
+    auto expected = GetClosestEdges<S2ShapeIndex>(index, target);
+    EXPECT_EQ(5, expected.size());
+    EXPECT_EQ(expected, GetClosestEdges(index, target));
+    EXPECT_EQ(expected, GetClosestEdges(encoded_index, target));
+  }
+}
+
 }  // namespace
@@ -18,16 +18,25 @@
 #ifndef S2_S2CROSSING_EDGE_QUERY_H_
 #define S2_S2CROSSING_EDGE_QUERY_H_
 
+#include <algorithm>
+#include <functional>
 #include <type_traits>
 #include <vector>
 
+#include "s2/base/logging.h"
 #include "s2/third_party/absl/base/macros.h"
 #include "s2/third_party/absl/container/inlined_vector.h"
 #include "s2/_fp_contract_off.h"
+#include "s2/mutable_s2shape_index.h"
+#include "s2/r1interval.h"
 #include "s2/r2.h"
 #include "s2/r2rect.h"
+#include "s2/s2cell_id.h"
+#include "s2/s2edge_clipping.h"
+#include "s2/s2edge_crosser.h"
 #include "s2/s2padded_cell.h"
 #include "s2/s2shape_index.h"
+#include "s2/s2shapeutil_count_edges.h"
 #include "s2/s2shapeutil_shape_edge.h"
 #include "s2/s2shapeutil_shape_edge_id.h"
 
@@ -62,26 +71,38 @@ enum class CrossingType { INTERIOR, ALL };
 // a single S2CrossingEdgeQuery object and reuse it so that temporary storage
 // does not need to be reallocated each time.
 //
+// S2CrossingEdgeQuery accepts any S2ShapeIndex type and accesses it through
+// virtual methods.  If the index type is known at compile time, you can
+// avoid this overhead by using S2CrossingEdgeQueryBase instead, which has
+// the same API (see below):
+//
+//   S2CrossingEdgeQueryBase<MutableS2ShapeIndex> query(&index);
+//
 // If you want to find *all* pairs of crossing edges, use
 // s2shapeutil::VisitCrossingEdgePairs() instead.
-class S2CrossingEdgeQuery {
+//
+// S2CrossingEdgeQueryBase is templated on the S2ShapeIndex type so that the
+// index iterator methods (Seek, Locate, etc) are not virtual calls when a
+// concrete index type such as MutableS2ShapeIndex or EncodedS2ShapeIndex is
+// used.  Most clients should use S2CrossingEdgeQuery instead.
+template <class IndexType>
+class S2CrossingEdgeQueryBase {
  public:
   using CrossingType = s2shapeutil::CrossingType;  // Defined above.
 
   // Convenience constructor that calls Init().
-  explicit S2CrossingEdgeQuery(const S2ShapeIndex* index);
+  explicit S2CrossingEdgeQueryBase(const IndexType* index);
 
   // Default constructor; requires Init() to be called.
-  S2CrossingEdgeQuery();
-  ~S2CrossingEdgeQuery();
+  S2CrossingEdgeQueryBase();
 
-  S2CrossingEdgeQuery(const S2CrossingEdgeQuery&) = delete;
-  void operator=(const S2CrossingEdgeQuery&) = delete;
+  S2CrossingEdgeQueryBase(const S2CrossingEdgeQueryBase&) = delete;
+  void operator=(const S2CrossingEdgeQueryBase&) = delete;
 
-  const S2ShapeIndex& index() const { return *index_; }
+  const IndexType& index() const { return *index_; }
 
   // REQUIRES: "index" is not modified after this method is called.
-  void Init(const S2ShapeIndex* index);
+  void Init(const IndexType* index);
 
   // Returns all edges that intersect the given query edge (a0,a1) and that
   // have the given CrossingType (ALL or INTERIOR).  Edges are sorted and
@@ -179,6 +200,12 @@ class S2CrossingEdgeQuery {
                 std::vector<const S2ShapeIndexCell*>* cells);
 
  private:
+  using Iterator = typename IndexType::Iterator;
+
+  // For small loops it is faster to use brute force.  The threshold below was
+  // determined using the benchmarks in the unit test.
+  static constexpr int kMaxBruteForceEdges = 27;
+
   // Internal methods are documented with their definitions.
   bool VisitCells(const S2PaddedCell& pcell, const R2Rect& edge_bound);
   bool ClipVAxis(const R2Rect& edge_bound, double center, int i,
@@ -190,24 +217,411 @@ class S2CrossingEdgeQuery {
   static void SplitBound(const R2Rect& edge_bound, int u_end, double u,
                          int v_end, double v, R2Rect child_bounds[2]);
 
-  const S2ShapeIndex* index_ = nullptr;
+  const IndexType* index_ = nullptr;
 
   //////////// Temporary storage used while processing a query ///////////
 
   R2Point a0_, a1_;
-  S2ShapeIndex::Iterator iter_;
+  Iterator iter_;
   const CellVisitor* visitor_;
 
   // Avoids repeated allocation when methods are called many times.
   std::vector<s2shapeutil::ShapeEdgeId> tmp_candidates_;
 };
 
+// The version of S2CrossingEdgeQueryBase that accepts any S2ShapeIndex type
+// (see comments at the top of this file).
+class S2CrossingEdgeQuery : public S2CrossingEdgeQueryBase<S2ShapeIndex> {
+ public:
+  // Convenience constructor that calls Init().
+  explicit S2CrossingEdgeQuery(const S2ShapeIndex* index);
+
+  // Default constructor; requires Init() to be called.
+  S2CrossingEdgeQuery();
+  ~S2CrossingEdgeQuery();
+};
+
 
 //////////////////   Implementation details follow   ////////////////////
 
 
-inline S2CrossingEdgeQuery::S2CrossingEdgeQuery(const S2ShapeIndex* index) {
+inline S2CrossingEdgeQuery::S2CrossingEdgeQuery(const S2ShapeIndex* index)
+    : S2CrossingEdgeQueryBase<S2ShapeIndex>(index) {
+}
+
+template <class IndexType>
+constexpr int S2CrossingEdgeQueryBase<IndexType>::kMaxBruteForceEdges;
+
+template <class IndexType>
+inline S2CrossingEdgeQueryBase<IndexType>::S2CrossingEdgeQueryBase(
+    const IndexType* index) {
   Init(index);
 }
 
+template <class IndexType>
+inline S2CrossingEdgeQueryBase<IndexType>::S2CrossingEdgeQueryBase() {
+}
+
+template <class IndexType>
+void S2CrossingEdgeQueryBase<IndexType>::Init(const IndexType* index) {
+  index_ = index;
+  iter_.Init(index);
+}
+
+template <class IndexType>
+std::vector<s2shapeutil::ShapeEdge>
+S2CrossingEdgeQueryBase<IndexType>::GetCrossingEdges(
+    const S2Point& a0, const S2Point& a1, CrossingType type) {
+  std::vector<s2shapeutil::ShapeEdge> edges;
+  GetCrossingEdges(a0, a1, type, &edges);
+  return edges;
+}
+
+template <class IndexType>
+std::vector<s2shapeutil::ShapeEdge>
+S2CrossingEdgeQueryBase<IndexType>::GetCrossingEdges(
+    const S2Point& a0, const S2Point& a1, const S2Shape& shape,
+    CrossingType type) {
+  std::vector<s2shapeutil::ShapeEdge> edges;
+  GetCrossingEdges(a0, a1, shape, type, &edges);
+  return edges;
+}
+
+template <class IndexType>
+void S2CrossingEdgeQueryBase<IndexType>::GetCrossingEdges(
+    const S2Point& a0, const S2Point& a1, CrossingType type,
+    std::vector<s2shapeutil::ShapeEdge>* edges) {
+  edges->clear();
+  GetCandidates(a0, a1, &tmp_candidates_);
+  int min_sign = (type == CrossingType::ALL) ? 0 : 1;
+  S2CopyingEdgeCrosser crosser(a0, a1);
+  int shape_id = -1;
+  const S2Shape* shape = nullptr;
+  for (s2shapeutil::ShapeEdgeId candidate : tmp_candidates_) {
+    if (candidate.shape_id != shape_id) {
+      shape_id = candidate.shape_id;
+      shape = index_->shape(shape_id);
+    }
+    int edge_id = candidate.edge_id;
+    S2Shape::Edge b = shape->edge(edge_id);
+    if (crosser.CrossingSign(b.v0, b.v1) >= min_sign) {
+      edges->push_back(s2shapeutil::ShapeEdge(shape_id, edge_id, b));
+    }
+  }
+}
+
+template <class IndexType>
+void S2CrossingEdgeQueryBase<IndexType>::GetCrossingEdges(
+    const S2Point& a0, const S2Point& a1, const S2Shape& shape,
+    CrossingType type, std::vector<s2shapeutil::ShapeEdge>* edges) {
+  edges->clear();
+  GetCandidates(a0, a1, shape, &tmp_candidates_);
+  int min_sign = (type == CrossingType::ALL) ? 0 : 1;
+  S2CopyingEdgeCrosser crosser(a0, a1);
+  for (s2shapeutil::ShapeEdgeId candidate : tmp_candidates_) {
+    int edge_id = candidate.edge_id;
+    S2Shape::Edge b = shape.edge(edge_id);
+    if (crosser.CrossingSign(b.v0, b.v1) >= min_sign) {
+      edges->push_back(s2shapeutil::ShapeEdge(shape.id(), edge_id, b));
+    }
+  }
+}
+
+template <class IndexType>
+std::vector<s2shapeutil::ShapeEdgeId>
+S2CrossingEdgeQueryBase<IndexType>::GetCandidates(const S2Point& a0,
+                                                  const S2Point& a1) {
+  std::vector<s2shapeutil::ShapeEdgeId> edges;
+  GetCandidates(a0, a1, &edges);
+  return edges;
+}
+
+template <class IndexType>
+std::vector<s2shapeutil::ShapeEdgeId>
+S2CrossingEdgeQueryBase<IndexType>::GetCandidates(const S2Point& a0,
+                                                  const S2Point& a1,
+                                                  const S2Shape& shape) {
+  std::vector<s2shapeutil::ShapeEdgeId> edges;
+  GetCandidates(a0, a1, shape, &edges);
+  return edges;
+}
+
+template <class IndexType>
+void S2CrossingEdgeQueryBase<IndexType>::GetCandidates(
+    const S2Point& a0, const S2Point& a1,
+    std::vector<s2shapeutil::ShapeEdgeId>* edges) {
+  edges->clear();
+  int num_edges = s2shapeutil::CountEdgesUpTo(*index_, kMaxBruteForceEdges + 1);
+  if (num_edges <= kMaxBruteForceEdges) {
+    edges->reserve(num_edges);
+  }
+  VisitRawCandidates(a0, a1, [edges](s2shapeutil::ShapeEdgeId id) {
+      edges->push_back(id);
+      return true;
+    });
+  if (edges->size() > 1) {
+    std::sort(edges->begin(), edges->end());
+    edges->erase(std::unique(edges->begin(), edges->end()), edges->end());
+  }
+}
+
+template <class IndexType>
+void S2CrossingEdgeQueryBase<IndexType>::GetCandidates(
+    const S2Point& a0, const S2Point& a1, const S2Shape& shape,
+    std::vector<s2shapeutil::ShapeEdgeId>* edges) {
+  edges->clear();
+  int num_edges = shape.num_edges();
+  if (num_edges <= kMaxBruteForceEdges) {
+    edges->reserve(num_edges);
+  }
+  VisitRawCandidates(a0, a1, shape, [edges](s2shapeutil::ShapeEdgeId id) {
+      edges->push_back(id);
+      return true;
+    });
+  if (edges->size() > 1) {
+    std::sort(edges->begin(), edges->end());
+    edges->erase(std::unique(edges->begin(), edges->end()), edges->end());
+  }
+}
+
+template <class IndexType>
+bool S2CrossingEdgeQueryBase<IndexType>::VisitRawCandidates(
+    const S2Point& a0, const S2Point& a1, const ShapeEdgeIdVisitor& visitor) {
+  int num_edges = s2shapeutil::CountEdgesUpTo(*index_, kMaxBruteForceEdges + 1);
+  if (num_edges <= kMaxBruteForceEdges) {
+    int num_shape_ids = index_->num_shape_ids();
+    for (int s = 0; s < num_shape_ids; ++s) {
+      const S2Shape* shape = index_->shape(s);
+      if (shape == nullptr) continue;
+      int num_shape_edges = shape->num_edges();
+      for (int e = 0; e < num_shape_edges; ++e) {
+        if (!visitor(s2shapeutil::ShapeEdgeId(s, e))) return false;
+      }
+    }
+    return true;
+  }
+  return VisitCells(a0, a1, [&visitor](const S2ShapeIndexCell& cell) {
+      for (int s = 0; s < cell.num_clipped(); ++s) {
+        const S2ClippedShape& clipped = cell.clipped(s);
+        for (int j = 0; j < clipped.num_edges(); ++j) {
+          if (!visitor(s2shapeutil::ShapeEdgeId(clipped.shape_id(),
+                                                clipped.edge(j)))) {
+            return false;
+          }
+        }
+      }
+      return true;
+    });
+}
+
+template <class IndexType>
+bool S2CrossingEdgeQueryBase<IndexType>::VisitRawCandidates(
+    const S2Point& a0, const S2Point& a1, const S2Shape& shape,
+    const ShapeEdgeIdVisitor& visitor) {
+  int num_edges = shape.num_edges();
+  if (num_edges <= kMaxBruteForceEdges) {
+    for (int e = 0; e < num_edges; ++e) {
+      if (!visitor(s2shapeutil::ShapeEdgeId(shape.id(), e))) return false;
+    }
+    return true;
+  }
+  return VisitCells(a0, a1, [&shape, &visitor](const S2ShapeIndexCell& cell) {
+      const S2ClippedShape* clipped = cell.find_clipped(shape.id());
+      if (clipped == nullptr) return true;
+      for (int j = 0; j < clipped->num_edges(); ++j) {
+        if (!visitor(s2shapeutil::ShapeEdgeId(shape.id(), clipped->edge(j)))) {
+          return false;
+        }
+      }
+      return true;
+    });
+}
+
+template <class IndexType>
+bool S2CrossingEdgeQueryBase<IndexType>::VisitCells(
+    const S2Point& a0, const S2Point& a1, const CellVisitor& visitor) {
+  visitor_ = &visitor;
+  S2::FaceSegmentVector segments;
+  S2::GetFaceSegments(a0, a1, &segments);
+  for (const auto& segment : segments) {
+    a0_ = segment.a;
+    a1_ = segment.b;
+
+    // Optimization: rather than always starting the recursive subdivision at
+    // the top level face cell, instead we start at the smallest S2CellId that
+    // contains the edge (the "edge root cell").  This typically lets us skip
+    // quite a few levels of recursion since most edges are short.
+    R2Rect edge_bound = R2Rect::FromPointPair(a0_, a1_);
+    S2PaddedCell pcell(S2CellId::FromFace(segment.face), 0);
+    S2CellId edge_root = pcell.ShrinkToFit(edge_bound);
+
+    // Now we need to determine how the edge root cell is related to the cells
+    // in the spatial index (cell_map_).  There are three cases:
+    //
+    //  1. edge_root is an index cell or is contained within an index cell.
+    //     In this case we only need to look at the contents of that cell.
+    //  2. edge_root is subdivided into one or more index cells.  In this case
+    //     we recursively subdivide to find the cells intersected by a0a1.
+    //  3. edge_root does not intersect any index cells.  In this case there
+    //     is nothing to do.
+    S2ShapeIndex::CellRelation relation = iter_.Locate(edge_root);
+    if (relation == S2ShapeIndex::INDEXED) {
+      // edge_root is an index cell or is contained by an index cell (case 1).
+      S2_DCHECK(iter_.id().contains(edge_root));
+      if (!visitor(iter_.cell())) return false;
+    } else if (relation == S2ShapeIndex::SUBDIVIDED) {
+      // edge_root is subdivided into one or more index cells (case 2).  We
+      // find the cells intersected by a0a1 using recursive subdivision.
+      if (!edge_root.is_face()) pcell = S2PaddedCell(edge_root, 0);
+      if (!VisitCells(pcell, edge_bound)) return false;
+    }
+  }
+  return true;
+}
+
+template <class IndexType>
+bool S2CrossingEdgeQueryBase<IndexType>::VisitCells(
+    const S2Point& a0, const S2Point& a1, const S2PaddedCell& root,
+    const CellVisitor& visitor) {
+  visitor_ = &visitor;
+  if (S2::ClipToFace(a0, a1, root.id().face(), &a0_, &a1_)) {
+    R2Rect edge_bound = R2Rect::FromPointPair(a0_, a1_);
+    if (root.bound().Intersects(edge_bound)) {
+      return VisitCells(root, edge_bound);
+    }
+  }
+  return true;
+}
+
+// Computes the index cells intersected by the current edge that are
+// descendants of "pcell" and calls visitor_ for each one.
+//
+// WARNING: This function is recursive with a maximum depth of 30.  The frame
+// size is about 2K in versions of GCC prior to 4.7 due to poor overlapping
+// of storage for temporaries.  This is fixed in GCC 4.7, reducing the frame
+// size to about 350 bytes (i.e., worst-case total stack usage of about 10K).
+template <class IndexType>
+bool S2CrossingEdgeQueryBase<IndexType>::VisitCells(const S2PaddedCell& pcell,
+                                                    const R2Rect& edge_bound) {
+  iter_.Seek(pcell.id().range_min());
+  if (iter_.done() || iter_.id() > pcell.id().range_max()) {
+    // The index does not contain "pcell" or any of its descendants.
+    return true;
+  }
+  if (iter_.id() == pcell.id()) {
+    return (*visitor_)(iter_.cell());
+  }
+
+  // Otherwise, split the edge among the four children of "pcell".
+  R2Point center = pcell.middle().lo();
+  if (edge_bound[0].hi() < center[0]) {
+    // Edge is entirely contained in the two left children.
+    return ClipVAxis(edge_bound, center[1], 0, pcell);
+  } else if (edge_bound[0].lo() >= center[0]) {
+    // Edge is entirely contained in the two right children.
+    return ClipVAxis(edge_bound, center[1], 1, pcell);
+  } else {
+    R2Rect child_bounds[2];
+    SplitUBound(edge_bound, center[0], child_bounds);
+    if (edge_bound[1].hi() < center[1]) {
+      // Edge is entirely contained in the two lower children.
+      return (VisitCells(S2PaddedCell(pcell, 0, 0), child_bounds[0]) &&
+              VisitCells(S2PaddedCell(pcell, 1, 0), child_bounds[1]));
+    } else if (edge_bound[1].lo() >= center[1]) {
+      // Edge is entirely contained in the two upper children.
+      return (VisitCells(S2PaddedCell(pcell, 0, 1), child_bounds[0]) &&
+              VisitCells(S2PaddedCell(pcell, 1, 1), child_bounds[1]));
+    } else {
+      // The edge bound spans all four children.  The edge itself intersects
+      // at most three children (since no padding is being used).
+      return (ClipVAxis(child_bounds[0], center[1], 0, pcell) &&
+              ClipVAxis(child_bounds[1], center[1], 1, pcell));
+    }
+  }
+}
+
+// Given either the left (i=0) or right (i=1) side of a padded cell "pcell",
+// determine whether the current edge intersects the lower child, upper child,
+// or both children, and call VisitCells() recursively on those children.
+// "center" is the v-coordinate at the center of "pcell".
+template <class IndexType>
+inline bool S2CrossingEdgeQueryBase<IndexType>::ClipVAxis(
+    const R2Rect& edge_bound, double center, int i,
+    const S2PaddedCell& pcell) {
+  if (edge_bound[1].hi() < center) {
+    // Edge is entirely contained in the lower child.
+    return VisitCells(S2PaddedCell(pcell, i, 0), edge_bound);
+  } else if (edge_bound[1].lo() >= center) {
+    // Edge is entirely contained in the upper child.
+    return VisitCells(S2PaddedCell(pcell, i, 1), edge_bound);
+  } else {
+    // The edge intersects both children.
+    R2Rect child_bounds[2];
+    SplitVBound(edge_bound, center, child_bounds);
+    return (VisitCells(S2PaddedCell(pcell, i, 0), child_bounds[0]) &&
+            VisitCells(S2PaddedCell(pcell, i, 1), child_bounds[1]));
+  }
+}
+
+// Split the current edge into two child edges at the given u-value "u" and
+// return the bound for each child.
+template <class IndexType>
+void S2CrossingEdgeQueryBase<IndexType>::SplitUBound(
+    const R2Rect& edge_bound, double u, R2Rect child_bounds[2]) const {
+  // See comments in MutableS2ShapeIndex::ClipUBound.
+  double v = edge_bound[1].Project(
+      S2::InterpolateDouble(u, a0_[0], a1_[0], a0_[1], a1_[1]));
+
+  // "diag_" indicates which diagonal of the bounding box is spanned by a0a1:
+  // it is 0 if a0a1 has positive slope, and 1 if a0a1 has negative slope.
+  int diag = (a0_[0] > a1_[0]) != (a0_[1] > a1_[1]);
+  SplitBound(edge_bound, 0, u, diag, v, child_bounds);
+}
+
+// Split the current edge into two child edges at the given v-value "v" and
+// return the bound for each child.
+template <class IndexType>
+void S2CrossingEdgeQueryBase<IndexType>::SplitVBound(
+    const R2Rect& edge_bound, double v, R2Rect child_bounds[2]) const {
+  double u = edge_bound[0].Project(
+      S2::InterpolateDouble(v, a0_[1], a1_[1], a0_[0], a1_[0]));
+  int diag = (a0_[0] > a1_[0]) != (a0_[1] > a1_[1]);
+  SplitBound(edge_bound, diag, u, 0, v, child_bounds);
+}
+
+// Split the current edge into two child edges at the given point (u,v) and
+// return the bound for each child.  "u_end" and "v_end" indicate which bound
+// endpoints of child 1 will be updated.
+template <class IndexType>
+inline void S2CrossingEdgeQueryBase<IndexType>::SplitBound(
+    const R2Rect& edge_bound, int u_end, double u, int v_end, double v,
+    R2Rect child_bounds[2]) {
+  child_bounds[0] = edge_bound;
+  child_bounds[0][0][1 - u_end] = u;
+  child_bounds[0][1][1 - v_end] = v;
+  S2_DCHECK(!child_bounds[0].is_empty());
+  S2_DCHECK(edge_bound.Contains(child_bounds[0]));
+
+  child_bounds[1] = edge_bound;
+  child_bounds[1][0][u_end] = u;
+  child_bounds[1][1][v_end] = v;
+  S2_DCHECK(!child_bounds[1].is_empty());
+  S2_DCHECK(edge_bound.Contains(child_bounds[1]));
+}
+
+template <class IndexType>
+void S2CrossingEdgeQueryBase<IndexType>::GetCells(
+    const S2Point& a0, const S2Point& a1, const S2PaddedCell& root,
+    std::vector<const S2ShapeIndexCell*>* cells) {
+  cells->clear();
+  VisitCells(a0, a1, root, [cells](const S2ShapeIndexCell& cell) {
+      cells->push_back(&cell);
+      return true;
+    });
+}
+
+// The common instantiations are compiled once in s2crossing_edge_query.cc.
+extern template class S2CrossingEdgeQueryBase<S2ShapeIndex>;
+extern template class S2CrossingEdgeQueryBase<MutableS2ShapeIndex>;
+
 #endif  // S2_S2CROSSING_EDGE_QUERY_H_
@@ -190,6 +190,11 @@ void TestAllCrossings(const vector<TestEdge>& edges) {
         query.GetCrossingEdges(a, b, *shape, CrossingType::INTERIOR);
     EXPECT_EQ(expected_interior_crossings,
               GetShapeEdgeIds(actual_interior_crossings));
+
+    // Verify that the version templated on the index type agrees.
+    S2CrossingEdgeQueryBase<MutableS2ShapeIndex> typed_query(&index);
+    EXPECT_EQ(candidates, typed_query.GetCandidates(a, b));
+    EXPECT_EQ(candidates, typed_query.GetCandidates(a, b, *shape));
   }
   // There is nothing magical about this particular ratio; this check exists
   // to catch changes that dramatically increase the number of candidates.
@@ -325,4 +330,33 @@ TEST(GetCrossings, ShapeIdsAreCorrect) {
   TestPolylineCrossings(index, MakePoint("1:-10"), MakePoint("1:30"));
 }
 
+// Checks each explicitly instantiated index type against S2CrossingEdgeQuery.
+template <class IndexType>
+class CrossingEdgeQueryBaseTest : public ::testing::Test {};
+
+using IndexTypes = ::testing::Types<S2ShapeIndex, MutableS2ShapeIndex>;
+TYPED_TEST_CASE(CrossingEdgeQueryBaseTest, IndexTypes);
+
+TYPED_TEST(CrossingEdgeQueryBaseTest, GetCrossingEdges) {
+  MutableS2ShapeIndex index;
+  index.Add(make_unique<S2Polyline::OwningShape>(
+      MakePolyline("0:0, 2:1, 0:2, 2:3, 0:4, 2:5, 0:6")));
+  index.Add(make_unique<S2Polyline::OwningShape>(
+      MakePolyline("1:0, 3:1, 1:2, 3:3, 1:4, 3:5, 1:6")));
+  S2Point a0 = MakePoint("1:-1"), a1 = MakePoint("1:7");
+  S2CrossingEdgeQuery query(&index);
+  S2CrossingEdgeQueryBase<TypeParam> typed_query(&index);
+  for (CrossingType type : {CrossingType::ALL, CrossingType::INTERIOR}) {
+    vector<ShapeEdgeId> expected =
+        GetShapeEdgeIds(query.GetCrossingEdges(a0, a1, type));
+    EXPECT_FALSE(expected.empty());
+    EXPECT_EQ(expected,
+              GetShapeEdgeIds(typed_query.GetCrossingEdges(a0, a1, type)));
+    const S2Shape& shape = *index.shape(1);
+    EXPECT_EQ(GetShapeEdgeIds(query.GetCrossingEdges(a0, a1, shape, type)),
+              GetShapeEdgeIds(typed_query.GetCrossingEdges(a0, a1, shape,
+                                                           type)));
+  }
+}
+
 }  // namespace
@@ -0,0 +1,278 @@
+// Copyright 2018 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "s2/s2edge_rasterizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <tuple>
+#include <vector>
+
+#include "s2/base/logging.h"
+#include "s2/r2.h"
+#include "s2/r2rect.h"
+#include "s2/s2contains_point_query.h"
+#include "s2/s2coords.h"
+#include "s2/s2edge_clipping.h"
+#include "s2/s2shape.h"
+
+using std::vector;
+
+namespace S2 {
+
+namespace {
+
+// The maximum error in the (u,v)-coordinates of a clipped edge, plus the
+// error in S2::IntersectsRect().  Cells closer than this to an edge are
+// included in its rasterization.
+const double kMaxError = kFaceClipErrorUVCoord + kIntersectsRectErrorUVDist;
+
+// Represents a cell at the rasterization level by its (face, i, j)
+// coordinates, where "i" and "j" are in units of cells at that level.
+// Cells are sorted by face, then by row (j), then by column (i).
+struct RasterCell {
+  int face, j, i;
+
+  friend bool operator<(const RasterCell& x, const RasterCell& y) {
+    return std::tie(x.face, x.j, x.i) < std::tie(y.face, y.j, y.i);
+  }
+  friend bool operator==(const RasterCell& x, const RasterCell& y) {
+    return x.face == y.face && x.j == y.j && x.i == y.i;
+  }
+};
+
+// Walks the grid of cells at a given level along edges clipped to a single
+// cube face.
+class FaceRasterizer {
+ public:
+  explicit FaceRasterizer(int level)
+      : level_(level), shift_(S2CellId::kMaxLevel - level),
+        size_(1 << level) {
+  }
+
+  int level() const { return level_; }
+  int size() const { return size_; }
+
+  S2CellId GetCellId(int face, int i, int j) const {
+    return S2CellId::FromFaceIJ(face, i << shift_, j << shift_).parent(level_);
+  }
+
+  // Calls visitor(i, j) for every cell at the current level that the
+  // segment AB (in the (u,v)-coordinates of some face) intersects, and for
+  // all neighbors of those cells that are within kMaxError of AB.
+  template <class Visitor>
+  void Rasterize(const R2Point& a, const R2Point& b, const Visitor& visitor);
+
+ private:
+  // Returns the index of the grid column (or row) containing "u".
+  int GetIndex(double u) const { return STtoIJ(UVtoST(u)) >> shift_; }
+
+  // Returns the (u,v)-coordinate of the grid line preceding column (or row)
+  // "k", where 0 <= k <= size_.
+  double GetGridLine(int k) const {
+    return STtoUV(IJtoSTMin(k << shift_));
+  }
+
+  R2Rect GetCellBound(int i, int j) const {
+    return R2Rect(R1Interval(GetGridLine(i), GetGridLine(i + 1)),
+                  R1Interval(GetGridLine(j), GetGridLine(j + 1)));
+  }
+
+  // Returns the parameter "t" along the segment from "a" to "b" at which the
+  // segment crosses the next grid line after column "k" in direction "dk".
+  double GetCrossing(int k, int dk, double a, double b) const {
+    return (GetGridLine(k + (dk > 0)) - a) / (b - a);
+  }
+
+  const int level_;
+  const int shift_;
+  const int size_;
+};
+
+template <class Visitor>
+void FaceRasterizer::Rasterize(const R2Point& a, const R2Point& b,
+                               const Visitor& visitor) {
+  static const double kInfinity = std::numeric_limits<double>::infinity();
+
+  int i = GetIndex(a[0]), j = GetIndex(a[1]);
+  const int i_end = GetIndex(b[0]), j_end = GetIndex(b[1]);
+  const int di = (i_end >= i) ? 1 : -1;
+  const int dj = (j_end >= j) ? 1 : -1;
+
+  // "t_u" and "t_v" are the parameters along AB at which the segment leaves
+  // the current column and row respectively.  Note that we only step in a
+  // given direction while we have not yet reached the final column (or row),
+  // which guarantees termination even in the presence of numerical errors.
+  double t_u = (i == i_end) ? kInfinity : GetCrossing(i, di, a[0], b[0]);
+  double t_v = (j == j_end) ? kInfinity : GetCrossing(j, dj, a[1], b[1]);
+  for (;;) {
+    visitor(i, j);
+
+    // If AB passes within kMaxError of the boundary of this cell, then it
+    // may also intersect the adjacent cells.  Rather than trying to
+    // determine this from the crossing parameters (which are not accurate
+    // near corners), we simply test all neighbors that are not already on
+    // the main path.
+    for (int ni = std::max(0, i - 1); ni <= std::min(size_ - 1, i + 1); ++ni) {
+      for (int nj = std::max(0, j - 1); nj <= std::min(size_ - 1, j + 1);
+           ++nj) {
+        if (ni == i && nj == j) continue;
+        if (IntersectsRect(a, b, GetCellBound(ni, nj).Expanded(kMaxError))) {
+          visitor(ni, nj);
+        }
+      }
+    }
+    if (i == i_end && j == j_end) break;
+    if (j == j_end || (i != i_end && t_u < t_v)) {
+      i += di;
+      t_u = (i == i_end) ? kInfinity : GetCrossing(i, di, a[0], b[0]);
+    } else {
+      j += dj;
+      t_v = (j == j_end) ? kInfinity : GetCrossing(j, dj, a[1], b[1]);
+    }
+  }
+}
+
+// Calls visitor(face, i, j) for every cell of the rasterizer's level that
+// intersects the edge AB (see AppendEdgeCells).
+template <class Visitor>
+void RasterizeEdge(const S2Point& a, const S2Point& b,
+                   FaceRasterizer* rasterizer, const Visitor& visitor) {
+  // Fast path: if both endpoints are on the same face and not too close to
+  // its boundary, then the entire edge is on that face (since every face is
+  // convex in (u,v)-space).
+  R2Point a_uv, b_uv;
+  const int face = XYZtoFaceUV(a, &a_uv);
+  if (face == GetFace(b)) {
+    ValidFaceXYZtoUV(face, b, &b_uv);
+    const double kMaxSafeUVCoord = 1 - kMaxError;
+    if (std::max(std::fabs(a_uv[0]), std::fabs(a_uv[1])) < kMaxSafeUVCoord &&
+        std::max(std::fabs(b_uv[0]), std::fabs(b_uv[1])) < kMaxSafeUVCoord) {
+      rasterizer->Rasterize(a_uv, b_uv, [face, &visitor](int i, int j) {
+          visitor(face, i, j);
+        });
+      return;
+    }
+  }
+  for (int f = 0; f < 6; ++f) {
+    if (ClipToPaddedFace(a, b, f, kMaxError, &a_uv, &b_uv)) {
+      rasterizer->Rasterize(a_uv, b_uv, [f, &visitor](int i, int j) {
+          visitor(f, i, j);
+        });
+    }
+  }
+}
+
+// Appends to "output" a set of cells that exactly covers the cells
+// [i0, i1] x [j0, j1] of the rasterizer's level on the given face, using the
+// largest cells possible.  The arguments (i, j, k) describe the node of the
+// cell hierarchy currently being visited: its level is "k", and its lower
+// left descendant at the rasterizer's level is (i, j).
+void AppendRect(const FaceRasterizer& rasterizer, int face, int i0, int i1,
+                int j0, int j1, int i, int j, int k, vector<S2CellId>* output) {
+  const int size = 1 << (rasterizer.level() - k);
+  if (i > i1 || i + size - 1 < i0 || j > j1 || j + size - 1 < j0) return;
+  if (i >= i0 && i + size - 1 <= i1 && j >= j0 && j + size - 1 <= j1) {
+    output->push_back(rasterizer.GetCellId(face, i, j).parent(k));
+    return;
+  }
+  const int half = size >> 1;
+  for (int dj = 0; dj <= half; dj += half) {
+    for (int di = 0; di <= half; di += half) {
+      AppendRect(rasterizer, face, i0, i1, j0, j1, i + di, j + dj, k + 1,
+                 output);
+    }
+  }
+}
+
+}  // namespace
+
+void AppendEdgeCells(const S2Point& a, const S2Point& b, int level,
+                     vector<S2CellId>* cells) {
+  S2_DCHECK_GE(level, 0);
+  S2_DCHECK_LE(level, S2CellId::kMaxLevel);
+  FaceRasterizer rasterizer(level);
+  RasterizeEdge(a, b, &rasterizer, [&](int face, int i, int j) {
+      cells->push_back(rasterizer.GetCellId(face, i, j));
+    });
+}
+
+S2CellUnion GetRasterCovering(const S2ShapeIndex& index, int level) {
+  S2_DCHECK_GE(level, 0);
+  S2_DCHECK_LE(level, S2CellId::kMaxLevel);
+  FaceRasterizer rasterizer(level);
+
+  // First rasterize all the edges.  (Points are represented as degenerate
+  // edges and therefore yield the cell that contains them.)
+  vector<RasterCell> boundary;
+  bool has_interior = false;
+  for (int id = 0; id < index.num_shape_ids(); ++id) {
+    const S2Shape* shape = index.shape(id);
+    if (shape == nullptr) continue;
+    if (shape->dimension() == 2) has_interior = true;
+    for (int e = 0; e < shape->num_edges(); ++e) {
+      S2Shape::Edge edge = shape->edge(e);
+      RasterizeEdge(edge.v0, edge.v1, &rasterizer, [&](int f, int i, int j) {
+          boundary.push_back(RasterCell{f, j, i});
+        });
+    }
+  }
+  std::sort(boundary.begin(), boundary.end());
+  boundary.erase(std::unique(boundary.begin(), boundary.end()),
+                 boundary.end());
+
+  vector<S2CellId> output;
+  output.reserve(boundary.size());
+  for (const RasterCell& cell : boundary) {
+    output.push_back(rasterizer.GetCellId(cell.face, cell.i, cell.j));
+  }
+  if (!has_interior) return S2CellUnion(std::move(output));
+
+  // Now fill in the polygon interiors.  Any two edge-adjacent cells that do
+  // not intersect an edge are either both inside or both outside, therefore
+  // each maximal run of such cells within a row (and each maximal group of
+  // consecutive rows without boundary cells) can be classified by testing
+  // the center of just one of its cells.
+  auto query = MakeS2ContainsPointQuery(&index);
+  const int n = rasterizer.size();
+  auto inside = [&](int face, int i, int j) {
+    return query.Contains(rasterizer.GetCellId(face, i, j).ToPoint());
+  };
+  auto append_rect = [&](int face, int i0, int i1, int j0, int j1) {
+    if (inside(face, i0, j0)) {
+      AppendRect(rasterizer, face, i0, i1, j0, j1, 0, 0, 0, &output);
+    }
+  };
+  auto it = boundary.begin();
+  for (int face = 0; face < 6; ++face) {
+    int next_row = 0;  // The first row that has not been processed yet.
+    for (; it != boundary.end() && it->face == face; ) {
+      const int row = it->j;
+      if (row > next_row) append_rect(face, 0, n - 1, next_row, row - 1);
+      int next_col = 0;
+      for (; it != boundary.end() && it->face == face && it->j == row; ++it) {
+        if (it->i > next_col) append_rect(face, next_col, it->i - 1, row, row);
+        next_col = it->i + 1;
+      }
+      if (next_col < n) append_rect(face, next_col, n - 1, row, row);
+      next_row = row + 1;
+    }
+    if (next_row < n) append_rect(face, 0, n - 1, next_row, n - 1);
+  }
+  return S2CellUnion(std::move(output));
+}
+
+}  // namespace S2
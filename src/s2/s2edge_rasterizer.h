@@ -0,0 +1,70 @@
+// Copyright 2018 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+// Functions for computing fixed-level coverings of edges, polylines and
+// polygons by "rasterizing" them directly in cube-face (i,j) coordinates,
+// rather than by testing candidate cells one at a time as
+// S2RegionCoverer::GetSimpleCovering() does.
+//
+// The key observation is that every geodesic edge projects to a straight
+// line segment in the (u,v)-coordinates of each cube face it passes through
+// (see s2edge_clipping.h), and that the cells of any given level form an
+// axis-aligned (albeit non-uniform) grid in (u,v)-space.  Each clipped edge
+// can therefore be walked through the grid one cell at a time, in the style
+// of a digital differential analyzer.  Polygon interiors are then filled
+// row by row between the boundary cells, using a single point containment
+// test per run of interior cells.
+
+#ifndef S2_S2EDGE_RASTERIZER_H_
+#define S2_S2EDGE_RASTERIZER_H_
+
+#include <vector>
+
+#include "s2/s2cell_id.h"
+#include "s2/s2cell_union.h"
+#include "s2/s2point.h"
+#include "s2/s2shape_index.h"
+
+namespace S2 {
+
+// Appends to "cells" all the cells at the given level that intersect the
+// edge AB, in the order that they are traversed from A to B.  A cell may be
+// appended more than once when the edge passes close to one of its corners.
+// In order to be robust to numerical errors, cells whose distance from AB
+// is less than S2::kFaceClipErrorUVCoord + S2::kIntersectsRectErrorUVDist
+// (in (u,v)-coordinates) are also included; a degenerate edge (A == B) yields the cell containing A.
+void AppendEdgeCells(const S2Point& a, const S2Point& b, int level,
+                     std::vector<S2CellId>* cells);
+
+// Returns a covering of all the shapes in "index" consisting of cells at the
+// given level, i.e. the union of all the level-"level" cells that intersect
+// any edge, point, or polygon interior in the index.  The result is
+// normalized, so groups of four interior cells are replaced by their parent;
+// call S2CellUnion::Denormalize() to obtain the cells at the given level.
+//
+// Polygon interiors are determined using S2ContainsPointQuery with the
+// default options, and each run of cells within a row of a cube face that
+// does not intersect any edge requires only a single such test.  Note that
+// the cost of this method is proportional to the number of cells returned
+// along edges and polygon boundaries, so it is well suited to computing fine
+// coverings of long polylines (e.g. road networks) and large polygons.
+//
+// Example usage:
+//   S2CellUnion covering = S2::GetRasterCovering(polygon.index(), 16);
+S2CellUnion GetRasterCovering(const S2ShapeIndex& index, int level);
+
+}  // namespace S2
+
+#endif  // S2_S2EDGE_RASTERIZER_H_
@@ -0,0 +1,145 @@
+// Copyright 2018 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "s2/s2edge_rasterizer.h"
+
+#include <memory>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include "s2/third_party/absl/memory/memory.h"
+#include "s2/mutable_s2shape_index.h"
+#include "s2/s1angle.h"
+#include "s2/s2cap.h"
+#include "s2/s2cell.h"
+#include "s2/s2cell_union.h"
+#include "s2/s2loop.h"
+#include "s2/s2polygon.h"
+#include "s2/s2polyline.h"
+#include "s2/s2region_coverer.h"
+#include "s2/s2testing.h"
+#include "s2/s2text_format.h"
+
+using absl::make_unique;
+using std::unique_ptr;
+using std::vector;
+
+namespace {
+
+// Checks that the raster covering of the given region contains the
+// (slower) covering computed by S2RegionCoverer::GetSimpleCovering, and
+// that it does not contain many extra cells.
+void CheckRasterCovering(const S2Region& region, const S2ShapeIndex& index,
+                         const S2Point& start, int level) {
+  vector<S2CellId> expected_ids;
+  S2RegionCoverer::GetSimpleCovering(region, start, level, &expected_ids);
+  S2CellUnion expected(std::move(expected_ids));
+  S2CellUnion actual = S2::GetRasterCovering(index, level);
+  EXPECT_TRUE(actual.Contains(expected));
+  vector<S2CellId> actual_ids;
+  actual.Denormalize(level, 1, &actual_ids);
+  vector<S2CellId> denormalized;
+  expected.Denormalize(level, 1, &denormalized);
+  // Extra cells are only expected where an edge passes within a tiny
+  // distance of a cell boundary.
+  EXPECT_LE(actual_ids.size(), denormalized.size() + 2);
+}
+
+TEST(AppendEdgeCells, DegenerateEdge) {
+  S2Point p = S2Testing::RandomPoint();
+  vector<S2CellId> cells;
+  S2::AppendEdgeCells(p, p, 10, &cells);
+  ASSERT_GE(cells.size(), 1);
+  EXPECT_EQ(S2CellId(p).parent(10), cells[0]);
+}
+
+TEST(AppendEdgeCells, MatchesFloodFill) {
+  for (int iter = 0; iter < 200; ++iter) {
+    S2Testing::rnd.Reset(iter + 1);
+    int level = S2Testing::rnd.Uniform(14);
+    S2Point a = S2Testing::RandomPoint();
+    S2Point b = S2Testing::SamplePoint(
+        S2Cap(a, S1Angle::Radians(S2Testing::rnd.RandDouble() * 0.5)));
+    S2Polyline polyline(vector<S2Point>{a, b});
+    vector<S2CellId> expected;
+    S2RegionCoverer::GetSimpleCovering(polyline, a, level, &expected);
+    vector<S2CellId> actual;
+    S2::AppendEdgeCells(a, b, level, &actual);
+    S2CellUnion actual_union(std::move(actual));
+    EXPECT_TRUE(actual_union.Contains(S2CellUnion(std::move(expected))))
+        << "iteration " << iter;
+  }
+}
+
+TEST(GetRasterCovering, EmptyIndex) {
+  MutableS2ShapeIndex index;
+  EXPECT_TRUE(S2::GetRasterCovering(index, 10).empty());
+}
+
+TEST(GetRasterCovering, Points) {
+  auto index = s2textformat::MakeIndexOrDie("0:0 | 10:10 # #");
+  S2CellUnion covering = S2::GetRasterCovering(*index, 12);
+  EXPECT_TRUE(covering.Contains(s2textformat::MakePoint("0:0")));
+  EXPECT_TRUE(covering.Contains(s2textformat::MakePoint("10:10")));
+  EXPECT_LE(covering.num_cells(), 8);
+}
+
+TEST(GetRasterCovering, Polylines) {
+  for (int iter = 0; iter < 50; ++iter) {
+    S2Testing::rnd.Reset(iter + 1);
+    int level = 4 + S2Testing::rnd.Uniform(8);
+    vector<S2Point> vertices;
+    S2Point p = S2Testing::RandomPoint();
+    for (int i = 0; i < 10; ++i) {
+      vertices.push_back(p);
+      p = S2Testing::SamplePoint(S2Cap(p, S1Angle::Degrees(5)));
+    }
+    S2Polyline polyline(vertices);
+    MutableS2ShapeIndex index;
+    index.Add(make_unique<S2Polyline::Shape>(&polyline));
+    CheckRasterCovering(polyline, index, vertices[0], level);
+  }
+}
+
+TEST(GetRasterCovering, Polygons) {
+  for (int iter = 0; iter < 50; ++iter) {
+    S2Testing::rnd.Reset(iter + 1);
+    int level = 4 + S2Testing::rnd.Uniform(6);
+    S2Point center = S2Testing::RandomPoint();
+    S2Polygon polygon(S2Loop::MakeRegularLoop(
+        center, S1Angle::Degrees(1 + 20 * S2Testing::rnd.RandDouble()), 20));
+    CheckRasterCovering(polygon, polygon.index(), polygon.loop(0)->vertex(0),
+                        level);
+  }
+}
+
+TEST(GetRasterCovering, PolygonWithHole) {
+  auto polygon = s2textformat::MakePolygonOrDie(
+      "0:0, 0:10, 10:10, 10:0; 4:4, 6:4, 6:6, 4:6");
+  S2CellUnion covering = S2::GetRasterCovering(polygon->index(), 10);
+  EXPECT_TRUE(covering.Contains(s2textformat::MakePoint("2:2")));
+  EXPECT_TRUE(covering.Contains(s2textformat::MakePoint("8:8")));
+  EXPECT_FALSE(covering.Contains(s2textformat::MakePoint("5:5")));
+  EXPECT_FALSE(covering.Contains(s2textformat::MakePoint("12:12")));
+}
+
+TEST(GetRasterCovering, FullPolygon) {
+  auto index = s2textformat::MakeIndexOrDie("# # full");
+  S2CellUnion covering = S2::GetRasterCovering(*index, 8);
+  EXPECT_TRUE(covering.IsNormalized());
+  EXPECT_EQ(6, covering.num_cells());
+}
+
+}  // namespace
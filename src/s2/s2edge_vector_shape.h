@@ -77,6 +77,13 @@ class S2EdgeVectorShape : public S2Shape {
   ChainPosition chain_position(int e) const final {
     return ChainPosition(e, 0);
   }
+  void GetEdges(int start, int n, Edge* edges) const final {
+    S2_DCHECK(0 <= start && start + n <= num_edges());
+    for (int i = 0; i < n; ++i) {
+      const auto& edge = edges_[start + i];
+      edges[i] = Edge(edge.first, edge.second);
+    }
+  }
 
  private:
   std::vector<std::pair<S2Point, S2Point>> edges_;
@@ -30,11 +30,13 @@ using ChainPosition = S2Shape::ChainPosition;
 static const unsigned char kCurrentEncodingVersionNumber = 1;
 
 S2LaxPolygonShape::S2LaxPolygonShape(
-    const vector<S2LaxPolygonShape::Loop>& loops) {
+    const vector<S2LaxPolygonShape::Loop>& loops)
+    : num_loops_(0) {
   Init(loops);
 }
 
-S2LaxPolygonShape::S2LaxPolygonShape(const S2Polygon& polygon) {
+S2LaxPolygonShape::S2LaxPolygonShape(const S2Polygon& polygon)
+    : num_loops_(0) {
   Init(polygon);
 }
 
@@ -69,6 +71,7 @@ void S2LaxPolygonShape::Init(const S2Polygon& polygon) {
 }
 
 void S2LaxPolygonShape::Init(const vector<Span<const S2Point>>& loops) {
+  if (num_loops_ > 1) delete[] cumulative_vertices_;
   num_loops_ = loops.size();
   if (num_loops_ == 0) {
     num_vertices_ = 0;
@@ -236,6 +239,27 @@ S2Shape::ChainPosition S2LaxPolygonShape::chain_position(int e) const {
   }
 }
 
+void S2LaxPolygonShape::GetEdges(int start, int n, Edge* edges) const {
+  S2_DCHECK(0 <= start && start + n <= num_edges());
+  if (n == 0) return;
+  if (num_loops() == 1) {
+    for (int i = 0, e0 = start; i < n; ++i, ++e0) {
+      int e1 = (e0 + 1 == num_vertices_) ? 0 : e0 + 1;
+      edges[i] = Edge(vertices_[e0], vertices_[e1]);
+    }
+  } else {
+    // Locate the loop containing the first edge, and then advance through
+    // the loops sequentially.
+    ChainPosition pos = S2LaxPolygonShape::chain_position(start);
+    const uint32* next = cumulative_vertices_ + pos.chain_id + 1;
+    for (int i = 0, e0 = start; i < n; ++i, ++e0) {
+      while (*next <= e0) ++next;  // Skips over empty loops.
+      int e1 = (e0 + 1 == *next) ? next[-1] : e0 + 1;
+      edges[i] = Edge(vertices_[e0], vertices_[e1]);
+    }
+  }
+}
+
 bool EncodedS2LaxPolygonShape::Init(Decoder* decoder) {
   if (decoder->avail() < 1) return false;
   uint8 version = decoder->get8();
@@ -94,6 +94,11 @@ class S2LaxPolygonShape : public S2Shape {
   // Full and empty S2Polygons are supported.
   void Init(const S2Polygon& polygon);
 
+  // Like Init(const std::vector<Loop>&), but the loops may refer to vertices
+  // stored elsewhere (e.g., consecutive ranges of a single vector).  An empty
+  // span represents the full loop.
+  void Init(const std::vector<absl::Span<const S2Point>>& loops);
+
   // Returns the number of loops.
   int num_loops() const { return num_loops_; }
 
@@ -128,11 +133,10 @@ class S2LaxPolygonShape : public S2Shape {
   Chain chain(int i) const final;
   Edge chain_edge(int i, int j) const final;
   ChainPosition chain_position(int e) const final;
+  void GetEdges(int start, int n, Edge* edges) const final;
   TypeTag type_tag() const override { return kTypeTag; }
 
  private:
-  void Init(const std::vector<absl::Span<const S2Point>>& loops);
-
   int32 num_loops_;
   std::unique_ptr<S2Point[]> vertices_;
   // If num_loops_ <= 1, this union stores the number of vertices.
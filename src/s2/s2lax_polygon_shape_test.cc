@@ -17,6 +17,7 @@
 
 #include "s2/s2lax_polygon_shape.h"
 
+#include <algorithm>
 #include <vector>
 
 #include <gtest/gtest.h>
@@ -152,6 +153,26 @@ TEST(S2LaxPolygonShape, MultiLoopS2Polygon) {
   }
 }
 
+TEST(S2LaxPolygonShape, ReinitializeMultiLoopPolygon) {
+  // Calling Init() on a shape that already has several loops must release
+  // the previous vertex storage exactly once.
+  vector<S2LaxPolygonShape::Loop> loops = {
+    s2textformat::ParsePoints("0:0, 0:3, 3:3"),
+    s2textformat::ParsePoints("1:1, 2:2, 1:2"),
+    s2textformat::ParsePoints("5:5, 5:6, 6:6")
+  };
+  S2LaxPolygonShape shape(loops);
+  loops.pop_back();
+  shape.Init(loops);
+  EXPECT_EQ(2, shape.num_loops());
+  EXPECT_EQ(6, shape.num_vertices());
+  EXPECT_EQ(3, shape.chain(1).start);
+  auto polygon = MakePolygonOrDie("0:0, 0:3, 3:3; 1:1, 1:2, 2:2");
+  shape.Init(*polygon);
+  EXPECT_EQ(2, shape.num_loops());
+  EXPECT_EQ(polygon->loop(1)->oriented_vertex(0), shape.loop_vertex(1, 0));
+}
+
 TEST(S2LaxPolygonShape, ManyLoopPolygon) {
   // Test a polygon with enough loops so that cumulative_vertices_ is used.
   vector<vector<S2Point>> loops;
@@ -180,6 +201,17 @@ TEST(S2LaxPolygonShape, ManyLoopPolygon) {
   }
   EXPECT_EQ(num_vertices, shape.num_vertices());
   EXPECT_EQ(num_vertices, shape.num_edges());
+
+  // Check that GetEdges() agrees with edge(), including for ranges that
+  // span empty loops.
+  for (int start = 0; start < shape.num_edges(); ++start) {
+    int n = std::min(7, shape.num_edges() - start);
+    vector<S2Shape::Edge> edges(n);
+    shape.GetEdges(start, n, edges.data());
+    for (int i = 0; i < n; ++i) {
+      EXPECT_EQ(shape.edge(start + i), edges[i]);
+    }
+  }
 }
 
 TEST(S2LaxPolygonShape, DegenerateLoops) {
@@ -90,6 +90,14 @@ S2Shape::ChainPosition S2LaxPolylineShape::chain_position(int e) const {
   return S2Shape::ChainPosition(0, e);
 }
 
+void S2LaxPolylineShape::GetEdges(int start, int n, Edge* edges) const {
+  S2_DCHECK(0 <= start && start + n <= num_edges());
+  const S2Point* v = vertices_.get() + start;
+  for (int i = 0; i < n; ++i) {
+    edges[i] = Edge(v[i], v[i + 1]);
+  }
+}
+
 bool EncodedS2LaxPolylineShape::Init(Decoder* decoder) {
   return vertices_.Init(decoder);
 }
@@ -78,6 +78,7 @@ class S2LaxPolylineShape : public S2Shape {
   Chain chain(int i) const final;
   Edge chain_edge(int i, int j) const final;
   ChainPosition chain_position(int e) const final;
+  void GetEdges(int start, int n, Edge* edges) const final;
   TypeTag type_tag() const override { return kTypeTag; }
 
  private:
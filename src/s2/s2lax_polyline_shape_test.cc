@@ -60,3 +60,12 @@ TEST(S2LaxPolylineShape, EdgeAccess) {
   EXPECT_EQ(vertices[1], edge1.v0);
   EXPECT_EQ(vertices[2], edge1.v1);
 }
+
+TEST(S2LaxPolylineShape, GetEdges) {
+  vector<S2Point> vertices = s2textformat::ParsePoints("0:0, 0:1, 1:1, 2:1");
+  S2LaxPolylineShape shape(vertices);
+  S2Shape::Edge edges[2];
+  shape.GetEdges(1, 2, edges);
+  EXPECT_EQ(shape.edge(1), edges[0]);
+  EXPECT_EQ(shape.edge(2), edges[1]);
+}
@@ -837,7 +837,7 @@ class LoopCrosser {
   int aj_, bj_prev_;
 
   // Temporary data declared here to avoid repeated memory allocations.
-  S2CrossingEdgeQuery b_query_;
+  S2CrossingEdgeQueryBase<MutableS2ShapeIndex> b_query_;
   vector<const S2ShapeIndexCell*> b_cells_;
 };
 
@@ -486,6 +486,12 @@ class S2Loop final : public S2Region {
     ChainPosition chain_position(int e) const final {
       return ChainPosition(0, e);
     }
+    void GetEdges(int start, int n, Edge* edges) const final {
+      S2_DCHECK(0 <= start && start + n <= num_edges());
+      for (int i = 0; i < n; ++i) {
+        edges[i] = Edge(loop_->vertex(start + i), loop_->vertex(start + i + 1));
+      }
+    }
 
    private:
     const S2Loop* loop_;
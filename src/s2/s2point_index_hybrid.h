@@ -0,0 +1,524 @@
+// Copyright 2018 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef S2_S2POINT_INDEX_HYBRID_H_
+#define S2_S2POINT_INDEX_HYBRID_H_
+
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "s2/base/logging.h"
+#include "s2/third_party/absl/memory/memory.h"
+#include "s2/s2cell_id.h"
+#include "s2/s2point_index.h"
+#include "s2/s2point_index_static.h"
+#include "s2/util/gtl/btree_map.h"
+
+// S2PointIndexHybrid is an updatable point index designed for very large,
+// mostly static collections of points.  It consists of an immutable
+// S2PointIndexStatic "base" segment (which may be compressed), together with
+// a small S2PointIndex "delta" containing points added since the base was
+// built and a set of "tombstones" recording points removed from the base.
+// Its Iterator presents the merged contents in S2CellId order, so the index
+// can be used with S2ClosestPointQuery just like S2PointIndex:
+//
+//   S2PointIndexHybrid<int, block_map> index(std::move(base));
+//   index.Add(new_point, 123);
+//   index.Remove(old_point, 456);
+//   S2ClosestPointQuery<int, S2PointIndexHybrid<int, block_map>> query(&index);
+//
+// Over time the delta should be merged into a new base segment.  Since this
+// is expensive for large indexes, compaction is split into three steps so
+// that the index can continue to be queried and updated while the new base
+// is being built:
+//
+//   auto compaction = index.StartCompaction();  // Fast; modifies the index.
+//   compaction->Build();                        // Slow; any thread.
+//   index.FinishCompaction(std::move(compaction));  // Fast; modifies index.
+//
+// Build() does not access the index at all, so it can run in a background
+// thread with no synchronization.  StartCompaction() takes time proportional
+// to the size of the delta, and FinishCompaction() takes time proportional
+// to the number of updates made while the compaction was in progress.
+//
+// Like S2PointIndex, this class is thread-compatible: const methods
+// (including iteration) may be called concurrently, but Add(), Remove(),
+// StartCompaction() and FinishCompaction() require exclusive access and
+// invalidate all iterators.
+//
+// REQUIRES: "Data" has default and copy constructors.
+// REQUIRES: "Data" has operator== and operator<.
+// REQUIRES: MapType iterators return references to the stored values (as
+//           std_map, ef_map, and block_map do).
+template <class Data, template<typename,typename> class MapType>
+class S2PointIndexHybrid {
+ public:
+  using StaticIndex = S2PointIndexStatic<Data, MapType>;
+  using DeltaIndex = S2PointIndex<Data>;
+  using PointData = typename DeltaIndex::PointData;
+
+  class Compaction;
+
+  // Constructs an index whose base segment is empty.
+  S2PointIndexHybrid();
+
+  // Constructs an index with the given base segment.
+  explicit S2PointIndexHybrid(std::shared_ptr<const StaticIndex> base);
+
+  // Returns the number of points in the index.
+  int num_points() const;
+
+  // Returns the number of points in the delta, and the number of points
+  // removed from the base segment.  Clients can use these to decide when to
+  // start a compaction.
+  int num_delta_points() const { return delta_.num_points(); }
+  int num_tombstones() const { return num_tombstones_; }
+
+  // Returns the memory used by the base segment, delta, and tombstones.
+  size_t bytes_used() const;
+
+  // Returns the current base segment.
+  const std::shared_ptr<const StaticIndex>& base() const { return base_; }
+
+  // Adds the given point to the index.  Invalidates all iterators.
+  void Add(const S2Point& point, const Data& data);
+  void Add(const PointData& point_data);
+
+  // Convenience function for the case when Data is an empty class.
+  void Add(const S2Point& point);
+
+  // Removes the given point from the index.  Both the "point" and "data"
+  // fields must match the point to be removed.  Returns false if the given
+  // point was not present.  Invalidates all iterators.
+  bool Remove(const S2Point& point, const Data& data);
+  bool Remove(const PointData& point_data);
+
+  // Convenience function for the case when Data is an empty class.
+  bool Remove(const S2Point& point);
+
+  // Begins a compaction (see above).  The returned object captures the
+  // current base, delta, and tombstones; updates made after this point are
+  // recorded and reapplied by FinishCompaction().
+  //
+  // REQUIRES: No other compaction is in progress.
+  std::unique_ptr<Compaction> StartCompaction();
+
+  // Installs the base segment built by "compaction", clears the delta and
+  // tombstones, and reapplies any updates made since StartCompaction().
+  // Invalidates all iterators.
+  //
+  // REQUIRES: compaction->Build() has been called.
+  void FinishCompaction(std::unique_ptr<Compaction> compaction);
+
+  // Convenience function that performs all three compaction steps.
+  void Compact();
+
+  // Represents a compaction in progress.
+  class Compaction {
+   public:
+    // Builds the new base segment.  This method does not access the
+    // S2PointIndexHybrid that created this object.
+    void Build();
+
+    // Returns the new base segment.  REQUIRES: Build() has been called.
+    const std::shared_ptr<const StaticIndex>& new_base() const {
+      return new_base_;
+    }
+
+   private:
+    friend class S2PointIndexHybrid;
+    Compaction() {}
+
+    std::shared_ptr<const StaticIndex> base_;
+    std::vector<PointData> delta_;  // Sorted by S2CellId.
+    gtl::btree_map<PointData, int> tombstones_;
+    std::shared_ptr<const StaticIndex> new_base_;
+  };
+
+ private:
+  // Maps each point removed from the base segment to the number of copies
+  // of that point that were removed.
+  using Tombstones = gtl::btree_map<PointData, int>;
+
+ public:
+  class Iterator {
+   public:
+    // Default constructor; must be followed by a call to Init().
+    Iterator();
+
+    // Convenience constructor that calls Init().
+    explicit Iterator(const S2PointIndexHybrid* index);
+
+    // Initializes an iterator for the given index.  If the index is
+    // non-empty, the iterator is positioned at the first point.
+    void Init(const S2PointIndexHybrid* index);
+
+    // The S2CellId for the current index entry.
+    // REQUIRES: !done()
+    S2CellId id() const;
+
+    // The point associated with the current index entry.
+    // REQUIRES: !done()
+    const S2Point& point() const { return point_data().point(); }
+
+    // The client-supplied data associated with the current index entry.
+    // REQUIRES: !done()
+    const Data& data() const { return point_data().data(); }
+
+    // The (S2Point, data) pair associated with the current index entry.
+    const PointData& point_data() const;
+
+    // Returns true if the iterator is positioned past the last index entry.
+    bool done() const { return base_iter_.done() && delta_iter_.done(); }
+
+    // Positions the iterator at the first index entry (if any).
+    void Begin();
+
+    // Positions the iterator so that done() is true.
+    void Finish();
+
+    // Advances the iterator to the next index entry.
+    // REQUIRES: !done()
+    void Next();
+
+    // If the iterator is already positioned at the beginning, returns false.
+    // Otherwise positions the iterator at the previous entry and returns true.
+    bool Prev();
+
+    // Positions the iterator at the first entry with id() >= target, or at the
+    // end of the index if no such entry exists.
+    void Seek(S2CellId target);
+
+   private:
+    // Returns true if the current entry comes from the base segment.  When
+    // both segments contain the same S2CellId, the base entries come first.
+    bool at_base() const {
+      return !base_iter_.done() &&
+             (delta_iter_.done() || base_iter_.id() <= delta_iter_.id());
+    }
+
+    // Advances "base_iter_" past any entries that have been removed.
+    void SkipRemoved();
+
+    const Tombstones* tombstones_;
+    typename StaticIndex::Iterator base_iter_;
+    typename DeltaIndex::Iterator delta_iter_;
+  };
+
+ private:
+  // Returns true if the base entry at "it" has been removed, i.e. if it is
+  // one of the first N copies of its point within its S2CellId, where N is
+  // the number of tombstones for that point.
+  static bool IsRemoved(const Tombstones& tombstones,
+                        const typename StaticIndex::Iterator& it);
+
+  // Returns the number of copies of "point_data" in the base segment,
+  // including those that have been removed.
+  int CountInBase(const PointData& point_data) const;
+
+  std::shared_ptr<const StaticIndex> base_;
+  DeltaIndex delta_;
+  Tombstones tombstones_;
+  int num_tombstones_ = 0;
+
+  // Updates made since StartCompaction(), as (is_add, point) pairs.
+  bool compaction_in_progress_ = false;
+  std::vector<std::pair<bool, PointData>> update_log_;
+
+  S2PointIndexHybrid(const S2PointIndexHybrid&) = delete;
+  void operator=(const S2PointIndexHybrid&) = delete;
+};
+
+
+//////////////////   Implementation details follow   ////////////////////
+
+
+template <class Data, template<typename,typename> class MapType>
+S2PointIndexHybrid<Data, MapType>::S2PointIndexHybrid()
+    : base_(std::make_shared<StaticIndex>()) {
+}
+
+template <class Data, template<typename,typename> class MapType>
+S2PointIndexHybrid<Data, MapType>::S2PointIndexHybrid(
+    std::shared_ptr<const StaticIndex> base)
+    : base_(std::move(base)) {
+  S2_DCHECK(base_ != nullptr);
+}
+
+template <class Data, template<typename,typename> class MapType>
+inline int S2PointIndexHybrid<Data, MapType>::num_points() const {
+  return base_->num_points() - num_tombstones_ + delta_.num_points();
+}
+
+template <class Data, template<typename,typename> class MapType>
+size_t S2PointIndexHybrid<Data, MapType>::bytes_used() const {
+  return base_->bytes_used() + delta_.bytes_used() +
+         tombstones_.bytes_used() +
+         update_log_.capacity() * sizeof(update_log_[0]);
+}
+
+template <class Data, template<typename,typename> class MapType>
+void S2PointIndexHybrid<Data, MapType>::Add(const PointData& point_data) {
+  delta_.Add(point_data);
+  if (compaction_in_progress_) update_log_.emplace_back(true, point_data);
+}
+
+template <class Data, template<typename,typename> class MapType>
+void S2PointIndexHybrid<Data, MapType>::Add(const S2Point& point,
+                                            const Data& data) {
+  Add(PointData(point, data));
+}
+
+template <class Data, template<typename,typename> class MapType>
+void S2PointIndexHybrid<Data, MapType>::Add(const S2Point& point) {
+  static_assert(std::is_empty<Data>::value, "Data must be empty");
+  Add(point, {});
+}
+
+template <class Data, template<typename,typename> class MapType>
+bool S2PointIndexHybrid<Data, MapType>::Remove(const PointData& point_data) {
+  // Points are removed from the delta in preference to the base, since this
+  // keeps the number of tombstones small.
+  if (!delta_.Remove(point_data)) {
+    auto it = tombstones_.find(point_data);
+    int num_removed = (it == tombstones_.end()) ? 0 : it->second;
+    if (CountInBase(point_data) <= num_removed) return false;
+    ++tombstones_[point_data];
+    ++num_tombstones_;
+  }
+  if (compaction_in_progress_) update_log_.emplace_back(false, point_data);
+  return true;
+}
+
+template <class Data, template<typename,typename> class MapType>
+bool S2PointIndexHybrid<Data, MapType>::Remove(const S2Point& point,
+                                               const Data& data) {
+  return Remove(PointData(point, data));
+}
+
+template <class Data, template<typename,typename> class MapType>
+bool S2PointIndexHybrid<Data, MapType>::Remove(const S2Point& point) {
+  static_assert(std::is_empty<Data>::value, "Data must be empty");
+  return Remove(point, {});
+}
+
+template <class Data, template<typename,typename> class MapType>
+int S2PointIndexHybrid<Data, MapType>::CountInBase(
+    const PointData& point_data) const {
+  S2CellId id(point_data.point());
+  int count = 0;
+  typename StaticIndex::Iterator it(base_.get());
+  for (it.Seek(id); !it.done() && it.id() == id; it.Next()) {
+    if (it.point_data() == point_data) ++count;
+  }
+  return count;
+}
+
+template <class Data, template<typename,typename> class MapType>
+bool S2PointIndexHybrid<Data, MapType>::IsRemoved(
+    const Tombstones& tombstones, const typename StaticIndex::Iterator& it) {
+  if (tombstones.empty()) return false;
+  auto tombstone = tombstones.find(it.point_data());
+  if (tombstone == tombstones.end()) return false;
+
+  // Count the identical entries that precede this one.
+  int rank = 0;
+  typename StaticIndex::Iterator prev = it;
+  while (rank < tombstone->second && prev.Prev() && prev.id() == it.id()) {
+    if (prev.point_data() == it.point_data()) ++rank;
+  }
+  return rank < tombstone->second;
+}
+
+template <class Data, template<typename,typename> class MapType>
+std::unique_ptr<typename S2PointIndexHybrid<Data, MapType>::Compaction>
+S2PointIndexHybrid<Data, MapType>::StartCompaction() {
+  S2_DCHECK(!compaction_in_progress_);
+  std::unique_ptr<Compaction> compaction(new Compaction);
+  compaction->base_ = base_;
+  compaction->delta_.reserve(delta_.num_points());
+  for (typename DeltaIndex::Iterator it(&delta_); !it.done(); it.Next()) {
+    compaction->delta_.push_back(it.point_data());
+  }
+  compaction->tombstones_ = tombstones_;
+  compaction_in_progress_ = true;
+  return compaction;
+}
+
+template <class Data, template<typename,typename> class MapType>
+void S2PointIndexHybrid<Data, MapType>::Compaction::Build() {
+  // The base and the delta are both sorted by S2CellId, so merging them adds
+  // the points to the builder in sorted order and build() does not need to
+  // sort them again.
+  typename StaticIndex::builder builder;
+  int num_points = 0;
+  auto delta_it = delta_.begin();
+  typename StaticIndex::Iterator base_it(base_.get());
+  for (; !base_it.done(); base_it.Next()) {
+    if (IsRemoved(tombstones_, base_it)) continue;
+    for (; delta_it != delta_.end() &&
+             S2CellId(delta_it->point()) < base_it.id(); ++delta_it) {
+      builder.Add(*delta_it);
+      ++num_points;
+    }
+    builder.Add(base_it.point_data());
+    ++num_points;
+  }
+  for (; delta_it != delta_.end(); ++delta_it) {
+    builder.Add(*delta_it);
+    ++num_points;
+  }
+  auto new_base = std::make_shared<StaticIndex>();
+  if (num_points > 0) builder.build(*new_base);
+  new_base_ = std::move(new_base);
+
+  // Release the inputs as early as possible.
+  base_.reset();
+  std::vector<PointData>().swap(delta_);
+  tombstones_.clear();
+}
+
+template <class Data, template<typename,typename> class MapType>
+void S2PointIndexHybrid<Data, MapType>::FinishCompaction(
+    std::unique_ptr<Compaction> compaction) {
+  S2_DCHECK(compaction_in_progress_);
+  S2_DCHECK(compaction->new_base_ != nullptr);
+  base_ = std::move(compaction->new_base_);
+  delta_.Clear();
+  tombstones_.clear();
+  num_tombstones_ = 0;
+  compaction_in_progress_ = false;
+
+  // Reapply the updates made during the compaction.  Every point that was
+  // removed was present at the time, and the new base together with the
+  // updates preceding the removal contains exactly the same points.
+  std::vector<std::pair<bool, PointData>> update_log;
+  update_log.swap(update_log_);
+  for (const auto& update : update_log) {
+    if (update.first) {
+      Add(update.second);
+    } else {
+      bool removed = Remove(update.second);
+      S2_DCHECK(removed);
+    }
+  }
+}
+
+template <class Data, template<typename,typename> class MapType>
+void S2PointIndexHybrid<Data, MapType>::Compact() {
+  auto compaction = StartCompaction();
+  compaction->Build();
+  FinishCompaction(std::move(compaction));
+}
+
+template <class Data, template<typename,typename> class MapType>
+inline S2PointIndexHybrid<Data, MapType>::Iterator::Iterator()
+    : tombstones_(nullptr) {
+}
+
+template <class Data, template<typename,typename> class MapType>
+inline S2PointIndexHybrid<Data, MapType>::Iterator::Iterator(
+    const S2PointIndexHybrid* index) {
+  Init(index);
+}
+
+template <class Data, template<typename,typename> class MapType>
+void S2PointIndexHybrid<Data, MapType>::Iterator::Init(
+    const S2PointIndexHybrid* index) {
+  tombstones_ = &index->tombstones_;
+  base_iter_.Init(index->base_.get());
+  delta_iter_.Init(&index->delta_);
+  SkipRemoved();
+}
+
+template <class Data, template<typename,typename> class MapType>
+inline S2CellId S2PointIndexHybrid<Data, MapType>::Iterator::id() const {
+  S2_DCHECK(!done());
+  return at_base() ? base_iter_.id() : delta_iter_.id();
+}
+
+template <class Data, template<typename,typename> class MapType>
+inline const typename S2PointIndexHybrid<Data, MapType>::PointData&
+S2PointIndexHybrid<Data, MapType>::Iterator::point_data() const {
+  S2_DCHECK(!done());
+  return at_base() ? base_iter_.point_data() : delta_iter_.point_data();
+}
+
+template <class Data, template<typename,typename> class MapType>
+inline void S2PointIndexHybrid<Data, MapType>::Iterator::SkipRemoved() {
+  while (!base_iter_.done() && IsRemoved(*tombstones_, base_iter_)) {
+    base_iter_.Next();
+  }
+}
+
+template <class Data, template<typename,typename> class MapType>
+void S2PointIndexHybrid<Data, MapType>::Iterator::Begin() {
+  base_iter_.Begin();
+  SkipRemoved();
+  delta_iter_.Begin();
+}
+
+template <class Data, template<typename,typename> class MapType>
+void S2PointIndexHybrid<Data, MapType>::Iterator::Finish() {
+  base_iter_.Finish();
+  delta_iter_.Finish();
+}
+
+template <class Data, template<typename,typename> class MapType>
+void S2PointIndexHybrid<Data, MapType>::Iterator::Next() {
+  S2_DCHECK(!done());
+  if (at_base()) {
+    base_iter_.Next();
+    SkipRemoved();
+  } else {
+    delta_iter_.Next();
+  }
+}
+
+template <class Data, template<typename,typename> class MapType>
+bool S2PointIndexHybrid<Data, MapType>::Iterator::Prev() {
+  // The previous entry is the larger of the entries preceding the current
+  // positions of the two underlying iterators.  (Each underlying iterator
+  // is positioned at the first of its entries that follows the previous
+  // entry of the merged sequence.)
+  typename StaticIndex::Iterator base_prev = base_iter_;
+  bool has_base_prev;
+  while ((has_base_prev = base_prev.Prev()) &&
+         IsRemoved(*tombstones_, base_prev)) {
+    continue;
+  }
+  typename DeltaIndex::Iterator delta_prev = delta_iter_;
+  bool has_delta_prev = delta_prev.Prev();
+  if (has_base_prev &&
+      (!has_delta_prev || base_prev.id() > delta_prev.id())) {
+    base_iter_ = base_prev;
+  } else if (has_delta_prev) {
+    delta_iter_ = delta_prev;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+template <class Data, template<typename,typename> class MapType>
+void S2PointIndexHybrid<Data, MapType>::Iterator::Seek(S2CellId target) {
+  base_iter_.Seek(target);
+  SkipRemoved();
+  delta_iter_.Seek(target);
+}
+
+#endif  // S2_S2POINT_INDEX_HYBRID_H_
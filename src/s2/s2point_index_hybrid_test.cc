@@ -0,0 +1,189 @@
+// Copyright 2018 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "s2/s2point_index_hybrid.h"
+
+#include <set>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include "s2/s1angle.h"
+#include "s2/s2cell_id.h"
+#include "s2/s2closest_point_query.h"
+#include "s2/s2testing.h"
+
+using std::vector;
+
+class S2PointIndexHybridTest : public ::testing::Test {
+ protected:
+  using Index = S2PointIndexHybrid<int, block_map>;
+  using PointData = Index::PointData;
+  using Contents = std::multiset<PointData>;
+  Index index_;
+  Contents contents_;
+
+ public:
+  void Add(const S2Point& point, int data) {
+    index_.Add(point, data);
+    contents_.insert(PointData(point, data));
+  }
+
+  void Remove(const PointData& point_data) {
+    // If there are multiple copies, remove only one.
+    contents_.erase(contents_.find(point_data));
+    EXPECT_TRUE(index_.Remove(point_data));
+  }
+
+  // Returns a random point that is present in the index.
+  PointData RandomContent() {
+    auto it = contents_.begin();
+    std::advance(it, S2Testing::rnd.Uniform(contents_.size()));
+    return *it;
+  }
+
+  void Verify() {
+    EXPECT_EQ(contents_.size(), index_.num_points());
+    VerifyContents();
+    VerifyIteratorMethods();
+  }
+
+  void VerifyContents() {
+    Contents remaining = contents_;
+    for (Index::Iterator it(&index_); !it.done(); it.Next()) {
+      Contents::iterator element = remaining.find(it.point_data());
+      ASSERT_TRUE(element != remaining.end());
+      remaining.erase(element);
+    }
+    EXPECT_TRUE(remaining.empty());
+  }
+
+  void VerifyIteratorMethods() {
+    Index::Iterator it(&index_);
+    vector<S2CellId> ids;
+    for (; !it.done(); it.Next()) {
+      EXPECT_EQ(it.id(), S2CellId(it.point()));
+      if (!ids.empty()) EXPECT_GE(it.id(), ids.back());
+      ids.push_back(it.id());
+    }
+    // Now iterate backwards and check that we visit the same entries.
+    for (int i = ids.size() - 1; i >= 0; --i) {
+      ASSERT_TRUE(it.Prev());
+      EXPECT_EQ(ids[i], it.id());
+    }
+    EXPECT_FALSE(it.Prev());
+
+    // Check that Seek() positions the iterator at the first entry >= target.
+    for (int i = 0; i < ids.size(); ++i) {
+      Index::Iterator it2(&index_);
+      it2.Seek(ids[i]);
+      ASSERT_FALSE(it2.done());
+      EXPECT_EQ(ids[i], it2.id());
+      if (i == 0 || ids[i - 1] != ids[i]) {
+        EXPECT_EQ(i == 0, !it2.Prev());
+      }
+    }
+  }
+};
+
+TEST_F(S2PointIndexHybridTest, NoPoints) {
+  Verify();
+}
+
+TEST_F(S2PointIndexHybridTest, AddRemoveAndCompact) {
+  for (int iter = 0; iter < 20; ++iter) {
+    for (int i = 0; i < 100; ++i) {
+      Add(S2Testing::RandomPoint(), S2Testing::rnd.Uniform(100));
+    }
+    // Add some duplicate points, sometimes with the same data.
+    for (int i = 0; i < 10; ++i) {
+      PointData x = RandomContent();
+      Add(x.point(), S2Testing::rnd.OneIn(2) ? x.data() : x.data() + 1);
+    }
+    for (int i = 0; i < 50; ++i) {
+      Remove(RandomContent());
+    }
+    Verify();
+    if (iter % 3 == 0) {
+      index_.Compact();
+      EXPECT_EQ(0, index_.num_delta_points());
+      EXPECT_EQ(0, index_.num_tombstones());
+      Verify();
+    }
+  }
+  EXPECT_GT(index_.num_tombstones(), 0);
+  EXPECT_FALSE(index_.Remove(S2Testing::RandomPoint(), 0));
+}
+
+TEST_F(S2PointIndexHybridTest, UpdatesDuringCompaction) {
+  for (int i = 0; i < 1000; ++i) {
+    Add(S2Testing::RandomPoint(), i);
+  }
+  index_.Compact();
+  for (int i = 0; i < 100; ++i) {
+    Remove(RandomContent());
+    Add(S2Testing::RandomPoint(), i);
+  }
+  auto compaction = index_.StartCompaction();
+  std::thread builder([&compaction]() { compaction->Build(); });
+  for (int i = 0; i < 100; ++i) {
+    Remove(RandomContent());
+    Add(S2Testing::RandomPoint(), i);
+  }
+  Verify();
+  builder.join();
+  index_.FinishCompaction(std::move(compaction));
+  EXPECT_LE(index_.num_delta_points(), 100);
+  Verify();
+}
+
+TEST(S2PointIndexHybrid, ClosestPointsMatchS2PointIndex) {
+  using Index = S2PointIndexHybrid<int, block_map>;
+  S2PointIndex<int> expected_index;
+  Index index;
+  vector<S2Point> points;
+  for (int i = 0; i < 5000; ++i) {
+    points.push_back(S2Testing::RandomPoint());
+    expected_index.Add(points.back(), i);
+    index.Add(points.back(), i);
+  }
+  index.Compact();
+  for (int i = 0; i < 1000; ++i) {
+    expected_index.Remove(points[i], i);
+    index.Remove(points[i], i);
+    S2Point p = S2Testing::RandomPoint();
+    expected_index.Add(p, -i);
+    index.Add(p, -i);
+  }
+  S2ClosestPointQuery<int> expected_query(&expected_index);
+  S2ClosestPointQuery<int, Index> query(&index);
+  for (auto* options : {expected_query.mutable_options(),
+                        query.mutable_options()}) {
+    options->set_max_results(10);
+    options->set_max_distance(S1Angle::Degrees(5));
+  }
+  for (int i = 0; i < 100; ++i) {
+    S2Point target_point = S2Testing::RandomPoint();
+    S2ClosestPointQuery<int>::PointTarget expected_target(target_point);
+    S2ClosestPointQuery<int, Index>::PointTarget target(target_point);
+    auto expected = expected_query.FindClosestPoints(&expected_target);
+    auto actual = query.FindClosestPoints(&target);
+    ASSERT_EQ(expected.size(), actual.size());
+    for (int j = 0; j < expected.size(); ++j) {
+      EXPECT_EQ(expected[j].distance(), actual[j].distance());
+      EXPECT_EQ(expected[j].data(), actual[j].data());
+    }
+  }
+}
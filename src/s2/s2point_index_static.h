@@ -17,43 +17,22 @@
 #ifndef S2_S2POINT_INDEX_STATIC_H_
 #define S2_S2POINT_INDEX_STATIC_H_
 
-#include "s2/s2cell_id.h"
+#include <algorithm>
 #include <tuple>
 #include <type_traits>
+#include <utility>
+#include <vector>
+#include "s2/s2cell_id.h"
+#include "s2/s2point_index.h"
 #include "s2/util/compressed_maps/compressed_maps.h"
 
 template <class Data, template<typename,typename> class MapType>
 class S2PointIndexStatic {
 public:
-    // PointData is essentially std::pair with named fields.  It stores an
-    // S2Point and its associated data, taking advantage of the "empty base
-    // optimization" to ensure that no extra space is used when Data is empty.
-    class PointData {
-    public:
-        PointData() {} // Needed by STL
-        PointData(const S2Point& point, const Data& data)
-            : tuple_(point, data)
-        {
-        }
-
-        const S2Point& point() const { return std::get<0>(tuple_); }
-        const Data& data() const { return std::get<1>(tuple_); }
-
-        friend bool operator==(const PointData& x, const PointData& y)
-        {
-            return x.tuple_ == y.tuple_;
-        }
-        friend bool operator<(const PointData& x, const PointData& y)
-        {
-            return x.tuple_ < y.tuple_;
-        }
-
-    private:
-        // Note that std::tuple has special template magic to ensure that Data
-        // doesn't take up any space when it is empty.  (This is not true if you
-        // simply declare a member of type Data.)
-        std::tuple<S2Point, Data> tuple_;
-    };
+    // PointData stores an S2Point and its associated data.  It is the same
+    // type as S2PointIndex<Data>::PointData, so that the two kinds of index
+    // can be used interchangeably (see S2PointIndexHybrid).
+    using PointData = typename S2PointIndex<Data>::PointData;
 
     // Default constructor.
     S2PointIndexStatic() {};
@@ -61,7 +40,7 @@ public:
     // Returns the number of points in the index.
     int num_points() const
     {
-        m_map.size();
+        return m_map.size();
     }
 
     size_t bytes_used() const {
@@ -73,17 +52,31 @@ private:
     using Map = MapType<S2CellId, PointData>;
     Map m_map;
 public:
+    // Points may be added in any order.  Adding them in S2CellId order
+    // (e.g. when merging existing indexes, see S2PointIndexHybrid) avoids
+    // sorting them in build().  Points with the same S2CellId keep the order
+    // in which they were added.
     class builder {
     public:
         void build(S2PointIndexStatic& static_index)
         {
-            Map(map_).swap(static_index.m_map);
+            if (!sorted_) {
+                std::stable_sort(entries_.begin(), entries_.end(),
+                                 [](const Entry& a, const Entry& b) {
+                                     return a.first < b.first;
+                                 });
+                sorted_ = true;
+            }
+            Map(entries_).swap(static_index.m_map);
         }
 
         void Add(const PointData& point_data)
         {
             S2CellId id(point_data.point());
-            map_.emplace(std::make_pair(id, point_data));
+            if (!entries_.empty() && id < entries_.back().first) {
+                sorted_ = false;
+            }
+            entries_.emplace_back(id, point_data);
         }
 
         void Add(const S2Point& point, const Data& data)
@@ -98,7 +91,9 @@ public:
         }
 
     private:
-        std::map<S2CellId, PointData> map_;
+        using Entry = std::pair<S2CellId, PointData>;
+        std::vector<Entry> entries_;
+        bool sorted_ = true;
     };
 
     class Iterator {
@@ -201,5 +196,11 @@ private:
 template<class Key>
 using S2PointIndexStaticEF = S2PointIndexStatic<Key,ef_map>;
 
+// Uses a block-structured layout (see block_map.h) that is larger than the
+// Elias-Fano representation but avoids a select operation and a separate
+// random access into the values for every point visited by a query.
+template<class Key>
+using S2PointIndexStaticBlock = S2PointIndexStatic<Key,block_map>;
+
 
 #endif // S2_S2POINT_INDEX_STATIC_H_
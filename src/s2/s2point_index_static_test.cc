@@ -0,0 +1,143 @@
+// Copyright 2018 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "s2/s2point_index_static.h"
+
+#include <map>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include "s2/s1angle.h"
+#include "s2/s2cap.h"
+#include "s2/s2cell_id.h"
+#include "s2/s2closest_point_query.h"
+#include "s2/s2point_index.h"
+#include "s2/s2testing.h"
+
+using std::vector;
+
+namespace {
+
+using BlockIndex = S2PointIndexStaticBlock<int>;
+
+// Builds a block_map and an std::map containing "n" random cell ids.
+void BuildMaps(int n, std::map<S2CellId, int>* expected,
+               block_map<S2CellId, int>* actual) {
+  while (expected->size() < n) {
+    (*expected)[S2CellId(S2Testing::RandomPoint())] = expected->size();
+  }
+  block_map<S2CellId, int>(*expected).swap(*actual);
+}
+
+TEST(BlockMap, IterationAndLowerBound) {
+  for (int n : {0, 1, 7, 8, 9, 63, 64, 65, 1000}) {
+    S2Testing::rnd.Reset(n + 1);
+    std::map<S2CellId, int> expected;
+    block_map<S2CellId, int> actual;
+    BuildMaps(n, &expected, &actual);
+    ASSERT_EQ(n, actual.size());
+
+    auto it = actual.begin();
+    for (const auto& entry : expected) {
+      ASSERT_TRUE(it != actual.end());
+      EXPECT_EQ(entry.first, it->first);
+      EXPECT_EQ(entry.second, it->second);
+      ++it;
+    }
+    EXPECT_TRUE(it == actual.end());
+
+    // Test lower_bound() with keys that are present, absent, and beyond
+    // either end of the map.
+    vector<S2CellId> keys = {S2CellId::Begin(S2CellId::kMaxLevel),
+                             S2CellId::End(S2CellId::kMaxLevel).prev()};
+    for (const auto& entry : expected) {
+      keys.push_back(entry.first);
+      keys.push_back(entry.first.next());
+      keys.push_back(entry.first.prev());
+    }
+    for (S2CellId key : keys) {
+      auto expected_it = expected.lower_bound(key);
+      auto actual_it = actual.lower_bound(key);
+      ASSERT_EQ(expected_it == expected.end(), actual_it == actual.end());
+      if (expected_it != expected.end()) {
+        EXPECT_EQ(expected_it->first, actual_it->first);
+        EXPECT_EQ(std::distance(expected.begin(), expected_it),
+                  actual_it.position());
+      }
+    }
+  }
+}
+
+TEST(S2PointIndexStaticBlock, IteratorMethods) {
+  BlockIndex index;
+  BlockIndex::builder builder;
+  for (int i = 0; i < 100; ++i) {
+    builder.Add(S2Testing::RandomPoint(), i);
+  }
+  builder.build(index);
+  EXPECT_EQ(100, index.num_points());
+
+  BlockIndex::Iterator it(&index);
+  EXPECT_FALSE(it.Prev());
+  S2CellId prev_id = S2CellId::None();
+  int count = 0;
+  for (; !it.done(); it.Next(), ++count) {
+    EXPECT_EQ(it.id(), S2CellId(it.point()));
+    EXPECT_GT(it.id(), prev_id);
+    BlockIndex::Iterator it2(&index);
+    it2.Seek(it.id());
+    EXPECT_EQ(it.id(), it2.id());
+    EXPECT_EQ(it.data(), it2.data());
+    prev_id = it.id();
+  }
+  EXPECT_EQ(100, count);
+  EXPECT_TRUE(it.Prev());
+  EXPECT_EQ(prev_id, it.id());
+}
+
+TEST(S2PointIndexStaticBlock, ClosestPointsMatchS2PointIndex) {
+  S2PointIndex<int> index;
+  BlockIndex static_index;
+  BlockIndex::builder builder;
+  for (int i = 0; i < 10000; ++i) {
+    S2Point p = S2Testing::RandomPoint();
+    index.Add(p, i);
+    builder.Add(p, i);
+  }
+  builder.build(static_index);
+
+  S2ClosestPointQuery<int> query(&index);
+  S2ClosestPointQuery<int, BlockIndex> static_query(&static_index);
+  for (auto* options : {query.mutable_options(),
+                        static_query.mutable_options()}) {
+    options->set_max_results(10);
+    options->set_max_distance(S1Angle::Degrees(5));
+  }
+  for (int i = 0; i < 100; ++i) {
+    S2Point target_point = S2Testing::RandomPoint();
+    S2ClosestPointQuery<int>::PointTarget target(target_point);
+    S2ClosestPointQuery<int, BlockIndex>::PointTarget static_target(
+        target_point);
+    auto expected = query.FindClosestPoints(&target);
+    auto actual = static_query.FindClosestPoints(&static_target);
+    ASSERT_EQ(expected.size(), actual.size());
+    for (int j = 0; j < expected.size(); ++j) {
+      EXPECT_EQ(expected[j].distance(), actual[j].distance());
+      EXPECT_EQ(expected[j].data(), actual[j].data());
+    }
+  }
+}
+
+}  // namespace
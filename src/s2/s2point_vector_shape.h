@@ -78,6 +78,13 @@ class S2PointVectorShape : public S2Shape {
   ChainPosition chain_position(int e) const final {
     return ChainPosition(e, 0);
   }
+  void GetEdges(int start, int n, Edge* edges) const final {
+    S2_DCHECK(0 <= start && start + n <= num_edges());
+    for (int i = 0; i < n; ++i) {
+      const S2Point& p = points_[start + i];
+      edges[i] = Edge(p, p);
+    }
+  }
   TypeTag type_tag() const override { return kTypeTag; }
 
  private:
@@ -1606,6 +1606,22 @@ S2Shape::ChainPosition S2Polygon::Shape::chain_position(int e) const {
   return ChainPosition(i, e);
 }
 
+void S2Polygon::Shape::GetEdges(int start, int n, Edge* edges) const {
+  S2_DCHECK(0 <= start && start + n <= num_edges());
+  if (n == 0) return;
+  // Locate the first edge, and then walk through the loops sequentially
+  // rather than searching for the loop containing each edge.
+  ChainPosition pos = Shape::chain_position(start);
+  const S2Loop* loop = polygon_->loop(pos.chain_id);
+  for (int i = 0, j = pos.offset; i < n; ++i, ++j) {
+    if (j == loop->num_vertices()) {
+      loop = polygon_->loop(++pos.chain_id);
+      j = 0;
+    }
+    edges[i] = Edge(loop->oriented_vertex(j), loop->oriented_vertex(j + 1));
+  }
+}
+
 size_t S2Polygon::SpaceUsed() const {
   size_t size = sizeof(*this);
   for (int i = 0; i < num_loops(); ++i) {
@@ -723,6 +723,7 @@ class S2Polygon final : public S2Region {
     Chain chain(int i) const final;
     Edge chain_edge(int i, int j) const final;
     ChainPosition chain_position(int e) const final;
+    void GetEdges(int start, int n, Edge* edges) const final;
     TypeTag type_tag() const override { return kTypeTag; }
 
    private:
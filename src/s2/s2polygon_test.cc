@@ -2956,6 +2956,15 @@ void TestPolygonShape(const S2Polygon& polygon) {
       EXPECT_EQ(loop_i->oriented_vertex(j+1), edge.v1);
     }
   }
+  // Check that GetEdges() agrees with edge() for ranges spanning loops.
+  for (int start = 0; start < shape.num_edges(); start += 5) {
+    int n = std::min(13, shape.num_edges() - start);
+    vector<S2Shape::Edge> edges(n);
+    shape.GetEdges(start, n, edges.data());
+    for (int i = 0; i < n; ++i) {
+      EXPECT_EQ(shape.edge(start + i), edges[i]);
+    }
+  }
   EXPECT_EQ(2, shape.dimension());
   EXPECT_FALSE(shape.is_empty());
   EXPECT_FALSE(shape.is_full());
@@ -322,6 +322,13 @@ class S2Polyline final : public S2Region {
     ChainPosition chain_position(int e) const final {
       return ChainPosition(0, e);
     }
+    void GetEdges(int start, int n, Edge* edges) const final {
+      S2_DCHECK(0 <= start && start + n <= num_edges());
+      for (int i = 0; i < n; ++i) {
+        edges[i] = Edge(polyline_->vertex(start + i),
+                        polyline_->vertex(start + i + 1));
+      }
+    }
     TypeTag type_tag() const override { return kTypeTag; }
 
    private:
@@ -25,8 +25,10 @@
 #include <vector>
 
 #include "s2/base/logging.h"
+#include "s2/third_party/absl/base/integral_types.h"
 #include "s2/third_party/absl/memory/memory.h"
 #include "s2/util/math/mathutil.h"
+#include "s2/util/thread/parallel_for.h"
 
 namespace s2polyline_alignment {
 
@@ -139,6 +141,69 @@ bool Window::IsValid() const {
   return true;
 }
 
+VertexCoordinates::VertexCoordinates(const S2Polyline& polyline) {
+  const int n = polyline.num_vertices();
+  x_.reserve(n);
+  y_.reserve(n);
+  z_.reserve(n);
+  for (int i = 0; i < n; ++i) {
+    const S2Point& v = polyline.vertex(i);
+    x_.push_back(v.x());
+    y_.push_back(v.y());
+    z_.push_back(v.z());
+  }
+}
+
+// The arithmetic is performed in the same order as (p - v).Norm2(), so the
+// results do not depend on whether this loop is vectorized.
+void VertexCoordinates::GetSquaredDistances(const S2Point& p, const int start,
+                                            const int end,
+                                            double* distances) const {
+  const double px = p.x(), py = p.y(), pz = p.z();
+  const double* x = x_.data();
+  const double* y = y_.data();
+  const double* z = z_.data();
+  for (int i = start; i < end; ++i) {
+    const double dx = px - x[i];
+    const double dy = py - y[i];
+    const double dz = pz - z[i];
+    distances[i] = dx * dx + dy * dy + dz * dz;
+  }
+}
+
+// Returns the lower bound described in GetVertexAlignmentCostLowerBound,
+// summed over the vertices of `a` only. The terms are added in the same
+// order as they appear along any warp path, and since floating-point
+// addition is monotonic, the result never exceeds the computed cost of any
+// warp path.
+double DirectedCostLowerBound(const S2Polyline& a, const S2Polyline& b,
+                              const S2Cap& b_cap) {
+  // The distance from a point to the cap is bounded using the triangle
+  // inequality for chord lengths. The cap radius is increased slightly to
+  // account for rounding errors in the distance computations.
+  const double kRadiusError = 1e-14;
+  const int a_n = a.num_vertices();
+  const int b_n = b.num_vertices();
+  const S2Point& center = b_cap.center();
+  const double radius = std::sqrt(b_cap.radius().length2()) + kRadiusError;
+  double cost = (a.vertex(0) - b.vertex(0)).Norm2();
+  for (int i = 1; i < a_n - 1; ++i) {
+    const double distance = (a.vertex(i) - center).Norm() - radius;
+    if (distance > 0) cost += distance * distance;
+  }
+  if (a_n > 1 || b_n > 1) {
+    cost += (a.vertex(a_n - 1) - b.vertex(b_n - 1)).Norm2();
+  }
+  return cost;
+}
+
+double GetVertexAlignmentCostLowerBound(const S2Polyline& a, const S2Cap& a_cap,
+                                        const S2Polyline& b,
+                                        const S2Cap& b_cap) {
+  return std::max(DirectedCostLowerBound(a, b, b_cap),
+                  DirectedCostLowerBound(b, a, a_cap));
+}
+
 inline double BoundsCheckedTableCost(const int row, const int col,
                                      const ColumnStride& stride,
                                      const CostTable& table) {
@@ -178,17 +243,22 @@ VertexAlignment DynamicTimewarp(const S2Polyline& a, const S2Polyline& b,
   const int rows = a.num_vertices();
   const int cols = b.num_vertices();
   auto costs = CostTable(rows, std::vector<double>(cols));
+  const VertexCoordinates b_coords(b);
 
   ColumnStride curr;
   ColumnStride prev = ColumnStride::All();
   for (int row = 0; row < rows; ++row) {
     curr = w.GetColumnStride(row);
+    // First fill in the distances for this row (a vectorized loop), and then
+    // add the cost of the best predecessor of each cell.
+    double* row_costs = costs[row].data();
+    b_coords.GetSquaredDistances(a.vertex(row), curr.start, curr.end,
+                                 row_costs);
     for (int col = curr.start; col < curr.end; ++col) {
       double d_cost = BoundsCheckedTableCost(row - 1, col - 1, prev, costs);
       double u_cost = BoundsCheckedTableCost(row - 1, col - 0, prev, costs);
       double l_cost = BoundsCheckedTableCost(row - 0, col - 1, curr, costs);
-      costs[row][col] = std::min({d_cost, u_cost, l_cost}) +
-                        (a.vertex(row) - b.vertex(col)).Norm2();
+      row_costs[col] += std::min({d_cost, u_cost, l_cost});
     }
     prev = curr;
   }
@@ -230,6 +300,66 @@ VertexAlignment DynamicTimewarp(const S2Polyline& a, const S2Polyline& b,
   return VertexAlignment(costs.back().back(), warp_path);
 }
 
+// Returns a Window covering the cells of an (rows x cols) cost table that
+// are within `radius` columns of the diagonal. Row `i` covers the columns
+// [i * cols / rows, (i + 1) * cols / rows) (rounded outwards), so that
+// consecutive rows always overlap or touch diagonally and the window
+// contains at least one warp path.
+Window DiagonalBand(const int rows, const int cols, const int radius) {
+  std::vector<ColumnStride> strides(rows);
+  for (int row = 0; row < rows; ++row) {
+    const int64 start = static_cast<int64>(row) * cols / rows;
+    const int64 end = (static_cast<int64>(row + 1) * cols + rows - 1) / rows;
+    strides[row] = {static_cast<int>(std::max<int64>(0, start - radius)),
+                    static_cast<int>(std::min<int64>(cols, end + radius))};
+  }
+  return Window(strides);
+}
+
+// Computes the discrete Frechet distance by filling in the cells of the DP
+// table that are inside the search window. This is the same recurrence as
+// DynamicTimewarp with the sum of the costs replaced by their maximum, i.e.
+//
+// table[i][j] = max(cost(i,j), min(table[i-1][j-1], table[i][j-1],
+//                                  table[i-1][j]))
+//
+// Since we only need the final value, we keep just two rows of the table.
+// Costs are squared chordal distances, which are monotonic in the true
+// spherical distance and therefore yield the same warp path.
+S1ChordAngle DiscreteFrechet(const S2Polyline& a, const S2Polyline& b,
+                             const Window& w) {
+  const int rows = a.num_vertices();
+  const int cols = b.num_vertices();
+  std::vector<double> prev_costs(cols, DOUBLE_MAX);
+  std::vector<double> costs(cols, DOUBLE_MAX);
+  std::vector<double> distances(cols);
+  const VertexCoordinates b_coords(b);
+
+  ColumnStride prev = {0, 0};
+  for (int row = 0; row < rows; ++row) {
+    const ColumnStride curr = w.GetColumnStride(row);
+    b_coords.GetSquaredDistances(a.vertex(row), curr.start, curr.end,
+                                 distances.data());
+    double l_cost = (row == 0) ? 0.0 : DOUBLE_MAX;
+    for (int col = curr.start; col < curr.end; ++col) {
+      double min_cost = l_cost;
+      if (prev.InRange(col - 1)) {
+        min_cost = std::min(min_cost, prev_costs[col - 1]);
+      }
+      if (prev.InRange(col)) {
+        min_cost = std::min(min_cost, prev_costs[col]);
+      }
+      costs[col] = std::max(min_cost, distances[col]);
+      l_cost = costs[col];
+    }
+    std::swap(costs, prev_costs);
+    prev = curr;
+  }
+  const double cost = prev_costs.back();
+  if (cost == DOUBLE_MAX) return S1ChordAngle::Infinity();
+  return S1ChordAngle::FromLength2(std::min(cost, 4.0));
+}
+
 std::unique_ptr<S2Polyline> HalfResolution(const S2Polyline& in) {
   const int n = in.num_vertices();
   std::vector<S2Point> vertices;
@@ -262,18 +392,29 @@ double GetExactVertexAlignmentCost(const S2Polyline& a, const S2Polyline& b) {
   const int b_n = b.num_vertices();
   S2_CHECK(a_n > 0) << "A is empty polyline.";
   S2_CHECK(b_n > 0) << "B is empty polyline.";
-  std::vector<double> cost(b_n, DOUBLE_MAX);
-  double left_diag_min_cost = 0;
+  std::vector<double> prev_cost(b_n, DOUBLE_MAX);
+  std::vector<double> cost(b_n);
+  std::vector<double> distances(b_n);
+  const VertexCoordinates b_coords(b);
   for (int row = 0; row < a_n; ++row) {
-    for (int col = 0; col < b_n; ++col) {
-      double up_cost = cost[col];
-      cost[col] = std::min(left_diag_min_cost, up_cost) +
-                  (a.vertex(row) - b.vertex(col)).Norm2();
-      left_diag_min_cost = std::min(cost[col], up_cost);
+    b_coords.GetSquaredDistances(a.vertex(row), 0, b_n, distances.data());
+    // The costs of reaching each cell from the previous row are independent
+    // of each other, so this loop is vectorized. Only the costs of reaching
+    // each cell from the left need to be computed sequentially. Since
+    // min(x, y) + d = min(x + d, y + d) exactly in floating point, this
+    // gives the same result as the usual single loop.
+    cost[0] = ((row == 0) ? 0.0 : prev_cost[0]) + distances[0];
+    for (int col = 1; col < b_n; ++col) {
+      cost[col] = std::min(prev_cost[col - 1], prev_cost[col]) + distances[col];
     }
-    left_diag_min_cost = DOUBLE_MAX;
+    double l_cost = cost[0];
+    for (int col = 1; col < b_n; ++col) {
+      l_cost = std::min(cost[col], l_cost + distances[col]);
+      cost[col] = l_cost;
+    }
+    std::swap(cost, prev_cost);
   }
-  return cost.back();
+  return prev_cost.back();
 }
 
 VertexAlignment GetExactVertexAlignment(const S2Polyline& a,
@@ -330,6 +471,205 @@ VertexAlignment GetApproxVertexAlignment(const S2Polyline& a,
   return GetApproxVertexAlignment(a, b, radius);
 }
 
+// This is the constant-space implementation of the discrete Frechet distance,
+// which has the same structure as GetExactVertexAlignmentCost.
+S1ChordAngle GetDiscreteFrechetDistance(const S2Polyline& a,
+                                        const S2Polyline& b) {
+  const int a_n = a.num_vertices();
+  const int b_n = b.num_vertices();
+  S2_CHECK(a_n > 0) << "A is empty polyline.";
+  S2_CHECK(b_n > 0) << "B is empty polyline.";
+  std::vector<double> cost(b_n, DOUBLE_MAX);
+  std::vector<double> distances(b_n);
+  const VertexCoordinates b_coords(b);
+  double left_diag_min_cost = 0;
+  for (int row = 0; row < a_n; ++row) {
+    b_coords.GetSquaredDistances(a.vertex(row), 0, b_n, distances.data());
+    for (int col = 0; col < b_n; ++col) {
+      double up_cost = cost[col];
+      cost[col] = std::max(std::min(left_diag_min_cost, up_cost),
+                           distances[col]);
+      left_diag_min_cost = std::min(cost[col], up_cost);
+    }
+    left_diag_min_cost = DOUBLE_MAX;
+  }
+  return S1ChordAngle::FromLength2(std::min(cost.back(), 4.0));
+}
+
+S1ChordAngle GetBandedDiscreteFrechetDistance(const S2Polyline& a,
+                                              const S2Polyline& b,
+                                              const int radius) {
+  const int a_n = a.num_vertices();
+  const int b_n = b.num_vertices();
+  S2_CHECK(a_n > 0) << "A is empty polyline.";
+  S2_CHECK(b_n > 0) << "B is empty polyline.";
+  S2_CHECK(radius >= 0) << "Radius is negative.";
+  return DiscreteFrechet(a, b, DiagonalBand(a_n, b_n, radius));
+}
+
+// This is a "free space" search: reachable[col] records whether cell (row,
+// col) can be reached by a warp path whose vertex pairs are all closer than
+// `limit`. The reachable cells of each row are confined to the columns
+// [start, end), and each row is scanned only from the first reachable column
+// of the previous row until no more cells can be reached. Cells outside the
+// scanned range of the current row hold stale values and are never read.
+bool IsDiscreteFrechetDistanceLess(const S2Polyline& a, const S2Polyline& b,
+                                   const S1ChordAngle limit) {
+  const int a_n = a.num_vertices();
+  const int b_n = b.num_vertices();
+  S2_CHECK(a_n > 0) << "A is empty polyline.";
+  S2_CHECK(b_n > 0) << "B is empty polyline.";
+  const double limit2 = limit.length2();
+  auto is_close = [&a, &b, limit2](int row, int col) {
+    return (a.vertex(row) - b.vertex(col)).Norm2() < limit2;
+  };
+  // The warp path always starts at (0, 0) and ends at (a_n - 1, b_n - 1).
+  if (!is_close(0, 0) || !is_close(a_n - 1, b_n - 1)) return false;
+
+  std::vector<bool> prev_reachable(b_n), reachable(b_n);
+  ColumnStride prev = {0, 1};
+  prev_reachable[0] = true;
+  for (int col = 1; col < b_n && is_close(0, col); ++col) {
+    prev_reachable[col] = true;
+    prev.end = col + 1;
+  }
+  for (int row = 1; row < a_n; ++row) {
+    ColumnStride curr = {b_n, 0};
+    bool l_reachable = false;
+    for (int col = prev.start; col < b_n; ++col) {
+      // Beyond the end of the previous row, cells can only be reached from
+      // the left (or diagonally from the last cell of the previous row).
+      if (col > prev.end && !l_reachable) break;
+      bool from_prev = ((prev.InRange(col) && prev_reachable[col]) ||
+                        (prev.InRange(col - 1) && prev_reachable[col - 1]));
+      l_reachable = (from_prev || l_reachable) && is_close(row, col);
+      reachable[col] = l_reachable;
+      if (l_reachable) {
+        curr.start = std::min(curr.start, col);
+        curr.end = col + 1;
+      }
+    }
+    if (curr.start >= curr.end) return false;
+    std::swap(reachable, prev_reachable);
+    prev = curr;
+  }
+  return prev.end == b_n;
+}
+
+// The pairwise costs of N polylines, stored as the upper triangle of the
+// (symmetric) cost matrix.
+class PairwiseCosts {
+ public:
+  PairwiseCosts(const int n, const double value)
+      : n_(n), costs_(static_cast<int64>(n) * (n - 1) / 2, value) {}
+
+  // REQUIRES: i != j
+  double& operator()(const int i, const int j) {
+    return (i < j) ? costs_[Index(i, j)] : costs_[Index(j, i)];
+  }
+
+  // Returns the sum of the costs of aligning polyline `i` with all other
+  // polylines, added in increasing order of the other polyline's index.
+  double RowSum(const int i) {
+    double sum = 0.0;
+    for (int j = 0; j < n_; ++j) {
+      if (j != i) sum += (*this)(i, j);
+    }
+    return sum;
+  }
+
+ private:
+  int64 Index(const int i, const int j) const {
+    return static_cast<int64>(i) * (2 * n_ - i - 1) / 2 + (j - i - 1);
+  }
+
+  int n_;
+  std::vector<double> costs_;
+};
+
+// Finds the medoid by visiting candidates in increasing order of the sum of
+// their lower bounds. The missing alignment costs of each candidate are
+// computed in batches (largest lower bound first), and the candidate is
+// abandoned as soon as its bound, refined using all of the costs computed so
+// far, cannot beat the best candidate. The bounds are summed in the same
+// order as the costs in the exhaustive algorithm and never exceed them, so
+// the result is the same.
+int GetMedoidPolylinePruned(
+    const std::vector<std::unique_ptr<S2Polyline>>& polylines,
+    const MedoidOptions& options) {
+  const int num_polylines = polylines.size();
+  std::vector<S2Cap> caps(num_polylines);
+  for (int i = 0; i < num_polylines; ++i) {
+    caps[i] = polylines[i]->GetCapBound();
+  }
+  PairwiseCosts bounds(num_polylines, 0.0);
+  util_thread::ParallelFor(num_polylines, options.num_threads(),
+                             [&](int thread, int i) {
+    for (int j = i + 1; j < num_polylines; ++j) {
+      bounds(i, j) = GetVertexAlignmentCostLowerBound(
+          *polylines[i], caps[i], *polylines[j], caps[j]);
+    }
+  });
+  std::vector<double> bound_sums(num_polylines);
+  for (int i = 0; i < num_polylines; ++i) bound_sums[i] = bounds.RowSum(i);
+  std::vector<int> order(num_polylines);
+  std::iota(order.begin(), order.end(), 0);
+  std::sort(order.begin(), order.end(), [&bound_sums](int i, int j) {
+    return std::make_pair(bound_sums[i], i) < std::make_pair(bound_sums[j], j);
+  });
+
+  // Negative entries are costs that have not been computed yet.
+  PairwiseCosts costs(num_polylines, -1.0);
+  double best_cost = DOUBLE_MAX;
+  int best = -1;
+  // Returns true if candidate `i` cannot be returned as the medoid. In case
+  // of a tie, the candidate with the lowest index is returned.
+  auto is_pruned = [&](const int i) {
+    double bound = 0.0;
+    for (int j = 0; j < num_polylines; ++j) {
+      if (j != i) bound += (costs(i, j) >= 0) ? costs(i, j) : bounds(i, j);
+    }
+    return bound > best_cost || (bound == best_cost && i > best);
+  };
+  // Checking the bound takes O(N) time, so it is done at most about 16
+  // times per candidate.
+  const int batch_size =
+      std::max(4 * options.num_threads(), num_polylines / 16 + 1);
+  std::vector<int> missing;
+  for (int i : order) {
+    // Every remaining candidate has a bound of at least bound_sums[i].
+    if (bound_sums[i] > best_cost) break;
+    missing.clear();
+    for (int j = 0; j < num_polylines; ++j) {
+      if (j != i && costs(i, j) < 0) missing.push_back(j);
+    }
+    std::sort(missing.begin(), missing.end(), [&bounds, i](int j, int k) {
+      return bounds(i, j) > bounds(i, k);
+    });
+    bool pruned = false;
+    for (int start = 0; start < missing.size(); start += batch_size) {
+      if (is_pruned(i)) {
+        pruned = true;
+        break;
+      }
+      const int end = std::min<int>(start + batch_size, missing.size());
+      util_thread::ParallelFor(end - start, options.num_threads(),
+                               [&](int thread, int k) {
+        const int j = missing[start + k];
+        costs(i, j) = CostFn(*polylines[std::min(i, j)],
+                             *polylines[std::max(i, j)], options.approx());
+      });
+    }
+    if (pruned) continue;
+    const double cost = costs.RowSum(i);
+    if (cost < best_cost || (cost == best_cost && i < best)) {
+      best_cost = cost;
+      best = i;
+    }
+  }
+  return best;
+}
+
 // We use some of the symmetry of our metric to avoid computing all N^2
 // alignments. Specifically, because cost_fn(a, b) = cost_fn(b, a), and
 // cost_fn(a, a) = 0, we can compute only the lower triangle of cost matrix
@@ -340,13 +680,28 @@ int GetMedoidPolyline(const std::vector<std::unique_ptr<S2Polyline>>& polylines,
   const bool approx = options.approx();
   S2_CHECK_GT(num_polylines, 0);
 
+  if (options.prune()) return GetMedoidPolylinePruned(polylines, options);
+
   // costs[i] stores total cost of aligning [i] with all other polylines.
   std::vector<double> costs(num_polylines, 0.0);
-  for (int i = 0; i < num_polylines; ++i) {
-    for (int j = i + 1; j < num_polylines; ++j) {
-      double cost = CostFn(*polylines[i], *polylines[j], approx);
-      costs[i] += cost;
-      costs[j] += cost;
+  if (options.num_threads() > 1) {
+    // Compute the rows of the cost matrix in parallel, and then sum each row
+    // in the same order as the serial loop below.
+    PairwiseCosts pair_costs(num_polylines, 0.0);
+    util_thread::ParallelFor(num_polylines, options.num_threads(),
+                             [&](int thread, int i) {
+      for (int j = i + 1; j < num_polylines; ++j) {
+        pair_costs(i, j) = CostFn(*polylines[i], *polylines[j], approx);
+      }
+    });
+    for (int i = 0; i < num_polylines; ++i) costs[i] = pair_costs.RowSum(i);
+  } else {
+    for (int i = 0; i < num_polylines; ++i) {
+      for (int j = i + 1; j < num_polylines; ++j) {
+        double cost = CostFn(*polylines[i], *polylines[j], approx);
+        costs[i] += cost;
+        costs[j] += cost;
+      }
     }
   }
   return std::min_element(costs.begin(), costs.end()) - costs.begin();
@@ -384,6 +739,7 @@ std::unique_ptr<S2Polyline> GetConsensusPolyline(
   if (options.seed_medoid()) {
     MedoidOptions medoid_options;
     medoid_options.set_approx(approx);
+    medoid_options.set_num_threads(options.num_threads());
     seed_index = GetMedoidPolyline(polylines, medoid_options);
   }
   auto consensus = std::unique_ptr<S2Polyline>(polylines[seed_index]->Clone());
@@ -392,12 +748,18 @@ std::unique_ptr<S2Polyline> GetConsensusPolyline(
 
   bool converged = false;
   int iterations = 0;
+  std::vector<WarpPath> warp_paths(num_polylines);
   while (!converged && iterations < options.iteration_cap()) {
+    // The alignments are independent, so they are computed in parallel and
+    // then accumulated in order so that the result is deterministic.
+    util_thread::ParallelFor(num_polylines, options.num_threads(),
+                             [&](int thread, int i) {
+      warp_paths[i] = AlignmentFn(*consensus, *polylines[i], approx).warp_path;
+    });
     std::vector<S2Point> points(num_consensus_vertices, S2Point());
-    for (const auto& polyline : polylines) {
-      const auto alignment = AlignmentFn(*consensus, *polyline, approx);
-      for (const auto& pair : alignment.warp_path) {
-        points[pair.first] += polyline->vertex(pair.second);
+    for (int i = 0; i < num_polylines; ++i) {
+      for (const auto& pair : warp_paths[i]) {
+        points[pair.first] += polylines[i]->vertex(pair.second);
       }
     }
     for (S2Point& p : points) {
@@ -20,6 +20,7 @@
 #include <memory>
 #include <vector>
 
+#include "s2/s1chord_angle.h"
 #include "s2/s2polyline.h"
 
 // This library provides code to compute vertex alignments between S2Polylines.
@@ -74,6 +75,12 @@
 // (3, 2) -> (2, 1) -> (1, 1) -> (0, 0). The VertexAlignment produced containing
 // this has alignment_cost = 7 and warp_path = {(0, 0), (1, 1), (2, 1), (3, 2)}.
 //
+// We also provide methods for computing the discrete Frechet distance between
+// two S2Polylines. This is the same dynamic programming problem with the sum
+// of the pairwise costs replaced by their maximum: it is the smallest value
+// `d` such that both polylines can be traversed by a monotonic warp path whose
+// paired vertices are always within distance `d` of each other.
+//
 // We also provide methods for performing alignment of multiple sequences. These
 // methods return a single, representative polyline from a non-empty collection
 // of polylines, for various definitions of "representative."
@@ -156,6 +163,38 @@ VertexAlignment GetApproxVertexAlignment(const S2Polyline& a,
 VertexAlignment GetApproxVertexAlignment(const S2Polyline& a,
                                          const S2Polyline& b);
 
+// GetDiscreteFrechetDistance takes two non-empty polylines as input, and
+// returns the discrete Frechet distance between them, i.e. the minimum over
+// all warp paths of the maximum distance between a pair of vertices in the
+// path. Like GetExactVertexAlignmentCost, this method takes O(A*B) time and
+// O(max(A,B)) space.
+S1ChordAngle GetDiscreteFrechetDistance(const S2Polyline& a,
+                                        const S2Polyline& b);
+
+// GetBandedDiscreteFrechetDistance computes the discrete Frechet distance
+// between two non-empty polylines, considering only warp paths that stay
+// within a band around the diagonal of the cost table. The band covers the
+// columns that row `i` maps to when the rows are stretched to the number of
+// columns, widened by `radius` columns on each side. Since fewer warp paths
+// are considered, the result is an upper bound on the exact discrete Frechet
+// distance, and it is exact whenever an optimal warp path lies inside the
+// band (e.g. for polylines that are sampled at similar rates along the same
+// route). This method takes O(max(A,B) * (radius + 1)) time and O(B) space.
+S1ChordAngle GetBandedDiscreteFrechetDistance(const S2Polyline& a,
+                                              const S2Polyline& b,
+                                              const int radius);
+
+// IsDiscreteFrechetDistanceLess returns true if the discrete Frechet distance
+// between two non-empty polylines is less than `limit`. Only the cells of the
+// cost table that can be reached by a warp path whose vertex pairs are all
+// closer than `limit` are visited, and the method returns false as soon as
+// no such path can be extended to the next row. For similar polylines this
+// is a narrow band around the optimal warp path, so the typical running time
+// is O(max(A,B) * k), where k is the typical number of vertices of `b` that
+// are within `limit` of a vertex of `a`. The worst case is O(A*B).
+bool IsDiscreteFrechetDistanceLess(const S2Polyline& a, const S2Polyline& b,
+                                   const S1ChordAngle limit);
+
 // GetMedoidPolyline returns the index `p` of a "medoid" polyline from a
 // non-empty collection of `polylines` such that
 //
@@ -168,7 +207,9 @@ VertexAlignment GetApproxVertexAlignment(const S2Polyline& a,
 // Computation may require up to (N^2 - N) / 2 alignment cost function
 // evaluations, for N input polylines. For polylines of length U, V, the
 // alignment cost function evaluation is O(U+V) if options.approx = true and
-// O(U*V) if options.approx = false.
+// O(U*V) if options.approx = false. If options.num_threads > 1 or
+// options.prune = true, the pairwise costs are stored, which requires
+// O(N^2) space.
 
 class MedoidOptions {
  public:
@@ -178,8 +219,26 @@ class MedoidOptions {
   bool approx() const { return approx_; }
   void set_approx(bool approx) { approx_ = approx; }
 
+  // options.num_threads controls the number of threads used to compute the
+  // pairwise alignment costs. The result does not depend on this value.
+  int num_threads() const { return num_threads_; }
+  void set_num_threads(int num_threads) { num_threads_ = num_threads; }
+
+  // If options.prune = true, we first compute a cheap lower bound on the
+  // alignment cost of every pair of polylines (the cost of aligning their
+  // first and last vertices, plus the distance from each remaining vertex to
+  // a bounding cap of the other polyline). Candidates are then visited in
+  // increasing order of their summed lower bounds, and candidates whose
+  // bound exceeds the best summed cost found so far are skipped along with
+  // all of their alignments. This returns the same medoid, and is much
+  // faster when the collection contains outliers or several clusters.
+  bool prune() const { return prune_; }
+  void set_prune(bool prune) { prune_ = prune; }
+
  private:
   bool approx_ = true;
+  int num_threads_ = 1;
+  bool prune_ = false;
 };
 
 int GetMedoidPolyline(const std::vector<std::unique_ptr<S2Polyline>>& polylines,
@@ -232,10 +291,17 @@ class ConsensusOptions {
   int iteration_cap() const { return iteration_cap_; }
   void set_iteration_cap(int iteration_cap) { iteration_cap_ = iteration_cap; }
 
+  // options.num_threads controls the number of threads used to align the
+  // polylines to the consensus in each DBA step (and to find the medoid if
+  // options.seed_medoid = true). The result does not depend on this value.
+  int num_threads() const { return num_threads_; }
+  void set_num_threads(int num_threads) { num_threads_ = num_threads; }
+
  private:
   bool approx_ = true;
   bool seed_medoid_ = false;
   int iteration_cap_ = 5;
+  int num_threads_ = 1;
 };
 
 std::unique_ptr<S2Polyline> GetConsensusPolyline(
@@ -22,6 +22,7 @@
 #include <limits>
 #include <vector>
 
+#include "s2/s2cap.h"
 #include "s2/s2polyline.h"
 
 namespace s2polyline_alignment {
@@ -147,6 +148,36 @@ class Window {
   bool IsValid() const;
 };
 
+// VertexCoordinates stores the vertices of a polyline as three separate
+// arrays of coordinates rather than an array of S2Points. This allows the
+// squared distances from a point to a range of vertices to be computed by a
+// simple loop over contiguous doubles, which the compiler vectorizes.
+class VertexCoordinates {
+ public:
+  explicit VertexCoordinates(const S2Polyline& polyline);
+
+  // Sets distances[i] = (p - polyline.vertex(i)).Norm2() for each `i` in
+  // [start, end). The results are identical to the scalar computation.
+  void GetSquaredDistances(const S2Point& p, const int start, const int end,
+                           double* distances) const;
+
+ private:
+  std::vector<double> x_, y_, z_;
+};
+
+// Returns a lower bound on the vertex alignment cost of `a` and `b`, where
+// `a_cap` and `b_cap` contain all of the vertices of `a` and `b`
+// respectively. Every warp path contains the pair of first vertices and the
+// pair of last vertices, and pairs every other vertex of `a` with some
+// vertex of `b`, which is no closer than `b_cap`. The bound is the larger of
+// this sum and the corresponding sum for the vertices of `b`, and is also a
+// lower bound on the cost computed by GetApproxVertexAlignment. This is the
+// analogue of LB_Kim and LB_Keogh for unconstrained warping, where the
+// envelope of a polyline is its bounding cap. Takes O(A+B) time.
+double GetVertexAlignmentCostLowerBound(const S2Polyline& a, const S2Cap& a_cap,
+                                        const S2Polyline& b,
+                                        const S2Cap& b_cap);
+
 // Reduce the number of vertices of polyline `in` by selecting every other
 // vertex for inclusion in a new polyline. Specifically, we take even-index
 // vertices [0, 2, 4,...]. For an even-length polyline, the last vertex is not
@@ -292,6 +292,18 @@ TEST(S2PolylineAlignmentTest, HalvesOddLengthPolyline) {
   const auto correct = s2textformat::MakePolylineOrDie("0:0, 0:2, 3:5");
   EXPECT_EQ(s2textformat::ToString(*halved), s2textformat::ToString(*correct));
 }
+TEST(S2PolylineAlignmentTest, ComputesSquaredDistancesFromVertexCoordinates) {
+  const auto line = s2textformat::MakePolylineOrDie("0:0, 1:1, 2:2, 3:3, 4:4");
+  const VertexCoordinates coords(*line);
+  const S2Point p = s2textformat::MakePoint("1:3");
+  std::vector<double> distances(5, -1.0);
+  coords.GetSquaredDistances(p, 1, 4, distances.data());
+  EXPECT_EQ(-1.0, distances[0]);
+  for (int i = 1; i < 4; ++i) {
+    EXPECT_EQ((p - line->vertex(i)).Norm2(), distances[i]);
+  }
+  EXPECT_EQ(-1.0, distances[4]);
+}
 
 // PUBLIC API TESTS
 
@@ -459,6 +471,128 @@ TEST(S2PolylineAlignmentTest, FuzzedWithBruteForce) {
   }
 }
 
+// Returns the discrete Frechet cost (the maximum squared chordal distance
+// along the best warp path) up until vertex i, j.
+double GetBruteForceFrechetCost(const CostTable& table, const int i,
+                                const int j) {
+  if (i == 0 && j == 0) {
+    return table[0][0];
+  } else if (i == 0) {
+    return std::max(GetBruteForceFrechetCost(table, i, j - 1), table[i][j]);
+  } else if (j == 0) {
+    return std::max(GetBruteForceFrechetCost(table, i - 1, j), table[i][j]);
+  } else {
+    return std::max(std::min({GetBruteForceFrechetCost(table, i - 1, j - 1),
+                              GetBruteForceFrechetCost(table, i - 1, j),
+                              GetBruteForceFrechetCost(table, i, j - 1)}),
+                    table[i][j]);
+  }
+}
+
+// Verify the discrete Frechet solvers against the brute force solver, and
+// check that IsDiscreteFrechetDistanceLess agrees with the exact distance.
+void VerifyFrechetDistance(const S2Polyline& a, const S2Polyline& b) {
+  const int a_n = a.num_vertices();
+  const int b_n = b.num_vertices();
+  const S1ChordAngle brute_distance = S1ChordAngle::FromLength2(
+      GetBruteForceFrechetCost(DistanceMatrix(a, b), a_n - 1, b_n - 1));
+  const S1ChordAngle exact_distance = GetDiscreteFrechetDistance(a, b);
+  EXPECT_EQ(brute_distance, exact_distance);
+  EXPECT_EQ(exact_distance,
+            GetBandedDiscreteFrechetDistance(a, b, std::max(a_n, b_n)));
+  EXPECT_LE(exact_distance, GetBandedDiscreteFrechetDistance(a, b, 0));
+  EXPECT_FALSE(IsDiscreteFrechetDistanceLess(a, b, exact_distance));
+  EXPECT_TRUE(IsDiscreteFrechetDistanceLess(a, b, exact_distance.Successor()));
+}
+
+TEST(S2PolylineAlignmentTest, FrechetLengthZeroInputA) {
+  const auto a = s2textformat::MakePolylineOrDie("");
+  const auto b = s2textformat::MakePolylineOrDie("0:0, 1:1, 2:2");
+  EXPECT_DEATH(GetDiscreteFrechetDistance(*a, *b), "");
+  EXPECT_DEATH(GetBandedDiscreteFrechetDistance(*a, *b, 1), "");
+  EXPECT_DEATH(
+      IsDiscreteFrechetDistanceLess(*a, *b, S1ChordAngle::Infinity()), "");
+}
+
+TEST(S2PolylineAlignmentTest, FrechetLengthOneInputs) {
+  const auto a = s2textformat::MakePolylineOrDie("1:1");
+  const auto b = s2textformat::MakePolylineOrDie("1:1, 3:1, 2:1");
+  VerifyFrechetDistance(*a, *b);
+  VerifyFrechetDistance(*b, *a);
+  EXPECT_NEAR(2.0, GetDiscreteFrechetDistance(*a, *b).degrees(), 1e-9);
+}
+
+TEST(S2PolylineAlignmentTest, FrechetHeaderFileExample) {
+  // The warp path is the same as for the vertex alignment, and the largest
+  // distance between a pair of its vertices is between (5, 0) and (7, 0).
+  const auto a = s2textformat::MakePolylineOrDie("1:0, 5:0, 6:0, 9:0");
+  const auto b = s2textformat::MakePolylineOrDie("2:0, 7:0, 8:0");
+  VerifyFrechetDistance(*a, *b);
+  EXPECT_NEAR(2.0, GetDiscreteFrechetDistance(*a, *b).degrees(), 1e-9);
+  EXPECT_FALSE(
+      IsDiscreteFrechetDistanceLess(*a, *b, S1ChordAngle::Degrees(1.5)));
+  EXPECT_TRUE(
+      IsDiscreteFrechetDistanceLess(*a, *b, S1ChordAngle::Degrees(2.5)));
+}
+
+TEST(S2PolylineAlignmentTest, FrechetReversedPolyline) {
+  // Reversing a polyline makes the Frechet distance at least the distance
+  // between its endpoints, even though every vertex still has a close match.
+  const auto a = s2textformat::MakePolylineOrDie("0:0, 0:1, 0:2, 0:3");
+  const auto b = s2textformat::MakePolylineOrDie("0:3, 0:2, 0:1, 0:0");
+  VerifyFrechetDistance(*a, *b);
+  EXPECT_NEAR(3.0, GetDiscreteFrechetDistance(*a, *b).degrees(), 1e-9);
+}
+
+TEST(S2PolylineAlignmentTest, FrechetFuzzedWithBruteForce) {
+  const int kNumPolylines = 10;
+  const int kNumVertices = 8;
+  const double kPerturbation = 1.5;
+  const auto lines = GenPolylines(kNumPolylines, kNumVertices, kPerturbation);
+  for (int i = 0; i < kNumPolylines; ++i) {
+    for (int j = i + 1; j < kNumPolylines; ++j) {
+      VerifyFrechetDistance(*lines[i], *lines[j]);
+    }
+  }
+}
+
+// Check the banded and thresholded methods against the exact method on longer
+// polylines with different numbers of vertices.
+TEST(S2PolylineAlignmentTest, FrechetLongPolylines) {
+  const auto lines = GenPolylines(2, 1000, 0.5);
+  const auto a = HalfResolution(*lines[0]);
+  const S2Polyline& b = *lines[1];
+  const S1ChordAngle exact_distance = GetDiscreteFrechetDistance(*a, b);
+  EXPECT_EQ(exact_distance, GetDiscreteFrechetDistance(b, *a));
+  EXPECT_EQ(exact_distance, GetBandedDiscreteFrechetDistance(*a, b, 4));
+  EXPECT_LE(exact_distance, GetBandedDiscreteFrechetDistance(*a, b, 0));
+  EXPECT_FALSE(IsDiscreteFrechetDistanceLess(*a, b, exact_distance));
+  EXPECT_TRUE(IsDiscreteFrechetDistanceLess(*a, b, exact_distance.Successor()));
+  EXPECT_FALSE(IsDiscreteFrechetDistanceLess(b, *a, exact_distance));
+  EXPECT_TRUE(IsDiscreteFrechetDistanceLess(b, *a, exact_distance.Successor()));
+}
+
+// Check that the lower bound used to prune medoid candidates never exceeds
+// the exact or approximate alignment cost, and that it is nontrivial for
+// polylines that are far apart.
+TEST(S2PolylineAlignmentTest, VertexAlignmentCostLowerBoundFuzzed) {
+  auto near = GenPolylines(5, 64, 1.5);
+  auto lines = GenPolylines(5, 40, 1.5);
+  for (auto& line : near) lines.push_back(std::move(line));
+  for (int i = 0; i < lines.size(); ++i) {
+    const S2Cap a_cap = lines[i]->GetCapBound();
+    for (int j = 0; j < lines.size(); ++j) {
+      const S2Cap b_cap = lines[j]->GetCapBound();
+      const double bound = GetVertexAlignmentCostLowerBound(
+          *lines[i], a_cap, *lines[j], b_cap);
+      EXPECT_LE(bound, GetExactVertexAlignmentCost(*lines[i], *lines[j]));
+      EXPECT_LE(bound,
+                GetApproxVertexAlignment(*lines[i], *lines[j]).alignment_cost);
+      if (!a_cap.Intersects(b_cap)) EXPECT_GT(bound, 0);
+    }
+  }
+}
+
 // TESTS FOR TRAJECTORY CONSENSUS ALGORITHMS
 
 // Tests for GetMedoidPolyline
@@ -568,6 +702,38 @@ TEST(S2PolylineAlignmentTest, MedoidPolylineFewLargePolylines) {
   EXPECT_EQ(approx_medoid, approx_medoid_index);
 }
 
+// Check that threads and pruning do not change the medoid of a collection
+// that contains two clusters of polylines.
+TEST(S2PolylineAlignmentTest, MedoidPolylineThreadsAndPruning) {
+  auto polylines = GenPolylines(12, 50, 0.9);
+  for (auto& polyline : GenPolylines(5, 40, 0.9)) {
+    polylines.push_back(std::move(polyline));
+  }
+  for (bool approx : {false, true}) {
+    MedoidOptions options;
+    options.set_approx(approx);
+    const int expected = GetMedoidPolyline(polylines, options);
+    for (int num_threads : {1, 4}) {
+      for (bool prune : {false, true}) {
+        options.set_num_threads(num_threads);
+        options.set_prune(prune);
+        EXPECT_EQ(expected, GetMedoidPolyline(polylines, options));
+      }
+    }
+  }
+}
+
+TEST(S2PolylineAlignmentTest, MedoidPolylinePruningTies) {
+  // All of the polylines are identical, so the first one is the medoid.
+  std::vector<std::unique_ptr<S2Polyline>> polylines;
+  for (int i = 0; i < 4; ++i) {
+    polylines.emplace_back(s2textformat::MakePolylineOrDie("1:0, 1:1, 1:2"));
+  }
+  MedoidOptions options;
+  options.set_prune(true);
+  EXPECT_EQ(0, GetMedoidPolyline(polylines, options));
+}
+
 // Tests for GetConsensusPolyline
 TEST(S2PolylineAlignmentTest, ConsensusPolylineNoPolylines) {
   std::vector<std::unique_ptr<S2Polyline>> polylines;
@@ -607,4 +773,17 @@ TEST(S2PolylineAlignmentTest, ConsensusPolylineOverlappingPolylines) {
   EXPECT_TRUE(result->ApproxEquals(*expected));
 }
 
+TEST(S2PolylineAlignmentTest, ConsensusPolylineThreads) {
+  const auto polylines = GenPolylines(8, 64, 0.5);
+  ConsensusOptions options;
+  options.set_seed_medoid(true);
+  const auto expected = GetConsensusPolyline(polylines, options);
+  options.set_num_threads(4);
+  const auto result = GetConsensusPolyline(polylines, options);
+  ASSERT_EQ(expected->num_vertices(), result->num_vertices());
+  for (int i = 0; i < expected->num_vertices(); ++i) {
+    EXPECT_EQ(expected->vertex(i), result->vertex(i));
+  }
+}
+
 }  // namespace s2polyline_alignment
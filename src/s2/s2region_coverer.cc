@@ -30,6 +30,7 @@
 #include "s2/s1angle.h"
 #include "s2/s2cap.h"
 #include "s2/s2cell_union.h"
+#include "s2/s2latlng_rect.h"
 #include "s2/s2metrics.h"
 #include "s2/s2region.h"
 #include "s2/third_party/absl/base/casts.h"
@@ -88,20 +89,82 @@ int S2RegionCoverer::Options::true_max_level() const {
   return max_level_ - (max_level_ - min_level_) % level_mod_;
 }
 
+S2RegionCoverer::CellRelation S2RegionCoverer::ClassifyCell(
+    const S2Cell& cell) const {
+  if (cap_ != nullptr) {
+    // This follows S2Cap::MayIntersect() and S2Cap::Contains(), except that
+    // each cell vertex is computed at most once and we stop as soon as we
+    // find one vertex inside the cap and one outside it.
+    S2Point vertices[4];
+    bool any_inside = false, any_outside = false;
+    for (int k = 0; k < 4; ++k) {
+      vertices[k] = cell.GetVertex(k);
+      if (cap_->Contains(vertices[k])) {
+        any_inside = true;
+      } else {
+        any_outside = true;
+      }
+      if (any_inside && any_outside) return CellRelation::kPartial;
+    }
+    if (any_inside) {
+      return cap_->Complement().Intersects(cell, vertices) ?
+          CellRelation::kPartial : CellRelation::kContained;
+    }
+    return cap_->Intersects(cell, vertices) ?
+        CellRelation::kPartial : CellRelation::kDisjoint;
+  }
+  if (rect_ != nullptr) {
+    // S2LatLngRect::MayIntersect() and S2LatLngRect::Contains() both compare
+    // against the cell's bounding rectangle, which is expensive to compute.
+    const S2LatLngRect cell_bound = cell.GetRectBound();
+    if (!rect_->Intersects(cell_bound)) return CellRelation::kDisjoint;
+    return rect_->Contains(cell_bound) ?
+        CellRelation::kContained : CellRelation::kPartial;
+  }
+  return CellRelation::kUnknown;
+}
+
+inline bool S2RegionCoverer::MayIntersect(const S2Cell& cell,
+                                          CellRelation relation) const {
+  switch (relation) {
+    case CellRelation::kDisjoint:
+      return false;
+    case CellRelation::kPartial:
+    case CellRelation::kContained:
+      return true;
+    default:
+      return region_->MayIntersect(cell);
+  }
+}
+
+inline bool S2RegionCoverer::Contains(const S2Cell& cell,
+                                      CellRelation relation) const {
+  switch (relation) {
+    case CellRelation::kDisjoint:
+    case CellRelation::kPartial:
+      return false;
+    case CellRelation::kContained:
+      return true;
+    default:
+      return region_->Contains(cell);
+  }
+}
+
 S2RegionCoverer::Candidate* S2RegionCoverer::NewCandidate(const S2Cell& cell) {
-  if (!region_->MayIntersect(cell)) return nullptr;
+  const CellRelation relation = ClassifyCell(cell);
+  if (!MayIntersect(cell, relation)) return nullptr;
 
   bool is_terminal = false;
   if (cell.level() >= options_.min_level()) {
     if (interior_covering_) {
-      if (region_->Contains(cell)) {
+      if (Contains(cell, relation)) {
         is_terminal = true;
       } else if (cell.level() + options_.level_mod() > options_.max_level()) {
         return nullptr;
       }
     } else {
       if (cell.level() + options_.level_mod() > options_.max_level() ||
-          region_->Contains(cell)) {
+          Contains(cell, relation)) {
         is_terminal = true;
       }
     }
@@ -140,7 +203,7 @@ int S2RegionCoverer::ExpandChildren(Candidate* candidate,
   int num_terminals = 0;
   for (int i = 0; i < 4; ++i) {
     if (num_levels > 0) {
-      if (region_->MayIntersect(child_cells[i])) {
+      if (MayIntersect(child_cells[i], ClassifyCell(child_cells[i]))) {
         num_terminals += ExpandChildren(candidate, child_cells[i], num_levels);
       }
       continue;
@@ -299,6 +362,8 @@ void S2RegionCoverer::GetCoveringInternal(const S2Region& region) {
     pq_.pop();
   }
   region_ = nullptr;
+  cap_ = nullptr;
+  rect_ = nullptr;
 
   // Rather than just returning the raw list of cell ids, we construct a cell
   // union and then denormalize it.  This has the effect of replacing four
@@ -341,6 +406,50 @@ S2CellUnion S2RegionCoverer::GetInteriorCovering(const S2Region& region) {
   return S2CellUnion::FromVerbatim(std::move(result_));
 }
 
+void S2RegionCoverer::GetCovering(const S2Cap& cap,
+                                  vector<S2CellId>* covering) {
+  cap_ = &cap;
+  GetCovering(static_cast<const S2Region&>(cap), covering);
+}
+
+void S2RegionCoverer::GetInteriorCovering(const S2Cap& cap,
+                                          vector<S2CellId>* interior) {
+  cap_ = &cap;
+  GetInteriorCovering(static_cast<const S2Region&>(cap), interior);
+}
+
+S2CellUnion S2RegionCoverer::GetCovering(const S2Cap& cap) {
+  cap_ = &cap;
+  return GetCovering(static_cast<const S2Region&>(cap));
+}
+
+S2CellUnion S2RegionCoverer::GetInteriorCovering(const S2Cap& cap) {
+  cap_ = &cap;
+  return GetInteriorCovering(static_cast<const S2Region&>(cap));
+}
+
+void S2RegionCoverer::GetCovering(const S2LatLngRect& rect,
+                                  vector<S2CellId>* covering) {
+  rect_ = &rect;
+  GetCovering(static_cast<const S2Region&>(rect), covering);
+}
+
+void S2RegionCoverer::GetInteriorCovering(const S2LatLngRect& rect,
+                                          vector<S2CellId>* interior) {
+  rect_ = &rect;
+  GetInteriorCovering(static_cast<const S2Region&>(rect), interior);
+}
+
+S2CellUnion S2RegionCoverer::GetCovering(const S2LatLngRect& rect) {
+  rect_ = &rect;
+  return GetCovering(static_cast<const S2Region&>(rect));
+}
+
+S2CellUnion S2RegionCoverer::GetInteriorCovering(const S2LatLngRect& rect) {
+  rect_ = &rect;
+  return GetInteriorCovering(static_cast<const S2Region&>(rect));
+}
+
 void S2RegionCoverer::GetFastCovering(const S2Region& region,
                                       vector<S2CellId>* covering) {
   region.GetCellUnionBound(covering);
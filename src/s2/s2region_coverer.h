@@ -28,6 +28,8 @@
 #include "s2/s2cell_id.h"
 #include "s2/s2cell_union.h"
 
+class S2Cap;
+class S2LatLngRect;
 class S2Region;
 
 // An S2RegionCoverer is a class that allows arbitrary regions to be
@@ -190,6 +192,23 @@ class S2RegionCoverer {
   void GetInteriorCovering(const S2Region& region,
                            std::vector<S2CellId>* interior);
 
+  // Specialized versions of the methods above for S2Cap and S2LatLngRect,
+  // which are selected automatically whenever the static type of the region
+  // is known.  Rather than calling MayIntersect() and Contains() separately
+  // on every candidate cell, these classify each cell with a single
+  // computation specific to the region type.  The coverings returned are
+  // identical to those of the generic methods.
+  S2CellUnion GetCovering(const S2Cap& cap);
+  S2CellUnion GetInteriorCovering(const S2Cap& cap);
+  void GetCovering(const S2Cap& cap, std::vector<S2CellId>* covering);
+  void GetInteriorCovering(const S2Cap& cap, std::vector<S2CellId>* interior);
+
+  S2CellUnion GetCovering(const S2LatLngRect& rect);
+  S2CellUnion GetInteriorCovering(const S2LatLngRect& rect);
+  void GetCovering(const S2LatLngRect& rect, std::vector<S2CellId>* covering);
+  void GetInteriorCovering(const S2LatLngRect& rect,
+                           std::vector<S2CellId>* interior);
+
   // Like GetCovering(), except that this method is much faster and the
   // coverings are not as tight.  All of the usual parameters are respected
   // (max_cells, min_level, max_level, and level_mod), except that the
@@ -251,6 +270,24 @@ class S2RegionCoverer {
     Candidate* children[0];  // Actual size may be 0, 4, 16, or 64 elements.
   };
 
+  // The relationship between a cell and the region being covered, as
+  // determined by ClassifyCell().  kUnknown means that the region's own
+  // MayIntersect() and Contains() methods must be called.
+  enum class CellRelation { kUnknown, kDisjoint, kPartial, kContained };
+
+  // For S2Cap and S2LatLngRect regions, determines both whether "cell"
+  // intersects the region and whether the region contains it while sharing
+  // the expensive part of the computation (the cell vertices or the cell's
+  // bounding rectangle) between the two tests.  The result is exactly
+  // equivalent to calling MayIntersect() and Contains().  For all other
+  // regions returns kUnknown.
+  CellRelation ClassifyCell(const S2Cell& cell) const;
+
+  // Equivalent to region_->MayIntersect(cell) and region_->Contains(cell),
+  // except that the virtual call is skipped when "relation" is known.
+  bool MayIntersect(const S2Cell& cell, CellRelation relation) const;
+  bool Contains(const S2Cell& cell, CellRelation relation) const;
+
   // If the cell intersects the given region, return a new candidate with no
   // children, otherwise return nullptr.  Also marks the candidate as "terminal"
   // if it should not be expanded further.
@@ -306,6 +343,12 @@ class S2RegionCoverer {
   // only valid) for the duration of a single GetCovering() call.
   const S2Region* region_ = nullptr;
 
+  // The S2Cap or S2LatLngRect passed to one of the specialized GetCovering()
+  // methods, if any (see ClassifyCell).  Like region_, these are only valid
+  // for the duration of a single GetCovering() call.
+  const S2Cap* cap_ = nullptr;
+  const S2LatLngRect* rect_ = nullptr;
+
   // The set of S2CellIds that have been added to the covering so far.
   std::vector<S2CellId> result_;
 
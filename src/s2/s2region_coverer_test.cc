@@ -37,6 +37,7 @@
 #include "s2/s2cell_id.h"
 #include "s2/s2cell_union.h"
 #include "s2/s2latlng.h"
+#include "s2/s2latlng_rect.h"
 #include "s2/s2region.h"
 #include "s2/s2testing.h"
 #include "s2/third_party/absl/base/integral_types.h"
@@ -140,6 +141,56 @@ TEST(S2RegionCoverer, RandomCaps) {
   }
 }
 
+TEST(S2RegionCoverer, RandomRects) {
+  static const int kMaxLevel = S2CellId::kMaxLevel;
+  S2RegionCoverer::Options options;
+  for (int i = 0; i < 1000; ++i) {
+    do {
+      options.set_min_level(S2Testing::rnd.Uniform(kMaxLevel + 1));
+      options.set_max_level(S2Testing::rnd.Uniform(kMaxLevel + 1));
+    } while (options.min_level() > options.max_level());
+    options.set_max_cells(S2Testing::rnd.Skewed(10));
+    options.set_level_mod(1 + S2Testing::rnd.Uniform(3));
+    double max_area =  min(4 * M_PI, (3 * options.max_cells() + 1) *
+                           S2Cell::AverageArea(options.min_level()));
+    S2LatLngRect rect = S2Testing::GetRandomCap(
+        0.1 * S2Cell::AverageArea(kMaxLevel), max_area).GetRectBound();
+    S2RegionCoverer coverer(options);
+    vector<S2CellId> covering, interior;
+    coverer.GetCovering(rect, &covering);
+    CheckCovering(options, rect, covering, false);
+    coverer.GetInteriorCovering(rect, &interior);
+    CheckCovering(options, rect, interior, true);
+  }
+}
+
+TEST(S2RegionCoverer, SpecializedCoveringsMatchGeneric) {
+  // The specialized S2Cap and S2LatLngRect methods should yield exactly the
+  // same coverings as the generic S2Region methods.
+  static const int kMaxLevel = S2CellId::kMaxLevel;
+  S2RegionCoverer::Options options;
+  for (int i = 0; i < 1000; ++i) {
+    options.set_max_cells(S2Testing::rnd.Skewed(10));
+    S2RegionCoverer coverer(options);
+    S2Cap cap = S2Testing::GetRandomCap(S2Cell::AverageArea(kMaxLevel),
+                                        4 * M_PI);
+    S2LatLngRect rect = cap.GetRectBound();
+    vector<S2CellId> covering, generic;
+    coverer.GetCovering(cap, &covering);
+    coverer.GetCovering(static_cast<const S2Region&>(cap), &generic);
+    EXPECT_EQ(generic, covering);
+    coverer.GetInteriorCovering(cap, &covering);
+    coverer.GetInteriorCovering(static_cast<const S2Region&>(cap), &generic);
+    EXPECT_EQ(generic, covering);
+    coverer.GetCovering(rect, &covering);
+    coverer.GetCovering(static_cast<const S2Region&>(rect), &generic);
+    EXPECT_EQ(generic, covering);
+    coverer.GetInteriorCovering(rect, &covering);
+    coverer.GetInteriorCovering(static_cast<const S2Region&>(rect), &generic);
+    EXPECT_EQ(generic, covering);
+  }
+}
+
 TEST(S2RegionCoverer, SimpleCoverings) {
   static const int kMaxLevel = S2CellId::kMaxLevel;
   S2RegionCoverer::Options options;
@@ -80,6 +80,7 @@
 #include "s2/s1angle.h"
 #include "s2/s2cap.h"
 #include "s2/s2cell_id.h"
+#include "s2/s2latlng_rect.h"
 #include "s2/s2region.h"
 #include "s2/third_party/absl/strings/str_cat.h"
 
@@ -141,14 +142,30 @@ vector<string> S2RegionTermIndexer::GetIndexTerms(const S2Point& point,
   return terms;
 }
 
-vector<string> S2RegionTermIndexer::GetIndexTerms(const S2Region& region,
-                                                  string_view prefix) {
+template <class Region>
+vector<string> S2RegionTermIndexer::GetIndexTermsImpl(const Region& region,
+                                                      string_view prefix) {
   // Note that options may have changed since the last call.
   *coverer_.mutable_options() = options_;
   S2CellUnion covering = coverer_.GetCovering(region);
   return GetIndexTermsForCanonicalCovering(covering, prefix);
 }
 
+vector<string> S2RegionTermIndexer::GetIndexTerms(const S2Region& region,
+                                                  string_view prefix) {
+  return GetIndexTermsImpl(region, prefix);
+}
+
+vector<string> S2RegionTermIndexer::GetIndexTerms(const S2Cap& cap,
+                                                  string_view prefix) {
+  return GetIndexTermsImpl(cap, prefix);
+}
+
+vector<string> S2RegionTermIndexer::GetIndexTerms(const S2LatLngRect& rect,
+                                                  string_view prefix) {
+  return GetIndexTermsImpl(rect, prefix);
+}
+
 vector<string> S2RegionTermIndexer::GetIndexTermsForCanonicalCovering(
     const S2CellUnion& covering, string_view prefix) {
   // See the top of this file for an overview of the indexing strategy.
@@ -216,14 +233,30 @@ vector<string> S2RegionTermIndexer::GetQueryTerms(const S2Point& point,
   return terms;
 }
 
-vector<string> S2RegionTermIndexer::GetQueryTerms(const S2Region& region,
-                                                  string_view prefix) {
+template <class Region>
+vector<string> S2RegionTermIndexer::GetQueryTermsImpl(const Region& region,
+                                                      string_view prefix) {
   // Note that options may have changed since the last call.
   *coverer_.mutable_options() = options_;
   S2CellUnion covering = coverer_.GetCovering(region);
   return GetQueryTermsForCanonicalCovering(covering, prefix);
 }
 
+vector<string> S2RegionTermIndexer::GetQueryTerms(const S2Region& region,
+                                                  string_view prefix) {
+  return GetQueryTermsImpl(region, prefix);
+}
+
+vector<string> S2RegionTermIndexer::GetQueryTerms(const S2Cap& cap,
+                                                  string_view prefix) {
+  return GetQueryTermsImpl(cap, prefix);
+}
+
+vector<string> S2RegionTermIndexer::GetQueryTerms(const S2LatLngRect& rect,
+                                                  string_view prefix) {
+  return GetQueryTermsImpl(rect, prefix);
+}
+
 vector<string> S2RegionTermIndexer::GetQueryTermsForCanonicalCovering(
     const S2CellUnion& covering, string_view prefix) {
   // See the top of this file for an overview of the indexing strategy.
@@ -261,6 +261,18 @@ class S2RegionTermIndexer {
   std::vector<string> GetQueryTerms(const S2Region& region,
                                     absl::string_view prefix);
 
+  // Specialized versions of the methods above for the most common region
+  // types.  These use the faster S2RegionCoverer methods for S2Cap and
+  // S2LatLngRect, and otherwise return the same terms.
+  std::vector<string> GetIndexTerms(const S2Cap& cap,
+                                    absl::string_view prefix);
+  std::vector<string> GetQueryTerms(const S2Cap& cap,
+                                    absl::string_view prefix);
+  std::vector<string> GetIndexTerms(const S2LatLngRect& rect,
+                                    absl::string_view prefix);
+  std::vector<string> GetQueryTerms(const S2LatLngRect& rect,
+                                    absl::string_view prefix);
+
   // Convenience methods that accept an S2Point rather than S2Region.  (These
   // methods are also faster.)
   //
@@ -292,6 +304,15 @@ class S2RegionTermIndexer {
   string GetTerm(TermType term_type, const S2CellId& id,
                  absl::string_view prefix) const;
 
+  // Implementations of GetIndexTerms() and GetQueryTerms() for any region
+  // type accepted by S2RegionCoverer::GetCovering().
+  template <class Region>
+  std::vector<string> GetIndexTermsImpl(const Region& region,
+                                        absl::string_view prefix);
+  template <class Region>
+  std::vector<string> GetQueryTermsImpl(const Region& region,
+                                        absl::string_view prefix);
+
   Options options_;
   S2RegionCoverer coverer_;
 };
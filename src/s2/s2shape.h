@@ -18,6 +18,7 @@
 #ifndef S2_S2SHAPE_H_
 #define S2_S2SHAPE_H_
 
+#include "s2/base/logging.h"
 #include "s2/third_party/absl/base/integral_types.h"
 #include "s2/s2point.h"
 #include "s2/s2pointutil.h"
@@ -219,6 +220,16 @@ class S2Shape {
   // where     pos == shape.chain_position(edge_id).
   virtual ChainPosition chain_position(int edge_id) const = 0;
 
+  // Copies the edges with ids in the range [start, start + n) to "edges".
+  // Equivalent to calling edge() for each edge id in turn, but shapes that
+  // store their vertices in an array override this method so that a range
+  // of edges can be retrieved with a single virtual call.  This can be
+  // significantly faster when processing all the edges of a large shape.
+  //
+  // REQUIRES: 0 <= start && start + n <= num_edges()
+  // REQUIRES: "edges" points to an array with at least "n" elements.
+  virtual void GetEdges(int start, int n, Edge* edges) const;
+
   // A unique id assigned to this shape by S2ShapeIndex.  Shape ids are
   // assigned sequentially starting from 0 in the order shapes are added.
   //
@@ -280,4 +291,15 @@ class S2Shape {
   void operator=(const S2Shape&) = delete;
 };
 
+
+//////////////////   Implementation details follow   ////////////////////
+
+
+inline void S2Shape::GetEdges(int start, int n, Edge* edges) const {
+  S2_DCHECK(0 <= start && start + n <= num_edges());
+  for (int i = 0; i < n; ++i) {
+    edges[i] = edge(start + i);
+  }
+}
+
 #endif  // S2_S2SHAPE_H_
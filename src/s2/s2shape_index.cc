@@ -44,6 +44,14 @@ S2ShapeIndexCell::find_clipped(int shape_id) const {
   return nullptr;
 }
 
+size_t S2ShapeIndexCell::SpaceUsed() const {
+  size_t size = sizeof(*this) + shapes_.capacity() * sizeof(S2ClippedShape);
+  for (const S2ClippedShape& clipped : shapes_) {
+    if (!clipped.is_inline()) size += clipped.num_edges() * sizeof(int32);
+  }
+  return size;
+}
+
 // Allocate room for "n" additional clipped shapes in the cell, and return a
 // pointer to the first new clipped shape.  Expects that all new clipped
 // shapes will have a larger shape id than any current shape, and that shapes
@@ -79,6 +79,7 @@ class S2ClippedShape {
   // This class may be copied by value, but note that it does *not* own its
   // underlying data.  (It is owned by the containing S2ShapeIndexCell.)
 
+  friend class EncodedS2ShapeIndexBuilder;
   friend class MutableS2ShapeIndex;
   friend class S2ShapeIndexCell;
   friend class S2Stats;
@@ -130,6 +131,9 @@ class S2ShapeIndexCell {
   // shapes.
   int num_edges() const;
 
+  // Returns the number of bytes used by this cell (including sizeof(*this)).
+  size_t SpaceUsed() const;
+
   // Appends an encoded representation of the S2ShapeIndexCell to "encoder".
   // "num_shape_ids" should be set to index.num_shape_ids(); this information
   // allows the encoding to be more compact in some cases.
@@ -145,6 +149,7 @@ class S2ShapeIndexCell {
  private:
   friend class MutableS2ShapeIndex;
   friend class EncodedS2ShapeIndex;
+  friend class EncodedS2ShapeIndexBuilder;
   friend class S2Stats;
 
   // Internal methods are documented with their definitions.
@@ -0,0 +1,351 @@
+// Copyright 2018 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "s2/s2shape_index_distance_query.h"
+
+#include <algorithm>
+#include <queue>
+#include <vector>
+
+#include "s2/s2cell.h"
+#include "s2/s2cell_id.h"
+#include "s2/s2closest_edge_query.h"
+#include "s2/s2edge_distances.h"
+#include "s2/s2min_distance_targets.h"
+
+using std::max;
+using std::vector;
+
+namespace {
+
+// A node of the cell hierarchy of an S2ShapeIndex.  If "cell" is not
+// nullptr, it is the contents of the index cell "id".  Otherwise "id" is the
+// smallest cell that contains a certain set of two or more index cells.
+struct Node {
+  S2CellId id;
+  const S2ShapeIndexCell* cell;
+};
+
+// Sets "node" to the node that contains the index cells within "id" (shrunk
+// as much as possible to fit them), and returns true.  Returns false if "id"
+// does not intersect any index cells.
+//
+// REQUIRES: "id" does not belong to the interior of an index cell.
+bool MakeNode(S2ShapeIndex::Iterator* it, S2CellId id, Node* node) {
+  S2ShapeIndex::CellRelation relation = it->Locate(id);
+  if (relation == S2ShapeIndex::DISJOINT) return false;
+  if (relation == S2ShapeIndex::INDEXED) {
+    *node = Node{it->id(), &it->cell()};
+    return true;
+  }
+  // Otherwise "it" is positioned at the first index cell within "id".
+  S2CellId first = it->id();
+  it->Seek(id.range_max().next());
+  it->Prev();
+  if (it->id() == first) {
+    *node = Node{first, &it->cell()};
+  } else {
+    *node = Node{first.parent(first.GetCommonAncestorLevel(it->id())),
+                 nullptr};
+  }
+  return true;
+}
+
+// Returns the nodes that together contain every cell of the given index.
+vector<Node> GetRootNodes(S2ShapeIndex::Iterator* it) {
+  vector<Node> roots;
+  for (int face = 0; face < 6; ++face) {
+    Node node;
+    if (MakeNode(it, S2CellId::FromFace(face), &node)) roots.push_back(node);
+  }
+  return roots;
+}
+
+// Returns true if "node" may contain edges.
+inline bool MayHaveEdges(const Node& node) {
+  return node.cell == nullptr || node.cell->num_edges() > 0;
+}
+
+// Appends all the edges in the given index cell to "edges".
+void GetEdges(const S2ShapeIndex& index, const S2ShapeIndexCell& cell,
+              vector<S2Shape::Edge>* edges) {
+  edges->clear();
+  for (int s = 0; s < cell.num_clipped(); ++s) {
+    const S2ClippedShape& clipped = cell.clipped(s);
+    const S2Shape& shape = *index.shape(clipped.shape_id());
+    for (int i = 0; i < clipped.num_edges(); ++i) {
+      edges->push_back(shape.edge(clipped.edge(i)));
+    }
+  }
+}
+
+}  // namespace
+
+S2ShapeIndexDistanceQuery::S2ShapeIndexDistanceQuery(
+    const S2ShapeIndex* a, const S2ShapeIndex* b, const Options& options)
+    : a_(a), b_(b), options_(options) {
+}
+
+S1ChordAngle S2ShapeIndexDistanceQuery::GetDistance() {
+  if (InteriorsIntersect()) return S1ChordAngle::Zero();
+  return GetEdgeDistance(S1ChordAngle::Infinity(), false /*stop_early*/);
+}
+
+bool S2ShapeIndexDistanceQuery::IsDistanceLess(S1ChordAngle limit) {
+  if (GetEdgeDistance(limit, true /*stop_early*/) < limit) return true;
+  return S1ChordAngle::Zero() < limit && InteriorsIntersect();
+}
+
+bool S2ShapeIndexDistanceQuery::IsDistanceLessOrEqual(S1ChordAngle limit) {
+  return IsDistanceLess(limit.Successor());
+}
+
+S1ChordAngle S2ShapeIndexDistanceQuery::GetEdgeDistance(
+    S1ChordAngle limit, bool stop_early) const {
+  // The algorithm maintains a priority queue of pairs of nodes (one from each
+  // index), sorted in increasing order of the distance between their cells.
+  // This distance is a lower bound on the distance between any pair of edges
+  // in the two nodes.  When the closest pair consists of two index cells,
+  // their edges are compared directly; otherwise the larger node is
+  // subdivided.  The search stops when the closest pair is no closer than
+  // the best distance found so far.
+  struct NodePair {
+    S1ChordAngle distance;
+    Node a, b;
+    bool operator<(const NodePair& other) const {
+      // The priority queue returns the largest elements first, so we want the
+      // "largest" entry to have the smallest distance.
+      return other.distance < distance;
+    }
+  };
+  std::priority_queue<NodePair> queue;
+  S1ChordAngle min_dist = limit;
+
+  S2ShapeIndex::Iterator a_it(a_), b_it(b_);
+  vector<Node> b_roots = GetRootNodes(&b_it);
+  for (const Node& a : GetRootNodes(&a_it)) {
+    if (!MayHaveEdges(a)) continue;
+    S2Cell a_cell(a.id);
+    for (const Node& b : b_roots) {
+      if (!MayHaveEdges(b)) continue;
+      S1ChordAngle distance = a_cell.GetDistance(S2Cell(b.id));
+      if (distance < min_dist) queue.push(NodePair{distance, a, b});
+    }
+  }
+  vector<S2Shape::Edge> a_edges, b_edges;
+  while (!queue.empty()) {
+    NodePair top = queue.top();
+    queue.pop();
+    if (!(top.distance < min_dist)) break;
+    if (top.a.cell != nullptr && top.b.cell != nullptr) {
+      GetEdges(*a_, *top.a.cell, &a_edges);
+      GetEdges(*b_, *top.b.cell, &b_edges);
+      for (const S2Shape::Edge& a : a_edges) {
+        for (const S2Shape::Edge& b : b_edges) {
+          S2::UpdateEdgePairMinDistance(a.v0, a.v1, b.v0, b.v1, &min_dist);
+        }
+      }
+      if (min_dist == S1ChordAngle::Zero()) break;
+      if (stop_early && min_dist < limit) break;
+      continue;
+    }
+    // Subdivide the node that is not an index cell, or the larger node if
+    // neither one is an index cell.
+    bool split_a = (top.b.cell != nullptr ||
+                    (top.a.cell == nullptr &&
+                     top.a.id.level() <= top.b.id.level()));
+    const Node& split = split_a ? top.a : top.b;
+    S2Cell other_cell(split_a ? top.b.id : top.a.id);
+    S2ShapeIndex::Iterator* it = split_a ? &a_it : &b_it;
+    for (S2CellId child = split.id.child_begin();
+         child != split.id.child_end(); child = child.next()) {
+      Node node;
+      if (!MakeNode(it, child, &node) || !MayHaveEdges(node)) continue;
+      S1ChordAngle distance = S2Cell(node.id).GetDistance(other_cell);
+      if (!(distance < min_dist)) continue;
+      if (split_a) {
+        queue.push(NodePair{distance, node, top.b});
+      } else {
+        queue.push(NodePair{distance, top.a, node});
+      }
+    }
+  }
+  return min_dist;
+}
+
+bool S2ShapeIndexDistanceQuery::InteriorsIntersect() const {
+  if (!options_.include_interiors()) return false;
+  // VisitContainingShapes() returns false as soon as the visitor does.
+  auto stop = [](S2Shape* containing_shape, const S2Point& target_point) {
+    return false;
+  };
+  S2MinDistanceShapeIndexTarget a_target(a_), b_target(b_);
+  return (!b_target.VisitContainingShapes(*a_, stop) ||
+          !a_target.VisitContainingShapes(*b_, stop));
+}
+
+S1ChordAngle S2ShapeIndexDistanceQuery::GetDirectedHausdorffDistance() {
+  return GetDirectedHausdorffDistance(*a_, *b_, options_, S1ChordAngle::Zero(),
+                                      false /*stop_early*/);
+}
+
+S1ChordAngle S2ShapeIndexDistanceQuery::GetHausdorffDistance() {
+  S1ChordAngle a_to_b = GetDirectedHausdorffDistance();
+  return GetDirectedHausdorffDistance(*b_, *a_, options_, a_to_b,
+                                      false /*stop_early*/);
+}
+
+bool S2ShapeIndexDistanceQuery::IsDirectedHausdorffDistanceLess(
+    S1ChordAngle limit) {
+  // The distance is never negative, even when A is empty.
+  if (!(S1ChordAngle::Zero() < limit)) return false;
+  return GetDirectedHausdorffDistance(*a_, *b_, options_, limit.Predecessor(),
+                                      true /*stop_early*/) < limit;
+}
+
+bool S2ShapeIndexDistanceQuery::IsHausdorffDistanceLess(S1ChordAngle limit) {
+  if (!IsDirectedHausdorffDistanceLess(limit)) return false;
+  return GetDirectedHausdorffDistance(*b_, *a_, options_, limit.Predecessor(),
+                                      true /*stop_early*/) < limit;
+}
+
+S1ChordAngle S2ShapeIndexDistanceQuery::GetDirectedHausdorffDistance(
+    const S2ShapeIndex& a, const S2ShapeIndex& b, const Options& options,
+    S1ChordAngle min_dist, bool stop_early) {
+  // The nodes of A are visited in decreasing order of an upper bound on the
+  // distance from any point of the node to B.  The bound is obtained by
+  // finding the closest point of B to the center of the node's cell, and
+  // then measuring the maximum distance from the cell to that point.  The
+  // search stops when the largest upper bound does not exceed the maximum
+  // distance found so far.
+  //
+  // Computing a bound costs about as much as measuring a vertex, so nodes
+  // that contain only a few index cells are not subdivided further; instead
+  // their vertices are measured directly.  Most vertices are then dismissed
+  // without querying B at all, since for similar geometry the edge of B
+  // that was close to the previous vertex is usually close enough to the
+  // current one as well.
+  struct NodeBound {
+    S1ChordAngle bound;
+    Node node;
+    bool operator<(const NodeBound& other) const {
+      return bound < other.bound;
+    }
+  };
+  std::priority_queue<NodeBound> queue;
+  S1ChordAngle max_dist = min_dist;
+
+  S2ClosestEdgeQuery::Options query_options;
+  query_options.set_include_interiors(options.include_interiors());
+  S2ClosestEdgeQuery query(&b, query_options);
+
+  // Returns true if the distance from "v" to B is at most "max_dist".  Any
+  // edge of B within that distance is stored in "near_edge".
+  S2ClosestEdgeQuery::Options within_options = query_options;
+  within_options.set_max_error(S1ChordAngle::Straight());
+  S2Shape::Edge near_edge;
+  bool has_near_edge = false;
+  auto is_within = [&](const S2Point& v) {
+    S1ChordAngle limit = max_dist.Successor();
+    if (has_near_edge &&
+        S2::UpdateMinDistance(v, near_edge.v0, near_edge.v1, &limit)) {
+      return true;
+    }
+    within_options.set_inclusive_max_distance(max_dist);
+    *query.mutable_options() = within_options;
+    S2ClosestEdgeQuery::PointTarget target(v);
+    S2ClosestEdgeQuery::Result result = query.FindClosestEdge(&target);
+    if (result.is_empty()) return false;
+    if (result.edge_id() >= 0) {
+      near_edge = query.GetEdge(result);
+      has_near_edge = true;
+    }
+    return true;
+  };
+  // Measures the vertices of the given index cell, and returns true if the
+  // search should stop.
+  vector<S2Shape::Edge> edges;
+  auto measure_vertices = [&](S2CellId id, const S2ShapeIndexCell& cell) {
+    GetEdges(a, cell, &edges);
+    for (const S2Shape::Edge& edge : edges) {
+      for (const S2Point& v : {edge.v0, edge.v1}) {
+        // Each vertex is measured only in the index cell that contains it.
+        if (!id.contains(S2CellId(v)) || is_within(v)) continue;
+        if (stop_early) {
+          max_dist = max_dist.Successor();
+          return true;
+        }
+        *query.mutable_options() = query_options;
+        S2ClosestEdgeQuery::PointTarget target(v);
+        S2ClosestEdgeQuery::Result result = query.FindClosestEdge(&target);
+        max_dist = result.distance();
+        if (result.edge_id() >= 0) {
+          near_edge = query.GetEdge(result);
+          has_near_edge = true;
+        }
+      }
+    }
+    return false;
+  };
+  auto enqueue = [&](const Node& node) {
+    if (!MayHaveEdges(node)) return;
+    S2Cell cell(node.id);
+    S2Point center = cell.GetCenter();
+    *query.mutable_options() = query_options;
+    S2ClosestEdgeQuery::PointTarget target(center);
+    S2ClosestEdgeQuery::Result result = query.FindClosestEdge(&target);
+    S1ChordAngle bound = S1ChordAngle::Infinity();
+    if (!result.is_empty()) {
+      bound = cell.GetMaxDistance(query.Project(center, result));
+    }
+    if (max_dist < bound) queue.push(NodeBound{bound, node});
+  };
+  S2ShapeIndex::Iterator it(&a);
+  for (const Node& node : GetRootNodes(&it)) enqueue(node);
+
+  // Nodes with at most this many index cells are not subdivided.
+  static const int kMaxCellsToMeasure = 128;
+  while (!queue.empty()) {
+    NodeBound top = queue.top();
+    queue.pop();
+    if (!(max_dist < top.bound)) break;
+    if (top.node.cell != nullptr) {
+      if (measure_vertices(top.node.id, *top.node.cell)) break;
+      continue;
+    }
+    int num_cells = 0;
+    S2CellId end = top.node.id.range_max().next();
+    for (it.Seek(top.node.id.range_min());
+         !it.done() && it.id() < end && num_cells <= kMaxCellsToMeasure;
+         it.Next()) {
+      ++num_cells;
+    }
+    if (num_cells <= kMaxCellsToMeasure) {
+      bool done = false;
+      for (it.Seek(top.node.id.range_min());
+           !done && !it.done() && it.id() < end; it.Next()) {
+        done = measure_vertices(it.id(), it.cell());
+      }
+      if (done) break;
+      continue;
+    }
+    for (S2CellId child = top.node.id.child_begin();
+         child != top.node.id.child_end(); child = child.next()) {
+      Node node;
+      if (MakeNode(&it, child, &node)) enqueue(node);
+    }
+  }
+  return max_dist;
+}
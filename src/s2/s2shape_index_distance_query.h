@@ -0,0 +1,150 @@
+// Copyright 2018 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef S2_S2SHAPE_INDEX_DISTANCE_QUERY_H_
+#define S2_S2SHAPE_INDEX_DISTANCE_QUERY_H_
+
+#include "s2/s1chord_angle.h"
+#include "s2/s2shape_index.h"
+
+// S2ShapeIndexDistanceQuery measures distances between the geometry in two
+// S2ShapeIndexes A and B, e.g. a coastline and a network of shipping lanes.
+// It supports the minimum distance, "within distance" tests, and the
+// Hausdorff distance.
+//
+// The minimum distance is computed by walking the cells of both indexes
+// simultaneously, starting from the top-level cells and using the distance
+// between each pair of cells as a lower bound for the distance between their
+// edges.  Pairs of cells that cannot contain a closer pair of edges are
+// pruned without being subdivided.  This is much faster than using an
+// S2ClosestEdgeQuery with an S2ClosestEdgeQuery::ShapeIndexTarget when both
+// indexes are large, since the latter runs a nested query for every cell of
+// the first index that it visits.
+//
+// Example usage:
+//
+//   S2ShapeIndexDistanceQuery query(&coastline_index, &lanes_index);
+//   if (query.IsDistanceLess(S1ChordAngle(S1Angle::Degrees(0.1)))) { ... }
+//
+// This class is not thread-safe.  To use it in parallel, each thread should
+// construct its own instance.
+class S2ShapeIndexDistanceQuery {
+ public:
+  class Options {
+   public:
+    Options();
+
+    // Specifies that distances should be measured to the boundary and
+    // interior of polygons rather than to polygon boundaries only.  In other
+    // words, the distance is zero if a polygon of either index contains any
+    // point of the other index.
+    //
+    // DEFAULT: true
+    bool include_interiors() const;
+    void set_include_interiors(bool include_interiors);
+
+   private:
+    bool include_interiors_;
+  };
+
+  // REQUIRES: "a" and "b" must persist for the lifetime of this object.
+  S2ShapeIndexDistanceQuery(const S2ShapeIndex* a, const S2ShapeIndex* b,
+                            const Options& options = Options());
+
+  const Options& options() const { return options_; }
+
+  // Returns the minimum distance between the geometry in A and B, or
+  // S1ChordAngle::Infinity() if either index contains no geometry.
+  S1ChordAngle GetDistance();
+
+  // Returns true if the distance between A and B is less than "limit".  This
+  // is faster than GetDistance(), since the search stops as soon as any pair
+  // of edges closer than "limit" is found.
+  bool IsDistanceLess(S1ChordAngle limit);
+
+  // Like IsDistanceLess(), but also returns true if the distance between A
+  // and B is exactly equal to "limit".
+  bool IsDistanceLessOrEqual(S1ChordAngle limit);
+
+  // Returns the directed Hausdorff distance from A to B, i.e. the maximum
+  // distance from any vertex of A to the geometry of B.  (Only the vertices
+  // of A are considered, so for polylines and polygons the result may be
+  // slightly smaller than the true maximum distance from any point of A.)
+  // Returns zero if A has no vertices, and S1ChordAngle::Infinity() if A has
+  // vertices but B contains no geometry.
+  //
+  // The cells of A are visited in decreasing order of an upper bound on the
+  // distance from their vertices to B, and cells whose upper bound does not
+  // exceed the current maximum are pruned.  Vertices are first compared
+  // against an edge of B that was close to a previously measured vertex, so
+  // B is queried only for vertices that might increase the maximum.
+  S1ChordAngle GetDirectedHausdorffDistance();
+
+  // Returns the (undirected) Hausdorff distance between A and B, i.e. the
+  // maximum of the directed distances in both directions.
+  S1ChordAngle GetHausdorffDistance();
+
+  // Returns true if the directed Hausdorff distance from A to B is less than
+  // "limit".  This is faster than GetDirectedHausdorffDistance(), since cells
+  // of A whose upper bound is less than "limit" are pruned immediately and
+  // the search stops as soon as any vertex of A is found whose distance to B
+  // is at least "limit".  For example, this can be used to test whether a
+  // recorded GPS trace stays within 50 meters of a planned route.
+  bool IsDirectedHausdorffDistanceLess(S1ChordAngle limit);
+
+  // Returns true if the (undirected) Hausdorff distance between A and B is
+  // less than "limit".
+  bool IsHausdorffDistanceLess(S1ChordAngle limit);
+
+ private:
+  // Returns the minimum distance between the edges of A and B if it is less
+  // than "limit", and "limit" otherwise.  If "stop_early" is true, returns
+  // as soon as any distance less than "limit" is found.
+  S1ChordAngle GetEdgeDistance(S1ChordAngle limit, bool stop_early) const;
+
+  // Returns true if a polygon of either index contains a point of the other.
+  bool InteriorsIntersect() const;
+
+  // Returns the directed Hausdorff distance from "a" to "b" if it is greater
+  // than "min_dist", and "min_dist" otherwise.  If "stop_early" is true,
+  // returns some value greater than "min_dist" as soon as any vertex of "a"
+  // farther than "min_dist" from "b" is found.
+  static S1ChordAngle GetDirectedHausdorffDistance(
+      const S2ShapeIndex& a, const S2ShapeIndex& b, const Options& options,
+      S1ChordAngle min_dist, bool stop_early);
+
+  const S2ShapeIndex* a_;
+  const S2ShapeIndex* b_;
+  Options options_;
+};
+
+
+//////////////////   Implementation details follow   ////////////////////
+
+
+inline S2ShapeIndexDistanceQuery::Options::Options()
+    : include_interiors_(true) {
+}
+
+inline bool S2ShapeIndexDistanceQuery::Options::include_interiors() const {
+  return include_interiors_;
+}
+
+inline void S2ShapeIndexDistanceQuery::Options::set_include_interiors(
+    bool include_interiors) {
+  include_interiors_ = include_interiors;
+}
+
+#endif  // S2_S2SHAPE_INDEX_DISTANCE_QUERY_H_
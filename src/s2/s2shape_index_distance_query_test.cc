@@ -0,0 +1,170 @@
+// Copyright 2018 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "s2/s2shape_index_distance_query.h"
+
+#include <algorithm>
+#include <memory>
+
+#include <gtest/gtest.h>
+#include "s2/third_party/absl/memory/memory.h"
+#include "s2/mutable_s2shape_index.h"
+#include "s2/s1angle.h"
+#include "s2/s2cap.h"
+#include "s2/s2closest_edge_query.h"
+#include "s2/s2edge_distances.h"
+#include "s2/s2loop.h"
+#include "s2/s2testing.h"
+#include "s2/s2text_format.h"
+
+using absl::make_unique;
+
+namespace {
+
+using Options = S2ShapeIndexDistanceQuery::Options;
+
+S1ChordAngle Degrees(double degrees) {
+  return S1ChordAngle(S1Angle::Degrees(degrees));
+}
+
+TEST(S2ShapeIndexDistanceQuery, EmptyIndexes) {
+  auto empty = s2textformat::MakeIndexOrDie("# #");
+  auto index = s2textformat::MakeIndexOrDie("# 5:5, 5:6 #");
+  S2ShapeIndexDistanceQuery query(empty.get(), index.get());
+  EXPECT_EQ(S1ChordAngle::Infinity(), query.GetDistance());
+  EXPECT_FALSE(query.IsDistanceLess(S1ChordAngle::Infinity()));
+  EXPECT_EQ(S1ChordAngle::Zero(), query.GetDirectedHausdorffDistance());
+  EXPECT_EQ(S1ChordAngle::Infinity(), query.GetHausdorffDistance());
+  EXPECT_FALSE(query.IsDirectedHausdorffDistanceLess(S1ChordAngle::Zero()));
+  EXPECT_TRUE(query.IsDirectedHausdorffDistanceLess(Degrees(1)));
+  EXPECT_FALSE(query.IsHausdorffDistanceLess(S1ChordAngle::Infinity()));
+}
+
+TEST(S2ShapeIndexDistanceQuery, Polylines) {
+  // Two polylines about two degrees apart (the edges are geodesics, so they
+  // are not exactly parallel), where the second is longer than the first.
+  auto a = s2textformat::MakeIndexOrDie("# 5:5, 5:15 #");
+  auto b = s2textformat::MakeIndexOrDie("# 7:5, 7:25 #");
+  S2ShapeIndexDistanceQuery query(a.get(), b.get());
+  S1ChordAngle distance = query.GetDistance();
+  EXPECT_NEAR(2.0, distance.ToAngle().degrees(), 0.2);
+  EXPECT_FALSE(query.IsDistanceLess(distance));
+  EXPECT_TRUE(query.IsDistanceLessOrEqual(distance));
+  EXPECT_TRUE(query.IsDistanceLess(distance.Successor()));
+  EXPECT_NEAR(2.0, query.GetDirectedHausdorffDistance().ToAngle().degrees(),
+              0.2);
+  EXPECT_NEAR(10.0, query.GetHausdorffDistance().ToAngle().degrees(), 0.5);
+  EXPECT_TRUE(query.IsDirectedHausdorffDistanceLess(Degrees(3)));
+  EXPECT_FALSE(query.IsDirectedHausdorffDistanceLess(Degrees(1)));
+  EXPECT_FALSE(query.IsHausdorffDistanceLess(Degrees(3)));
+  EXPECT_TRUE(query.IsHausdorffDistanceLess(Degrees(11)));
+}
+
+TEST(S2ShapeIndexDistanceQuery, Interiors) {
+  // A polyline inside a polygon, far from the polygon boundary.
+  auto a = s2textformat::MakeIndexOrDie("# # 1:1, 1:20, 20:20, 20:1");
+  auto b = s2textformat::MakeIndexOrDie("# 10:10, 11:11 #");
+  S2ShapeIndexDistanceQuery query(a.get(), b.get());
+  EXPECT_EQ(S1ChordAngle::Zero(), query.GetDistance());
+  EXPECT_TRUE(query.IsDistanceLess(Degrees(1)));
+  EXPECT_EQ(S1ChordAngle::Zero(),
+            S2ShapeIndexDistanceQuery(b.get(), a.get())
+            .GetDirectedHausdorffDistance());
+
+  Options options;
+  options.set_include_interiors(false);
+  S2ShapeIndexDistanceQuery boundary_query(a.get(), b.get(), options);
+  EXPECT_LT(Degrees(5), boundary_query.GetDistance());
+  EXPECT_FALSE(boundary_query.IsDistanceLess(Degrees(5)));
+}
+
+// Adds "num_loops" random loops within "cap" to "index".
+void AddRandomLoops(const S2Cap& cap, int num_loops, S1Angle radius,
+                    MutableS2ShapeIndex* index) {
+  for (int i = 0; i < num_loops; ++i) {
+    index->Add(make_unique<S2Loop::OwningShape>(S2Loop::MakeRegularLoop(
+        S2Testing::SamplePoint(cap), radius, 8)));
+  }
+}
+
+// Returns the minimum distance between the edges of "a" and "b".
+S1ChordAngle GetBruteForceDistance(const S2ShapeIndex& a,
+                                   const S2ShapeIndex& b) {
+  S1ChordAngle min_dist = S1ChordAngle::Infinity();
+  for (const S2Shape* a_shape : a) {
+    for (const S2Shape* b_shape : b) {
+      for (int i = 0; i < a_shape->num_edges(); ++i) {
+        S2Shape::Edge a_edge = a_shape->edge(i);
+        for (int j = 0; j < b_shape->num_edges(); ++j) {
+          S2Shape::Edge b_edge = b_shape->edge(j);
+          S2::UpdateEdgePairMinDistance(a_edge.v0, a_edge.v1,
+                                        b_edge.v0, b_edge.v1, &min_dist);
+        }
+      }
+    }
+  }
+  return min_dist;
+}
+
+// Returns the maximum distance from any vertex of "a" to "b".
+S1ChordAngle GetBruteForceDirectedHausdorffDistance(const S2ShapeIndex& a,
+                                                    const S2ShapeIndex& b) {
+  S2ClosestEdgeQuery query(&b);
+  S1ChordAngle max_dist = S1ChordAngle::Zero();
+  for (const S2Shape* shape : a) {
+    for (int i = 0; i < shape->num_edges(); ++i) {
+      S2ClosestEdgeQuery::PointTarget target(shape->edge(i).v0);
+      max_dist = std::max(max_dist, query.GetDistance(&target));
+    }
+  }
+  return max_dist;
+}
+
+TEST(S2ShapeIndexDistanceQuery, RandomLoopsMatchBruteForce) {
+  S2Testing::rnd.Reset(1);
+  for (int iter = 0; iter < 10; ++iter) {
+    // Half of the time the loops of A and B are interleaved.
+    S2Point a_center = S2Testing::RandomPoint();
+    S2Point b_center = (iter % 2) ? a_center : S2Testing::RandomPoint();
+    MutableS2ShapeIndex a, b;
+    AddRandomLoops(S2Cap(a_center, S1Angle::Degrees(5)), 100,
+                   S1Angle::Degrees(0.1), &a);
+    AddRandomLoops(S2Cap(b_center, S1Angle::Degrees(5)), 100,
+                   S1Angle::Degrees(0.1), &b);
+    Options options;
+    options.set_include_interiors(false);
+    S2ShapeIndexDistanceQuery query(&a, &b, options);
+    S1ChordAngle expected = GetBruteForceDistance(a, b);
+    EXPECT_EQ(expected, query.GetDistance());
+    EXPECT_FALSE(query.IsDistanceLess(expected));
+    EXPECT_TRUE(query.IsDistanceLessOrEqual(expected));
+
+    S2ShapeIndexDistanceQuery interior_query(&a, &b);
+    S1ChordAngle a_to_b = GetBruteForceDirectedHausdorffDistance(a, b);
+    S1ChordAngle b_to_a = GetBruteForceDirectedHausdorffDistance(b, a);
+    EXPECT_EQ(a_to_b, interior_query.GetDirectedHausdorffDistance());
+    EXPECT_EQ(b_to_a,
+              S2ShapeIndexDistanceQuery(&b, &a).GetDirectedHausdorffDistance());
+    S1ChordAngle hausdorff = std::max(a_to_b, b_to_a);
+    EXPECT_EQ(hausdorff, interior_query.GetHausdorffDistance());
+    EXPECT_FALSE(interior_query.IsDirectedHausdorffDistanceLess(a_to_b));
+    EXPECT_TRUE(
+        interior_query.IsDirectedHausdorffDistanceLess(a_to_b.Successor()));
+    EXPECT_FALSE(interior_query.IsHausdorffDistanceLess(hausdorff));
+    EXPECT_TRUE(interior_query.IsHausdorffDistanceLess(hausdorff.Successor()));
+  }
+}
+
+}  // namespace
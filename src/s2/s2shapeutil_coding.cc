@@ -157,31 +157,33 @@ unique_ptr<S2Shape> LazyDecodeShape(S2Shape::TypeTag tag, Decoder* decoder) {
 
 bool EncodeTaggedShapes(const S2ShapeIndex& index,
                         const ShapeEncoder& shape_encoder,
-                        Encoder* encoder) {
-  s2coding::StringVectorEncoder shape_vector;
+                        Encoder* encoder, int num_threads) {
   for (S2Shape* shape : index) {
-    Encoder* sub_encoder = shape_vector.AddViaEncoder();
-    if (shape == nullptr) continue;  // Encode as zero bytes.
-
-    uint32 tag = shape->type_tag();
-    if (tag == S2Shape::kNoTypeTag) {
-      S2_LOG(DFATAL) << "Unsupported S2Shape type: " << tag;
+    if (shape != nullptr && shape->type_tag() == S2Shape::kNoTypeTag) {
+      S2_LOG(DFATAL) << "Unsupported S2Shape type: " << shape->type_tag();
       return false;
     }
-    sub_encoder->Ensure(Encoder::kVarintMax32);
-    sub_encoder->put_varint32(tag);
-    shape_encoder(*shape, sub_encoder);
   }
-  shape_vector.Encode(encoder);
+  s2coding::StringVectorEncoder::EncodeParallel(
+      index.num_shape_ids(),
+      [&index, &shape_encoder](int id, Encoder* sub_encoder) {
+        S2Shape* shape = index.shape(id);
+        if (shape == nullptr) return;  // Encode as zero bytes.
+        sub_encoder->Ensure(Encoder::kVarintMax32);
+        sub_encoder->put_varint32(shape->type_tag());
+        shape_encoder(*shape, sub_encoder);
+      }, num_threads, encoder);
   return true;
 }
 
-bool FastEncodeTaggedShapes(const S2ShapeIndex& index, Encoder* encoder) {
-  return EncodeTaggedShapes(index, FastEncodeShape, encoder);
+bool FastEncodeTaggedShapes(const S2ShapeIndex& index, Encoder* encoder,
+                            int num_threads) {
+  return EncodeTaggedShapes(index, FastEncodeShape, encoder, num_threads);
 }
 
-bool CompactEncodeTaggedShapes(const S2ShapeIndex& index, Encoder* encoder) {
-  return EncodeTaggedShapes(index, CompactEncodeShape, encoder);
+bool CompactEncodeTaggedShapes(const S2ShapeIndex& index, Encoder* encoder,
+                               int num_threads) {
+  return EncodeTaggedShapes(index, CompactEncodeShape, encoder, num_threads);
 }
 
 TaggedShapeFactory::TaggedShapeFactory(const ShapeDecoder& shape_decoder,
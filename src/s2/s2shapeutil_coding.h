@@ -114,25 +114,31 @@ std::unique_ptr<S2Shape> LazyDecodeShape(S2Shape::TypeTag tag,
 // This is because when the index is decoded, the shape vector is required as
 // a parameter.
 //
+// If "num_threads" is greater than one, the shapes are encoded concurrently
+// using that many threads (in which case "shape_encoder" must be safe to call
+// from multiple threads).  The output does not depend on "num_threads".
+//
 // REQUIRES: "encoder" uses the default constructor, so that its buffer
 //           can be enlarged as necessary by calling Ensure(int).
 bool EncodeTaggedShapes(const S2ShapeIndex& index,
                         const ShapeEncoder& shape_encoder,
-                        Encoder* encoder);
+                        Encoder* encoder, int num_threads = 1);
 
 // Convenience function that calls EncodeTaggedShapes using FastEncodeShape as
 // the ShapeEncoder.
 //
 // REQUIRES: "encoder" uses the default constructor, so that its buffer
 //           can be enlarged as necessary by calling Ensure(int).
-bool FastEncodeTaggedShapes(const S2ShapeIndex& index, Encoder* encoder);
+bool FastEncodeTaggedShapes(const S2ShapeIndex& index, Encoder* encoder,
+                            int num_threads = 1);
 
 // Convenience function that calls EncodeTaggedShapes using CompactEncodeShape
 // as the ShapeEncoder.
 //
 // REQUIRES: "encoder" uses the default constructor, so that its buffer
 //           can be enlarged as necessary by calling Ensure(int).
-bool CompactEncodeTaggedShapes(const S2ShapeIndex& index, Encoder* encoder);
+bool CompactEncodeTaggedShapes(const S2ShapeIndex& index, Encoder* encoder,
+                               int num_threads = 1);
 
 // A ShapeFactory that decodes a vector generated by EncodeTaggedShapes()
 // above.  Example usage:
@@ -221,11 +227,15 @@ class WrappedShapeFactory : public S2ShapeIndex::ShapeFactory {
 // This is useful for encoding experimental or locally defined types, or when
 // the S2Shape type in a given index is known in advance.
 //
+// If "num_threads" is greater than one, the shapes are encoded concurrently
+// using that many threads.  The output does not depend on "num_threads".
+//
 // REQUIRES: The Shape class must have an Encode(Encoder*) method.
 // REQUIRES: "encoder" uses the default constructor, so that its buffer
 //           can be enlarged as necessary by calling Ensure(int).
 template <class Shape>
-void EncodeHomogeneousShapes(const S2ShapeIndex& index, Encoder* encoder);
+void EncodeHomogeneousShapes(const S2ShapeIndex& index, Encoder* encoder,
+                             int num_threads = 1);
 
 // A ShapeFactory that decodes shapes of a given fixed type (e.g.,
 // EncodedS2LaxPolylineShape).  Example usage:
@@ -255,13 +265,13 @@ class HomogeneousShapeFactory : public S2ShapeIndex::ShapeFactory {
 
 
 template <class Shape>
-void EncodeHomogeneousShapes(const S2ShapeIndex& index, Encoder* encoder) {
-  s2coding::StringVectorEncoder shape_vector;
-  for (S2Shape* shape : index) {
-    S2_DCHECK(shape != nullptr);
-    down_cast<Shape*>(shape)->Encode(shape_vector.AddViaEncoder());
-  }
-  shape_vector.Encode(encoder);
+void EncodeHomogeneousShapes(const S2ShapeIndex& index, Encoder* encoder,
+                             int num_threads) {
+  s2coding::StringVectorEncoder::EncodeParallel(
+      index.num_shape_ids(), [&index](int id, Encoder* sub_encoder) {
+        S2_DCHECK(index.shape(id) != nullptr);
+        down_cast<Shape*>(index.shape(id))->Encode(sub_encoder);
+      }, num_threads, encoder);
 }
 
 template <class Shape>
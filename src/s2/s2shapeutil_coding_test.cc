@@ -19,10 +19,17 @@
 
 #include <gtest/gtest.h>
 #include "s2/util/coding/coder.h"
+#include "s2/mutable_s2shape_index.h"
+#include "s2/s1angle.h"
+#include "s2/s2lax_polyline_shape.h"
+#include "s2/s2loop.h"
+#include "s2/s2point_vector_shape.h"
 #include "s2/s2polygon.h"
+#include "s2/s2testing.h"
 #include "s2/s2text_format.h"
 
 using absl::make_unique;
+using std::vector;
 
 namespace s2shapeutil {
 
@@ -51,4 +58,60 @@ TEST(FastEncodeTaggedShapes, MixedShapes) {
             s2textformat::ToString(decoded_index));
 }
 
+TEST(FastEncodeTaggedShapes, EncoderSink) {
+  // Encoding to an EncoderSink must produce the same bytes as encoding to a
+  // memory buffer.
+  auto index = s2textformat::MakeIndexOrDie(
+      "0:0 | 0:1 # 1:1, 1:2, 1:3 # 2:2; 2:3, 2:4, 3:3");
+  Encoder expected;
+  s2shapeutil::FastEncodeTaggedShapes(*index, &expected);
+  string output;
+  StringEncoderSink sink(&output);
+  Encoder actual(&sink, 16);
+  s2shapeutil::FastEncodeTaggedShapes(*index, &actual);
+  ASSERT_TRUE(actual.Flush());
+  EXPECT_EQ(string(expected.base(), expected.length()), output);
+}
+
+TEST(FastEncodeTaggedShapes, ParallelEncode) {
+  // Encoding with multiple threads must produce the same bytes as encoding
+  // with a single thread.
+  MutableS2ShapeIndex index;
+  for (int i = 0; i < 1000; ++i) {
+    switch (i % 3) {
+      case 0:
+        index.Add(make_unique<S2PointVectorShape>(
+            vector<S2Point>(1 + i % 5, S2Testing::RandomPoint())));
+        break;
+      case 1:
+        index.Add(make_unique<S2LaxPolylineShape>(
+            vector<S2Point>{S2Testing::RandomPoint(),
+                            S2Testing::RandomPoint()}));
+        break;
+      default: {
+        auto loop = S2Loop::MakeRegularLoop(S2Testing::RandomPoint(),
+                                            S1Angle::Degrees(1), 3 + i % 20);
+        index.Add(make_unique<S2Polygon::OwningShape>(
+            make_unique<S2Polygon>(std::move(loop))));
+        break;
+      }
+    }
+  }
+  Encoder expected;
+  ASSERT_TRUE(s2shapeutil::FastEncodeTaggedShapes(index, &expected));
+  Encoder actual;
+  ASSERT_TRUE(s2shapeutil::FastEncodeTaggedShapes(index, &actual, 4));
+  EXPECT_EQ(string(expected.base(), expected.length()),
+            string(actual.base(), actual.length()));
+
+  string output;
+  StringEncoderSink sink(&output);
+  Encoder sink_encoder(&sink, 256);
+  ASSERT_TRUE(s2shapeutil::CompactEncodeTaggedShapes(index, &sink_encoder, 4));
+  ASSERT_TRUE(sink_encoder.Flush());
+  Encoder compact;
+  ASSERT_TRUE(s2shapeutil::CompactEncodeTaggedShapes(index, &compact));
+  EXPECT_EQ(string(compact.base(), compact.length()), output);
+}
+
 }  // namespace s2shapeutil
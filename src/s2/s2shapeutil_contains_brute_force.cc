@@ -17,6 +17,7 @@
 
 #include "s2/s2shapeutil_contains_brute_force.h"
 
+#include <algorithm>
 #include <utility>
 #include "s2/s2edge_crosser.h"
 
@@ -30,9 +31,15 @@ bool ContainsBruteForce(const S2Shape& shape, const S2Point& point) {
 
   S2CopyingEdgeCrosser crosser(ref_point.point, point);
   bool inside = ref_point.contained;
-  for (int e = 0; e < shape.num_edges(); ++e) {
-    auto edge = shape.edge(e);
-    inside ^= crosser.EdgeOrVertexCrossing(edge.v0, edge.v1);
+  static const int kEdgeBatchSize = 64;
+  S2Shape::Edge edges[kEdgeBatchSize];
+  int num_edges = shape.num_edges();
+  for (int start = 0; start < num_edges; start += kEdgeBatchSize) {
+    int n = std::min(kEdgeBatchSize, num_edges - start);
+    shape.GetEdges(start, n, edges);
+    for (int i = 0; i < n; ++i) {
+      inside ^= crosser.EdgeOrVertexCrossing(edges[i].v0, edges[i].v1);
+    }
   }
   return inside;
 }
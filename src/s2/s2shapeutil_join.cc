@@ -0,0 +1,330 @@
+// Copyright 2018 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "s2/s2shapeutil_join.h"
+
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "s2/s2cell_id.h"
+#include "s2/s2closest_edge_query.h"
+#include "s2/s2contains_point_query.h"
+#include "s2/s2edge_crosser.h"
+#include "s2/util/thread/parallel_for.h"
+
+using std::unique_ptr;
+using std::vector;
+
+namespace s2shapeutil {
+
+namespace {
+
+// The number of S2ShapeIndex cells (of the first index) in each chunk of the
+// S2CellId range that is processed by a single thread.
+const int kJoinChunkSize = 256;
+
+// The number of shapes (of the second index) in each chunk processed by a
+// single thread when looking for pairs within max_distance().
+const int kDistanceChunkSize = 16;
+
+inline uint64 PairKey(int32 a_shape_id, int32 b_shape_id) {
+  return (uint64{static_cast<uint32>(a_shape_id)} << 32) |
+      static_cast<uint32>(b_shape_id);
+}
+
+inline ShapeIdPair KeyPair(uint64 key) {
+  return ShapeIdPair(static_cast<int32>(key >> 32), static_cast<int32>(key));
+}
+
+// Positions "it" at the first cell whose range_max() is at least "target",
+// i.e. the first cell that contains or follows the leaf cell "target".
+void SeekToLeaf(S2ShapeIndex::Iterator* it, S2CellId target) {
+  it->Seek(target);
+  if (it->Prev() && it->id().range_max() < target) it->Next();
+}
+
+// ShapeJoiner finds the pairs of intersecting shapes within a range of
+// S2CellIds.  Each thread has its own ShapeJoiner, which accumulates the
+// pairs found in all the ranges processed by that thread.
+class ShapeJoiner {
+ public:
+  ShapeJoiner(const S2ShapeIndex& a_index, const S2ShapeIndex& b_index)
+      : a_index_(a_index), b_index_(b_index),
+        a_query_(&a_index), b_query_(&b_index) {
+  }
+
+  // Visits every pair of overlapping cells (one from each index) such that
+  // the smaller cell begins within the leaf cell range [begin, end).  This
+  // ensures that each pair of cells is visited by exactly one range.
+  void JoinRange(S2CellId begin, S2CellId end);
+
+  // Returns all the intersecting pairs found by JoinRange().  Should be
+  // called once, after all the ranges have been processed.
+  std::unordered_set<uint64> Finish();
+
+ private:
+  using Iterator = S2ShapeIndex::Iterator;
+
+  void JoinCells(const Iterator& ai, const Iterator& bi, S2CellId small_id);
+  bool ContainsCenter(const S2ContainsPointQuery<S2ShapeIndex>& query,
+                      const Iterator& it, const S2ClippedShape& clipped,
+                      S2CellId small_id, const S2Point& center) const;
+  bool EdgesIntersect(const S2ClippedShape& a_clipped,
+                      const S2ClippedShape& b_clipped) const;
+  bool ContainsVertex(const S2ContainsPointQuery<S2ShapeIndex>& query,
+                      const Iterator& it, const S2ClippedShape& clipped,
+                      const S2Shape& other,
+                      const S2ClippedShape& other_clipped,
+                      S2CellId small_id) const;
+
+  const S2ShapeIndex& a_index_;
+  const S2ShapeIndex& b_index_;
+  S2ContainsPointQuery<S2ShapeIndex> a_query_, b_query_;
+
+  // Pairs that are known to intersect.
+  std::unordered_set<uint64> found_;
+};
+
+void ShapeJoiner::JoinRange(S2CellId begin, S2CellId end) {
+  // This is a simpler version of the merge in VisitCrossingEdgePairs(),
+  // since we need to visit each pair of overlapping cells individually.
+  Iterator ai(&a_index_), bi(&b_index_);
+  SeekToLeaf(&ai, begin);
+  SeekToLeaf(&bi, begin);
+  while (!ai.done() && !bi.done()) {
+    if (ai.id().range_max() < bi.id().range_min()) {
+      // The A and B cells don't overlap, and A precedes B.
+      SeekToLeaf(&ai, bi.id().range_min());
+    } else if (bi.id().range_max() < ai.id().range_min()) {
+      // The A and B cells don't overlap, and B precedes A.
+      SeekToLeaf(&bi, ai.id().range_min());
+    } else {
+      // One cell contains the other.  We advance past the smaller cell (or
+      // both cells, if they are the same).
+      bool a_is_larger = ai.id().lsb() >= bi.id().lsb();
+      S2CellId small_id = a_is_larger ? bi.id() : ai.id();
+      if (small_id.range_min() >= end) break;
+      if (small_id.range_min() >= begin) JoinCells(ai, bi, small_id);
+      if (ai.id() == bi.id()) {
+        ai.Next();
+        bi.Next();
+      } else if (a_is_larger) {
+        bi.Next();
+      } else {
+        ai.Next();
+      }
+    }
+  }
+}
+
+// Given two overlapping cells where "small_id" is the smaller one, tests
+// whether each pair of shapes intersects within that cell.  Every pair of
+// intersecting shapes intersects within some such cell: either their edges
+// cross or touch, or one shape contains a vertex of the other (which lies in
+// a cell where both shapes are present), or both contain the center of some
+// cell (which handles full polygons).
+void ShapeJoiner::JoinCells(const Iterator& ai, const Iterator& bi,
+                            S2CellId small_id) {
+  const S2ShapeIndexCell& a_cell = ai.cell();
+  const S2ShapeIndexCell& b_cell = bi.cell();
+  S2Point center = small_id.ToPoint();
+  for (int i = 0; i < a_cell.num_clipped(); ++i) {
+    const S2ClippedShape& a_clipped = a_cell.clipped(i);
+    for (int j = 0; j < b_cell.num_clipped(); ++j) {
+      const S2ClippedShape& b_clipped = b_cell.clipped(j);
+      uint64 key = PairKey(a_clipped.shape_id(), b_clipped.shape_id());
+      if (found_.count(key)) continue;
+      // The shapes intersect if they both contain the center of the smaller
+      // cell, if any of their edges cross or share a vertex, or if one shape
+      // contains a vertex of the other that lies within the smaller cell.
+      // Every vertex is tested (rather than just one per shape) because a
+      // shape may consist of several components, e.g. a multipoint or a
+      // polygon with several shells.
+      const S2Shape& a_shape = *a_index_.shape(a_clipped.shape_id());
+      const S2Shape& b_shape = *b_index_.shape(b_clipped.shape_id());
+      if ((ContainsCenter(a_query_, ai, a_clipped, small_id, center) &&
+           ContainsCenter(b_query_, bi, b_clipped, small_id, center)) ||
+          EdgesIntersect(a_clipped, b_clipped) ||
+          ContainsVertex(a_query_, ai, a_clipped, b_shape, b_clipped,
+                         small_id) ||
+          ContainsVertex(b_query_, bi, b_clipped, a_shape, a_clipped,
+                         small_id)) {
+        found_.insert(key);
+      }
+    }
+  }
+}
+
+// Returns true if the shape clipped to the current cell of "it" contains
+// "center", the center of the cell "small_id" (which is either the current
+// cell or one of its descendants).
+bool ShapeJoiner::ContainsCenter(
+    const S2ContainsPointQuery<S2ShapeIndex>& query, const Iterator& it,
+    const S2ClippedShape& clipped, S2CellId small_id,
+    const S2Point& center) const {
+  if (it.id() == small_id) return clipped.contains_center();
+  return query.ShapeContains(it, clipped, center);
+}
+
+bool ShapeJoiner::EdgesIntersect(const S2ClippedShape& a_clipped,
+                                 const S2ClippedShape& b_clipped) const {
+  int a_num_edges = a_clipped.num_edges();
+  int b_num_edges = b_clipped.num_edges();
+  if (a_num_edges == 0 || b_num_edges == 0) return false;
+  const S2Shape& a_shape = *a_index_.shape(a_clipped.shape_id());
+  const S2Shape& b_shape = *b_index_.shape(b_clipped.shape_id());
+  for (int i = 0; i < a_num_edges; ++i) {
+    S2Shape::Edge a = a_shape.edge(a_clipped.edge(i));
+    S2CopyingEdgeCrosser crosser(a.v0, a.v1);
+    for (int j = 0; j < b_num_edges; ++j) {
+      S2Shape::Edge b = b_shape.edge(b_clipped.edge(j));
+      if (crosser.CrossingSign(b.v0, b.v1) >= 0) return true;
+    }
+  }
+  return false;
+}
+
+// Returns true if the shape "clipped" (which belongs to the current cell of
+// "it") contains a vertex of "other" that belongs to an edge of
+// "other_clipped" and lies within "small_id" (which is either the current
+// cell of "it" or one of its descendants).
+bool ShapeJoiner::ContainsVertex(
+    const S2ContainsPointQuery<S2ShapeIndex>& query, const Iterator& it,
+    const S2ClippedShape& clipped, const S2Shape& other,
+    const S2ClippedShape& other_clipped, S2CellId small_id) const {
+  // Only polygons contain points under the default (SEMI_OPEN) vertex model.
+  if (query.index().shape(clipped.shape_id())->dimension() < 2) return false;
+  for (int i = 0; i < other_clipped.num_edges(); ++i) {
+    S2Shape::Edge edge = other.edge(other_clipped.edge(i));
+    for (const S2Point& v : {edge.v0, edge.v1}) {
+      if (small_id.contains(S2CellId(v)) &&
+          query.ShapeContains(it, clipped, v)) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+std::unordered_set<uint64> ShapeJoiner::Finish() {
+  return std::move(found_);
+}
+
+// Returns the boundaries of the leaf cell ranges that are processed by each
+// thread.  Each range spans approximately "chunk_size" cells of "index".
+vector<S2CellId> GetChunkBoundaries(const S2ShapeIndex& index,
+                                    int chunk_size) {
+  vector<S2CellId> boundaries;
+  boundaries.push_back(S2CellId::Begin(S2CellId::kMaxLevel));
+  int num_cells = 0;
+  for (S2ShapeIndex::Iterator it(&index, S2ShapeIndex::BEGIN);
+       !it.done(); it.Next()) {
+    if (++num_cells % chunk_size == 0) {
+      boundaries.push_back(it.id().range_max().next());
+    }
+  }
+  if (boundaries.back() != S2CellId::End(S2CellId::kMaxLevel)) {
+    boundaries.push_back(S2CellId::End(S2CellId::kMaxLevel));
+  }
+  return boundaries;
+}
+
+// Returns the pairs of shapes such that some edge of the B shape is within
+// "max_distance" of the A shape, as one set per thread.  Together with the
+// intersecting pairs, this yields all the pairs within "max_distance".
+vector<std::unordered_set<uint64>> FindPairsWithinDistance(
+    const S2ShapeIndex& a_index, const S2ShapeIndex& b_index,
+    S1ChordAngle max_distance, int num_threads) {
+  int num_shape_ids = b_index.num_shape_ids();
+  int num_chunks = (num_shape_ids + kDistanceChunkSize - 1) /
+                   kDistanceChunkSize;
+  num_threads = util_thread::NumParallelForThreads(num_chunks, num_threads);
+  vector<std::unordered_set<uint64>> found(num_threads);
+  S2ClosestEdgeQuery::Options query_options;
+  query_options.set_inclusive_max_distance(max_distance);
+  vector<unique_ptr<S2ClosestEdgeQuery>> queries;
+  for (int i = 0; i < num_threads; ++i) {
+    queries.emplace_back(new S2ClosestEdgeQuery(&a_index, query_options));
+  }
+  util_thread::ParallelFor(num_chunks, num_threads, [&](int thread,
+                                                         int chunk) {
+    S2ClosestEdgeQuery* query = queries[thread].get();
+    std::unordered_set<uint64>* thread_found = &found[thread];
+    vector<S2ClosestEdgeQuery::Result> results;
+    int limit = std::min(num_shape_ids, (chunk + 1) * kDistanceChunkSize);
+    for (int id = chunk * kDistanceChunkSize; id < limit; ++id) {
+      const S2Shape* shape = b_index.shape(id);
+      if (shape == nullptr) continue;
+      for (int e = 0; e < shape->num_edges(); ++e) {
+        S2Shape::Edge edge = shape->edge(e);
+        S2ClosestEdgeQuery::EdgeTarget target(edge.v0, edge.v1);
+        query->FindClosestEdges(&target, &results);
+        for (const auto& result : results) {
+          thread_found->insert(PairKey(result.shape_id(), id));
+        }
+      }
+    }
+  });
+  return found;
+}
+
+}  // namespace
+
+vector<ShapeIdPair> JoinShapes(const S2ShapeIndex& a_index,
+                               const S2ShapeIndex& b_index,
+                               const JoinOptions& options) {
+  vector<S2CellId> boundaries;
+  if (options.num_threads() > 1) {
+    boundaries = GetChunkBoundaries(a_index, kJoinChunkSize);
+  } else {
+    boundaries = {S2CellId::Begin(S2CellId::kMaxLevel),
+                  S2CellId::End(S2CellId::kMaxLevel)};
+  }
+  int num_chunks = boundaries.size() - 1;
+  int num_threads =
+      util_thread::NumParallelForThreads(num_chunks, options.num_threads());
+  vector<unique_ptr<ShapeJoiner>> joiners;
+  for (int i = 0; i < num_threads; ++i) {
+    joiners.emplace_back(new ShapeJoiner(a_index, b_index));
+  }
+  util_thread::ParallelFor(num_chunks, num_threads, [&](int thread,
+                                                         int chunk) {
+    joiners[thread]->JoinRange(boundaries[chunk], boundaries[chunk + 1]);
+  });
+  vector<std::unordered_set<uint64>> found(num_threads);
+  util_thread::ParallelFor(num_threads, num_threads, [&](int thread, int i) {
+    found[i] = joiners[i]->Finish();
+  });
+  if (options.max_distance() > S1ChordAngle::Zero()) {
+    for (auto& keys : FindPairsWithinDistance(a_index, b_index,
+                                              options.max_distance(),
+                                              options.num_threads())) {
+      found.push_back(std::move(keys));
+    }
+  }
+  vector<ShapeIdPair> result;
+  for (const auto& keys : found) {
+    for (uint64 key : keys) result.push_back(KeyPair(key));
+  }
+  std::sort(result.begin(), result.end());
+  result.erase(std::unique(result.begin(), result.end()), result.end());
+  return result;
+}
+
+}  // namespace s2shapeutil
@@ -0,0 +1,112 @@
+// Copyright 2018 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef S2_S2SHAPEUTIL_JOIN_H_
+#define S2_S2SHAPEUTIL_JOIN_H_
+
+#include <utility>
+#include <vector>
+#include "s2/base/logging.h"
+#include "s2/third_party/absl/base/integral_types.h"
+#include "s2/s1angle.h"
+#include "s2/s1chord_angle.h"
+#include "s2/s2shape_index.h"
+
+namespace s2shapeutil {
+
+// A pair of shape ids (a_shape_id, b_shape_id), where the first shape
+// belongs to the first index passed to JoinShapes() and the second shape
+// belongs to the second index.
+using ShapeIdPair = std::pair<int32, int32>;
+
+// Options that control the behavior of JoinShapes().
+class JoinOptions {
+ public:
+  JoinOptions();
+
+  // Specifies that pairs of shapes whose distance is at most "max_distance"
+  // should be reported.  If this is zero, only pairs of intersecting shapes
+  // are reported.
+  //
+  // DEFAULT: S1ChordAngle::Zero()
+  S1ChordAngle max_distance() const;
+  void set_max_distance(S1ChordAngle max_distance);
+  void set_max_distance(S1Angle max_distance);
+
+  // The number of threads used to compute the join (including the calling
+  // thread).  The S2CellId range covered by the two indexes is divided into
+  // chunks, which are processed in parallel.  Both indexes must be safe to
+  // read concurrently (which is true of MutableS2ShapeIndex and
+  // EncodedS2ShapeIndex).
+  //
+  // DEFAULT: 1
+  int num_threads() const;
+  void set_num_threads(int num_threads);
+
+ private:
+  S1ChordAngle max_distance_;
+  int num_threads_;
+};
+
+// Returns all pairs (a, b) such that shape "a" of "a_index" and shape "b" of
+// "b_index" intersect (or are within options.max_distance() of each other).
+// The result is sorted and contains each pair at most once.
+//
+// Two shapes intersect if any of their edges cross or share a vertex, or if
+// one shape contains a point of the other.  Containment is determined using
+// the semi-open vertex model (see S2ContainsPointQuery), so for example a
+// point that lies on a polygon boundary but is not one of its vertices may or
+// may not be reported.
+//
+// The join visits the cells of both indexes in S2CellId order, and tests
+// only the pairs of shapes that appear in overlapping cells.  This makes it
+// much faster than querying one index once per shape of the other, e.g.
+// when joining millions of parcels against thousands of zones.
+std::vector<ShapeIdPair> JoinShapes(const S2ShapeIndex& a_index,
+                                    const S2ShapeIndex& b_index,
+                                    const JoinOptions& options = JoinOptions());
+
+
+//////////////////   Implementation details follow   ////////////////////
+
+
+inline JoinOptions::JoinOptions()
+    : max_distance_(S1ChordAngle::Zero()), num_threads_(1) {
+}
+
+inline S1ChordAngle JoinOptions::max_distance() const {
+  return max_distance_;
+}
+
+inline void JoinOptions::set_max_distance(S1ChordAngle max_distance) {
+  max_distance_ = max_distance;
+}
+
+inline void JoinOptions::set_max_distance(S1Angle max_distance) {
+  max_distance_ = S1ChordAngle(max_distance);
+}
+
+inline int JoinOptions::num_threads() const {
+  return num_threads_;
+}
+
+inline void JoinOptions::set_num_threads(int num_threads) {
+  S2_DCHECK_GE(num_threads, 1);
+  num_threads_ = num_threads;
+}
+
+}  // namespace s2shapeutil
+
+#endif  // S2_S2SHAPEUTIL_JOIN_H_
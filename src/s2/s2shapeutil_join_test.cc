@@ -0,0 +1,144 @@
+// Copyright 2018 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "s2/s2shapeutil_join.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include "s2/third_party/absl/memory/memory.h"
+#include "s2/mutable_s2shape_index.h"
+#include "s2/s1angle.h"
+#include "s2/s2cap.h"
+#include "s2/s2loop.h"
+#include "s2/s2testing.h"
+#include "s2/s2text_format.h"
+
+using absl::make_unique;
+using std::string;
+using std::unique_ptr;
+using std::vector;
+
+namespace s2shapeutil {
+namespace {
+
+vector<ShapeIdPair> Join(const string& a_str, const string& b_str,
+                         const JoinOptions& options = JoinOptions()) {
+  auto a = s2textformat::MakeIndexOrDie(a_str);
+  auto b = s2textformat::MakeIndexOrDie(b_str);
+  return JoinShapes(*a, *b, options);
+}
+
+TEST(JoinShapes, EmptyIndexes) {
+  EXPECT_EQ(vector<ShapeIdPair>{}, Join("# #", "# #"));
+  EXPECT_EQ(vector<ShapeIdPair>{}, Join("# # 0:0, 0:1, 1:0", "# #"));
+}
+
+TEST(JoinShapes, Polygons) {
+  // Shape pairs that intersect because their edges cross (0, 0), because one
+  // contains the other (2, 1), or because they share a vertex (1, 3).
+  auto a = "# # 0:0, 0:2, 2:2, 2:0 | 10:10, 10:12, 12:12, 12:10 | "
+      "20:20, 20:30, 30:30, 30:20";
+  auto b = "# # 1:1, 1:3, 3:3, 3:1 | 22:22, 22:23, 23:23, 23:22 | "
+      "50:50, 50:51, 51:51, 51:50 | 12:12, 12:13, 13:13, 13:12";
+  EXPECT_EQ((vector<ShapeIdPair>{{0, 0}, {1, 3}, {2, 1}}), Join(a, b));
+  EXPECT_EQ((vector<ShapeIdPair>{{0, 0}, {1, 2}, {3, 1}}), Join(b, a));
+}
+
+TEST(JoinShapes, MixedDimensions) {
+  // Shape 0 of B contains the points, shapes 1-2 are polylines and shape 3
+  // is a polygon.
+  auto a = "# # 0:0, 0:10, 10:10, 10:0";
+  auto b = "5:5 | 20:20 # 1:1, 2:2 | 30:30, 31:31 # 9:9, 9:11, 11:11, 11:9";
+  EXPECT_EQ((vector<ShapeIdPair>{{0, 0}, {0, 1}, {0, 3}}), Join(a, b));
+
+  // A point that is a polyline vertex (0, 2), and polylines that share a
+  // vertex (1, 1).
+  EXPECT_EQ((vector<ShapeIdPair>{{0, 2}, {1, 1}}),
+            Join("3:3 # 0:0, 1:1 #", "# 5:5, 6:6 | 1:1, 2:0 | 3:3, 4:4 #"));
+}
+
+TEST(JoinShapes, ContainedComponentIsNotFirst) {
+  // Shapes with several components where only a later component is
+  // contained by the other shape.
+  auto a = "# # 0:0, 0:10, 10:10, 10:0";
+  EXPECT_EQ((vector<ShapeIdPair>{{0, 0}}), Join(a, "20:20 | 5:5 # #"));
+  EXPECT_EQ((vector<ShapeIdPair>{{0, 0}}), Join("20:20 | 5:5 # #", a));
+  auto b = "# # 20:20, 20:21, 21:21, 21:20; 5:5, 5:5.1, 5.1:5.1, 5.1:5";
+  EXPECT_EQ((vector<ShapeIdPair>{{0, 0}}), Join(a, b));
+  EXPECT_EQ((vector<ShapeIdPair>{{0, 0}}), Join(b, a));
+  EXPECT_EQ(vector<ShapeIdPair>{},
+            Join(a, "# # 20:20, 20:21, 21:21, 21:20; "
+                 "30:30, 30:30.1, 30.1:30.1, 30.1:30"));
+}
+
+TEST(JoinShapes, FullPolygon) {
+  EXPECT_EQ((vector<ShapeIdPair>{{0, 0}, {0, 1}}),
+            Join("# # full", "# 1:1, 2:2 # 5:5, 5:6, 6:6"));
+  EXPECT_EQ((vector<ShapeIdPair>{{0, 0}}), Join("# # full", "# # full"));
+}
+
+TEST(JoinShapes, MaxDistance) {
+  // The first two polygons are about one degree apart.
+  auto a = "# # 5:5, 5:6, 6:6, 6:5";
+  auto b = "# # 5:7, 5:8, 6:8, 6:7 | 5:15, 5:16, 6:16, 6:15";
+  JoinOptions options;
+  options.set_max_distance(S1Angle::Degrees(0.5));
+  EXPECT_EQ(vector<ShapeIdPair>{}, Join(a, b, options));
+  options.set_max_distance(S1Angle::Degrees(1.5));
+  EXPECT_EQ((vector<ShapeIdPair>{{0, 0}}), Join(a, b, options));
+  // A polyline inside a polygon is within distance of the polygon even
+  // though it is far from the polygon boundary.
+  EXPECT_EQ((vector<ShapeIdPair>{{0, 0}}),
+            Join("# # 1:1, 1:20, 20:20, 20:1", "# 10:10, 11:11 #", options));
+}
+
+// Adds "num_loops" random loops within "cap" to "index", and also appends
+// them to "loops".
+void AddRandomLoops(const S2Cap& cap, int num_loops, S1Angle radius,
+                    MutableS2ShapeIndex* index,
+                    vector<unique_ptr<S2Loop>>* loops) {
+  for (int i = 0; i < num_loops; ++i) {
+    loops->push_back(S2Loop::MakeRegularLoop(
+        S2Testing::SamplePoint(cap), radius, 8));
+    index->Add(make_unique<S2Loop::Shape>(loops->back().get()));
+  }
+}
+
+TEST(JoinShapes, RandomLoopsMatchBruteForce) {
+  S2Testing::rnd.Reset(1);
+  S2Cap cap(S2Testing::RandomPoint(), S1Angle::Degrees(10));
+  MutableS2ShapeIndex a_index, b_index;
+  vector<unique_ptr<S2Loop>> a_loops, b_loops;
+  AddRandomLoops(cap, 1000, S1Angle::Degrees(0.2), &a_index, &a_loops);
+  AddRandomLoops(cap, 100, S1Angle::Degrees(1), &b_index, &b_loops);
+  vector<ShapeIdPair> expected;
+  for (int i = 0; i < a_loops.size(); ++i) {
+    for (int j = 0; j < b_loops.size(); ++j) {
+      if (a_loops[i]->Intersects(b_loops[j].get())) expected.emplace_back(i, j);
+    }
+  }
+  ASSERT_FALSE(expected.empty());
+  for (int num_threads : {1, 4}) {
+    JoinOptions options;
+    options.set_num_threads(num_threads);
+    EXPECT_EQ(expected, JoinShapes(a_index, b_index, options));
+  }
+}
+
+}  // namespace
+}  // namespace s2shapeutil
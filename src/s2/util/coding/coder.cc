@@ -18,8 +18,13 @@
 
 #include "s2/util/coding/coder.h"
 
+#if defined(__unix__) || defined(__APPLE__)
+#include <unistd.h>
+#endif
+
 #include <algorithm>
 #include <cassert>
+#include <cerrno>
 
 #include "s2/base/logging.h"
 #include "s2/third_party/absl/base/integral_types.h"
@@ -27,12 +32,38 @@
 // An initialization value used when we are allowed to
 unsigned char Encoder::kEmptyBuffer = 0;
 
+bool FileDescriptorEncoderSink::Append(const char* data, size_t n) {
+#if defined(__unix__) || defined(__APPLE__)
+  while (n > 0) {
+    ssize_t written = write(fd_, data, n);
+    if (written < 0) {
+      if (errno == EINTR) continue;
+      return false;
+    }
+    data += written;
+    n -= written;
+  }
+  return true;
+#else
+  return false;  // Not supported on this platform.
+#endif
+}
+
 Encoder::Encoder()
   : underlying_buffer_(&kEmptyBuffer) {
 }
 
+Encoder::Encoder(EncoderSink* sink, size_t chunk_size)
+    : sink_(sink) {
+  S2_DCHECK_GT(chunk_size, 0);
+  underlying_buffer_ = std::allocator<unsigned char>().allocate(chunk_size);
+  orig_ = buf_ = underlying_buffer_;
+  limit_ = orig_ + chunk_size;
+}
+
 Encoder::~Encoder() {
   S2_CHECK_LE(buf_, limit_);  // Catch the buffer overflow.
+  if (sink_ != nullptr) FlushToSink();
   if (underlying_buffer_ != &kEmptyBuffer) {
     std::allocator<unsigned char>().deallocate(
         underlying_buffer_, limit_ - orig_);
@@ -47,9 +78,39 @@ int Encoder::varint64_length(uint64 v) {
   return Varint::Length64(v);
 }
 
+void Encoder::FlushToSink() {
+  S2_DCHECK(sink_ != nullptr);
+  const size_t current_len = buf_ - orig_;
+  if (current_len > 0) {
+    if (!sink_->Append(reinterpret_cast<const char*>(orig_), current_len)) {
+      sink_ok_ = false;
+    }
+    flushed_ += current_len;
+    buf_ = orig_;
+  }
+}
+
+bool Encoder::Flush() {
+  if (sink_ == nullptr) return true;
+  FlushToSink();
+  return sink_ok_;
+}
+
 void Encoder::EnsureSlowPath(size_t N) {
   S2_CHECK(ensure_allowed());
   assert(avail() < N);
+  if (sink_ != nullptr) {
+    // Flush the buffered data, and enlarge the buffer only if it is smaller
+    // than the requested size.
+    FlushToSink();
+    if (avail() >= N) return;
+    std::allocator<unsigned char>().deallocate(underlying_buffer_,
+                                               limit_ - orig_);
+    underlying_buffer_ = std::allocator<unsigned char>().allocate(N);
+    orig_ = buf_ = underlying_buffer_;
+    limit_ = orig_ + N;
+    return;
+  }
   assert(length() == 0 || orig_ == underlying_buffer_);
 
   // Double buffer size, but make sure we always have at least N extra bytes
@@ -72,12 +133,12 @@ void Encoder::EnsureSlowPath(size_t N) {
 }
 
 void Encoder::RemoveLast(size_t N) {
-  S2_CHECK(length() >= N);
+  S2_CHECK(static_cast<size_t>(buf_ - orig_) >= N);
   buf_ -= N;
 }
 
 void Encoder::Resize(size_t N) {
-  S2_CHECK(length() >= N);
-  buf_ = orig_ + N;
+  S2_CHECK(length() >= N && N >= flushed_);
+  buf_ = orig_ + (N - flushed_);
   assert(length() == N);
 }
@@ -21,6 +21,7 @@
 #define S2_UTIL_CODING_CODER_H_
 
 #include <cstring>
+#include <string>
 
 // Avoid adding expensive includes here.
 #include "s2/base/casts.h"
@@ -32,6 +33,40 @@
 #include "s2/util/coding/varint.h"
 #include "s2/util/endian/endian.h"
 
+/* Destination for the output of an Encoder that does not buffer its output
+   in memory (see Encoder(EncoderSink*, size_t)). */
+class EncoderSink {
+ public:
+  virtual ~EncoderSink() {}
+
+  // Appends "n" bytes to the output.  Returns false on errors.
+  virtual bool Append(const char* data, size_t n) = 0;
+};
+
+/* An EncoderSink that writes to a file descriptor.  The descriptor is not
+   closed when the sink is destroyed. */
+class FileDescriptorEncoderSink : public EncoderSink {
+ public:
+  explicit FileDescriptorEncoderSink(int fd) : fd_(fd) {}
+  bool Append(const char* data, size_t n) override;
+
+ private:
+  int fd_;
+};
+
+/* An EncoderSink that appends to a string (mainly useful for testing). */
+class StringEncoderSink : public EncoderSink {
+ public:
+  explicit StringEncoderSink(std::string* output) : output_(output) {}
+  bool Append(const char* data, size_t n) override {
+    output_->append(data, n);
+    return true;
+  }
+
+ private:
+  std::string* output_;
+};
+
 /* Class for encoding data into a memory buffer */
 class Decoder;
 class Encoder {
@@ -43,6 +78,31 @@ class Encoder {
 
   // Initialize encoder to encode into "buf"
   Encoder(void* buf, size_t maxn);
+
+  // Creates an Encoder that writes its output to "sink" in chunks of
+  // "chunk_size" bytes, so that the memory used does not depend on the
+  // total size of the output.  Ensure() must be called as usual; it flushes
+  // the buffered data to the sink when necessary (and enlarges the buffer if
+  // more than "chunk_size" bytes are requested).  The output is identical to
+  // what an Encoder created with the default constructor would produce.
+  //
+  // length() returns the total number of bytes encoded, while base() only
+  // returns the data that has not been flushed yet.  clear(), reset(),
+  // RemoveLast() and Resize() may not be used to modify data that has
+  // already been flushed.  The remaining data is flushed when the Encoder is
+  // destroyed, but clients should call Flush() in order to detect errors.
+  //
+  // REQUIRES: "sink" must outlive this object.
+  explicit Encoder(EncoderSink* sink, size_t chunk_size = 1 << 20);
+
+  // Writes any buffered data to the sink.  Returns false if any sink error
+  // has occurred.  Does nothing (and returns true) if there is no sink.
+  bool Flush();
+
+  // Returns true if this Encoder writes to an EncoderSink.  Encoding methods
+  // that would otherwise buffer large amounts of data in memory can use
+  // this to choose an approach that uses less memory.
+  bool has_sink() const { return sink_ != nullptr; }
   void reset(void* buf, size_t maxn);
   void clear();
 
@@ -84,7 +144,8 @@ class Encoder {
   // dec->get_varint64(&val).
   bool put_varint64_from_decoder(Decoder* dec);
 
-  // Return number of bytes encoded so far
+  // Return number of bytes encoded so far (including any bytes that have
+  // already been flushed to the sink).
   size_t length() const;
 
   // Return number of bytes of space remaining in buffer
@@ -121,6 +182,7 @@ class Encoder {
 
  private:
   void EnsureSlowPath(size_t N);
+  void FlushToSink();
 
   // Puts varint64 from decoder for varint64 sizes from 3 ~ 10. This is less
   // common cases compared to 1 - 2 byte varint64. Returns false if either the
@@ -143,6 +205,12 @@ class Encoder {
   // whether or not the Encoder owns it.
   unsigned char* orig_ = nullptr;
 
+  // The destination of the encoded data (if any), the number of bytes that
+  // have been flushed to it, and whether all writes have succeeded.
+  EncoderSink* sink_ = nullptr;
+  size_t flushed_ = 0;
+  bool sink_ok_ = true;
+
   static unsigned char kEmptyBuffer;
 
 #ifndef SWIG
@@ -228,6 +296,7 @@ inline void Encoder::reset(void* b, size_t maxn) {
 }
 
 inline void Encoder::clear() {
+  S2_DCHECK_EQ(flushed_, 0);
   buf_ = orig_;
 }
 
@@ -241,7 +310,7 @@ inline void Encoder::Ensure(size_t N) {
 inline size_t Encoder::length() const {
   S2_DCHECK_GE(buf_, orig_);
   S2_CHECK_LE(buf_, limit_);  // Catch the buffer overflow.
-  return buf_ - orig_;
+  return flushed_ + (buf_ - orig_);
 }
 
 inline size_t Encoder::avail() const {
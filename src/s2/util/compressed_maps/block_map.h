@@ -0,0 +1,197 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <utility>
+#include <vector>
+
+// A static sorted map that stores its entries in fixed-size blocks, laid out
+// for fast lookups rather than for compression.  Each block stores
+// kBlock_size keys (exactly one 64-byte cache line) followed by the
+// corresponding values, so that scanning a range of entries in key order
+// touches contiguous memory.  Lookups first search a small directory that
+// contains the minimum key of every block, stored in Eytzinger (BFS) order
+// so that the search is branch-free and its first few levels share cache
+// lines, and then locate the key within a single block using a comparison
+// count that the compiler vectorizes.
+//
+// The interface mirrors the subset of std::map used by S2PointIndexStatic.
+// Keys must be convertible to and from uint64_t via key.id() and
+// key_type(uint64_t) (e.g. S2CellId), and must be less than
+// std::numeric_limits<uint64_t>::max(), which is used to pad the last block.
+template <typename key_type, typename value_type>
+class block_map {
+public:
+    using size_type = std::size_t;
+    static constexpr size_type kBlock_size = 8;
+
+    struct block {
+        uint64_t keys[kBlock_size];
+        value_type values[kBlock_size];
+    };
+
+protected:
+    struct directory_entry {
+        uint64_t min_key;
+        size_type block_id;
+    };
+
+    std::vector<block> m_blocks;
+    // m_directory[1..num_blocks] in Eytzinger order; m_directory[0] is unused.
+    std::vector<directory_entry> m_directory;
+    size_type m_size = 0;
+
+public:
+    struct const_iterator {
+        typedef const_iterator self_type;
+
+        // Dereferencing an iterator yields a pair-like object whose "second"
+        // member refers directly to the value stored in the map.
+        struct reference {
+            key_type first;
+            const value_type& second;
+        };
+        struct pointer {
+            reference m_ref;
+            const reference* operator->() const { return &m_ref; }
+        };
+        typedef std::ptrdiff_t difference_type;
+        typedef std::bidirectional_iterator_tag iterator_category;
+
+        const block_map* m_map = nullptr;
+        size_type m_pos = 0;
+
+        const_iterator() {}
+
+        const_iterator(const block_map* map, size_type pos)
+            : m_map(map), m_pos(pos)
+        {
+        }
+
+        self_type& operator++() {
+            ++m_pos;
+            return *this;
+        }
+
+        self_type& operator--() {
+            --m_pos;
+            return *this;
+        }
+
+        bool operator==(const self_type& rhs) const {
+            return m_pos == rhs.m_pos;
+        }
+
+        bool operator!=(const self_type& other) const {return !(*this == other);}
+
+        reference operator*() const {
+            const block& b = m_map->m_blocks[m_pos / kBlock_size];
+            size_type slot = m_pos % kBlock_size;
+            return reference{key_type(b.keys[slot]), b.values[slot]};
+        }
+
+        pointer operator->() const {
+            return pointer{**this};
+        }
+
+        // Returns the position of this entry in key order.
+        size_type position() const { return m_pos; }
+    };
+
+    // Iterator routines.
+    const_iterator begin() const { return const_iterator(this, 0); }
+    const_iterator end() const { return const_iterator(this, m_size); }
+
+    // Returns an iterator to the first entry whose key is >= "key".
+    const_iterator lower_bound(const key_type& key) const {
+        return const_iterator(this, lower_bound_position(key.id()));
+    }
+
+    void swap(block_map& x) {
+        m_blocks.swap(x.m_blocks);
+        m_directory.swap(x.m_directory);
+        std::swap(m_size, x.m_size);
+    }
+
+    // Size routines.
+    size_type size() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+    size_type num_blocks() const { return m_blocks.size(); }
+
+    size_type bytes_used() const {
+        return m_blocks.size() * sizeof(block) +
+               m_directory.size() * sizeof(directory_entry);
+    }
+
+    friend bool operator==(const block_map& x, const block_map& y) {
+        if (x.size() != y.size()) return false;
+        for (auto i = x.begin(), j = y.begin(); i != x.end(); ++i, ++j) {
+            if (i->first != j->first || !(i->second == j->second)) return false;
+        }
+        return true;
+    }
+
+    friend bool operator!=(const block_map& x, const block_map& y) {
+        return !(x == y);
+    }
+
+    block_map() {};
+
+    // Builds the map from any sorted associative container whose value type
+    // is std::pair<key_type, value_type> (e.g. std::map).
+    template<class other_map_type>
+    block_map(other_map_type& other) {
+        m_size = other.size();
+        m_blocks.resize((m_size + kBlock_size - 1) / kBlock_size);
+        size_type pos = 0;
+        for (const auto& pair : other) {
+            block& b = m_blocks[pos / kBlock_size];
+            b.keys[pos % kBlock_size] = pair.first.id();
+            b.values[pos % kBlock_size] = pair.second;
+            ++pos;
+        }
+        for (; pos % kBlock_size != 0; ++pos) {
+            m_blocks.back().keys[pos % kBlock_size] =
+                std::numeric_limits<uint64_t>::max();
+        }
+        m_directory.resize(m_blocks.size() + 1);
+        size_type next_block = 0;
+        build_directory(1, &next_block);
+    }
+
+private:
+    // Fills in the Eytzinger subtree rooted at "k" by an in-order traversal.
+    void build_directory(size_type k, size_type* next_block) {
+        if (k >= m_directory.size()) return;
+        build_directory(2 * k, next_block);
+        m_directory[k].min_key = m_blocks[*next_block].keys[0];
+        m_directory[k].block_id = (*next_block)++;
+        build_directory(2 * k + 1, next_block);
+    }
+
+    size_type lower_bound_position(uint64_t key) const {
+        // Find the first block whose minimum key is >= "key".  The entry we
+        // are looking for is either in the preceding block or is the first
+        // entry of that block.
+        const size_type n = m_blocks.size();
+        size_type k = 1;
+        while (k <= n) {
+            k = 2 * k + (m_directory[k].min_key < key);
+        }
+        // Undo the trailing right turns (plus one left turn) to recover the
+        // Eytzinger index of the answer; k == 0 means all blocks are < key.
+        k >>= __builtin_ffsll(~k);
+        size_type next = (k == 0) ? n : m_directory[k].block_id;
+        if (next == 0) return 0;
+
+        // Count the keys in the preceding block that are less than "key".
+        const block& b = m_blocks[next - 1];
+        size_type count = 0;
+        for (size_type i = 0; i < kBlock_size; ++i) {
+            count += (b.keys[i] < key);
+        }
+        return std::min((next - 1) * kBlock_size + count, m_size);
+    }
+};
@@ -5,4 +5,5 @@
 template<class K,class V>
 using std_map = std::map<K,V>;
 
-#include "ef_map.h"
\ No newline at end of file
+#include "ef_map.h"
+#include "block_map.h"
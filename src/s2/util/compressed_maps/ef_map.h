@@ -13,21 +13,29 @@ public:
 protected:
     value_container_type m_values;
     succinct::bit_vector m_ef;
-    size_type m_universe;
+    size_type m_universe = 0;
     quasi_succinct::global_parameters m_params;
 public:
 
     struct const_iterator {
         typedef const_iterator self_type;
-        typedef std::pair<key_type,value_type> pair_type;
-        typedef pair_type& reference;
-        typedef pair_type* pointer;
+
+        // Dereferencing an iterator yields a pair-like object whose "second"
+        // member refers directly to the value stored in the map, so that
+        // references to values remain valid after the iterator moves.
+        struct reference {
+            key_type first;
+            const value_type& second;
+        };
+        struct pointer {
+            reference m_ref;
+            const reference* operator->() const { return &m_ref; }
+        };
         typedef int difference_type;
         typedef std::forward_iterator_tag iterator_category;
 
         quasi_succinct::compact_elias_fano::enumerator m_enum;
         const value_container_type* m_values = nullptr;
-        mutable pair_type m_cur_value;
 
         const_iterator() {
 
@@ -36,7 +44,6 @@ public:
         const_iterator(const const_iterator& other) {
             m_enum = other.m_enum;
             m_values = other.m_values;
-            m_cur_value = other.m_cur_value;
         }
 
         const_iterator(const value_container_type& v,
@@ -55,8 +62,7 @@ public:
         }
 
         self_type operator--() {
-            std::cerr << "USING PREV!!!" << std::endl;
-            m_enum.next(); // TODO
+            m_enum.move(m_enum.position() - 1);
             return *this;
         }
 
@@ -66,14 +72,12 @@ public:
 
         bool operator!=(const self_type& other) const {return !(*this == other);}
 
-        const reference operator*() const {
-            m_cur_value = std::make_pair(key_type(m_enum.value().second),(*m_values)[m_enum.position()]);
-            return m_cur_value;
+        reference operator*() const {
+            return reference{key_type(m_enum.value().second),(*m_values)[m_enum.position()]};
         }
 
-        const pointer operator->() const {
-            m_cur_value = std::make_pair(key_type(m_enum.value().second),(*m_values)[m_enum.position()]);
-            return &m_cur_value;
+        pointer operator->() const {
+            return pointer{**this};
         }
 
         template<class K>
@@ -95,6 +99,8 @@ public:
     void swap(ef_map &x) {
         m_values.swap(x.m_values);
         m_ef.swap(x.m_ef);
+        std::swap(m_universe, x.m_universe);
+        std::swap(m_params, x.m_params);
     }
     void verify() const {
 
@@ -110,7 +116,10 @@ public:
 
     friend bool operator==(const ef_map &x, const ef_map &y) {
         if (x.size() != y.size()) return false;
-        return std::equal(x.begin(), x.end(), y.begin());
+        for (auto i = x.begin(), j = y.begin(); i != x.end(); ++i, ++j) {
+            if (i->first != j->first || !(i->second == j->second)) return false;
+        }
+        return true;
     }
 
     friend bool operator!=(const ef_map &x, const ef_map &y) {
@@ -121,6 +130,7 @@ public:
 
     template<class other_map_type>
     ef_map(other_map_type& other) {
+        if (other.empty()) return;
         auto last = other.rbegin();
         m_universe = last->first.id() + 1;
         size_type n = other.size();
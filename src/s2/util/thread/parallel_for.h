@@ -0,0 +1,69 @@
+// Copyright 2018 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+// A minimal work-sharing loop used by the parallel code paths in this
+// library.  It is intentionally simple: there is no thread pool, and each
+// call starts and joins its own threads.
+
+#ifndef S2_UTIL_THREAD_PARALLEL_FOR_H_
+#define S2_UTIL_THREAD_PARALLEL_FOR_H_
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+namespace util_thread {
+
+// Returns the number of threads that ParallelFor(num_items, num_threads, fn)
+// uses, i.e. "num_threads" clamped to [1, max(1, num_items)].  Callers that
+// keep per-thread state should size it using this function.
+inline int NumParallelForThreads(int num_items, int num_threads) {
+  return std::max(1, std::min(num_threads, num_items));
+}
+
+// Calls fn(thread, i) for each "i" in [0, num_items), using up to
+// "num_threads" threads including the calling thread.  Items are claimed
+// dynamically in increasing order, so they may take different amounts of
+// time.  "thread" is in [0, NumParallelForThreads(num_items, num_threads))
+// and identifies the calling thread, which allows callers to keep
+// per-thread state without locking.  When only one thread is used, all
+// items are processed in order on the calling thread.  Returns once every
+// item has been processed.
+template <class Fn>
+void ParallelFor(int num_items, int num_threads, const Fn& fn) {
+  num_threads = NumParallelForThreads(num_items, num_threads);
+  if (num_threads == 1) {
+    for (int i = 0; i < num_items; ++i) fn(0, i);
+    return;
+  }
+  std::atomic<int> next_item(0);
+  auto worker = [num_items, &next_item, &fn](int thread) {
+    for (;;) {
+      int i = next_item.fetch_add(1, std::memory_order_relaxed);
+      if (i >= num_items) break;
+      fn(thread, i);
+    }
+  };
+  std::vector<std::thread> threads;
+  threads.reserve(num_threads - 1);
+  for (int i = 1; i < num_threads; ++i) threads.emplace_back(worker, i);
+  worker(0);
+  for (auto& thread : threads) thread.join();
+}
+
+}  // namespace util_thread
+
+#endif  // S2_UTIL_THREAD_PARALLEL_FOR_H_